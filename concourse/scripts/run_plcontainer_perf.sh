@@ -36,7 +36,9 @@ psql -d postgres -f plcontainer_src/tests/perfsql/function_setup.sql; \
 psql -d postgres -f plcontainer_src/tests/perfsql/perf_prepare1.sql; \
 nohup psql -d postgres -f plcontainer_src/tests/perfsql/perf_pl1.sql > perf_pl1 2>&1; \
 nohup psql -d postgres -f plcontainer_src/tests/perfsql/perf_py1.sql > perf_py1 2>&1; \
+nohup psql -d postgres -f plcontainer_src/tests/perfsql/perf_text1.sql > perf_text1 2>&1; \
 \""
 
 scp mdw:~/perf_pl1 plcontainer_perf_result/perf_pl1
 scp mdw:~/perf_py1 plcontainer_perf_result/perf_py1
+scp mdw:~/perf_text1 plcontainer_perf_result/perf_text1
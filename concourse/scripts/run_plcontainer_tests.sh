@@ -33,5 +33,10 @@ gpstop -arf; \
 psql -d postgres -f /usr/local/greenplum-db-devel/share/postgresql/plcontainer/plcontainer_install.sql; \
 pushd plcontainer_src/tests; \
 timeout -s 9 60m make tests; \
+plcontainer runtime-replace -r plc_python_shared -i pivotaldata/plcontainer_python_shared:devel -l python -s use_container_logging=yes -s use_shared_memory=yes -s compression_threshold=64; \
+timeout -s 9 30m make transport; \
+plcontainer runtime-replace -r plc_python_shared -i pivotaldata/plcontainer_python_shared:devel -l python -s use_container_logging=yes -s fd_passing_threshold=4096 -s compression_threshold=64; \
+timeout -s 9 30m make transport; \
+plcontainer runtime-replace -r plc_python_shared -i pivotaldata/plcontainer_python_shared:devel -l python -s use_container_logging=yes; \
 popd; \
 \""
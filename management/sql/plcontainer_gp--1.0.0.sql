@@ -22,6 +22,15 @@ CREATE OR REPLACE FUNCTION plcontainer_containers_summary() RETURNS setof contai
 AS '$libdir/plcontainer', 'containers_summary'
 LANGUAGE C VOLATILE;
 
+CREATE OR REPLACE FUNCTION plcontainer_compression_stats(
+    OUT runtime_id text, OUT compression_threshold int,
+    OUT raw_bytes_sent bigint, OUT wire_bytes_sent bigint,
+    OUT raw_bytes_received bigint, OUT wire_bytes_received bigint,
+    OUT blocks_compressed bigint, OUT compress_ms float8, OUT decompress_ms float8)
+RETURNS setof record
+AS '$libdir/plcontainer', 'containers_compression_stats'
+LANGUAGE C VOLATILE;
+
 CREATE OR REPLACE VIEW plcontainer_show_config as
     select gp_segment_id, plcontainer_show_local_config()
         from (
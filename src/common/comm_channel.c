@@ -33,6 +33,7 @@ interpreted as representing official policies, either expressed or implied, of t
 #include "comm_channel.h"
 #include "comm_utils.h"
 #include "comm_connectivity.h"
+#include "comm_memfd.h"
 #include "comm_server.h"
 #include "config.h"
 
@@ -40,9 +41,67 @@ interpreted as representing official policies, either expressed or implied, of t
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
+#ifdef PLC_CLIENT
+#include <pthread.h>
+#endif
+
+/* Keeps the length in front of each bytea array element aligned */
+#define PLC_ARRAY_ELEM_ALIGN(len) (((len) + 3) & ~((size_t) 3))
+
+/*
+ * Row programs
+ *
+ * The types of a row are compiled once into a program, and the rows are
+ * sent and received by running it instead of switching over the type of
+ * every value. A program is a flat array of operations. The segment of a
+ * row starts with a PLC_OP_ROW operation followed by the runs of its
+ * values: consecutive values of the same fixed-width type, or of the same
+ * varlena type, make one run, and the fixed-width ones are put together in
+ * a block on the stack and appended to the buffer at once. The members of
+ * composite values and of the composite elements of arrays get segments of
+ * their own after the segment of the row.
+ *
+ * The programs of calls and results are kept with the descriptors of the
+ * connection, so a function compiles its argument and result rows only
+ * the first time they are sent or received.
+ */
+#define PLC_OP_ROW     'R'
+#define PLC_OP_BOOL    'b'
+#define PLC_OP_INT     'i'
+#define PLC_OP_FLOAT   'f'
+#define PLC_OP_TEXT    't'
+#define PLC_OP_BYTEA   'y'
+#define PLC_OP_ARRAY   'a'
+#define PLC_OP_UDT     'u'
+#define PLC_OP_INVALID '?'
+
+/* Values of a fixed-width run put together on the stack at a time */
+#define PLC_ROW_CHUNK 32
+/* Bytes of the short text and bytea values of a run put together at a time */
+#define PLC_ROW_VARLEN_CHUNK 1024
+
+typedef struct plcRowOp {
+	char code;
+	char width;               /* size of the fixed-width values */
+	bool hasBools;            /* PLC_OP_ROW: the row has booleans */
+	int32 first;              /* index of the first value of the run */
+	int32 count;              /* values of the run, or of the row */
+	struct plcRowOp *end;     /* PLC_OP_ROW: end of the runs of the row */
+	plcType *type;            /* type of the first value of the run */
+	struct plcRowOp *members; /* segment of the members of composite values */
+} plcRowOp;
+
+typedef struct plcRowProgram {
+	int32 n;                  /* values of the row */
+	bool persistent;          /* kept with a descriptor */
+	plcType *types;           /* copies of the types of a persistent program */
+	plcRowOp *ops;
+} plcRowProgram;
 
 static int message_start(plcConn *conn, char msgType);
 static int message_end(plcConn *conn);
+static void commit_descriptors(plcConn *conn);
+static void rollback_descriptors(plcConn *conn);
 static int send_char(plcConn *conn, char c);
 static int send_int16(plcConn *conn, int16 i);
 static int send_int32(plcConn *conn, int32 i);
@@ -53,10 +112,15 @@ static int send_float8(plcConn *conn, float8 f);
 static int send_cstring(plcConn *conn, char *s);
 static int send_bytea(plcConn *conn, char *s);
 static int send_raw_object(plcConn *conn, plcType *type, rawdata *obj);
-static int send_raw_array_iter(plcConn *conn, plcType *type, plcIterator *iter);
-static int send_type(plcConn *conn, plcType *type);
+static int send_value(plcConn *conn, plcType *type, rawdata *obj);
+static int send_raw_array_iter(plcConn *conn, plcType *type, plcIterator *iter, plcRowOp *members);
+static int send_array_nulls(plcConn *conn, char *nulls, int32 size);
+static int send_array_fixed(plcConn *conn, plcType *type, plcIterator *iter);
+static int send_array_varlen(plcConn *conn, plcType *type, plcIterator *iter);
 static int send_udt(plcConn *conn, plcType *type, plcUDT *udt);
+static int send_row(plcConn *conn, plcRowOp *row, rawdata *values, size_t valueStride, bool topLevel);
 static int receive_message_type(plcConn *conn, char *c);
+static int receive_frame(plcConn *conn, char msgType);
 static int receive_char(plcConn *conn, char *c);
 static int receive_int16(plcConn *conn, int16 *i);
 static int receive_int32(plcConn *conn, int32 *i);
@@ -68,56 +132,177 @@ static int receive_raw(plcConn *conn, char *s, size_t len);
 static int receive_cstring(plcConn *conn, char **s);
 static int receive_bytea(plcConn *conn, char **s);
 static int receive_raw_object(plcConn *conn, plcType *type, rawdata *obj);
-static int receive_array(plcConn *conn, plcType *type, rawdata *obj);
+static int receive_cstring_data(plcConn *conn, int32 cnt, char **s);
+static int receive_bytea_data(plcConn *conn, int32 len, char **s);
+static int receive_value(plcConn *conn, plcType *type, rawdata *obj, plcMapping **mappings);
+static int receive_value_fd(plcConn *conn, plcType *type, rawdata *obj, int64 size, plcMapping **mappings);
+static int receive_array(plcConn *conn, plcType *type, rawdata *obj, plcRowOp *members);
+static int receive_array_nulls(plcConn *conn, plcArray *arr);
+static int receive_array_varlen(plcConn *conn, plcType *type, plcArray *arr);
 static int receive_type(plcConn *conn, plcType *type);
 static int receive_udt(plcConn *conn, plcType *type, char **resdata);
-static int send_argument(plcConn *conn, plcArgument *arg);
-static int send_ping(plcConn *conn);
+static int receive_udt_members(plcConn *conn, plcRowOp *members, char **resdata);
+static int receive_row(plcConn *conn, plcRowOp *row, rawdata *values, size_t valueStride,
+                       plcMapping **mappings);
+static void copy_type(plcType *dst, plcType *src, bool persistent);
+static plcRowProgram *compile_row_program(int n, plcType *types, size_t typeStride, bool persistent);
+static void free_row_program(plcRowProgram *program);
+static void release_row_program(plcRowProgram *program);
+static int send_ping(plcConn *conn, plcMsgPing *msg);
 static int send_call(plcConn *conn, plcMsgCallreq *call);
+static int send_call_batch(plcConn *conn, plcMsgCallreq *call);
 static int send_result(plcConn *conn, plcMsgResult *res);
+static int send_result_next(plcConn *conn, plcMsgResultNext *msg);
+static int send_source_request(plcConn *conn, plcMsgSourceRequest *msg);
+static int send_slice_request(plcConn *conn, plcMsgSliceRequest *msg);
+static int send_columns(plcConn *conn, plcMsgColumns *res);
+static int send_column(plcConn *conn, plcType *type, plcColumn *col, uint32 rows);
 static int send_log(plcConn *conn, plcMsgLog *mlog);
 static int send_quote(plcConn *conn, plcMsgQuote *mquote);
 static int send_quote_result(plcConn *conn, plcMsgQuoteResult *mQuoteResult);
 static int send_subtransaction(plcConn *conn, plcMsgSubtransaction *mSub);
 static int send_subtransaction_result(plcConn *conn, plcMsgSubtransactionResult *mSubr);
 static int send_exception(plcConn *conn, plcMsgError *err);
+static int send_exception_body(plcConn *conn, plcMsgError *err);
 static int send_sql(plcConn *conn, plcMsgSQL *msg);
 static int send_sql_statement(plcConn *conn, plcMsgSQL *msg);
 static int send_sql_prepare(plcConn *conn, plcMsgSQL *msg);
 static int send_sql_unprepare(plcConn *conn, plcMsgSQL *msg);
 static int send_sql_pexecute(plcConn *conn, plcMsgSQL *msg);
+static int send_sql_cursor_open(plcConn *conn, plcMsgSQL *msg);
+static int send_sql_cursor(plcConn *conn, plcMsgSQL *msg);
 static int send_rawmsg(plcConn *conn, plcMsgRaw *msg);
 static int receive_exception(plcConn *conn, plcMessage **mExc);
-static int receive_result(plcConn *conn, plcMessage **mRes);
+static int receive_result(plcConn *conn, plcMessage **mRes, char msgType);
+static int receive_result_next(plcConn *conn, plcMessage **mNext);
+static int receive_source_request(plcConn *conn, plcMessage **mReq);
+static int receive_slice_request(plcConn *conn, plcMessage **mReq);
+static int receive_columns(plcConn *conn, plcMessage **mRes);
+static int receive_column(plcConn *conn, plcType *type, plcColumn *col, uint32 rows);
 static int receive_log(plcConn *conn, plcMessage **mLog);
 static int receive_quote(plcConn *conn, plcMessage **mQuote);
 static int receive_quote_result(plcConn *conn, plcMessage **mQuoteResult);
 static int receive_sql_statement(plcConn *conn, plcMessage **mStmt);
 static int receive_sql_prepare(plcConn *conn, plcMessage **mStmt);
 static int receive_sql_pexecute(plcConn *conn, plcMessage **mStmt);
+static int receive_sql_cursor_open(plcConn *conn, plcMessage **mStmt);
+static int receive_sql_cursor(plcConn *conn, plcMessage **mStmt);
 static int receive_subtransaction(plcConn *conn, plcMessage **mSub);
 static int receive_subtransaction_result(plcConn *conn, plcMessage **mSubr);
-static int receive_argument(plcConn *conn, plcArgument *arg);
 static int receive_ping(plcConn *conn, plcMessage **mPing);
 static int receive_call(plcConn *conn, plcMessage **mCall);
+static int receive_call_batch(plcConn *conn, plcMessage **mCall);
 static int receive_sql(plcConn *conn, plcMessage **mSql);
 static int receive_rawmsg(plcConn *conn, plcMessage **mRaw);
 
+#ifdef PLC_CLIENT
+/*
+ * The client flushes held messages from a thread of its own, see
+ * plcontainer_channel_flush(). The main thread uses the connection under this
+ * lock.
+ */
+static pthread_mutex_t channel_lock = PTHREAD_MUTEX_INITIALIZER;
+
+#define channel_lock_acquire() pthread_mutex_lock(&channel_lock)
+#define channel_lock_release() pthread_mutex_unlock(&channel_lock)
+#else
+#define channel_lock_acquire()
+#define channel_lock_release()
+#endif
+
+static int channel_send(plcConn *conn, plcMessage *msg);
+
+static int channel_receive(plcConn *conn, plcMessage **msg, int64 mask);
+
 /* Public API Functions */
 
 int plcontainer_channel_send(plcConn *conn, plcMessage *msg) {
 	int res;
+
+	channel_lock_acquire();
+	res = channel_send(conn, msg);
+	channel_lock_release();
+	return res;
+}
+
+/*
+ * Send a message that can wait to go out in the same write as the next one.
+ * The messages keep their order, the next message sent without holding it,
+ * the next receive or plcontainer_channel_flush() flushes them all. The output
+ * buffer is flushed earlier if it fills up.
+ */
+int plcontainer_channel_send_held(plcConn *conn, plcMessage *msg) {
+	int res;
+
+	channel_lock_acquire();
+	conn->holdOutput = true;
+	res = channel_send(conn, msg);
+	conn->holdOutput = false;
+	channel_lock_release();
+	return res;
+}
+
+#ifdef PLC_CLIENT
+/*
+ * Send the messages held in the output buffer. Nothing is done if the
+ * connection is in use, the messages go out with what is sent or received
+ * there anyway.
+ *
+ * Returns 0 on success, -1 if failed
+ */
+int plcontainer_channel_flush(plcConn *conn) {
+	int res = 0;
+
+	if (pthread_mutex_trylock(&channel_lock) != 0)
+		return 0;
+	if (conn->frameOff < 0
+	    && conn->buffer[PLC_OUTPUT_BUFFER]->pEnd > conn->buffer[PLC_OUTPUT_BUFFER]->pStart)
+		res = plcBufferFlush(conn);
+	channel_lock_release();
+	return res;
+}
+#endif
+
+int plcontainer_channel_receive(plcConn *conn, plcMessage **msg, int64 mask) {
+	int res;
+
+	channel_lock_acquire();
+	res = channel_receive(conn, msg, mask);
+	channel_lock_release();
+	return res;
+}
+
+/* Static Functions */
+
+static int channel_send(plcConn *conn, plcMessage *msg) {
+	int res;
 	plc_elog(DEBUG1, "start to send data, type is %c", msg->msgtype);
 	switch (msg->msgtype) {
 		case MT_PING:
-			res = send_ping(conn);
+			res = send_ping(conn, (plcMsgPing *) msg);
 			break;
 		case MT_CALLREQ:
 			res = send_call(conn, (plcMsgCallreq *) msg);
 			break;
+		case MT_CALLREQ_BATCH:
+			res = send_call_batch(conn, (plcMsgCallreq *) msg);
+			break;
 		case MT_RESULT:
+		case MT_RESULT_CHUNK:
 			res = send_result(conn, (plcMsgResult *) msg);
 			break;
+		case MT_RESULT_NEXT:
+			res = send_result_next(conn, (plcMsgResultNext *) msg);
+			break;
+		case MT_SOURCE_REQUEST:
+			res = send_source_request(conn, (plcMsgSourceRequest *) msg);
+			break;
+		case MT_SLICE_REQUEST:
+			res = send_slice_request(conn, (plcMsgSliceRequest *) msg);
+			break;
+		case MT_RESULT_COLUMNS:
+			res = send_columns(conn, (plcMsgColumns *) msg);
+			break;
 		case MT_EXCEPTION:
 			res = send_exception(conn, (plcMsgError *) msg);
 			break;
@@ -151,14 +336,24 @@ int plcontainer_channel_send(plcConn *conn, plcMessage *msg) {
 }
 
 /* Only receive for expected types. This helps memory recycling. */
-int plcontainer_channel_receive(plcConn *conn, plcMessage **msg, int64 mask) {
+static int channel_receive(plcConn *conn, plcMessage **msg, int64 mask) {
 	int res;
 	char cType;
 
-	conn->rx_timeout_sec = 0x7fffFFFF; /* Wait for ever at this moment */
+	/* A receive interrupted by an error leaves its frame behind */
+	plcBufferFrameDone(conn, false);
+
+	/* The peer may be waiting for the messages held before answering */
+	if (conn->buffer[PLC_OUTPUT_BUFFER]->pEnd > conn->buffer[PLC_OUTPUT_BUFFER]->pStart
+	    && plcBufferFlush(conn) < 0)
+		return -1;
+
+	conn->rx_timeout_sec = PLC_RX_WAIT_FOREVER; /* Wait for ever at this moment */
 	res = receive_message_type(conn, &cType);
 	conn->rx_timeout_sec = TIMEOUT_SEC;
 	plc_elog(DEBUG1, "start to receive data, type is %c", cType);
+	if (res >= 0 && conn->framing)
+		res = receive_frame(conn, cType);
 	if (res >= 0) {
 		switch (cType) {
 			case MT_PING:
@@ -171,10 +366,40 @@ int plcontainer_channel_receive(plcConn *conn, plcMessage **msg, int64 mask) {
 					goto unexpected_type;
 				res = receive_call(conn, msg);
 				break;
+			case MT_CALLREQ_BATCH:
+				if (!(mask & MT_CALLREQ_BATCH_BIT))
+					goto unexpected_type;
+				res = receive_call_batch(conn, msg);
+				break;
 			case MT_RESULT:
 				if (!(mask & MT_RESULT_BIT))
 					goto unexpected_type;
-				res = receive_result(conn, msg);
+				res = receive_result(conn, msg, MT_RESULT);
+				break;
+			case MT_RESULT_CHUNK:
+				if (!(mask & MT_RESULT_CHUNK_BIT))
+					goto unexpected_type;
+				res = receive_result(conn, msg, MT_RESULT_CHUNK);
+				break;
+			case MT_RESULT_NEXT:
+				if (!(mask & MT_RESULT_NEXT_BIT))
+					goto unexpected_type;
+				res = receive_result_next(conn, msg);
+				break;
+			case MT_SOURCE_REQUEST:
+				if (!(mask & MT_SOURCE_REQUEST_BIT))
+					goto unexpected_type;
+				res = receive_source_request(conn, msg);
+				break;
+			case MT_SLICE_REQUEST:
+				if (!(mask & MT_SLICE_REQUEST_BIT))
+					goto unexpected_type;
+				res = receive_slice_request(conn, msg);
+				break;
+			case MT_RESULT_COLUMNS:
+				if (!(mask & MT_RESULT_COLUMNS_BIT))
+					goto unexpected_type;
+				res = receive_columns(conn, msg);
 				break;
 			case MT_EXCEPTION:
 				if (!(mask & MT_EXCEPTION_BIT))
@@ -217,14 +442,17 @@ int plcontainer_channel_receive(plcConn *conn, plcMessage **msg, int64 mask) {
 				res = receive_subtransaction_result(conn, msg);
 				break;
 			default:
+				plcBufferFrameDone(conn, true);
 				plc_elog(ERROR, "unknown message type: %d / '%c'", (int) cType, cType);
 				*msg = NULL;
 				return -1;
 		}
 	}
+	plcBufferFrameDone(conn, true);
 	return res;
 
 	unexpected_type:
+	plcBufferFrameDone(conn, true);
 	/* If lprint with level < ERROR, we need to free the message for various types. */
 	plc_elog(ERROR, "unexpected message type: %d / '%c'. Mask of expected "
 		    "message: 0x%llx", (int) cType, cType, (long long) mask);
@@ -235,11 +463,25 @@ int plcontainer_channel_receive(plcConn *conn, plcMessage **msg, int64 mask) {
 /* Send-Receive for Primitive Datatypes */
 
 static int message_start(plcConn *conn, char msgType) {
-	return plcBufferAppend(conn, &msgType, 1);
+	int res;
+
+	/* A message left unfinished by an error never reached the peer */
+	plcBufferFrameAbort(conn);
+	rollback_descriptors(conn);
+
+	res = plcBufferAppend(conn, &msgType, 1);
+
+	if (res == 0)
+		res = plcBufferFrameStart(conn);
+	return res;
 }
 
 static int message_end(plcConn *conn) {
-	return plcBufferFlush(conn);
+	int res = plcBufferFrameEnd(conn);
+
+	if (res == 0)
+		commit_descriptors(conn);
+	return res;
 }
 
 static int send_char(plcConn *conn, char c) {
@@ -335,10 +577,17 @@ static int send_raw_object(plcConn *conn, plcType *type, rawdata *obj) {
 				res |= send_cstring(conn, obj->value);
 				break;
 			case PLC_DATA_BYTEA:
+			case PLC_DATA_NUMERIC:
+			case PLC_DATA_DATE:
+			case PLC_DATA_TIMESTAMP:
+			case PLC_DATA_TIMESTAMPTZ:
+			case PLC_DATA_INTERVAL:
+			case PLC_DATA_UUID:
+			case PLC_DATA_JSONB:
 				res |= send_bytea(conn, obj->value);
 				break;
 			case PLC_DATA_ARRAY:
-				res |= send_raw_array_iter(conn, &type->subTypes[0], (plcIterator *) obj->value);
+				res |= send_raw_array_iter(conn, &type->subTypes[0], (plcIterator *) obj->value, NULL);
 				break;
 			case PLC_DATA_UDT:
 				res |= send_udt(conn, type, (plcUDT *) obj->value);
@@ -352,25 +601,69 @@ static int send_raw_object(plcConn *conn, plcType *type, rawdata *obj) {
 	return res;
 }
 
-static int send_raw_array_iter(plcConn *conn, plcType *type, plcIterator *iter) {
+/*
+ * Arrays of fixed-width types are sent as one block of values and arrays of
+ * text and bytea as an offsets table plus one block holding all the values,
+ * both preceded by a NULL bitmap. Only arrays of composite types are sent
+ * element by element.
+ */
+static int send_raw_array_iter(plcConn *conn, plcType *type, plcIterator *iter, plcRowOp *members) {
 	int res = 0;
 	int i = 0;
 	plcArrayMeta *meta = (plcArrayMeta *) iter->meta;
+	plcRowProgram *program = NULL;
 	res |= send_int32(conn, meta->ndims);
 
 	for (i = 0; i < meta->ndims; i++) {
 		res |= send_int32(conn, meta->dims[i]);
 	}
-	for (i = 0; i < meta->size && res == 0; i++) {
-		rawdata *raw_object = iter->next(iter);
-		res |= send_raw_object(conn, type, raw_object);
-		if (!raw_object->isnull) {
-			if (type->type == PLC_DATA_UDT) {
-				plc_free_udt((plcUDT *) raw_object->value, type, true);
-			}
-			pfree(raw_object->value);
+	if (meta->size > 0 && res == 0) {
+		switch (type->type) {
+			case PLC_DATA_INT1:
+			case PLC_DATA_INT2:
+			case PLC_DATA_INT4:
+			case PLC_DATA_INT8:
+			case PLC_DATA_FLOAT4:
+			case PLC_DATA_FLOAT8:
+				res |= send_array_fixed(conn, type, iter);
+				break;
+			case PLC_DATA_TEXT:
+			case PLC_DATA_BYTEA:
+			case PLC_DATA_NUMERIC:
+			case PLC_DATA_DATE:
+			case PLC_DATA_TIMESTAMP:
+			case PLC_DATA_TIMESTAMPTZ:
+			case PLC_DATA_INTERVAL:
+			case PLC_DATA_UUID:
+			case PLC_DATA_JSONB:
+				res |= send_array_varlen(conn, type, iter);
+				break;
+			default:
+				/* The members of composite elements are compiled once for the array */
+				if (type->type == PLC_DATA_UDT && members == NULL) {
+					program = compile_row_program(type->nSubTypes, type->subTypes, sizeof(plcType), false);
+					members = program->ops;
+				}
+				for (i = 0; i < meta->size && res == 0; i++) {
+					rawdata *raw_object = iter->next(iter);
+					if (type->type == PLC_DATA_UDT && !raw_object->isnull) {
+						res |= send_char(conn, 'D');
+						res |= send_row(conn, members, ((plcUDT *) raw_object->value)->data,
+						                sizeof(rawdata), false);
+					} else {
+						res |= send_raw_object(conn, type, raw_object);
+					}
+					if (!raw_object->isnull) {
+						if (type->type == PLC_DATA_UDT) {
+							plc_free_udt((plcUDT *) raw_object->value, type, true);
+						}
+						pfree(raw_object->value);
+					}
+					pfree(raw_object);
+				}
+				release_row_program(program);
+				break;
 		}
-		pfree(raw_object);
 	}
 	if (iter->cleanup != NULL) {
 		iter->cleanup(iter);
@@ -378,147 +671,814 @@ static int send_raw_array_iter(plcConn *conn, plcType *type, plcIterator *iter)
 	return res;
 }
 
-static int send_type(plcConn *conn, plcType *type) {
+/* The bitmap is only sent if there are NULL elements */
+static int send_array_nulls(plcConn *conn, char *nulls, int32 size) {
 	int res = 0;
-	int i = 0;
+	int nbytes = (size + 7) / 8;
+	int i;
 
-	channel_elog(WARNING, "VVVVVVVVVVVVVVV");
-	channel_elog(WARNING, "    Type '%s' with name '%s'", plc_get_type_name(type->type), type->typeName);
-	res |= send_char(conn, (char) type->type);
-	res |= send_cstring(conn, type->typeName);
-	if (type->type == PLC_DATA_ARRAY || type->type == PLC_DATA_UDT) {
-		res |= send_int16(conn, type->nSubTypes);
-		for (i = 0; i < type->nSubTypes && res == 0; i++)
-			res |= send_type(conn, &type->subTypes[i]);
+	for (i = 0; i < nbytes; i++) {
+		if (nulls[i] != 0)
+			break;
 	}
-	channel_elog(WARNING, "///////////////");
+	res |= send_char(conn, i < nbytes);
+	if (i < nbytes)
+		res |= plcBufferAppend(conn, nulls, nbytes);
 
 	return res;
 }
 
-static int send_udt(plcConn *conn, plcType *type, plcUDT *udt) {
+static int send_array_fixed(plcConn *conn, plcType *type, plcIterator *iter) {
 	int res = 0;
-	int i = 0;
+	int32 size = iter->meta->size;
+	int len = plc_get_type_length(type->type);
+	char *nulls;
+	char *block;
+	int i;
 
-	channel_elog(WARNING, "Sending user-defined type with %d members", type->nSubTypes);
+	nulls = pmalloc((size + 7) / 8);
+	memset(nulls, 0, (size + 7) / 8);
 
-	for (i = 0; i < type->nSubTypes && res == 0; i++) {
-		res |= send_raw_object(conn, &type->subTypes[i], &udt->data[i]);
+	if (iter->block != NULL) {
+		block = iter->block(iter, nulls);
+		if (block == NULL) {
+			pfree(nulls);
+			return -1;
+		}
+		res |= send_array_nulls(conn, nulls, size);
+		res |= plcBufferAppend(conn, block, (size_t) size * len);
+	} else {
+		/* Without a bulk accessor the block is put together element by element */
+		block = pmalloc((size_t) size * len);
+		memset(block, 0, (size_t) size * len);
+		for (i = 0; i < size; i++) {
+			rawdata *raw_object = iter->next(iter);
+			if (raw_object->isnull || raw_object->value == NULL) {
+				nulls[i >> 3] |= (char) (1 << (i & 7));
+			} else {
+				memcpy(block + (size_t) i * len, raw_object->value, len);
+			}
+			if (raw_object->value != NULL)
+				pfree(raw_object->value);
+			pfree(raw_object);
+		}
+		res |= send_array_nulls(conn, nulls, size);
+		res |= plcBufferAppend(conn, block, (size_t) size * len);
+		pfree(block);
 	}
 
+	pfree(nulls);
 	return res;
 }
 
-static int receive_message_type(plcConn *conn, char *c) {
-	int res;
-	*c = '@';
-	res = plcBufferReceive(conn, 1);
-	if (res == 0)
-		res = plcBufferRead(conn, c, 1);
+static int send_array_varlen(plcConn *conn, plcType *type, plcIterator *iter) {
+	int res = 0;
+	int32 size = iter->meta->size;
+	char *nulls;
+	char **values;
+	int32 *offsets;
+	int32 len;
+	int i;
+
+	nulls = pmalloc((size + 7) / 8);
+	memset(nulls, 0, (size + 7) / 8);
+	values = pmalloc(size * sizeof(char *));
+	offsets = pmalloc((size + 1) * sizeof(int32));
+
+	offsets[0] = 0;
+	for (i = 0; i < size; i++) {
+		rawdata *raw_object = iter->next(iter);
+		values[i] = raw_object->isnull ? NULL : raw_object->value;
+		if (values[i] == NULL) {
+			nulls[i >> 3] |= (char) (1 << (i & 7));
+			len = 0;
+		} else {
+			len = type->type == PLC_DATA_TEXT ? (int32) strlen(values[i]) : *((int32 *) values[i]);
+		}
+		offsets[i + 1] = offsets[i] + len;
+		pfree(raw_object);
+	}
+
+	res |= send_array_nulls(conn, nulls, size);
+	res |= plcBufferAppend(conn, (char *) offsets, (size + 1) * sizeof(int32));
+	for (i = 0; i < size; i++) {
+		if (values[i] == NULL)
+			continue;
+		/* values of the types other than text carry their length in front of the data */
+		res |= plcBufferAppend(conn, type->type != PLC_DATA_TEXT ? values[i] + 4 : values[i],
+		                       offsets[i + 1] - offsets[i]);
+		pfree(values[i]);
+	}
+
+	pfree(offsets);
+	pfree(values);
+	pfree(nulls);
 	return res;
 }
 
-static int receive_char(plcConn *conn, char *c) {
-	int res = plcBufferRead(conn, c, 1);
-	channel_elog(WARNING, "    <=== receiving int8/char '%d/%c'", (int) *c, *c);
+/*
+ * Pass the data of a value as a file if it is large enough, marker goes to
+ * the socket with the descriptor. Returns 1 if the value is to be sent
+ * inline.
+ */
+static int send_value_file(plcConn *conn, char *data, int64 size, char *marker, size_t markerLen) {
+	int fd;
+	int res;
+
+	if (conn->fdThreshold == 0 || size < conn->fdThreshold)
+		return 1;
+
+	/* Sent inline if the file could not be made */
+	fd = plcMemfdCreate(data, size);
+	if (fd < 0)
+		return 1;
+
+	res = plcBufferAppendFd(conn, fd, marker, markerLen);
+	close(fd);
 	return res;
 }
 
-static int receive_int16(plcConn *conn, int16 *i) {
-	int res = plcBufferRead(conn, (char *) i, 2);
-	channel_elog(WARNING, "    <=== receiving int16 '%d'", (int) *i);
-	return res;
+/*
+ * Send a value of a row or an argument. Large text and bytea values are
+ * passed as files when the connection agreed on it.
+ */
+static int send_value(plcConn *conn, plcType *type, rawdata *obj) {
+	if (conn->fdThreshold > 0 && !obj->isnull && obj->value != NULL
+	    && (type->type == PLC_DATA_TEXT || type->type == PLC_DATA_BYTEA)) {
+		char data[1 + sizeof(int32) + sizeof(int64)];
+		int32 len;
+		int64 size;
+		int res;
+
+		if (type->type == PLC_DATA_TEXT) {
+			size = strlen(obj->value) + 1;
+		} else {
+			memcpy(&len, obj->value, sizeof(len));
+			size = len + (int64) sizeof(len);
+		}
+
+		len = PLC_VALUE_FD;
+		data[0] = 'D';
+		memcpy(data + 1, &len, sizeof(len));
+		memcpy(data + 1 + sizeof(len), &size, sizeof(size));
+		res = send_value_file(conn, obj->value, size, data, sizeof(data));
+		if (res <= 0)
+			return res;
+	}
+
+	return send_raw_object(conn, type, obj);
 }
 
-static int receive_int32(plcConn *conn, int32 *i) {
-	int res = plcBufferRead(conn, (char *) i, 4);
-	channel_elog(WARNING, "    <=== receiving int32 '%d'", *i);
-	return res;
+/*
+ * Varints are little endian groups of 7 bits with the high bit set on all
+ * the bytes but the last one. Signed integers are zigzag encoded first, so
+ * that small negative numbers are short as well.
+ */
+#define PLC_VARINT_MAX 10
+#define ZIGZAG(v) (((uint64) (v) << 1) ^ (uint64) ((int64) (v) >> 63))
+#define UNZIGZAG(u) ((int64) ((u) >> 1) ^ -(int64) ((u) & 1))
+
+/*
+ * Bytea values of at least this size get their length padded to 4 bytes, so
+ * that the receiver can put the length of the value in front of the data and
+ * use it in place
+ */
+#define PLC_WIRE_BYTEA_VIEW_MIN 256
+
+/* Tags of text and bytea values in the compact encoding, lengths follow */
+#define PLC_WIRE_NULL_CSTRING 0
+#define PLC_WIRE_FILE         1
+#define PLC_WIRE_DATA         2 /* plus the length of the data */
+
+static int encode_varint(char *data, uint64 v, int minLen) {
+	int n = 0;
+
+	while (v >= 0x80 || n + 1 < minLen) {
+		data[n++] = (char) (v | 0x80);
+		v >>= 7;
+	}
+	data[n++] = (char) v;
+	return n;
 }
 
-static int receive_uint32(plcConn *conn, uint32 *i) {
-	int res = plcBufferRead(conn, (char *) i, 4);
-	channel_elog(WARNING, "    <=== receiving uint32 '%u'", *i);
-	return res;
+static int send_varint(plcConn *conn, uint64 v) {
+	char data[PLC_VARINT_MAX];
+
+	channel_elog(WARNING, "    ===> sending varint '%llu'", (unsigned long long) v);
+	return plcBufferAppend(conn, data, encode_varint(data, v, 1));
 }
 
-static int receive_int64(plcConn *conn, int64 *i) {
-	int res = plcBufferRead(conn, (char *) i, 8);
-	channel_elog(WARNING, "    <=== receiving int64 '" INT64_FORMAT "'", *i);
+/* Text or bytea value in the compact encoding */
+static int send_compact_data(plcConn *conn, plcType *type, rawdata *obj, bool topLevel) {
+	char data[2 * PLC_VARINT_MAX];
+	char *bytes;
+	int32 len;
+	int64 size;
+	int n;
+	int res;
+
+	if (obj->value == NULL)
+		return send_varint(conn, PLC_WIRE_NULL_CSTRING);
+	if (type->type == PLC_DATA_TEXT) {
+		len = strlen(obj->value);
+		size = len + 1;
+		bytes = obj->value;
+	} else {
+		memcpy(&len, obj->value, sizeof(len));
+		size = len + (int64) sizeof(len);
+		bytes = obj->value + sizeof(len);
+	}
+	if (topLevel) {
+		n = encode_varint(data, PLC_WIRE_FILE, 1);
+		n += encode_varint(data + n, size, 1);
+		res = send_value_file(conn, obj->value, size, data, n);
+		if (res <= 0)
+			return res;
+	}
+	n = encode_varint(data, PLC_WIRE_DATA + (uint64) len,
+	                  type->type != PLC_DATA_TEXT && len >= PLC_WIRE_BYTEA_VIEW_MIN
+	                  ? (int) sizeof(int32) : 1);
+	res = plcBufferAppend(conn, data, n);
+	if (res == 0 && len > 0)
+		res = plcBufferAppend(conn, bytes, len);
 	return res;
 }
 
-static int receive_float4(plcConn *conn, float4 *f) {
-	int res = plcBufferRead(conn, (char *) f, 4);
-	channel_elog(WARNING, "    <=== receiving float4 '%f'", *f);
-	return res;
+#define ROW_TYPE(i) ((plcType *) ((char *) types + (size_t) (i) * typeStride))
+#define ROW_VALUE(i) ((rawdata *) ((char *) values + (size_t) (i) * valueStride))
+
+/* Bitmaps of rows up to this many values are kept on the stack */
+#define PLC_ROW_BITMAP_STACK 64
+
+static char row_op_code(plcType *type) {
+	switch (type->type) {
+		case PLC_DATA_INT1:
+			return PLC_OP_BOOL;
+		case PLC_DATA_INT2:
+		case PLC_DATA_INT4:
+		case PLC_DATA_INT8:
+			return PLC_OP_INT;
+		case PLC_DATA_FLOAT4:
+		case PLC_DATA_FLOAT8:
+			return PLC_OP_FLOAT;
+		case PLC_DATA_TEXT:
+			return PLC_OP_TEXT;
+		case PLC_DATA_BYTEA:
+		case PLC_DATA_NUMERIC:
+		case PLC_DATA_DATE:
+		case PLC_DATA_TIMESTAMP:
+		case PLC_DATA_TIMESTAMPTZ:
+		case PLC_DATA_INTERVAL:
+		case PLC_DATA_UUID:
+		case PLC_DATA_JSONB:
+			return PLC_OP_BYTEA;
+		case PLC_DATA_ARRAY:
+			return PLC_OP_ARRAY;
+		case PLC_DATA_UDT:
+			return PLC_OP_UDT;
+		default:
+			return PLC_OP_INVALID;
+	}
 }
 
-static int receive_float8(plcConn *conn, float8 *f) {
-	int res = plcBufferRead(conn, (char *) f, 8);
-	channel_elog(WARNING, "    <=== receiving float8 '%f'", *f);
-	return res;
+/* Whether a value of type b continues the run of a value of type a */
+static bool row_op_continues(plcType *a, plcType *b) {
+	switch (row_op_code(a)) {
+		case PLC_OP_BOOL:
+		case PLC_OP_INT:
+		case PLC_OP_FLOAT:
+			return a->type == b->type;
+		case PLC_OP_TEXT:
+		case PLC_OP_BYTEA:
+			return row_op_code(a) == row_op_code(b);
+		default:
+			return false;
+	}
 }
 
-static int receive_raw(plcConn *conn, char *s, size_t len) {
-	int res = plcBufferRead(conn, s, len);
-	channel_elog(WARNING, "    <=== receiving raw '%d' bytes", (int) len);
-	return res;
+/* Type of the members a value has a segment for, if any */
+static plcType *row_op_composite(plcType *type) {
+	if (type->type == PLC_DATA_UDT)
+		return type;
+	if (type->type == PLC_DATA_ARRAY && type->nSubTypes > 0 && type->subTypes[0].type == PLC_DATA_UDT)
+		return &type->subTypes[0];
+	return NULL;
 }
 
-static int receive_cstring(plcConn *conn, char **s) {
-	int res = 0;
-	int32 cnt;
+static int count_row_ops(int n, plcType *types, size_t typeStride) {
+	int nops = 1;
+	int i;
 
-	if (receive_int32(conn, &cnt) < 0) {
-		return -1;
+	for (i = 0; i < n; i++) {
+		plcType *composite = row_op_composite(ROW_TYPE(i));
+
+		if (i == 0 || !row_op_continues(ROW_TYPE(i - 1), ROW_TYPE(i)))
+			nops++;
+		if (composite != NULL)
+			nops += count_row_ops(composite->nSubTypes, composite->subTypes, sizeof(plcType));
 	}
+	return nops;
+}
 
-	if (cnt == -1) {
-		*s = NULL;
-	} else if (cnt < 0) {
-		plc_elog(LOG, "receive_cstring() returns a negative length: %d", cnt);
-		return -1;
-	} else {
-		*s = pmalloc(cnt + 1);
-		if (cnt > 0) {
-			res = plcBufferRead(conn, *s, cnt);
+/* Compiles the segment of a row at ops, returns the end of the segments written */
+static plcRowOp *compile_row_segment(plcRowOp *ops, int n, plcType *types, size_t typeStride) {
+	plcRowOp *row = ops;
+	plcRowOp *op = ops;
+	plcRowOp *next;
+	int i;
+
+	memset(row, 0, sizeof(plcRowOp));
+	row->code = PLC_OP_ROW;
+	row->count = n;
+	for (i = 0; i < n; i++) {
+		plcType *type = ROW_TYPE(i);
+
+		if (op != row && row_op_continues(op->type, type)) {
+			op->count++;
+			continue;
 		}
-		(*s)[cnt] = 0;
+		op++;
+		memset(op, 0, sizeof(plcRowOp));
+		op->code = row_op_code(type);
+		op->first = i;
+		op->count = 1;
+		op->type = type;
+		if (op->code == PLC_OP_BOOL || op->code == PLC_OP_INT || op->code == PLC_OP_FLOAT)
+			op->width = (char) plc_get_type_length(type->type);
+		if (op->code == PLC_OP_BOOL)
+			row->hasBools = true;
 	}
+	row->end = op + 1;
 
-	channel_elog(WARNING, "    <=== receiving cstring '%s'", *s);
-	return res;
+	next = row->end;
+	for (op = row + 1; op < row->end; op++) {
+		plcType *composite = row_op_composite(op->type);
+
+		if (composite != NULL) {
+			op->members = next;
+			next = compile_row_segment(next, composite->nSubTypes, composite->subTypes, sizeof(plcType));
+		}
+	}
+	return next;
 }
 
-static int receive_bytea(plcConn *conn, char **s) {
-	int res = 0;
-	int len = 0;
+/*
+ * Compiles the program of a row of n values. A persistent program lives as
+ * long as the connection and refers to copies of the types, the others
+ * refer to the types given and are freed with release_row_program().
+ */
+static plcRowProgram *compile_row_program(int n, plcType *types, size_t typeStride, bool persistent) {
+	plcRowProgram *program;
+	size_t size;
+	int i;
 
-	if (receive_int32(conn, &len) < 0) {
-		return -1;
+	size = sizeof(plcRowProgram) + count_row_ops(n, types, typeStride) * sizeof(plcRowOp);
+	program = persistent ? PLy_malloc(size) : pmalloc(size);
+	program->n = n;
+	program->persistent = persistent;
+	program->types = NULL;
+	program->ops = (plcRowOp *) (program + 1);
+	if (persistent && n > 0) {
+		program->types = PLy_malloc(n * sizeof(plcType));
+		for (i = 0; i < n; i++)
+			copy_type(&program->types[i], ROW_TYPE(i), true);
+		types = program->types;
+		typeStride = sizeof(plcType);
 	}
 
-	*s = pmalloc(len + 4);
-	channel_elog(WARNING, "    ===> receiving bytea of size '%d' at %p for %p", len, *s, s);
+	compile_row_segment(program->ops, n, types, typeStride);
+	return program;
+}
 
-	*((int *) *s) = len;
-	if (len > 0) {
-		res = plcBufferRead(conn, *s + 4, len);
+static void free_row_program(plcRowProgram *program) {
+	int i;
+
+	if (program->types != NULL) {
+		for (i = 0; i < program->n; i++)
+			free_type(&program->types[i]);
+		pfree(program->types);
 	}
-	channel_elog(WARNING, "    ===> receiving bytea '%s'", strndup(*s + 4, len));
+	pfree(program);
+}
+
+static void release_row_program(plcRowProgram *program) {
+	if (program != NULL && !program->persistent)
+		free_row_program(program);
+}
+
+/* Copies a fixed-width value with a constant size, which is inlined */
+static void copy_fixed(char *dst, const char *src, int width) {
+	switch (width) {
+		case 1:
+			*dst = *src;
+			break;
+		case 2:
+			memcpy(dst, src, 2);
+			break;
+		case 4:
+			memcpy(dst, src, 4);
+			break;
+		default:
+			memcpy(dst, src, 8);
+			break;
+	}
+}
+
+/* Tagged fixed-width values of a run */
+static int send_tagged_run(plcConn *conn, plcRowOp *op, rawdata *values, size_t valueStride) {
+	char data[PLC_ROW_CHUNK * (1 + sizeof(int64))];
+	int len = 0;
+	int res = 0;
+	int i;
+
+	for (i = op->first; i < op->first + op->count && res == 0; i++) {
+		rawdata *obj = ROW_VALUE(i);
 
+		if (obj->isnull) {
+			data[len++] = 'N';
+		} else {
+			data[len++] = 'D';
+			copy_fixed(data + len, obj->value, op->width);
+			len += op->width;
+		}
+		if (len > (int) sizeof(data) - 1 - (int) sizeof(int64)) {
+			res = plcBufferAppend(conn, data, len);
+			len = 0;
+		}
+	}
+	if (res == 0 && len > 0)
+		res = plcBufferAppend(conn, data, len);
 	return res;
 }
 
-static int receive_raw_object(plcConn *conn, plcType *type, rawdata *obj) {
+/* Non-NULL integers of a run as varints, or floats as they are */
+static int send_compact_run(plcConn *conn, plcRowOp *op, rawdata *values, size_t valueStride) {
+	char data[PLC_ROW_CHUNK * PLC_VARINT_MAX];
+	int len = 0;
 	int res = 0;
-	char isn;
-	if (obj == NULL) {
-		plc_elog(ERROR, "NULL object reference received by receive_raw_object");
+	int i;
+
+	for (i = op->first; i < op->first + op->count && res == 0; i++) {
+		rawdata *obj = ROW_VALUE(i);
+
+		if (obj->isnull)
+			continue;
+		if (op->code == PLC_OP_FLOAT) {
+			copy_fixed(data + len, obj->value, op->width);
+			len += op->width;
+		} else {
+			int64 v;
+
+			if (op->width == 2)
+				v = *((int16 *) obj->value);
+			else if (op->width == 4)
+				v = *((int32 *) obj->value);
+			else
+				v = *((int64 *) obj->value);
+			len += encode_varint(data + len, ZIGZAG(v), 1);
+		}
+		if (len > (int) sizeof(data) - PLC_VARINT_MAX) {
+			res = plcBufferAppend(conn, data, len);
+			len = 0;
+		}
 	}
-	res |= receive_char(conn, &isn);
-	if (isn == 'N') {
+	if (res == 0 && len > 0)
+		res = plcBufferAppend(conn, data, len);
+	return res;
+}
+
+/*
+ * Text and bytea values of a run. The short ones are put together on the
+ * stack with their tags, the top level ones go one by one when they can be
+ * passed as files.
+ */
+static int send_varlen_run(plcConn *conn, plcRowOp *op, rawdata *values, size_t valueStride,
+                           bool compact, bool topLevel) {
+	char data[PLC_ROW_VARLEN_CHUNK];
+	char *bytes;
+	int32 len;
+	int used = 0;
+	int res = 0;
+	int i;
+
+	for (i = op->first; i < op->first + op->count && res == 0; i++) {
+		rawdata *obj = ROW_VALUE(i);
+		char header[1 + PLC_VARINT_MAX];
+		int n = 0;
+
+		if (topLevel && conn->fdThreshold > 0 && !obj->isnull && obj->value != NULL) {
+			if (used > 0)
+				res = plcBufferAppend(conn, data, used);
+			used = 0;
+			if (res == 0)
+				res = compact ? send_compact_data(conn, op->type, obj, true) : send_value(conn, op->type, obj);
+			continue;
+		}
+
+		bytes = NULL;
+		len = 0;
+		if (obj->isnull) {
+			if (compact)
+				continue;
+			header[n++] = 'N';
+		} else {
+			if (obj->value != NULL) {
+				if (op->code == PLC_OP_TEXT) {
+					len = strlen(obj->value);
+					bytes = obj->value;
+				} else {
+					memcpy(&len, obj->value, sizeof(len));
+					bytes = obj->value + sizeof(len);
+				}
+			}
+			if (compact) {
+				n = encode_varint(header, bytes == NULL ? PLC_WIRE_NULL_CSTRING : PLC_WIRE_DATA + (uint64) len,
+				                  op->code == PLC_OP_BYTEA && len >= PLC_WIRE_BYTEA_VIEW_MIN
+				                  ? (int) sizeof(int32) : 1);
+			} else {
+				int32 cnt = bytes == NULL ? -1 : len;
+
+				header[n++] = 'D';
+				memcpy(header + n, &cnt, sizeof(cnt));
+				n += sizeof(cnt);
+			}
+		}
+
+		if (used + n + len > (int) sizeof(data)) {
+			res = plcBufferAppend(conn, data, used);
+			used = 0;
+			if (res == 0 && n + len > (int) sizeof(data)) {
+				res = plcBufferAppend(conn, header, n);
+				if (res == 0 && len > 0)
+					res = plcBufferAppend(conn, bytes, len);
+				continue;
+			}
+		}
+		memcpy(data + used, header, n);
+		used += n;
+		if (len > 0) {
+			memcpy(data + used, bytes, len);
+			used += len;
+		}
+	}
+	if (res == 0 && used > 0)
+		res = plcBufferAppend(conn, data, used);
+	return res;
+}
+
+/*
+ * Send a row of values with the segment of its program: the columns of a
+ * result row, the arguments of a call or the members of a composite value.
+ * The values are taken valueStride bytes apart, so that they can be read
+ * from an array of arguments. In the compact encoding the row starts with
+ * a bitmap of its NULL values followed by a bitmap of the values of its
+ * non-NULL booleans, and only the other non-NULL values follow. Values of
+ * the top level of a message can be passed as files.
+ */
+static int send_row(plcConn *conn, plcRowOp *row, rawdata *values, size_t valueStride, bool topLevel) {
+	char stackBitmaps[2 * PLC_ROW_BITMAP_STACK];
+	char *nulls;
+	char *bools;
+	int nbytes = (row->count + 7) / 8;
+	int nbools = 0;
+	int res = 0;
+	bool compact = conn->wireVersion >= PLC_WIRE_COMPACT;
+	plcRowOp *op;
+	int i;
+
+	channel_elog(WARNING, "Sending row of %d values", row->count);
+	if (compact) {
+		nulls = nbytes <= PLC_ROW_BITMAP_STACK ? stackBitmaps : pmalloc(2 * nbytes);
+		bools = nulls + nbytes;
+		memset(nulls, 0, 2 * nbytes);
+		for (op = row + 1; op < row->end; op++) {
+			for (i = op->first; i < op->first + op->count; i++) {
+				rawdata *obj = ROW_VALUE(i);
+
+				if (obj->isnull) {
+					nulls[i / 8] |= 1 << (i % 8);
+				} else if (op->code == PLC_OP_BOOL) {
+					if (*((char *) obj->value))
+						bools[nbools / 8] |= 1 << (nbools % 8);
+					nbools++;
+				}
+			}
+		}
+		res |= plcBufferAppend(conn, nulls, nbytes);
+		if (nbools > 0)
+			res |= plcBufferAppend(conn, bools, (nbools + 7) / 8);
+		if (nulls != stackBitmaps)
+			pfree(nulls);
+	}
+
+	for (op = row + 1; op < row->end && res == 0; op++) {
+		switch (op->code) {
+			case PLC_OP_BOOL:
+			case PLC_OP_INT:
+			case PLC_OP_FLOAT:
+				if (!compact)
+					res = send_tagged_run(conn, op, values, valueStride);
+				else if (op->code != PLC_OP_BOOL)
+					res = send_compact_run(conn, op, values, valueStride);
+				continue;
+			case PLC_OP_TEXT:
+			case PLC_OP_BYTEA:
+				res = send_varlen_run(conn, op, values, valueStride, compact, topLevel);
+				continue;
+			default:
+				break;
+		}
+
+		/* Arrays, composite and unsupported values make runs of one */
+		if (ROW_VALUE(op->first)->isnull) {
+			if (!compact)
+				res = send_char(conn, 'N');
+			continue;
+		}
+		if (!compact)
+			res = send_char(conn, 'D');
+		if (res != 0)
+			break;
+		switch (op->code) {
+			case PLC_OP_ARRAY:
+				res = send_raw_array_iter(conn, &op->type->subTypes[0],
+				                          (plcIterator *) ROW_VALUE(op->first)->value, op->members);
+				break;
+			case PLC_OP_UDT:
+				res = send_row(conn, op->members, ((plcUDT *) ROW_VALUE(op->first)->value)->data,
+				               sizeof(rawdata), false);
+				break;
+			default:
+				plc_elog(ERROR, "Received unsupported argument type: %s [%d]",
+				         plc_get_type_name(op->type->type), op->type->type);
+				return -1;
+		}
+	}
+
+	return res;
+}
+
+/* Composite values outside of the rows of a program */
+static int send_udt(plcConn *conn, plcType *type, plcUDT *udt) {
+	plcRowProgram *program;
+	int res;
+
+	channel_elog(WARNING, "Sending user-defined type with %d members", type->nSubTypes);
+
+	program = compile_row_program(type->nSubTypes, type->subTypes, sizeof(plcType), false);
+	res = send_row(conn, program->ops, udt->data, sizeof(rawdata), false);
+	release_row_program(program);
+	return res;
+}
+
+static int receive_message_type(plcConn *conn, char *c) {
+	int res;
+	*c = '@';
+	res = plcBufferReceive(conn, 1);
+	if (res == 0)
+		res = plcBufferRead(conn, c, 1);
+	return res;
+}
+
+/*
+ * Read the length of the message. A message of a known length is read at
+ * once: into the input buffer, or into a frame of its own for the messages
+ * that can keep their values in it.
+ */
+static int receive_frame(plcConn *conn, char msgType) {
+	int32 len;
+	int res;
+
+	res = receive_int32(conn, &len);
+	if (res < 0 || len == PLC_FRAME_STREAMED)
+		return res;
+	if (len < 0 || len > PLC_COMPRESS_MAX_BLOCK) {
+		plc_elog(LOG, "receive_frame: Bad message length %d", len);
+		return -1;
+	}
+
+	switch (msgType) {
+		case MT_RESULT:
+		case MT_RESULT_CHUNK:
+		case MT_CALLREQ:
+		case MT_CALLREQ_BATCH:
+			return plcBufferFrameReceive(conn, len);
+		default:
+			return plcBufferReceive(conn, len);
+	}
+}
+
+static int receive_char(plcConn *conn, char *c) {
+	int res = plcBufferRead(conn, c, 1);
+	channel_elog(WARNING, "    <=== receiving int8/char '%d/%c'", (int) *c, *c);
+	return res;
+}
+
+static int receive_int16(plcConn *conn, int16 *i) {
+	int res = plcBufferRead(conn, (char *) i, 2);
+	channel_elog(WARNING, "    <=== receiving int16 '%d'", (int) *i);
+	return res;
+}
+
+static int receive_int32(plcConn *conn, int32 *i) {
+	int res = plcBufferRead(conn, (char *) i, 4);
+	channel_elog(WARNING, "    <=== receiving int32 '%d'", *i);
+	return res;
+}
+
+static int receive_uint32(plcConn *conn, uint32 *i) {
+	int res = plcBufferRead(conn, (char *) i, 4);
+	channel_elog(WARNING, "    <=== receiving uint32 '%u'", *i);
+	return res;
+}
+
+static int receive_int64(plcConn *conn, int64 *i) {
+	int res = plcBufferRead(conn, (char *) i, 8);
+	channel_elog(WARNING, "    <=== receiving int64 '" INT64_FORMAT "'", *i);
+	return res;
+}
+
+static int receive_float4(plcConn *conn, float4 *f) {
+	int res = plcBufferRead(conn, (char *) f, 4);
+	channel_elog(WARNING, "    <=== receiving float4 '%f'", *f);
+	return res;
+}
+
+static int receive_float8(plcConn *conn, float8 *f) {
+	int res = plcBufferRead(conn, (char *) f, 8);
+	channel_elog(WARNING, "    <=== receiving float8 '%f'", *f);
+	return res;
+}
+
+static int receive_raw(plcConn *conn, char *s, size_t len) {
+	int res = plcBufferRead(conn, s, len);
+	channel_elog(WARNING, "    <=== receiving raw '%d' bytes", (int) len);
+	return res;
+}
+
+static int receive_cstring(plcConn *conn, char **s) {
+	int32 cnt;
+
+	if (receive_int32(conn, &cnt) < 0) {
+		return -1;
+	}
+
+	return receive_cstring_data(conn, cnt, s);
+}
+
+static int receive_cstring_data(plcConn *conn, int32 cnt, char **s) {
+	int res = 0;
+
+	if (cnt == -1) {
+		*s = NULL;
+	} else if (cnt < 0) {
+		plc_elog(LOG, "receive_cstring() returns a negative length: %d", cnt);
+		return -1;
+	} else {
+		*s = pmalloc(cnt + 1);
+		if (cnt > 0) {
+			res = plcBufferRead(conn, *s, cnt);
+		}
+		(*s)[cnt] = 0;
+	}
+
+	channel_elog(WARNING, "    <=== receiving cstring '%s'", *s);
+	return res;
+}
+
+static int receive_bytea(plcConn *conn, char **s) {
+	int32 len = 0;
+
+	if (receive_int32(conn, &len) < 0) {
+		return -1;
+	}
+
+	return receive_bytea_data(conn, len, s);
+}
+
+static int receive_bytea_data(plcConn *conn, int32 len, char **s) {
+	int res = 0;
+
+	*s = pmalloc(len + 4);
+	channel_elog(WARNING, "    ===> receiving bytea of size '%d' at %p for %p", len, *s, s);
+
+	*((int *) *s) = len;
+	if (len > 0) {
+		res = plcBufferRead(conn, *s + 4, len);
+	}
+	channel_elog(WARNING, "    ===> receiving bytea '%s'", strndup(*s + 4, len));
+
+	return res;
+}
+
+static int receive_raw_object(plcConn *conn, plcType *type, rawdata *obj) {
+	int res = 0;
+	char isn;
+	if (obj == NULL) {
+		plc_elog(ERROR, "NULL object reference received by receive_raw_object");
+	}
+	res |= receive_char(conn, &isn);
+	if (isn == 'N') {
 		obj->isnull = 1;
 		obj->value = NULL;
 		channel_elog(WARNING, "Object is null");
@@ -551,13 +1511,22 @@ static int receive_raw_object(plcConn *conn, plcType *type, rawdata *obj) {
 				res |= receive_float8(conn, (float8 *) obj->value);
 				break;
 			case PLC_DATA_TEXT:
-				res |= receive_cstring(conn, &obj->value);
+				res |= receive_int32(conn, &obj->len);
+				if (res == 0)
+					res = receive_cstring_data(conn, obj->len, &obj->value);
 				break;
 			case PLC_DATA_BYTEA:
+			case PLC_DATA_NUMERIC:
+			case PLC_DATA_DATE:
+			case PLC_DATA_TIMESTAMP:
+			case PLC_DATA_TIMESTAMPTZ:
+			case PLC_DATA_INTERVAL:
+			case PLC_DATA_UUID:
+			case PLC_DATA_JSONB:
 				res |= receive_bytea(conn, &obj->value);
 				break;
 			case PLC_DATA_ARRAY:
-				res |= receive_array(conn, &type->subTypes[0], obj);
+				res |= receive_array(conn, &type->subTypes[0], obj, NULL);
 				break;
 			case PLC_DATA_UDT:
 				res |= receive_udt(conn, type, &obj->value);
@@ -571,13 +1540,395 @@ static int receive_raw_object(plcConn *conn, plcType *type, rawdata *obj) {
 	return res;
 }
 
-static int receive_array(plcConn *conn, plcType *type, rawdata *obj) {
+/*
+ * Receive a value of a row or an argument. Text and bytea values of a message
+ * read into a frame point into the frame instead of being copied out: bytea
+ * is laid out as on the wire, and text is moved over its length to make room
+ * for the terminating zero. Values passed as files are added to mappings.
+ */
+static int receive_value(plcConn *conn, plcType *type, rawdata *obj, plcMapping **mappings) {
+	plcBuffer *buf = conn->buffer[PLC_INPUT_BUFFER];
+	int res = 0;
+	char isn;
+	int32 len;
+	char *pos;
+
+	if ((conn->frame == NULL && conn->fdThreshold == 0)
+	    || (type->type != PLC_DATA_TEXT && !plc_type_is_bytea(type->type)))
+		return receive_raw_object(conn, type, obj);
+
+	res |= receive_char(conn, &isn);
+	if (res < 0)
+		return res;
+	if (isn == 'N') {
+		obj->isnull = 1;
+		obj->value = NULL;
+		return 0;
+	}
+
+	obj->isnull = 0;
+	res |= receive_int32(conn, &len);
+	if (res < 0)
+		return res;
+	if (len == PLC_VALUE_FD) {
+		int64 size;
+
+		if (receive_int64(conn, &size) < 0)
+			return -1;
+		return receive_value_fd(conn, type, obj, size, mappings);
+	}
+	obj->len = len;
+	if (conn->frame == NULL) {
+		if (type->type == PLC_DATA_TEXT)
+			return receive_cstring_data(conn, len, &obj->value);
+		return receive_bytea_data(conn, len, &obj->value);
+	}
+	if (len == -1 && type->type == PLC_DATA_TEXT) {
+		obj->value = NULL;
+		return 0;
+	}
+	if (len < 0 || len > buf->pEnd - buf->pStart) {
+		plc_elog(LOG, "receive_value: Bad value length %d", len);
+		obj->value = NULL;
+		return -1;
+	}
+
+	pos = buf->data + buf->pStart - sizeof(len);
+	if (type->type == PLC_DATA_TEXT) {
+		memmove(pos, pos + sizeof(len), len);
+		pos[len] = '\0';
+	}
+	obj->value = pos;
+	buf->pStart += len;
+	return 0;
+}
+
+/*
+ * The client maps the file of a value, which stays mapped with the message.
+ * The backend builds a datum out of the value anyway, and reads the file at
+ * once so that nothing is left behind when an error cuts the call short.
+ */
+static int receive_value_fd(plcConn *conn, plcType *type, rawdata *obj, int64 size, plcMapping **mappings) {
+	int32 len = 0;
+	char *data;
+	int fd;
+
+	obj->value = NULL;
+	fd = plcBufferTakeFd(conn);
+	if (fd < 0)
+		return -1;
+	if (size < (type->type == PLC_DATA_TEXT ? 1 : (int64) sizeof(len))
+	    || size > PLC_COMPRESS_MAX_BLOCK) {
+		plc_elog(LOG, "receive_value_fd: Bad value size " INT64_FORMAT, size);
+		close(fd);
+		return -1;
+	}
+
+#ifdef PLC_CLIENT
+	data = plcMemfdMap(fd, size);
+	if (data != NULL) {
+		plcMapping *mapping = pmalloc(sizeof(plcMapping));
+
+		mapping->addr = data;
+		mapping->len = size;
+		mapping->next = *mappings;
+		*mappings = mapping;
+	}
+#else
+	(void) mappings;
+	data = pmalloc(size);
+	if (plcMemfdRead(fd, data, size) < 0) {
+		pfree(data);
+		data = NULL;
+	}
+#endif
+	close(fd);
+	if (data == NULL)
+		return -1;
+
+	if (type->type != PLC_DATA_TEXT)
+		memcpy(&len, data, sizeof(len));
+	if (type->type == PLC_DATA_TEXT ? data[size - 1] != '\0' : len != size - (int64) sizeof(len)) {
+		plc_elog(LOG, "receive_value_fd: The value does not fill its file");
+#ifndef PLC_CLIENT
+		pfree(data);
+#endif
+		return -1;
+	}
+
+	obj->value = data;
+	obj->len = type->type == PLC_DATA_TEXT ? (int32) (size - 1) : len;
+	return 0;
+}
+
+static int receive_varint(plcConn *conn, uint64 *v) {
+	plcBuffer *buf = conn->buffer[PLC_INPUT_BUFFER];
+	uint64 val = 0;
+	unsigned char c;
+	int shift;
+
+	for (shift = 0; shift < 64; shift += 7) {
+		if (buf->pStart < buf->pEnd) {
+			c = (unsigned char) buf->data[buf->pStart++];
+		} else if (plcBufferRead(conn, (char *) &c, 1) < 0) {
+			return -1;
+		}
+		val |= (uint64) (c & 0x7f) << shift;
+		if ((c & 0x80) == 0) {
+			*v = val;
+			channel_elog(WARNING, "    <=== receiving varint '%llu'", (unsigned long long) val);
+			return 0;
+		}
+	}
+
+	plc_elog(LOG, "receive_varint: Varint is too long");
+	return -1;
+}
+
+/*
+ * Text and bytea values of the top level of a message read into a frame
+ * are used in place like in receive_value: text is moved over its tag, and
+ * bytea gets its length written over the tail of its tag, which the sender
+ * pads to 4 bytes for the values worth it.
+ */
+static int receive_compact_data(plcConn *conn, plcType *type, rawdata *obj, plcMapping **mappings) {
+	plcBuffer *buf = conn->buffer[PLC_INPUT_BUFFER];
+	int inFrame = conn->frame != NULL && mappings != NULL;
+	char *tag = buf->data + buf->pStart;
+	uint64 v;
+	int32 len;
+
+	if (receive_varint(conn, &v) < 0)
+		return -1;
+	if (v == PLC_WIRE_NULL_CSTRING && type->type == PLC_DATA_TEXT)
+		return 0;
+	if (v == PLC_WIRE_FILE && mappings != NULL) {
+		if (receive_varint(conn, &v) < 0)
+			return -1;
+		return receive_value_fd(conn, type, obj, (int64) v, mappings);
+	}
+	if (v < PLC_WIRE_DATA || v - PLC_WIRE_DATA > PLC_COMPRESS_MAX_BLOCK) {
+		plc_elog(LOG, "receive_compact_data: Bad value tag %llu", (unsigned long long) v);
+		return -1;
+	}
+	len = (int32) (v - PLC_WIRE_DATA);
+	obj->len = len;
+
+	if (inFrame && len > buf->pEnd - buf->pStart) {
+		plc_elog(LOG, "receive_compact_data: Bad value length %d", len);
+		return -1;
+	}
+	if (inFrame && type->type == PLC_DATA_TEXT) {
+		memmove(tag, buf->data + buf->pStart, len);
+		tag[len] = '\0';
+		obj->value = tag;
+		buf->pStart += len;
+		return 0;
+	}
+	if (inFrame && buf->data + buf->pStart - tag >= (long) sizeof(len)) {
+		obj->value = buf->data + buf->pStart - sizeof(len);
+		memcpy(obj->value, &len, sizeof(len));
+		buf->pStart += len;
+		return 0;
+	}
+
+	if (type->type == PLC_DATA_TEXT)
+		return receive_cstring_data(conn, len, &obj->value);
+	return receive_bytea_data(conn, len, &obj->value);
+}
+
+/* Tagged fixed-width values of a run, read from the buffer when it has them */
+static int receive_tagged_run(plcConn *conn, plcRowOp *op, rawdata *values, size_t valueStride) {
+	plcBuffer *buf = conn->buffer[PLC_INPUT_BUFFER];
+	int res = 0;
+	char isn;
+	int i;
+
+	for (i = op->first; i < op->first + op->count && res == 0; i++) {
+		rawdata *obj = ROW_VALUE(i);
+
+		if (buf->pEnd - buf->pStart > op->width) {
+			isn = buf->data[buf->pStart++];
+			if (isn == 'N')
+				continue;
+			obj->isnull = 0;
+			obj->value = pmalloc(op->width);
+			copy_fixed(obj->value, buf->data + buf->pStart, op->width);
+			buf->pStart += op->width;
+			continue;
+		}
+
+		res = receive_char(conn, &isn);
+		if (res < 0 || isn == 'N')
+			continue;
+		obj->isnull = 0;
+		obj->value = pmalloc(op->width);
+		res = receive_raw(conn, obj->value, op->width);
+	}
+	return res;
+}
+
+/* Non-NULL integers and floats of a run in the compact encoding */
+static int receive_compact_run(plcConn *conn, plcRowOp *op, char *nulls, rawdata *values, size_t valueStride) {
+	plcBuffer *buf = conn->buffer[PLC_INPUT_BUFFER];
+	uint64 v;
+	int res = 0;
+	int i;
+
+	for (i = op->first; i < op->first + op->count && res == 0; i++) {
+		rawdata *obj = ROW_VALUE(i);
+
+		if (nulls[i / 8] & (1 << (i % 8)))
+			continue;
+		if (op->code == PLC_OP_FLOAT) {
+			obj->value = pmalloc(op->width);
+			if (buf->pEnd - buf->pStart >= op->width) {
+				copy_fixed(obj->value, buf->data + buf->pStart, op->width);
+				buf->pStart += op->width;
+			} else {
+				res = receive_raw(conn, obj->value, op->width);
+			}
+		} else {
+			res = receive_varint(conn, &v);
+			if (res < 0)
+				break;
+			obj->value = pmalloc(op->width);
+			if (op->width == 2)
+				*((int16 *) obj->value) = (int16) UNZIGZAG(v);
+			else if (op->width == 4)
+				*((int32 *) obj->value) = (int32) UNZIGZAG(v);
+			else
+				*((int64 *) obj->value) = UNZIGZAG(v);
+		}
+		obj->isnull = 0;
+	}
+	return res;
+}
+
+/*
+ * Receive a row sent by send_row with the same segment of a program. All
+ * the values are set, the ones not received because of an error are NULL.
+ * Values of the top level of a message, which have mappings to be added
+ * to, can be used in place.
+ */
+static int receive_row(plcConn *conn, plcRowOp *row, rawdata *values, size_t valueStride,
+                       plcMapping **mappings) {
+	char stackBitmaps[2 * PLC_ROW_BITMAP_STACK];
+	char *nulls = NULL;
+	char *bools = NULL;
+	int nbytes = (row->count + 7) / 8;
+	int nbools = 0;
+	int res = 0;
+	char isn;
+	plcRowOp *op;
+	int i;
+
+	for (i = 0; i < row->count; i++) {
+		ROW_VALUE(i)->isnull = 1;
+		ROW_VALUE(i)->value = NULL;
+	}
+
+	if (conn->wireVersion >= PLC_WIRE_COMPACT) {
+		nulls = nbytes <= PLC_ROW_BITMAP_STACK ? stackBitmaps : pmalloc(2 * nbytes);
+		bools = nulls + nbytes;
+		res = receive_raw(conn, nulls, nbytes);
+		if (row->hasBools) {
+			for (op = row + 1; op < row->end && res == 0; op++) {
+				if (op->code != PLC_OP_BOOL)
+					continue;
+				for (i = op->first; i < op->first + op->count; i++) {
+					if ((nulls[i / 8] & (1 << (i % 8))) == 0)
+						nbools++;
+				}
+			}
+		}
+		if (res == 0 && nbools > 0)
+			res = receive_raw(conn, bools, (nbools + 7) / 8);
+		nbools = 0;
+	}
+
+	for (op = row + 1; op < row->end && res == 0; op++) {
+		rawdata *obj = ROW_VALUE(op->first);
+
+		switch (op->code) {
+			case PLC_OP_BOOL:
+				if (nulls == NULL) {
+					res = receive_tagged_run(conn, op, values, valueStride);
+					continue;
+				}
+				for (i = op->first; i < op->first + op->count; i++) {
+					if (nulls[i / 8] & (1 << (i % 8)))
+						continue;
+					obj = ROW_VALUE(i);
+					obj->isnull = 0;
+					obj->value = pmalloc(1);
+					*obj->value = (bools[nbools / 8] >> (nbools % 8)) & 1;
+					nbools++;
+				}
+				continue;
+			case PLC_OP_INT:
+			case PLC_OP_FLOAT:
+				if (nulls == NULL)
+					res = receive_tagged_run(conn, op, values, valueStride);
+				else
+					res = receive_compact_run(conn, op, nulls, values, valueStride);
+				continue;
+			case PLC_OP_TEXT:
+			case PLC_OP_BYTEA:
+				for (i = op->first; i < op->first + op->count && res == 0; i++) {
+					obj = ROW_VALUE(i);
+					if (nulls == NULL) {
+						if (mappings != NULL)
+							res = receive_value(conn, op->type, obj, mappings);
+						else
+							res = receive_raw_object(conn, op->type, obj);
+					} else if ((nulls[i / 8] & (1 << (i % 8))) == 0) {
+						res = receive_compact_data(conn, op->type, obj, mappings);
+						obj->isnull = res < 0 && obj->value == NULL;
+					}
+				}
+				continue;
+			default:
+				break;
+		}
+
+		/* Arrays, composite and unsupported values make runs of one */
+		if (nulls == NULL) {
+			res = receive_char(conn, &isn);
+			if (res < 0 || isn == 'N')
+				continue;
+		} else if (nulls[op->first / 8] & (1 << (op->first % 8))) {
+			continue;
+		}
+		switch (op->code) {
+			case PLC_OP_ARRAY:
+				res = receive_array(conn, &op->type->subTypes[0], obj, op->members);
+				break;
+			case PLC_OP_UDT:
+				res = receive_udt_members(conn, op->members, &obj->value);
+				break;
+			default:
+				plc_elog(ERROR, "Received unsupported argument type: %s [%d]",
+				         plc_get_type_name(op->type->type), op->type->type);
+				res = -1;
+				break;
+		}
+		obj->isnull = res < 0 && obj->value == NULL;
+	}
+
+	if (nulls != NULL && nulls != stackBitmaps)
+		pfree(nulls);
+	return res;
+}
+
+static int receive_array(plcConn *conn, plcType *type, rawdata *obj, plcRowOp *members) {
 	int res = 0;
 	int i = 0;
 	int ndims;
 	int entrylen = 0;
 	char isnull;
 	plcArray *arr;
+	plcRowProgram *program = NULL;
 
 	res |= receive_int32(conn, &ndims);
 	arr = plc_alloc_array(ndims);
@@ -591,41 +1942,132 @@ static int receive_array(plcConn *conn, plcType *type, rawdata *obj) {
 	if (arr->meta->size > 0) {
 		entrylen = plc_get_type_length(arr->meta->type);
 		arr->nulls = (char *) pmalloc(arr->meta->size * 1);
-		arr->data = (char *) pmalloc(arr->meta->size * entrylen);
-		memset(arr->data, 0, arr->meta->size * entrylen);
+		arr->data = (char *) pmalloc((size_t) arr->meta->size * entrylen);
+		memset(arr->data, 0, (size_t) arr->meta->size * entrylen);
 
-		for (i = 0; i < arr->meta->size && res == 0; i++) {
-			res |= receive_char(conn, &isnull);
-			if (isnull == 'N') {
-				arr->nulls[i] = 1;
-			} else {
-				arr->nulls[i] = 0;
-				switch (arr->meta->type) {
-					case PLC_DATA_INT1:
-					case PLC_DATA_INT2:
-					case PLC_DATA_INT4:
-					case PLC_DATA_INT8:
-					case PLC_DATA_FLOAT4:
-					case PLC_DATA_FLOAT8:
-						res |= receive_raw(conn, arr->data + i * entrylen, entrylen);
-						break;
-					case PLC_DATA_TEXT:
-						res |= receive_cstring(conn, &((char **) arr->data)[i]);
-						break;
-					case PLC_DATA_BYTEA:
-						res |= receive_bytea(conn, &((char **) arr->data)[i]);
-						break;
-					case PLC_DATA_UDT:
-						res |= receive_udt(conn, type, &((char **) arr->data)[i]);
-						break;
-					default:
-						plc_elog(ERROR, "Should not get here (type: %d)",
-							    arr->meta->type);
-						break;
+		switch (arr->meta->type) {
+			case PLC_DATA_INT1:
+			case PLC_DATA_INT2:
+			case PLC_DATA_INT4:
+			case PLC_DATA_INT8:
+			case PLC_DATA_FLOAT4:
+			case PLC_DATA_FLOAT8:
+				res |= receive_array_nulls(conn, arr);
+				res |= receive_raw(conn, arr->data, (size_t) arr->meta->size * entrylen);
+				break;
+			case PLC_DATA_TEXT:
+			case PLC_DATA_BYTEA:
+			case PLC_DATA_NUMERIC:
+			case PLC_DATA_DATE:
+			case PLC_DATA_TIMESTAMP:
+			case PLC_DATA_TIMESTAMPTZ:
+			case PLC_DATA_INTERVAL:
+			case PLC_DATA_UUID:
+			case PLC_DATA_JSONB:
+				res |= receive_array_nulls(conn, arr);
+				if (res == 0)
+					res |= receive_array_varlen(conn, type, arr);
+				break;
+			case PLC_DATA_UDT:
+				/* The members of the elements are compiled once for the array */
+				if (members == NULL) {
+					program = compile_row_program(type->nSubTypes, type->subTypes, sizeof(plcType), false);
+					members = program->ops;
 				}
-			}
+				for (i = 0; i < arr->meta->size && res == 0; i++) {
+					res |= receive_char(conn, &isnull);
+					if (isnull == 'N') {
+						arr->nulls[i] = 1;
+					} else {
+						arr->nulls[i] = 0;
+						res |= receive_udt_members(conn, members, &((char **) arr->data)[i]);
+					}
+				}
+				release_row_program(program);
+				break;
+			default:
+				plc_elog(ERROR, "Should not get here (type: %d)",
+					    arr->meta->type);
+				break;
+		}
+	}
+	return res;
+}
+
+static int receive_array_nulls(plcConn *conn, plcArray *arr) {
+	int res = 0;
+	char hasnulls;
+	char *bitmap;
+	int i;
+
+	res |= receive_char(conn, &hasnulls);
+	if (res != 0 || !hasnulls) {
+		memset(arr->nulls, 0, arr->meta->size);
+		return res;
+	}
+
+	bitmap = pmalloc((arr->meta->size + 7) / 8);
+	res |= receive_raw(conn, bitmap, (arr->meta->size + 7) / 8);
+	for (i = 0; i < arr->meta->size; i++)
+		arr->nulls[i] = (bitmap[i >> 3] >> (i & 7)) & 1;
+	pfree(bitmap);
+
+	return res;
+}
+
+/*
+ * Text and bytea elements are placed in one blob, text ones with a trailing
+ * zero byte and bytea ones behind their length, as receive_cstring() and
+ * receive_bytea() would have allocated them.
+ */
+static int receive_array_varlen(plcConn *conn, plcType *type, plcArray *arr) {
+	int res = 0;
+	int32 size = arr->meta->size;
+	int32 *offsets;
+	size_t bloblen = 0;
+	char *pos;
+	int32 len;
+	int i;
+
+	offsets = pmalloc((size + 1) * sizeof(int32));
+	res |= receive_raw(conn, (char *) offsets, (size + 1) * sizeof(int32));
+	if (res != 0 || offsets[0] != 0) {
+		pfree(offsets);
+		plc_elog(LOG, "array with a bad offsets table");
+		return -1;
+	}
+	for (i = 0; i < size; i++) {
+		len = offsets[i + 1] - offsets[i];
+		if (len < 0 || (len > 0 && arr->nulls[i])) {
+			pfree(offsets);
+			plc_elog(LOG, "array with a bad length %d of element %d", len, i);
+			return -1;
+		}
+		if (type->type == PLC_DATA_TEXT)
+			bloblen += len + 1;
+		else
+			bloblen += PLC_ARRAY_ELEM_ALIGN(len + 4);
+	}
+
+	arr->blob = pmalloc(bloblen > 0 ? bloblen : 1);
+	pos = arr->blob;
+	for (i = 0; i < size && res == 0; i++) {
+		if (arr->nulls[i])
+			continue;
+		len = offsets[i + 1] - offsets[i];
+		((char **) arr->data)[i] = pos;
+		if (type->type == PLC_DATA_TEXT) {
+			res |= receive_raw(conn, pos, len);
+			pos[len] = 0;
+			pos += len + 1;
+		} else {
+			*((int32 *) pos) = len;
+			res |= receive_raw(conn, pos + 4, len);
+			pos += PLC_ARRAY_ELEM_ALIGN(len + 4);
 		}
 	}
+
+	pfree(offsets);
 	return res;
 }
 
@@ -647,49 +2089,552 @@ static int receive_type(plcConn *conn, plcType *type) {
 			for (i = 0; i < type->nSubTypes && res == 0; i++)
 				res |= receive_type(conn, &type->subTypes[i]);
 		}
-	} else {
-		type->nSubTypes = 0;
-		type->subTypes = NULL;
+	} else {
+		type->nSubTypes = 0;
+		type->subTypes = NULL;
+	}
+	channel_elog(WARNING, "///////////////");
+
+	return res;
+}
+
+static int receive_udt_members(plcConn *conn, plcRowOp *members, char **resdata) {
+	int res;
+	plcUDT *udt;
+
+	channel_elog(WARNING, "Receiving user-defined type with %d members", members->count);
+
+	udt = plc_alloc_udt(members->count);
+	res = receive_row(conn, members, udt->data, sizeof(rawdata), NULL);
+
+	*resdata = (char *) udt;
+	return res;
+}
+
+/* Composite values outside of the rows of a program */
+static int receive_udt(plcConn *conn, plcType *type, char **resdata) {
+	plcRowProgram *program;
+	int res;
+
+	program = compile_row_program(type->nSubTypes, type->subTypes, sizeof(plcType), false);
+	res = receive_udt_members(conn, program->ops, resdata);
+	release_row_program(program);
+	return res;
+}
+
+/*
+ * Descriptors
+ *
+ * The types of the function arguments, of the function result and of the
+ * columns of a result set are sent as a descriptor: int32 number of entries
+ * followed by the type tree and the name of every entry. The same descriptor
+ * is usually sent with every call of a function, so each side of the
+ * connection numbers the descriptors it has sent, and after the first time
+ * only the number travels:
+ *
+ *   'D' int32 id <descriptor>  - defines descriptor id and uses it
+ *   'R' int32 id               - uses descriptor id defined before
+ *   'I' <descriptor>           - uses a descriptor without defining it,
+ *                                when the table of the connection is full
+ *
+ * The sender recognizes a descriptor by its serialized form, the receiver
+ * keeps the decoded types and names. The descriptors a message defines only
+ * count as sent once the message is complete. A message cut short by an
+ * error is dropped, and so are its definitions.
+ */
+
+#define PLC_MAX_DESCRIPTORS 1024
+#define PLC_DESCRIPTOR_BUCKETS 256
+
+#define PLC_DESCRIPTOR_DEFINE 'D'
+#define PLC_DESCRIPTOR_REF    'R'
+#define PLC_DESCRIPTOR_INLINE 'I'
+
+typedef struct plcDescriptor {
+	struct plcDescriptor *next; /* next descriptor in the hash bucket */
+	int32 id;                   /* -1 for the inline descriptor */
+	/* sending side */
+	uint32 hash;
+	size_t len;
+	char *key;
+	/* receiving side */
+	int32 n;
+	plcType *types;
+	char **names;
+	/* program of the rows sent or received with the descriptor */
+	plcRowProgram *program;
+} plcDescriptor;
+
+struct plcDescriptorTable {
+	int32 count;
+	int32 committed; /* descriptors defined by complete messages */
+	plcDescriptor *buckets[PLC_DESCRIPTOR_BUCKETS];
+	plcDescriptor *byId[PLC_MAX_DESCRIPTORS];
+};
+
+/* Descriptor being serialized for sending */
+typedef struct plcDescriptorKey {
+	char *data;
+	size_t len;
+	size_t size;
+	int32 n;
+} plcDescriptorKey;
+
+static void descriptor_key_init(plcDescriptorKey *key) {
+	key->size = 256;
+	key->data = pmalloc(key->size);
+	key->len = sizeof(int32);
+	key->n = 0;
+}
+
+static void descriptor_key_append(plcDescriptorKey *key, const void *ptr, size_t len) {
+	if (key->len + len > key->size) {
+		char *data;
+
+		while (key->len + len > key->size)
+			key->size *= 2;
+		data = pmalloc(key->size);
+		memcpy(data, key->data, key->len);
+		pfree(key->data);
+		key->data = data;
+	}
+	memcpy(key->data + key->len, ptr, len);
+	key->len += len;
+}
+
+static void descriptor_key_add_cstring(plcDescriptorKey *key, char *s) {
+	int32 len = (s == NULL) ? -1 : (int32) strlen(s);
+
+	descriptor_key_append(key, &len, sizeof(int32));
+	if (len > 0)
+		descriptor_key_append(key, s, len);
+}
+
+/* Same layout as receive_type() expects */
+static void descriptor_key_add_type(plcDescriptorKey *key, plcType *type) {
+	char typ = (char) type->type;
+	int i;
+
+	descriptor_key_append(key, &typ, 1);
+	descriptor_key_add_cstring(key, type->typeName);
+	if (type->type == PLC_DATA_ARRAY || type->type == PLC_DATA_UDT) {
+		descriptor_key_append(key, &type->nSubTypes, sizeof(int16));
+		for (i = 0; i < type->nSubTypes; i++)
+			descriptor_key_add_type(key, &type->subTypes[i]);
+	}
+}
+
+static void descriptor_key_add(plcDescriptorKey *key, plcType *type, char *name) {
+	descriptor_key_add_type(key, type);
+	descriptor_key_add_cstring(key, name);
+	key->n++;
+}
+
+/* FNV-1a */
+static uint32 descriptor_hash(const char *data, size_t len) {
+	uint32 hash = 2166136261U;
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		hash ^= (unsigned char) data[i];
+		hash *= 16777619U;
+	}
+	return hash;
+}
+
+static plcDescriptorTable *descriptor_table_create(void) {
+	plcDescriptorTable *table = PLy_malloc(sizeof(plcDescriptorTable));
+
+	memset(table, 0, sizeof(plcDescriptorTable));
+	return table;
+}
+
+/*
+ * Program of a row of n values of the given types sent or received with
+ * desc, which is compiled the first time the descriptor is used for a row.
+ * A descriptor that is not kept, or that is used for rows of another
+ * length, gets a program to be released after the message.
+ */
+static plcRowProgram *descriptor_program(plcDescriptor *desc, int n, plcType *types, size_t typeStride) {
+	if (desc == NULL || desc->id < 0 || (desc->program != NULL && desc->program->n != n))
+		return compile_row_program(n, types, typeStride, false);
+	if (desc->program == NULL)
+		desc->program = compile_row_program(n, types, typeStride, true);
+	return desc->program;
+}
+
+/*
+ * Sends the descriptor and frees the key. If program is not NULL, it is set
+ * to the program of the rows of n values of the given types that follow.
+ */
+static int send_descriptor(plcConn *conn, plcDescriptorKey *key, int n, plcType *types, size_t typeStride,
+                           plcRowProgram **program) {
+	int res = 0;
+	uint32 hash;
+	plcDescriptor *desc;
+	plcDescriptorTable *table;
+
+	memcpy(key->data, &key->n, sizeof(int32));
+	hash = descriptor_hash(key->data, key->len);
+
+	if (conn->sent_descs == NULL)
+		conn->sent_descs = descriptor_table_create();
+	table = conn->sent_descs;
+
+	for (desc = table->buckets[hash % PLC_DESCRIPTOR_BUCKETS]; desc != NULL; desc = desc->next) {
+		if (desc->hash == hash && desc->len == key->len &&
+		    memcmp(desc->key, key->data, key->len) == 0) {
+			channel_elog(WARNING, "Sending reference to descriptor %d", desc->id);
+			res |= send_char(conn, PLC_DESCRIPTOR_REF);
+			res |= send_int32(conn, desc->id);
+			pfree(key->data);
+			if (program != NULL)
+				*program = descriptor_program(desc, n, types, typeStride);
+			return res;
+		}
+	}
+
+	if (table->count < PLC_MAX_DESCRIPTORS) {
+		desc = PLy_malloc(sizeof(plcDescriptor));
+		memset(desc, 0, sizeof(plcDescriptor));
+		desc->id = table->count;
+		desc->hash = hash;
+		desc->len = key->len;
+		desc->key = PLy_malloc(key->len);
+		memcpy(desc->key, key->data, key->len);
+		desc->n = key->n;
+		desc->next = table->buckets[hash % PLC_DESCRIPTOR_BUCKETS];
+		table->buckets[hash % PLC_DESCRIPTOR_BUCKETS] = desc;
+		table->byId[table->count++] = desc;
+
+		channel_elog(WARNING, "Defining descriptor %d with %d entries", desc->id, desc->n);
+		res |= send_char(conn, PLC_DESCRIPTOR_DEFINE);
+		res |= send_int32(conn, desc->id);
+	} else {
+		res |= send_char(conn, PLC_DESCRIPTOR_INLINE);
+	}
+	res |= plcBufferAppend(conn, key->data, key->len);
+	pfree(key->data);
+	if (program != NULL)
+		*program = descriptor_program(desc, n, types, typeStride);
+
+	return res;
+}
+
+/*
+ * Deep copy of a type tree, either in the current memory context or, for
+ * the descriptors kept on the connection, in the long living one.
+ */
+static void copy_type(plcType *dst, plcType *src, bool persistent) {
+	int i;
+
+	dst->type = src->type;
+	dst->nSubTypes = src->nSubTypes;
+	dst->typeName = NULL;
+	if (src->typeName != NULL)
+		dst->typeName = persistent ? plc_top_strdup(src->typeName) : pstrdup(src->typeName);
+	dst->subTypes = NULL;
+	if (src->nSubTypes > 0) {
+		size_t size = src->nSubTypes * sizeof(plcType);
+
+		dst->subTypes = persistent ? PLy_malloc(size) : pmalloc(size);
+		for (i = 0; i < src->nSubTypes; i++)
+			copy_type(&dst->subTypes[i], &src->subTypes[i], persistent);
+	}
+}
+
+static void free_descriptor(plcDescriptor *desc) {
+	int i;
+
+	if (desc->types != NULL) {
+		for (i = 0; i < desc->n; i++) {
+			free_type(&desc->types[i]);
+			if (desc->names[i] != NULL)
+				pfree(desc->names[i]);
+		}
+		pfree(desc->types);
+		pfree(desc->names);
+	}
+	if (desc->key != NULL)
+		pfree(desc->key);
+	if (desc->program != NULL)
+		free_row_program(desc->program);
+	pfree(desc);
+}
+
+static int receive_descriptor_body(plcConn *conn, plcDescriptor *desc, int32 n) {
+	int res = 0;
+	int i;
+
+	res |= receive_int32(conn, &desc->n);
+	if (res != 0 || desc->n != n) {
+		plc_elog(LOG, "descriptor has %d entries instead of %d", desc->n, n);
+		return -1;
+	}
+
+	desc->types = pmalloc((desc->n > 0 ? desc->n : 1) * sizeof(plcType));
+	desc->names = pmalloc((desc->n > 0 ? desc->n : 1) * sizeof(char *));
+	for (i = 0; i < desc->n; i++) {
+		desc->types[i].typeName = NULL;
+		desc->types[i].nSubTypes = 0;
+		desc->types[i].subTypes = NULL;
+		desc->names[i] = NULL;
+	}
+	for (i = 0; i < desc->n && res == 0; i++) {
+		res |= receive_type(conn, &desc->types[i]);
+		res |= receive_cstring(conn, &desc->names[i]);
+	}
+
+	return res;
+}
+
+/* Moves a received descriptor into the long living memory of the table */
+static plcDescriptor *descriptor_persist(plcDescriptor *src) {
+	plcDescriptor *desc = PLy_malloc(sizeof(plcDescriptor));
+	int i;
+
+	memset(desc, 0, sizeof(plcDescriptor));
+	desc->id = src->id;
+	desc->n = src->n;
+	desc->types = PLy_malloc((src->n > 0 ? src->n : 1) * sizeof(plcType));
+	desc->names = PLy_malloc((src->n > 0 ? src->n : 1) * sizeof(char *));
+	for (i = 0; i < src->n; i++) {
+		copy_type(&desc->types[i], &src->types[i], true);
+		desc->names[i] = src->names[i] == NULL ? NULL : plc_top_strdup(src->names[i]);
+	}
+	free_descriptor(src);
+
+	return desc;
+}
+
+/*
+ * Receives a descriptor of n entries. The descriptor belongs to the
+ * connection unless its id is -1, then the caller frees it with
+ * release_descriptor().
+ */
+static int receive_descriptor(plcConn *conn, int32 n, plcDescriptor **result) {
+	int res = 0;
+	char tag;
+	int32 id = -1;
+	plcDescriptor *desc = NULL;
+	plcDescriptorTable *table;
+
+	*result = NULL;
+	res |= receive_char(conn, &tag);
+	if (tag == PLC_DESCRIPTOR_REF || tag == PLC_DESCRIPTOR_DEFINE)
+		res |= receive_int32(conn, &id);
+	if (res != 0)
+		return res;
+
+	if (conn->received_descs == NULL)
+		conn->received_descs = descriptor_table_create();
+	table = conn->received_descs;
+
+	switch (tag) {
+		case PLC_DESCRIPTOR_REF:
+			if (id < 0 || id >= table->count) {
+				plc_elog(LOG, "reference to unknown descriptor %d", id);
+				return -1;
+			}
+			desc = table->byId[id];
+			break;
+		case PLC_DESCRIPTOR_DEFINE:
+			if (id != table->count || id >= PLC_MAX_DESCRIPTORS) {
+				plc_elog(LOG, "unexpected definition of descriptor %d", id);
+				return -1;
+			}
+			/* Fall through */
+		case PLC_DESCRIPTOR_INLINE:
+			desc = pmalloc(sizeof(plcDescriptor));
+			memset(desc, 0, sizeof(plcDescriptor));
+			desc->id = id;
+			/* On failure the connection is dropped, the memory goes with it */
+			res |= receive_descriptor_body(conn, desc, n);
+			if (res != 0)
+				return res;
+			if (tag == PLC_DESCRIPTOR_DEFINE) {
+				desc = descriptor_persist(desc);
+				table->byId[table->count++] = desc;
+			}
+			break;
+		default:
+			plc_elog(LOG, "unknown descriptor tag '%c'", tag);
+			return -1;
+	}
+
+	if (desc->n != n) {
+		plc_elog(LOG, "descriptor %d has %d entries instead of %d", desc->id, desc->n, n);
+		return -1;
+	}
+
+	*result = desc;
+	return res;
+}
+
+static void release_descriptor(plcDescriptor *desc) {
+	if (desc != NULL && desc->id < 0)
+		free_descriptor(desc);
+}
+
+/* The descriptors defined by the message just sent are known to the peer */
+static void commit_descriptors(plcConn *conn) {
+	if (conn->sent_descs != NULL)
+		conn->sent_descs->committed = conn->sent_descs->count;
+}
+
+/* Forget the descriptors defined by a message that was not sent */
+static void rollback_descriptors(plcConn *conn) {
+	plcDescriptorTable *table = conn->sent_descs;
+	plcDescriptor **link;
+	plcDescriptor *desc;
+
+	if (table == NULL)
+		return;
+	while (table->count > table->committed) {
+		desc = table->byId[--table->count];
+		for (link = &table->buckets[desc->hash % PLC_DESCRIPTOR_BUCKETS]; *link != desc; link = &(*link)->next)
+			;
+		*link = desc->next;
+		table->byId[table->count] = NULL;
+		channel_elog(WARNING, "Forgetting descriptor %d of an unsent message", desc->id);
+		free_descriptor(desc);
+	}
+}
+
+void plcFreeDescriptors(plcConn *conn) {
+	plcDescriptorTable *tables[2];
+	int i, j;
+
+	tables[0] = conn->sent_descs;
+	tables[1] = conn->received_descs;
+	for (i = 0; i < 2; i++) {
+		if (tables[i] == NULL)
+			continue;
+		for (j = 0; j < tables[i]->count; j++)
+			free_descriptor(tables[i]->byId[j]);
+		pfree(tables[i]);
+	}
+	conn->sent_descs = NULL;
+	conn->received_descs = NULL;
+}
+
+/*
+ * Argument types and names are sent as one descriptor, preceded by the
+ * return type of the function if retType is not NULL. If program is not
+ * NULL, it is set to the program of the row of the arguments.
+ */
+static int send_argument_types(plcConn *conn, plcType *retType, int nargs, plcArgument *args,
+                               plcRowProgram **program) {
+	plcDescriptorKey key;
+	int i;
+
+	descriptor_key_init(&key);
+	if (retType != NULL)
+		descriptor_key_add(&key, retType, NULL);
+	for (i = 0; i < nargs; i++)
+		descriptor_key_add(&key, &args[i].type, args[i].name);
+
+	return send_descriptor(conn, &key, nargs, nargs > 0 ? &args[0].type : NULL, sizeof(plcArgument), program);
+}
+
+static int receive_argument_types(plcConn *conn, plcType *retType, int nargs, plcArgument *args,
+                                  plcRowProgram **program) {
+	int res = 0;
+	int i, first;
+	plcDescriptor *desc;
+
+	if (program != NULL)
+		*program = NULL;
+	first = (retType != NULL) ? 1 : 0;
+	res |= receive_descriptor(conn, nargs + first, &desc);
+	if (res != 0) {
+		/* Make free_callreq() and free_arguments() happy. */
+		if (retType != NULL) {
+			retType->typeName = NULL;
+			retType->nSubTypes = 0;
+		}
+		for (i = 0; i < nargs; i++) {
+			args[i].name = NULL;
+			args[i].type.typeName = NULL;
+			args[i].type.nSubTypes = 0;
+			args[i].data.isnull = 1;
+			args[i].data.value = NULL;
+		}
+		return res;
 	}
-	channel_elog(WARNING, "///////////////");
+
+	if (retType != NULL)
+		copy_type(retType, &desc->types[0], false);
+	for (i = 0; i < nargs; i++) {
+		copy_type(&args[i].type, &desc->types[i + first], false);
+		args[i].name = desc->names[i + first] == NULL ? NULL : pstrdup(desc->names[i + first]);
+		args[i].data.isnull = 1;
+		args[i].data.value = NULL;
+	}
+	if (program != NULL)
+		*program = descriptor_program(desc, nargs, nargs > 0 ? &args[0].type : NULL, sizeof(plcArgument));
+	release_descriptor(desc);
 
 	return res;
 }
 
-static int receive_udt(plcConn *conn, plcType *type, char **resdata) {
+/* Result columns types and names, and the program of the result rows */
+static int send_column_types(plcConn *conn, uint32 cols, plcType *types, char **names,
+                             plcRowProgram **program) {
+	plcDescriptorKey key;
+	uint32 i;
+
+	descriptor_key_init(&key);
+	for (i = 0; i < cols; i++)
+		descriptor_key_add(&key, &types[i], names[i]);
+
+	return send_descriptor(conn, &key, (int) cols, types, sizeof(plcType), program);
+}
+
+static int receive_column_types(plcConn *conn, uint32 cols, plcType *types, char **names,
+                                plcRowProgram **program) {
 	int res = 0;
-	int i = 0;
-	plcUDT *udt;
+	uint32 i;
+	plcDescriptor *desc;
 
-	channel_elog(WARNING, "Receiving user-defined type with %d members", type->nSubTypes);
+	if (program != NULL)
+		*program = NULL;
 
-	udt = plc_alloc_udt(type->nSubTypes);
-	for (i = 0; i < type->nSubTypes && res == 0; i++) {
-		res |= receive_raw_object(conn, &type->subTypes[i], &udt->data[i]);
+	for (i = 0; i < cols; i++) {
+		types[i].typeName = NULL;
+		types[i].nSubTypes = 0;
+		names[i] = NULL;
 	}
 
-	*resdata = (char *) udt;
-	return res;
-}
+	res |= receive_descriptor(conn, (int32) cols, &desc);
+	if (res != 0)
+		return res;
 
-/* Send Functions for the Main Engine */
+	for (i = 0; i < cols; i++) {
+		copy_type(&types[i], &desc->types[i], false);
+		names[i] = desc->names[i] == NULL ? NULL : pstrdup(desc->names[i]);
+	}
+	if (program != NULL)
+		*program = descriptor_program(desc, (int) cols, types, sizeof(plcType));
+	release_descriptor(desc);
 
-static int send_argument(plcConn *conn, plcArgument *arg) {
-	int res = 0;
-	channel_elog(WARNING, "Sending argument '%s'", arg->name);
-	res |= send_cstring(conn, arg->name);
-	channel_elog(WARNING, "Argument type is '%s'", plc_get_type_name(arg->type.type));
-	res |= send_type(conn, &arg->type);
-	res |= send_raw_object(conn, &arg->type, &arg->data);
 	return res;
 }
 
-static int send_ping(plcConn *conn) {
+/* Send Functions for the Main Engine */
+
+static int send_ping(plcConn *conn, plcMsgPing *msg) {
 	int res = 0;
 
 	channel_elog(WARNING, "Sending ping message");
 	res |= message_start(conn, MT_PING);
 	res |= send_cstring(conn, PLCONTAINER_VERSION);
+	res |= send_int32(conn, msg->compressThreshold);
+	res |= send_int32(conn, msg->sharedMemory);
+	res |= send_int32(conn, msg->sharedMemorySpinUs);
+	res |= send_int32(conn, msg->fdPassingThreshold);
+	res |= send_int32(conn, msg->wireVersion);
+	res |= send_int32(conn, msg->framing);
 	res |= message_end(conn);
 	channel_elog(WARNING, "Finished ping message");
 	return res;
@@ -698,6 +2643,7 @@ static int send_ping(plcConn *conn) {
 static int send_call(plcConn *conn, plcMsgCallreq *call) {
 	int res = 0;
 	int i;
+	plcRowProgram *program;
 
 	channel_elog(WARNING, "Sending call request for function '%s'", call->proc.name);
 	res |= message_start(conn, MT_CALLREQ);
@@ -709,58 +2655,109 @@ static int send_call(plcConn *conn, plcMsgCallreq *call) {
 	res |= send_cstring(conn, call->serverenc);
 	channel_elog(WARNING, "Log level is %d", call->logLevel);
 	res |=send_int32(conn, call->logLevel);
+	res |= send_int32(conn, call->clientMinMessages);
 	channel_elog(WARNING, "Function OID is '%u'", call->objectid);
 	res |= send_uint32(conn, call->objectid);
 	channel_elog(WARNING, "Function has changed is '%d'", call->hasChanged);
 	res |= send_int32(conn, call->hasChanged);
-	channel_elog(WARNING, "Function return type is '%s'", plc_get_type_name(call->retType.type));
-	res |= send_type(conn, &call->retType);
+	channel_elog(WARNING, "Function version is '%u'", call->version);
+	res |= send_uint32(conn, call->version);
 	channel_elog(WARNING, "Function is set-returning: %d", (int) call->retset);
 	res |= send_int32(conn, call->retset);
 	channel_elog(WARNING, "Function number of arguments is '%d'", call->nargs);
 	res |= send_int32(conn, call->nargs);
+	channel_elog(WARNING, "Function return type is '%s'", plc_get_type_name(call->retType.type));
+	res |= send_argument_types(conn, &call->retType, call->nargs, call->args, &program);
 
-	for (i = 0; i < call->nargs; i++)
-		res |= send_argument(conn, &call->args[i]);
+	if (call->nargs > 0)
+		res |= send_row(conn, program->ops, &call->args[0].data, sizeof(plcArgument), true);
+	release_row_program(program);
+
+	/* Arguments sent as NULL above that the client reads in slices */
+	res |= send_int32(conn, call->nsliced);
+	for (i = 0; i < call->nsliced; i++) {
+		res |= send_int32(conn, call->sliced[i].argument);
+		res |= send_int64(conn, call->sliced[i].size);
+	}
 
 	res |= message_end(conn);
 	channel_elog(WARNING, "Finished call request for function '%s'", call->proc.name);
 	return res;
 }
 
+/*
+ * Batched call request: the header is the same as for the plain call, the
+ * descriptor of the argument names and types is followed by nrows rows of
+ * argument values.
+ */
+static int send_call_batch(plcConn *conn, plcMsgCallreq *call) {
+	int res = 0;
+	uint32 i;
+	plcRowProgram *program;
+
+	channel_elog(WARNING, "Sending batched call request for function '%s'", call->proc.name);
+	res |= message_start(conn, MT_CALLREQ_BATCH);
+	res |= send_cstring(conn, call->proc.name);
+	res |= send_cstring(conn, call->proc.src);
+	res |= send_cstring(conn, call->serverenc);
+	res |= send_int32(conn, call->logLevel);
+	res |= send_int32(conn, call->clientMinMessages);
+	res |= send_uint32(conn, call->objectid);
+	res |= send_int32(conn, call->hasChanged);
+	res |= send_uint32(conn, call->version);
+	res |= send_int32(conn, call->retset);
+	res |= send_int32(conn, call->nargs);
+	res |= send_argument_types(conn, &call->retType, call->nargs, call->args, &program);
+
+	channel_elog(WARNING, "Batch contains %u rows", call->nrows);
+	res |= send_uint32(conn, call->nrows);
+	for (i = 0; i < call->nrows && res == 0 && call->nargs > 0; i++)
+		res |= send_row(conn, program->ops, call->rows[i], sizeof(rawdata), true);
+	release_row_program(program);
+
+	res |= message_end(conn);
+	channel_elog(WARNING, "Finished batched call request for function '%s'", call->proc.name);
+	return res;
+}
+
 static int send_result(plcConn *conn, plcMsgResult *ret) {
 	int res = 0;
-	uint32 i, j;
+	uint32 i;
 	plcMsgError *msg = NULL;
+	plcRowProgram *program = NULL;
 
-	res |= message_start(conn, MT_RESULT);
+	res |= message_start(conn, ret->msgtype);
 	channel_elog(WARNING, "Sending result of %d rows and %d columns", ret->rows, ret->cols);
+	if (ret->msgtype == MT_RESULT_CHUNK)
+		res |= send_int32(conn, ret->stream);
 	res |= send_int32(conn, ret->rows);
 	res |= send_int32(conn, ret->cols);
 
 	/* send columns types and names */
 	channel_elog(WARNING, "Sending types and names of %d columns", ret->cols);
-	for (i = 0; i < ret->cols; i++) {
-		channel_elog(WARNING, "Column '%s' with type '%d'", ret->names[i], (int) ret->types[i].type);
-		res |= send_type(conn, &ret->types[i]);
-		res |= send_cstring(conn, ret->names[i]);
-	}
+	if (ret->cols > 0)
+		res |= send_column_types(conn, ret->cols, ret->types, ret->names, &program);
 
 	/* send rows */
-	for (i = 0; i < ret->rows; i++)
-		for (j = 0; j < ret->cols; j++) {
-			channel_elog(WARNING, "Sending row %d column %d", i, j);
-			res |= send_raw_object(conn, &ret->types[j], &ret->data[i][j]);
-		}
+	for (i = 0; i < ret->rows && ret->cols > 0; i++) {
+		channel_elog(WARNING, "Sending row %d", i);
+		res |= send_row(conn, program->ops, ret->data[i], sizeof(rawdata), true);
+	}
+	release_row_program(program);
 
 	if (ret->exception_callback != NULL) {
 		msg = (plcMsgError *) ret->exception_callback();
 	}
 
+	/*
+	 * Without framing these are the bytes of an exception message of its own,
+	 * as peers that do not frame expect. A framed result carries it inside.
+	 */
 	if (msg == NULL) {
 		res |= send_char(conn, 'N');
 	} else {
-		res |= send_exception(conn, msg);
+		res |= send_char(conn, MT_EXCEPTION);
+		res |= send_exception_body(conn, msg);
 		free_error(msg);
 	}
 
@@ -771,6 +2768,100 @@ static int send_result(plcConn *conn, plcMsgResult *ret) {
 	return res;
 }
 
+static int send_result_next(plcConn *conn, plcMsgResultNext *msg) {
+	int res = 0;
+
+	channel_elog(WARNING, "Sending request '%c' for result set %d", msg->action, msg->stream);
+	res |= message_start(conn, MT_RESULT_NEXT);
+	res |= send_int32(conn, msg->stream);
+	res |= send_char(conn, msg->action);
+	res |= message_end(conn);
+
+	return res;
+}
+
+static int send_source_request(plcConn *conn, plcMsgSourceRequest *msg) {
+	int res = 0;
+
+	channel_elog(WARNING, "Requesting the source of function '%u'", msg->objectid);
+	res |= message_start(conn, MT_SOURCE_REQUEST);
+	res |= send_uint32(conn, msg->objectid);
+	res |= message_end(conn);
+
+	return res;
+}
+
+static int send_slice_request(plcConn *conn, plcMsgSliceRequest *msg) {
+	int res = 0;
+
+	channel_elog(WARNING, "Requesting %d bytes at %lld of argument %d", msg->length,
+	             (long long) msg->offset, msg->argument);
+	res |= message_start(conn, MT_SLICE_REQUEST);
+	res |= send_int32(conn, msg->argument);
+	res |= send_int64(conn, msg->offset);
+	res |= send_int32(conn, msg->length);
+	res |= message_end(conn);
+
+	return res;
+}
+
+static int send_column(plcConn *conn, plcType *type, plcColumn *col, uint32 rows) {
+	int res = 0;
+	uint32 i;
+
+	res |= send_char(conn, (char) col->encoding);
+	res |= send_char(conn, col->nulls != NULL);
+	if (col->nulls != NULL)
+		res |= plcBufferAppend(conn, col->nulls, (rows + 7) / 8);
+
+	switch (col->encoding) {
+		case PLC_COLUMN_FIXED:
+			res |= plcBufferAppend(conn, col->values, rows * plc_get_type_length(type->type));
+			break;
+		case PLC_COLUMN_VARLEN:
+		case PLC_COLUMN_DICT:
+			res |= send_int32(conn, col->nvalues);
+			res |= plcBufferAppend(conn, (char *) col->offsets, (col->nvalues + 1) * sizeof(int32));
+			res |= plcBufferAppend(conn, col->values, col->offsets[col->nvalues]);
+			if (col->encoding == PLC_COLUMN_DICT)
+				res |= plcBufferAppend(conn, (char *) col->codes, rows * sizeof(int32));
+			break;
+		case PLC_COLUMN_OBJECT:
+			for (i = 0; i < rows && res == 0; i++)
+				res |= send_raw_object(conn, type, &col->objects[i]);
+			break;
+		default:
+			plc_elog(ERROR, "Unsupported column encoding: %d", (int) col->encoding);
+			break;
+	}
+
+	return res;
+}
+
+static int send_columns(plcConn *conn, plcMsgColumns *ret) {
+	int res = 0;
+	uint32 i;
+
+	res |= message_start(conn, MT_RESULT_COLUMNS);
+	channel_elog(WARNING, "Sending columnar result of %d rows and %d columns", ret->rows, ret->cols);
+	res |= send_uint32(conn, ret->rows);
+	res |= send_uint32(conn, ret->cols);
+	if (ret->cols > 0)
+		res |= send_column_types(conn, ret->cols, ret->types, ret->names, NULL);
+
+	for (i = 0; i < ret->cols && res == 0; i++) {
+		channel_elog(WARNING, "Sending column '%s' with encoding %d", ret->names[i],
+		             (int) ret->columns[i].encoding);
+		res |= send_column(conn, &ret->types[i], &ret->columns[i], ret->rows);
+	}
+
+	res |= message_end(conn);
+
+	channel_elog(WARNING, "Finished sending columnar result");
+
+	return res;
+}
+
 static int send_log(plcConn *conn, plcMsgLog *mlog) {
 	int res = 0;
 
@@ -839,9 +2930,16 @@ static int send_subtransaction(plcConn *conn, plcMsgSubtransaction *mSub) {
 static int send_exception(plcConn *conn, plcMsgError *err) {
 	int res = 0;
 	res |= message_start(conn, MT_EXCEPTION);
+	res |= send_exception_body(conn, err);
+	res |= message_end(conn);
+	return res;
+}
+
+/* Also sent at the end of a result */
+static int send_exception_body(plcConn *conn, plcMsgError *err) {
+	int res = 0;
 	res |= send_cstring(conn, err->message);
 	res |= send_cstring(conn, err->stacktrace);
-	res |= message_end(conn);
 	return res;
 }
 
@@ -850,6 +2948,7 @@ static int send_sql(plcConn *conn, plcMsgSQL *msg) {
 
 	switch (msg->sqltype) {
 		case SQL_TYPE_STATEMENT:
+		case SQL_TYPE_STATEMENT_COLUMNS:
 			res = send_sql_statement(conn, msg);
 			break;
 		case SQL_TYPE_PREPARE:
@@ -859,8 +2958,16 @@ static int send_sql(plcConn *conn, plcMsgSQL *msg) {
 			res = send_sql_unprepare(conn, msg);
 			break;
 		case SQL_TYPE_PEXECUTE:
+		case SQL_TYPE_PEXECUTE_COLUMNS:
 			res = send_sql_pexecute(conn, msg);
 			break;
+		case SQL_TYPE_CURSOR_OPEN:
+			res = send_sql_cursor_open(conn, msg);
+			break;
+		case SQL_TYPE_FETCH:
+		case SQL_TYPE_CURSOR_CLOSE:
+			res = send_sql_cursor(conn, msg);
+			break;
 		default:
 			res = -1;
 			plc_elog(ERROR, "UNHANDLED SQL TYPE: %d for sql send", msg->sqltype);
@@ -891,8 +2998,9 @@ static int send_sql_prepare(plcConn *conn, plcMsgSQL *msg) {
 	res |= send_int32(conn, msg->sqltype);
 
 	res |= send_int32(conn, msg->nargs);
+	res |= send_argument_types(conn, NULL, msg->nargs, msg->args, NULL);
 	for (i = 0; i < msg->nargs; i++)
-		res |= send_argument(conn, &msg->args[i]);
+		res |= send_raw_object(conn, &msg->args[i].type, &msg->args[i].data);
 
 	res |= send_cstring(conn, msg->statement);
 	res |= message_end(conn);
@@ -919,8 +3027,9 @@ static int send_sql_pexecute(plcConn *conn, plcMsgSQL *msg) {
 	res |= send_int32(conn, msg->sqltype);
 
 	res |= send_int32(conn, msg->nargs);
+	res |= send_argument_types(conn, NULL, msg->nargs, msg->args, NULL);
 	for (i = 0; i < msg->nargs; i++)
-		res |= send_argument(conn, &msg->args[i]);
+		res |= send_raw_object(conn, &msg->args[i].type, &msg->args[i].data);
 	res |= send_int64(conn, msg->limit);
 
 	res |= send_int64(conn, (int64) msg->pplan);
@@ -929,14 +3038,46 @@ static int send_sql_pexecute(plcConn *conn, plcMsgSQL *msg) {
 	return res;
 }
 
-static int send_rawmsg(plcConn *conn, plcMsgRaw *msg) {
+/* Open a cursor either for a statement or for a prepared plan with its arguments */
+static int send_sql_cursor_open(plcConn *conn, plcMsgSQL *msg) {
 	int res = 0;
 	int i;
 
+	res |= message_start(conn, MT_SQL);
+	res |= send_int32(conn, msg->sqltype);
+	res |= send_int32(conn, msg->cursor);
+	res |= send_int64(conn, msg->limit);
+
+	res |= send_int32(conn, msg->nargs);
+	res |= send_argument_types(conn, NULL, msg->nargs, msg->args, NULL);
+	for (i = 0; i < msg->nargs; i++)
+		res |= send_raw_object(conn, &msg->args[i].type, &msg->args[i].data);
+	res |= send_int64(conn, (int64) msg->pplan);
+	res |= send_cstring(conn, msg->statement);
+	res |= message_end(conn);
+
+	return res;
+}
+
+static int send_sql_cursor(plcConn *conn, plcMsgSQL *msg) {
+	int res = 0;
+
+	res |= message_start(conn, MT_SQL);
+	res |= send_int32(conn, msg->sqltype);
+	res |= send_int32(conn, msg->cursor);
+	res |= send_int64(conn, msg->limit);
+	res |= message_end(conn);
+
+	return res;
+}
+
+static int send_rawmsg(plcConn *conn, plcMsgRaw *msg) {
+	int res = 0;
+
 	res |= message_start(conn, MT_RAW);
 	res |= send_int32(conn, msg->size);
-	for (i = 0; i < msg->size; i++)
-		res |= send_char(conn, msg->data[i]);
+	if (msg->size > 0)
+		res |= plcBufferAppend(conn, msg->data, msg->size);
 	res |= message_end(conn);
 
 	return res;
@@ -957,15 +3098,21 @@ static int receive_exception(plcConn *conn, plcMessage **mExc) {
 	return res;
 }
 
-static int receive_result(plcConn *conn, plcMessage **mRes) {
-	uint32 i, j;
+static int receive_result(plcConn *conn, plcMessage **mRes, char msgType) {
+	uint32 i;
 	int res = 0;
 	char exc;
 	plcMsgResult *ret;
+	plcRowProgram *program = NULL;
 
 	*mRes = pmalloc(sizeof(plcMsgResult));
 	ret = (plcMsgResult *) *mRes;
-	ret->msgtype = MT_RESULT;
+	ret->msgtype = msgType;
+	ret->stream = 0;
+	ret->frame = plcBufferFrameTake(conn, &ret->frameLen);
+	ret->mappings = NULL;
+	if (msgType == MT_RESULT_CHUNK)
+		res |= receive_int32(conn, &ret->stream);
 	res |= receive_uint32(conn, &ret->rows);
 	res |= receive_uint32(conn, &ret->cols);
 	channel_elog(WARNING, "Receiving function result of %d rows and %d columns",
@@ -983,16 +3130,7 @@ static int receive_result(plcConn *conn, plcMessage **mRes) {
 			ret->types = pmalloc(ret->cols * sizeof(plcType));
 			ret->names = pmalloc(ret->cols * sizeof(*ret->names));
 
-			for (i = 0; i < ret->cols && res == 0; i++) {
-				res |= receive_type(conn, &ret->types[i]);
-				res |= receive_cstring(conn, &ret->names[i]);
-				channel_elog(WARNING, "Column '%s' with type '%d'", ret->names[i], (int) ret->types[i].type);
-			}
-			for (; i < ret->cols; i++) {
-				ret->types[i].typeName = NULL;
-				ret->types[i].nSubTypes = 0;
-				ret->names[i] = NULL;
-			}
+			res |= receive_column_types(conn, ret->cols, ret->types, ret->names, &program);
 
 			/* receive rows */
 			if (ret->rows > 0) {
@@ -1000,14 +3138,13 @@ static int receive_result(plcConn *conn, plcMessage **mRes) {
 
 				for (i = 0; i < ret->rows && res == 0; i++) {
 					ret->data[i] = pmalloc(ret->cols * sizeof(*ret->data[i]));
-					for (j = 0; j < ret->cols; j++) {
-						channel_elog(WARNING, "Receiving row %d column %d", i, j);
-						res |= receive_raw_object(conn, &ret->types[j], &ret->data[i][j]);
-					}
+					channel_elog(WARNING, "Receiving row %d", i);
+					res |= receive_row(conn, program->ops, ret->data[i], sizeof(rawdata), &ret->mappings);
 				}
 				for (; i < ret->rows; i++)
 					ret->data[i] = NULL;
 			}
+			release_row_program(program);
 		}
 	}
 
@@ -1021,6 +3158,142 @@ static int receive_result(plcConn *conn, plcMessage **mRes) {
 	return res;
 }
 
+static int receive_result_next(plcConn *conn, plcMessage **mNext) {
+	int res = 0;
+	plcMsgResultNext *ret;
+
+	*mNext = pmalloc(sizeof(plcMsgResultNext));
+	ret = (plcMsgResultNext *) *mNext;
+	ret->msgtype = MT_RESULT_NEXT;
+	res |= receive_int32(conn, &ret->stream);
+	res |= receive_char(conn, &ret->action);
+	channel_elog(WARNING, "Received request '%c' for result set %d", ret->action, ret->stream);
+
+	return res;
+}
+
+static int receive_source_request(plcConn *conn, plcMessage **mReq) {
+	int res = 0;
+	plcMsgSourceRequest *ret;
+
+	*mReq = pmalloc(sizeof(plcMsgSourceRequest));
+	ret = (plcMsgSourceRequest *) *mReq;
+	ret->msgtype = MT_SOURCE_REQUEST;
+	res |= receive_uint32(conn, &ret->objectid);
+	channel_elog(WARNING, "Received request for the source of function '%u'", ret->objectid);
+
+	return res;
+}
+
+static int receive_slice_request(plcConn *conn, plcMessage **mReq) {
+	int res = 0;
+	plcMsgSliceRequest *ret;
+
+	*mReq = pmalloc(sizeof(plcMsgSliceRequest));
+	ret = (plcMsgSliceRequest *) *mReq;
+	ret->msgtype = MT_SLICE_REQUEST;
+	res |= receive_int32(conn, &ret->argument);
+	res |= receive_int64(conn, &ret->offset);
+	res |= receive_int32(conn, &ret->length);
+
+	return res;
+}
+
+static int receive_column(plcConn *conn, plcType *type, plcColumn *col, uint32 rows) {
+	int res = 0;
+	char encoding;
+	char hasnulls;
+	uint32 i;
+
+	res |= receive_char(conn, &encoding);
+	res |= receive_char(conn, &hasnulls);
+	if (res != 0)
+		return res;
+
+	col->encoding = (plcColumnEncoding) encoding;
+	if (hasnulls) {
+		col->nulls = pmalloc((rows + 7) / 8);
+		res |= receive_raw(conn, col->nulls, (rows + 7) / 8);
+	}
+
+	switch (col->encoding) {
+		case PLC_COLUMN_FIXED:
+			col->values = pmalloc(rows * plc_get_type_length(type->type));
+			res |= receive_raw(conn, col->values, rows * plc_get_type_length(type->type));
+			break;
+		case PLC_COLUMN_VARLEN:
+		case PLC_COLUMN_DICT:
+			res |= receive_int32(conn, &col->nvalues);
+			if (res != 0 || col->nvalues < 0) {
+				plc_elog(LOG, "column with a bad number of values: %d", col->nvalues);
+				return -1;
+			}
+			col->offsets = pmalloc((col->nvalues + 1) * sizeof(int32));
+			res |= receive_raw(conn, (char *) col->offsets, (col->nvalues + 1) * sizeof(int32));
+			if (res != 0 || col->offsets[col->nvalues] < 0) {
+				plc_elog(LOG, "column with a bad data length");
+				return -1;
+			}
+			col->values = pmalloc(col->offsets[col->nvalues] + 1);
+			res |= receive_raw(conn, col->values, col->offsets[col->nvalues]);
+			if (col->encoding == PLC_COLUMN_DICT) {
+				col->codes = pmalloc(rows * sizeof(int32));
+				res |= receive_raw(conn, (char *) col->codes, rows * sizeof(int32));
+			}
+			break;
+		case PLC_COLUMN_OBJECT:
+			col->objects = pmalloc(rows * sizeof(rawdata));
+			for (i = 0; i < rows; i++) {
+				col->objects[i].isnull = 1;
+				col->objects[i].value = NULL;
+			}
+			for (i = 0; i < rows && res == 0; i++)
+				res |= receive_raw_object(conn, type, &col->objects[i]);
+			break;
+		default:
+			plc_elog(LOG, "unsupported column encoding: %d", (int) encoding);
+			return -1;
+	}
+
+	return res;
+}
+
+static int receive_columns(plcConn *conn, plcMessage **mRes) {
+	uint32 i;
+	int res = 0;
+	plcMsgColumns *ret;
+
+	*mRes = pmalloc(sizeof(plcMsgColumns));
+	ret = (plcMsgColumns *) *mRes;
+	ret->msgtype = MT_RESULT_COLUMNS;
+	ret->types = NULL;
+	ret->names = NULL;
+	ret->columns = NULL;
+	ret->cols = 0;
+	res |= receive_uint32(conn, &ret->rows);
+	res |= receive_uint32(conn, &ret->cols);
+	channel_elog(WARNING, "Receiving columnar result of %d rows and %d columns",
+	             ret->rows, ret->cols);
+	if (res != 0 || ret->cols == 0) {
+		ret->cols = 0;
+		return res;
+	}
+
+	ret->types = pmalloc(ret->cols * sizeof(plcType));
+	ret->names = pmalloc(ret->cols * sizeof(*ret->names));
+	ret->columns = pmalloc(ret->cols * sizeof(plcColumn));
+	for (i = 0; i < ret->cols; i++)
+		memset(&ret->columns[i], 0, sizeof(plcColumn));
+
+	res |= receive_column_types(conn, ret->cols, ret->types, ret->names, NULL);
+
+	for (i = 0; i < ret->cols && res == 0; i++)
+		res |= receive_column(conn, &ret->types[i], &ret->columns[i], ret->rows);
+
+	channel_elog(WARNING, "Finished receiving columnar result");
+	return res;
+}
+
 static int receive_log(plcConn *conn, plcMessage **mLog) {
 	int res = 0;
 	plcMsgLog *ret;
@@ -1089,8 +3362,9 @@ static int receive_sql_prepare(plcConn *conn, plcMessage **mStmt) {
 		return -1;
 	} else if (ret->nargs > 0) {
 		ret->args = pmalloc(ret->nargs * sizeof(*ret->args));
-		for (i = 0; i < ret->nargs; i++)
-			res |= receive_argument(conn, &ret->args[i]);
+		res |= receive_argument_types(conn, NULL, ret->nargs, ret->args, NULL);
+		for (i = 0; i < ret->nargs && res == 0; i++)
+			res |= receive_raw_object(conn, &ret->args[i].type, &ret->args[i].data);
 	}
 
 	res |= receive_cstring(conn, &ret->statement);
@@ -1164,8 +3438,9 @@ static int receive_sql_pexecute(plcConn *conn, plcMessage **mStmt) {
 		return -1;
 	} else if (ret->nargs > 0) {
 		ret->args = pmalloc(ret->nargs * sizeof(*ret->args));
-		for (i = 0; i < ret->nargs; i++)
-			res |= receive_argument(conn, &ret->args[i]);
+		res |= receive_argument_types(conn, NULL, ret->nargs, ret->args, NULL);
+		for (i = 0; i < ret->nargs && res == 0; i++)
+			res |= receive_raw_object(conn, &ret->args[i].type, &ret->args[i].data);
 	}
 	res |= receive_int64(conn, &ret->limit);
 	res |= receive_int64(conn, &pplan);
@@ -1175,13 +3450,49 @@ static int receive_sql_pexecute(plcConn *conn, plcMessage **mStmt) {
 	return res;
 }
 
-static int receive_argument(plcConn *conn, plcArgument *arg) {
+static int receive_sql_cursor_open(plcConn *conn, plcMessage **mStmt) {
+	int res = 0;
+	int64 pplan;
+	plcMsgSQL *ret;
+	int i;
+
+	*mStmt = pmalloc(sizeof(plcMsgSQL));
+	ret = (plcMsgSQL *) *mStmt;
+	ret->msgtype = MT_SQL;
+	ret->sqltype = SQL_TYPE_CURSOR_OPEN;
+	ret->args = NULL;
+
+	channel_elog(WARNING, "Receiving spi cursor open request");
+	res |= receive_int32(conn, &ret->cursor);
+	res |= receive_int64(conn, &ret->limit);
+	res |= receive_int32(conn, &ret->nargs);
+	if (ret->nargs < 0) {
+		plc_elog(LOG, "spi cursor open request with nargs (%d) < 0", ret->nargs);
+		return -1;
+	} else if (ret->nargs > 0) {
+		ret->args = pmalloc(ret->nargs * sizeof(*ret->args));
+		res |= receive_argument_types(conn, NULL, ret->nargs, ret->args, NULL);
+		for (i = 0; i < ret->nargs && res == 0; i++)
+			res |= receive_raw_object(conn, &ret->args[i].type, &ret->args[i].data);
+	}
+	res |= receive_int64(conn, &pplan);
+	ret->pplan = (void *) pplan;
+	res |= receive_cstring(conn, &ret->statement);
+
+	channel_elog(WARNING, "Received spi cursor open request and returned %d", res);
+	return res;
+}
+
+static int receive_sql_cursor(plcConn *conn, plcMessage **mStmt) {
 	int res = 0;
-	res |= receive_cstring(conn, &arg->name);
-	channel_elog(WARNING, "Receiving argument '%s'", arg->name);
-	res |= receive_type(conn, &arg->type);
-	channel_elog(WARNING, "Argument type is '%s'", plc_get_type_name(arg->type.type));
-	res |= receive_raw_object(conn, &arg->type, &arg->data);
+	plcMsgSQL *ret;
+
+	*mStmt = pmalloc(sizeof(plcMsgSQL));
+	ret = (plcMsgSQL *) *mStmt;
+	ret->msgtype = MT_SQL;
+
+	res |= receive_int32(conn, &ret->cursor);
+	res |= receive_int64(conn, &ret->limit);
 	return res;
 }
 
@@ -1201,20 +3512,65 @@ static int receive_ping(plcConn *conn, plcMessage **mPing) {
 		}
 		pfree(version);
 	}
+	res |= receive_int32(conn, &((plcMsgPing *) *mPing)->compressThreshold);
+	res |= receive_int32(conn, &((plcMsgPing *) *mPing)->sharedMemory);
+	res |= receive_int32(conn, &((plcMsgPing *) *mPing)->sharedMemorySpinUs);
+	res |= receive_int32(conn, &((plcMsgPing *) *mPing)->fdPassingThreshold);
+	res |= receive_int32(conn, &((plcMsgPing *) *mPing)->wireVersion);
+	res |= receive_int32(conn, &((plcMsgPing *) *mPing)->framing);
 
 	channel_elog(WARNING, "Finished receiving ping message");
 	return res;
 }
 
-static int receive_call(plcConn *conn, plcMessage **mCall) {
+/*
+ * The arguments of a call the client reads in slices: they were sent as NULL,
+ * only their index and size follow the values.
+ */
+static int receive_sliced_arguments(plcConn *conn, plcMsgCallreq *req) {
 	int res = 0;
 	int i;
+
+	res |= receive_int32(conn, &req->nsliced);
+	if (res != 0 || req->nsliced == 0)
+		return res;
+	if (req->nsliced < 0 || req->nsliced > req->nargs) {
+		plc_elog(LOG, "function call with %d sliced arguments out of %d", req->nsliced, req->nargs);
+		req->nsliced = 0;
+		return -1;
+	}
+
+	req->sliced = pmalloc(req->nsliced * sizeof(plcSlicedArg));
+	for (i = 0; i < req->nsliced; i++) {
+		req->sliced[i].source = NULL;
+		req->sliced[i].detoasted = false;
+		res |= receive_int32(conn, &req->sliced[i].argument);
+		res |= receive_int64(conn, &req->sliced[i].size);
+		if (res == 0 && (req->sliced[i].argument < 0 || req->sliced[i].argument >= req->nargs ||
+		                 req->sliced[i].size < 0)) {
+			plc_elog(LOG, "sliced argument %d of %lld bytes is invalid",
+			         req->sliced[i].argument, (long long) req->sliced[i].size);
+			return -1;
+		}
+	}
+	return res;
+}
+
+static int receive_call(plcConn *conn, plcMessage **mCall) {
+	int res = 0;
 	plcMsgCallreq *req;
+	plcRowProgram *program = NULL;
 
 	*mCall = pmalloc(sizeof(plcMsgCallreq));
 	req = (plcMsgCallreq *) *mCall;
 	req->msgtype = MT_CALLREQ;
+	req->frame = plcBufferFrameTake(conn, &req->frameLen);
+	req->mappings = NULL;
+	req->nsliced = 0;
+	req->sliced = NULL;
 	res |= receive_cstring(conn, &req->proc.name);
+	req->nrows = 0;
+	req->rows = NULL;
 	channel_elog(WARNING, "Receiving call request for function '%s'", req->proc.name);
 	res |= receive_cstring(conn, &req->proc.src);
 	channel_elog(WARNING, "Function source code:");
@@ -1223,31 +3579,96 @@ static int receive_call(plcConn *conn, plcMessage **mCall) {
 	channel_elog(WARNING, "db encoding %s", req->serverenc);
 	res |= receive_int32(conn, &req->logLevel);
 	channel_elog(WARNING, "Receiving Log level %d",req->logLevel);
+	res |= receive_int32(conn, &req->clientMinMessages);
 	res |= receive_uint32(conn, &req->objectid);
 	channel_elog(WARNING, "Function OID is '%u'", req->objectid);
 	res |= receive_int32(conn, &req->hasChanged);
 	channel_elog(WARNING, "Function has changed is '%d'", req->hasChanged);
-	res |= receive_type(conn, &req->retType);
-	channel_elog(WARNING, "Function return type is '%s'", plc_get_type_name(req->retType.type));
+	res |= receive_uint32(conn, &req->version);
+	channel_elog(WARNING, "Function version is '%u'", req->version);
 	res |= receive_int32(conn, &req->retset);
 	channel_elog(WARNING, "Function is set-returning: %d", (int) req->retset);
 	res |= receive_int32(conn, &req->nargs);
 	channel_elog(WARNING, "Function number of arguments is '%d'", req->nargs);
 	if (res == 0) {
 		req->args = NULL;
-		if (req->nargs > 0) {
-			req->args = pmalloc(sizeof(*req->args) * req->nargs);
-			for (i = 0; i < req->nargs && res == 0; i++)
-				res |= receive_argument(conn, &req->args[i]);
-		} else if (req->nargs < 0) {
+		if (req->nargs < 0) {
 			plc_elog(LOG, "function call with nargs (%d) < 0", req->nargs);
 			return -1;
 		}
+		if (req->nargs > 0)
+			req->args = pmalloc(sizeof(*req->args) * req->nargs);
+		res |= receive_argument_types(conn, &req->retType, req->nargs, req->args, &program);
+		channel_elog(WARNING, "Function return type is '%s'", plc_get_type_name(req->retType.type));
+		if (req->nargs > 0 && res == 0)
+			res |= receive_row(conn, program->ops, &req->args[0].data, sizeof(plcArgument), &req->mappings);
+		release_row_program(program);
 	}
+	if (res == 0)
+		res |= receive_sliced_arguments(conn, req);
 	channel_elog(WARNING, "Finished call request for function '%s'", req->proc.name);
 	return res;
 }
 
+static int receive_call_batch(plcConn *conn, plcMessage **mCall) {
+	int res = 0;
+	uint32 i;
+	plcMsgCallreq *req;
+	plcRowProgram *program = NULL;
+
+	*mCall = pmalloc(sizeof(plcMsgCallreq));
+	req = (plcMsgCallreq *) *mCall;
+	req->msgtype = MT_CALLREQ_BATCH;
+	req->frame = plcBufferFrameTake(conn, &req->frameLen);
+	req->mappings = NULL;
+	req->nsliced = 0;
+	req->sliced = NULL;
+	req->args = NULL;
+	req->nrows = 0;
+	req->rows = NULL;
+	res |= receive_cstring(conn, &req->proc.name);
+	channel_elog(WARNING, "Receiving batched call request for function '%s'", req->proc.name);
+	res |= receive_cstring(conn, &req->proc.src);
+	res |= receive_cstring(conn, &req->serverenc);
+	res |= receive_int32(conn, &req->logLevel);
+	res |= receive_int32(conn, &req->clientMinMessages);
+	res |= receive_uint32(conn, &req->objectid);
+	res |= receive_int32(conn, &req->hasChanged);
+	res |= receive_uint32(conn, &req->version);
+	res |= receive_int32(conn, &req->retset);
+	res |= receive_int32(conn, &req->nargs);
+	if (res != 0)
+		return res;
+
+	if (req->nargs < 0) {
+		plc_elog(LOG, "batched function call with nargs (%d) < 0", req->nargs);
+		return -1;
+	}
+
+	/* Values are filled in from rows[] for each call of the batch */
+	if (req->nargs > 0)
+		req->args = pmalloc(sizeof(*req->args) * req->nargs);
+	res |= receive_argument_types(conn, &req->retType, req->nargs, req->args, &program);
+
+	res |= receive_uint32(conn, &req->nrows);
+	channel_elog(WARNING, "Batch contains %u rows", req->nrows);
+	if (res == 0 && req->nrows > 0) {
+		req->rows = pmalloc(req->nrows * sizeof(rawdata *));
+		for (i = 0; i < req->nrows; i++) {
+			req->rows[i] = NULL;
+		}
+		for (i = 0; i < req->nrows && res == 0; i++) {
+			req->rows[i] = pmalloc((req->nargs > 0 ? req->nargs : 1) * sizeof(rawdata));
+			if (req->nargs > 0)
+				res |= receive_row(conn, program->ops, req->rows[i], sizeof(rawdata), &req->mappings);
+		}
+	}
+	release_row_program(program);
+
+	channel_elog(WARNING, "Finished batched call request for function '%s'", req->proc.name);
+	return res;
+}
+
 static int receive_sql(plcConn *conn, plcMessage **mSql) {
 	int res = 0;
 	int sqlType;
@@ -1256,7 +3677,9 @@ static int receive_sql(plcConn *conn, plcMessage **mSql) {
 	if (res == 0) {
 		switch (sqlType) {
 			case SQL_TYPE_STATEMENT:
+			case SQL_TYPE_STATEMENT_COLUMNS:
 				res = receive_sql_statement(conn, mSql);
+				((plcMsgSQL *) *mSql)->sqltype = sqlType;
 				break;
 			case SQL_TYPE_PREPARE:
 				res = receive_sql_prepare(conn, mSql);
@@ -1265,7 +3688,17 @@ static int receive_sql(plcConn *conn, plcMessage **mSql) {
 				res = receive_sql_unprepare(conn, mSql);
 				break;
 			case SQL_TYPE_PEXECUTE:
+			case SQL_TYPE_PEXECUTE_COLUMNS:
 				res = receive_sql_pexecute(conn, mSql);
+				((plcMsgSQL *) *mSql)->sqltype = sqlType;
+				break;
+			case SQL_TYPE_CURSOR_OPEN:
+				res = receive_sql_cursor_open(conn, mSql);
+				break;
+			case SQL_TYPE_FETCH:
+			case SQL_TYPE_CURSOR_CLOSE:
+				res = receive_sql_cursor(conn, mSql);
+				((plcMsgSQL *) *mSql)->sqltype = sqlType;
 				break;
 			default:
 				res = -1;
@@ -46,8 +46,16 @@ interpreted as representing official policies, either expressed or implied, of t
 
 int plcontainer_channel_send(plcConn *conn, plcMessage *msg);
 
+int plcontainer_channel_send_held(plcConn *conn, plcMessage *msg);
+
 int plcontainer_channel_receive(plcConn *conn, plcMessage **msg, int64 mask);
 
+#ifdef PLC_CLIENT
+int plcontainer_channel_flush(plcConn *conn);
+#endif
+
 void fill_prepare_argument(plcArgument *arg, char *str, plcDatatype plcData);
 
+void plcFreeDescriptors(plcConn *conn);
+
 #endif /* PLC_COMM_CHANNEL_H */
@@ -0,0 +1,201 @@
+/*------------------------------------------------------------------------------
+ *
+ *
+ * Copyright (c) 2016-Present Pivotal Software, Inc
+ *
+ *------------------------------------------------------------------------------
+ */
+
+/*
+ * Fast LZ77 compression in the LZ4 block format, used for the blocks of a
+ * compressed connection. The compressor is the greedy single probe one: a
+ * hash of the next four bytes finds the last position with the same hash
+ * and the match is extended in both directions. This gives a ratio in the
+ * range of LZ4 on text and JSON at a few hundred MB/s, and never looks at
+ * more than one candidate, so incompressible data costs little.
+ *
+ * A block is a sequence of
+ *   token - high 4 bits literal length, low 4 bits match length - 4,
+ *           15 means the length continues in the following bytes
+ *   [literal length bytes] literals offset(2 bytes LE) [match length bytes]
+ * and ends with a sequence of literals only.
+ */
+#include <string.h>
+
+#include "comm_compress.h"
+
+#define PLC_LZ_HASH_BITS 12
+#define PLC_LZ_MIN_MATCH 4
+#define PLC_LZ_LAST_LITERALS 5 /* the block ends with at least as many literals */
+#define PLC_LZ_MF_LIMIT 12     /* no match starts closer to the end */
+#define PLC_LZ_MAX_OFFSET 65535
+
+static unsigned int lz_read32(const unsigned char *p) {
+	unsigned int v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static unsigned int lz_hash(unsigned int v) {
+	return (v * 2654435761U) >> (32 - PLC_LZ_HASH_BITS);
+}
+
+/* Length continuation bytes of a length that did not fit into its 4 bits */
+static unsigned char *lz_write_length(unsigned char *op, size_t len) {
+	while (len >= 255) {
+		*op++ = 255;
+		len -= 255;
+	}
+	*op++ = (unsigned char) len;
+	return op;
+}
+
+size_t plc_lz_compress(const char *source, size_t srcLen, char *dest, size_t dstCap) {
+	const unsigned char *src = (const unsigned char *) source;
+	const unsigned char *ip = src;
+	const unsigned char *anchor = src;
+	const unsigned char *end = src + srcLen;
+	unsigned char *op = (unsigned char *) dest;
+	unsigned char *oend = op + dstCap;
+	size_t table[1 << PLC_LZ_HASH_BITS];
+	size_t litLen;
+
+	/* Positions are stored + 1 so that 0 means empty */
+	memset(table, 0, sizeof(table));
+
+	if (srcLen > PLC_LZ_MF_LIMIT) {
+		const unsigned char *mflimit = end - PLC_LZ_MF_LIMIT;
+		const unsigned char *matchlimit = end - PLC_LZ_LAST_LITERALS;
+
+		while (ip < mflimit) {
+			unsigned int seq = lz_read32(ip);
+			unsigned int h = lz_hash(seq);
+			const unsigned char *match;
+			size_t matchLen;
+			unsigned char *token;
+
+			match = table[h] == 0 ? NULL : src + table[h] - 1;
+			table[h] = (size_t) (ip - src) + 1;
+			if (match == NULL || ip - match > PLC_LZ_MAX_OFFSET || lz_read32(match) != seq) {
+				ip++;
+				continue;
+			}
+
+			while (ip > anchor && match > src && ip[-1] == match[-1]) {
+				ip--;
+				match--;
+			}
+			matchLen = PLC_LZ_MIN_MATCH;
+			while (ip + matchLen < matchlimit && ip[matchLen] == match[matchLen])
+				matchLen++;
+
+			litLen = (size_t) (ip - anchor);
+			if ((size_t) (oend - op) < 1 + litLen / 255 + 1 + litLen + 2 + matchLen / 255 + 1)
+				return 0;
+
+			token = op++;
+			if (litLen >= 15) {
+				*token = 15 << 4;
+				op = lz_write_length(op, litLen - 15);
+			} else {
+				*token = (unsigned char) (litLen << 4);
+			}
+			memcpy(op, anchor, litLen);
+			op += litLen;
+
+			*op++ = (unsigned char) ((ip - match) & 0xff);
+			*op++ = (unsigned char) ((ip - match) >> 8);
+
+			if (matchLen - PLC_LZ_MIN_MATCH >= 15) {
+				*token |= 15;
+				op = lz_write_length(op, matchLen - PLC_LZ_MIN_MATCH - 15);
+			} else {
+				*token |= (unsigned char) (matchLen - PLC_LZ_MIN_MATCH);
+			}
+
+			ip += matchLen;
+			anchor = ip;
+		}
+	}
+
+	litLen = (size_t) (end - anchor);
+	if ((size_t) (oend - op) < 1 + litLen / 255 + 1 + litLen)
+		return 0;
+	if (litLen >= 15) {
+		*op++ = 15 << 4;
+		op = lz_write_length(op, litLen - 15);
+	} else {
+		*op++ = (unsigned char) (litLen << 4);
+	}
+	memcpy(op, anchor, litLen);
+	op += litLen;
+
+	return (size_t) (op - (unsigned char *) dest);
+}
+
+/* Reads the continuation bytes of a length, returns -1 past the input */
+static int lz_read_length(const unsigned char **ip, const unsigned char *iend, size_t *len) {
+	unsigned char b;
+
+	do {
+		if (*ip >= iend)
+			return -1;
+		b = *(*ip)++;
+		*len += b;
+	} while (b == 255);
+
+	return 0;
+}
+
+int plc_lz_decompress(const char *source, size_t srcLen, char *dest, size_t dstLen) {
+	const unsigned char *ip = (const unsigned char *) source;
+	const unsigned char *iend = ip + srcLen;
+	unsigned char *op = (unsigned char *) dest;
+	unsigned char *ostart = op;
+	unsigned char *oend = op + dstLen;
+
+	while (ip < iend) {
+		unsigned char token = *ip++;
+		size_t litLen = token >> 4;
+		size_t matchLen = token & 15;
+		size_t offset;
+		const unsigned char *match;
+
+		if (litLen == 15 && lz_read_length(&ip, iend, &litLen) < 0)
+			return -1;
+		if (litLen > (size_t) (iend - ip) || litLen > (size_t) (oend - op))
+			return -1;
+		memcpy(op, ip, litLen);
+		op += litLen;
+		ip += litLen;
+
+		/* The last sequence has literals only */
+		if (ip == iend)
+			break;
+
+		if (iend - ip < 2)
+			return -1;
+		offset = ip[0] | ((size_t) ip[1] << 8);
+		ip += 2;
+		if (offset == 0 || offset > (size_t) (op - ostart))
+			return -1;
+
+		if (matchLen == 15 && lz_read_length(&ip, iend, &matchLen) < 0)
+			return -1;
+		matchLen += PLC_LZ_MIN_MATCH;
+		if (matchLen > (size_t) (oend - op))
+			return -1;
+
+		/* The match may overlap the output it is copied to */
+		match = op - offset;
+		if (offset >= matchLen) {
+			memcpy(op, match, matchLen);
+			op += matchLen;
+		} else {
+			while (matchLen-- > 0)
+				*op++ = *match++;
+		}
+	}
+
+	return op == oend ? 0 : -1;
+}
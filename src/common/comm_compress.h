@@ -0,0 +1,28 @@
+/*------------------------------------------------------------------------------
+ *
+ *
+ * Copyright (c) 2016-Present Pivotal Software, Inc
+ *
+ *------------------------------------------------------------------------------
+ */
+#ifndef PLC_COMM_COMPRESS_H
+#define PLC_COMM_COMPRESS_H
+
+#include <stddef.h>
+
+/* Worst case size of the compressed form of len bytes */
+#define PLC_LZ_BOUND(len) ((len) + (len) / 255 + 16)
+
+/*
+ * Compress src into dst in the LZ4 block format. Returns the compressed
+ * size, or 0 if it would not fit into dstCap bytes.
+ */
+size_t plc_lz_compress(const char *src, size_t srcLen, char *dst, size_t dstCap);
+
+/*
+ * Decompress src into exactly dstLen bytes of dst. Returns 0 on success,
+ * -1 if the input is malformed or does not decompress to dstLen bytes.
+ */
+int plc_lz_decompress(const char *src, size_t srcLen, char *dst, size_t dstLen);
+
+#endif /* PLC_COMM_COMPRESS_H */
@@ -5,6 +5,9 @@
  *
  *------------------------------------------------------------------------------
  */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
 #include <errno.h>
 #include <signal.h>
 #include <time.h>
@@ -19,24 +22,60 @@
 #include <assert.h>
 #include <sys/un.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <libgen.h>
+#include <limits.h>
 
 #include "comm_utils.h"
+#include "comm_compress.h"
 #include "comm_connectivity.h"
+#include "comm_shm.h"
 #ifndef PLC_CLIENT
   #include "miscadmin.h"
+  #if PG_VERSION_NUM >= 90400
+    #include "storage/latch.h"
+    #include "storage/proc.h"
+    #if PG_VERSION_NUM >= 100000
+      #include "pgstat.h"
+    #endif
+  #endif
+#endif
+
+/*
+ * The backend sleeps on its latch while waiting for the socket, the signals
+ * of an interrupt or of the postmaster going away set it. Without latches it
+ * sleeps in ppoll() with the signals blocked until then.
+ */
+#ifndef PLC_CLIENT
+  #if PG_VERSION_NUM >= 90500
+    #define PLC_WAIT_LATCH MyLatch
+  #elif PG_VERSION_NUM >= 90400
+    #define PLC_WAIT_LATCH (&MyProc->procLatch)
+  #endif
 #endif
 
 static ssize_t plcSocketRecv(plcConn *conn, void *ptr, size_t len);
 
 static ssize_t plcSocketSend(plcConn *conn, const void *ptr, size_t len);
 
+static ssize_t plcSocketSendv(plcConn *conn, struct iovec *iov, int iovcnt);
+
+static int plcSocketWait(plcConn *conn, int events, struct timeval *start);
+
 static int plcBufferMaybeFlush(plcConn *conn, bool isForse);
 
 static void plcBufferMaybeReset(plcConn *conn, int bufType);
 
 static int plcBufferMaybeResize(plcConn *conn, int bufType, size_t bufAppend);
 
+static int plcBlockSend(plcConn *conn, char *data, size_t len);
+
+static int plcBlockReceive(plcConn *conn, size_t nBytes);
+
+static int plcBufferSendDirect(plcConn *conn, char *srcBuffer, size_t nBytes);
+
+static int plcBufferReadDirect(plcConn *conn, char *resBuffer, size_t nBytes);
+
 static void
 plc_gettimeofday(struct timeval *tv)
 {
@@ -46,36 +85,177 @@ plc_gettimeofday(struct timeval *tv)
 		plc_elog(ERROR, "Failed to get time: %s", strerror(errno));
 }
 
+static int64 plc_elapsed_usec(struct timeval *start) {
+	struct timeval end;
+
+	plc_gettimeofday(&end);
+	return (int64) (end.tv_sec - start->tv_sec) * 1000000 + (end.tv_usec - start->tv_usec);
+}
+
 /*
- *  Read data from the socket
+ * Wait until the socket is readable, or writable for POLLOUT. A start time
+ * limits the wait to rx_timeout_sec from it. The peer going away makes the
+ * socket readable, and the backend wakes up at once to handle an interrupt.
+ *
+ * Returns 0 to try again, -1 on timeout
  */
-static ssize_t plcSocketRecv(plcConn *conn, void *ptr, size_t len) {
-	ssize_t sz = 0;
-	int time_count = 0;
-	int intr_count = 0;
-	struct timeval start_ts, end_ts;
+static int plcSocketWait(plcConn *conn, int events, struct timeval *start) {
+	long timeout = -1;
+
+	if (start != NULL && conn->rx_timeout_sec != PLC_RX_WAIT_FOREVER) {
+		int64 elapsed = plc_elapsed_usec(start);
+
+		if (elapsed >= (int64) conn->rx_timeout_sec * 1000000) {
+			plc_elog(ERROR, "rx timeout (%ds > %ds)",
+				(int) (elapsed / 1000000), conn->rx_timeout_sec);
+			return -1;
+		}
+		timeout = (long) (((int64) conn->rx_timeout_sec * 1000000 - elapsed + 999) / 1000);
+	}
+
+#ifdef PLC_WAIT_LATCH
+	{
+		int rc;
+
+		rc = WaitLatchOrSocket(PLC_WAIT_LATCH,
+		                       WL_LATCH_SET | WL_POSTMASTER_DEATH
+		                       | (events == POLLOUT ? WL_SOCKET_WRITEABLE : WL_SOCKET_READABLE)
+		                       | (timeout >= 0 ? WL_TIMEOUT : 0),
+		                       conn->sock, timeout
+#if PG_VERSION_NUM >= 100000
+		                       , PG_WAIT_EXTENSION
+#endif
+		                       );
+		if (rc & WL_POSTMASTER_DEATH)
+			proc_exit(1);
+		if (rc & WL_LATCH_SET)
+			ResetLatch(PLC_WAIT_LATCH);
+	}
+#else
+	{
+		struct pollfd pfd;
+		struct timespec ts;
+		int rc;
+
+		pfd.fd = conn->sock;
+		pfd.events = events;
+		pfd.revents = 0;
+		ts.tv_sec = timeout / 1000;
+		ts.tv_nsec = (timeout % 1000) * 1000000;
+#ifndef PLC_CLIENT
+		{
+			sigset_t blocked, unblocked;
+
+			/* A signal coming before ppoll() is handled when it unblocks them */
+			sigfillset(&blocked);
+			sigprocmask(SIG_BLOCK, &blocked, &unblocked);
+			rc = InterruptPending ? 0 : ppoll(&pfd, 1, timeout >= 0 ? &ts : NULL, &unblocked);
+			sigprocmask(SIG_SETMASK, &unblocked, NULL);
+		}
+#else
+		rc = ppoll(&pfd, 1, timeout >= 0 ? &ts : NULL, NULL);
+#endif
+		if (rc < 0 && errno != EINTR) {
+			plc_elog(ERROR, "Failed to wait for the socket: %s", strerror(errno));
+			return -1;
+		}
+	}
+#endif
 
-	while((sz=recv(conn->sock, ptr, len, 0))<0) {
 #ifndef PLC_CLIENT
-		CHECK_FOR_INTERRUPTS();
+	CHECK_FOR_INTERRUPTS();
 #endif
-		if (errno == EINTR && intr_count++ < 5)
+	return 0;
+}
+
+/*
+ * Keep the descriptors coming with the data until the values they stand for
+ * are read
+ */
+static int plcSocketKeepFds(plcConn *conn, struct msghdr *msg) {
+	struct cmsghdr *cmsg;
+
+	if (msg->msg_flags & MSG_CTRUNC) {
+		plc_elog(LOG, "Received too many file descriptors at once");
+		return -1;
+	}
+
+	for (cmsg = CMSG_FIRSTHDR(msg); cmsg != NULL; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+		int nfds, i;
+
+		if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
 			continue;
-		if (errno == EAGAIN || errno == EWOULDBLOCK) {
-			if (time_count==0) {
-				plc_gettimeofday(&start_ts);
-				time_count++;
-			} else {
-				plc_gettimeofday(&end_ts);
-				if ((end_ts.tv_sec - start_ts.tv_sec) > conn->rx_timeout_sec) {
-					plc_elog(ERROR, "rx timeout (%ds > %ds)",
-						(int) (end_ts.tv_sec - start_ts.tv_sec), conn->rx_timeout_sec);
-					return -1;
-				}
+		nfds = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+		for (i = 0; i < nfds; i++) {
+			if (conn->nRecvFds == conn->recvFdsSize) {
+				int *fds;
+
+				conn->recvFdsSize = conn->recvFdsSize > 0 ? conn->recvFdsSize * 2 : 8;
+				fds = (int *) PLy_malloc(conn->recvFdsSize * sizeof(int));
+				if (conn->nRecvFds > 0)
+					memcpy(fds, conn->recvFds, conn->nRecvFds * sizeof(int));
+				if (conn->recvFds != NULL)
+					pfree(conn->recvFds);
+				conn->recvFds = fds;
 			}
-		} else {
+			memcpy(&conn->recvFds[conn->nRecvFds++],
+			       CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+		}
+	}
+	return 0;
+}
+
+/*
+ * Receive from the socket along with the descriptors attached to the data
+ */
+static ssize_t plcSocketRecvFds(plcConn *conn, void *ptr, size_t len) {
+	union {
+		struct cmsghdr align;
+		char buf[CMSG_SPACE(PLC_MAX_SEND_FDS * sizeof(int))];
+	} control;
+	struct msghdr msg;
+	struct iovec iov;
+	ssize_t sz;
+
+	iov.iov_base = ptr;
+	iov.iov_len = len;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control.buf;
+	msg.msg_controllen = sizeof(control.buf);
+
+	sz = recvmsg(conn->sock, &msg, MSG_CMSG_CLOEXEC | MSG_DONTWAIT);
+	if (sz > 0 && plcSocketKeepFds(conn, &msg) < 0)
+		return -1;
+	return sz;
+}
+
+/*
+ *  Read data from the socket, waiting for it if there is none
+ */
+static ssize_t plcSocketRecv(plcConn *conn, void *ptr, size_t len) {
+	ssize_t sz = 0;
+	bool waited = false;
+	struct timeval start;
+
+	if (conn->shm != NULL)
+		return plcShmRecv(conn, ptr, len);
+
+	while((sz = conn->fdThreshold > 0 ? plcSocketRecvFds(conn, ptr, len)
+	                                  : recv(conn->sock, ptr, len, MSG_DONTWAIT)) < 0) {
+		if (errno == EINTR)
+			continue;
+		if (errno != EAGAIN && errno != EWOULDBLOCK) {
 			plc_elog(ERROR, "Failed to recv data: %s", strerror(errno));
+			return -1;
+		}
+		if (!waited) {
+			plc_gettimeofday(&start);
+			waited = true;
 		}
+		if (plcSocketWait(conn, POLLIN, &start) < 0)
+			return -1;
 	}
 
 	/* Log info if needed. */
@@ -91,19 +271,230 @@ static ssize_t plcSocketRecv(plcConn *conn, void *ptr, size_t len) {
  */
 static ssize_t plcSocketSend(plcConn *conn, const void *ptr, size_t len) {
 	ssize_t sz;
-	int n=0;
-	while((sz=send(conn->sock, ptr, len, 0))==-1) {
-#ifndef PLC_CLIENT
-		CHECK_FOR_INTERRUPTS();
-#endif
-		if (errno == EINTR && n++ < 5)
+
+	if (conn->shm != NULL)
+		return plcShmSend(conn, ptr, len);
+
+	if (conn->sendFd >= 0) {
+		struct iovec iov;
+
+		iov.iov_base = (void *) ptr;
+		iov.iov_len = len;
+		return plcSocketSendv(conn, &iov, 1);
+	}
+
+	while((sz=send(conn->sock, ptr, len, MSG_DONTWAIT))==-1) {
+		if (errno == EINTR)
+			continue;
+		if (errno == EAGAIN || errno == EWOULDBLOCK) {
+			if (plcSocketWait(conn, POLLOUT, NULL) < 0)
+				break;
+			continue;
+		}
+		plc_elog(ERROR, "Failed to send: %s", strerror(errno));
+		break;
+	}
+	return sz;
+}
+
+/*
+ *  Write data from several places to the socket at once
+ */
+static ssize_t plcSocketSendv(plcConn *conn, struct iovec *iov, int iovcnt) {
+	union {
+		struct cmsghdr align;
+		char buf[CMSG_SPACE(sizeof(int))];
+	} control;
+	struct msghdr msg;
+	ssize_t sz;
+
+	/* The rings take one piece at a time, a descriptor goes on the socket */
+	if (conn->shm != NULL && conn->sendFd < 0) {
+		while (iovcnt > 1 && iov->iov_len == 0) {
+			iov++;
+			iovcnt--;
+		}
+		return plcSocketSend(conn, iov->iov_base, iov->iov_len);
+	}
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = iovcnt;
+
+	/* A descriptor waiting to be sent goes with the first byte */
+	if (conn->sendFd >= 0) {
+		struct cmsghdr *cmsg;
+
+		memset(&control, 0, sizeof(control));
+		msg.msg_control = control.buf;
+		msg.msg_controllen = sizeof(control.buf);
+		cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+		memcpy(CMSG_DATA(cmsg), &conn->sendFd, sizeof(int));
+	}
+
+	while((sz=sendmsg(conn->sock, &msg, MSG_DONTWAIT))==-1) {
+		if (errno == EINTR)
 			continue;
+		if (errno == EAGAIN || errno == EWOULDBLOCK) {
+			if (plcSocketWait(conn, POLLOUT, NULL) < 0)
+				break;
+			continue;
+		}
 		plc_elog(ERROR, "Failed to send: %s", strerror(errno));
 		break;
 	}
+	if (sz > 0)
+		conn->sendFd = -1;
 	return sz;
 }
 
+/*
+ *  Write all the data to the socket
+ */
+static int plcSocketSendAll(plcConn *conn, const char *ptr, size_t len) {
+	while (len > 0) {
+		ssize_t sent = plcSocketSend(conn, ptr, len);
+
+		if (sent < 0) {
+			plc_elog(LOG, "plcSocketSendAll: Socket write failed, send "
+				"return code is %d, error message is '%s'",
+				(int) sent, strerror(errno));
+			return -1;
+		}
+		ptr += sent;
+		len -= sent;
+	}
+
+	return 0;
+}
+
+/*
+ *  Read exactly len bytes from the socket
+ */
+static int plcSocketRecvAll(plcConn *conn, char *ptr, size_t len) {
+	while (len > 0) {
+		ssize_t received = plcSocketRecv(conn, ptr, len);
+
+		if (received <= 0)
+			return -1;
+		ptr += received;
+		len -= received;
+	}
+
+	return 0;
+}
+
+/*
+ * Send the data as one block of a compressed connection, see
+ * comm_connectivity.h
+ *
+ * Returns 0 on success, -1 on failure
+ */
+static int plcBlockSend(plcConn *conn, char *data, size_t len) {
+	uint32 header[2];
+	char *payload = data;
+	plcCompressStats *stats = &conn->compressStats;
+
+	header[0] = (uint32) len;
+	header[1] = (uint32) len;
+
+	if (len >= (size_t) conn->compressThreshold) {
+		size_t bound = PLC_LZ_BOUND(len);
+		size_t compressed;
+		struct timeval start;
+
+		if (conn->compressBufSize < bound) {
+			if (conn->compressBuf != NULL)
+				pfree(conn->compressBuf);
+			conn->compressBuf = (char *) PLy_malloc(bound);
+			conn->compressBufSize = bound;
+		}
+
+		plc_gettimeofday(&start);
+		/* Keep the block raw unless it shrinks by at least 1/16 */
+		compressed = plc_lz_compress(data, len, conn->compressBuf, len - len / 16);
+		stats->compressUsec += plc_elapsed_usec(&start);
+
+		if (compressed > 0) {
+			header[1] = (uint32) compressed;
+			payload = conn->compressBuf;
+			stats->blocksCompressed++;
+		}
+	}
+
+	stats->rawSent += len;
+	stats->wireSent += sizeof(header) + header[1];
+
+	if (plcSocketSendAll(conn, (char *) header, sizeof(header)) < 0)
+		return -1;
+	return plcSocketSendAll(conn, payload, header[1]);
+}
+
+/*
+ * Receive blocks of a compressed connection until the input buffer holds
+ * nBytes bytes
+ *
+ * Returns 0 on success, -1 on failure
+ */
+static int plcBlockReceive(plcConn *conn, size_t nBytes) {
+	plcBuffer *buf = conn->buffer[PLC_INPUT_BUFFER];
+	plcCompressStats *stats = &conn->compressStats;
+
+	while (buf->pEnd - buf->pStart < (int) nBytes) {
+		uint32 header[2];
+		uint32 rawLen, wireLen;
+
+		if (plcSocketRecvAll(conn, (char *) header, sizeof(header)) < 0)
+			return -1;
+		rawLen = header[0];
+		wireLen = header[1];
+		if (rawLen > PLC_COMPRESS_MAX_BLOCK || wireLen > rawLen) {
+			plc_elog(LOG, "plcBlockReceive: Bad block of %u bytes (%u on the wire)",
+				rawLen, wireLen);
+			return -1;
+		}
+
+		plcBufferMaybeReset(conn, PLC_INPUT_BUFFER);
+		if (plcBufferMaybeResize(conn, PLC_INPUT_BUFFER, rawLen) < 0)
+			return -1;
+
+		if (wireLen == rawLen) {
+			if (plcSocketRecvAll(conn, buf->data + buf->pEnd, rawLen) < 0)
+				return -1;
+		} else {
+			struct timeval start;
+
+			if (conn->compressBufSize < wireLen) {
+				if (conn->compressBuf != NULL)
+					pfree(conn->compressBuf);
+				conn->compressBuf = (char *) PLy_malloc(wireLen);
+				conn->compressBufSize = wireLen;
+			}
+			if (plcSocketRecvAll(conn, conn->compressBuf, wireLen) < 0)
+				return -1;
+
+			plc_gettimeofday(&start);
+			if (plc_lz_decompress(conn->compressBuf, wireLen, buf->data + buf->pEnd, rawLen) < 0) {
+				plc_elog(LOG, "plcBlockReceive: Corrupted block of %u bytes (%u on the wire)",
+					rawLen, wireLen);
+				return -1;
+			}
+			stats->decompressUsec += plc_elapsed_usec(&start);
+			stats->blocksCompressed++;
+		}
+
+		buf->pEnd += rawLen;
+		stats->rawReceived += rawLen;
+		stats->wireReceived += sizeof(header) + wireLen;
+		assert(buf->pEnd <= buf->bufSize);
+	}
+
+	return 0;
+}
+
 /*
  * Function flushes the output buffer if it has reached a certain margin in
  * size or if the isForse parameter has passed to it
@@ -113,6 +504,33 @@ static ssize_t plcSocketSend(plcConn *conn, const void *ptr, size_t len) {
 static int plcBufferMaybeFlush(plcConn *conn, bool isForse) {
 	plcBuffer *buf = conn->buffer[PLC_OUTPUT_BUFFER];
 
+	/*
+	 * Keep the message being sent in the buffer so that its length can be
+	 * filled in, unless it gets too long. The length stays -1 otherwise.
+	 */
+	if (conn->frameOff >= 0) {
+		if (!isForse && buf->pEnd - buf->pStart <= PLC_FRAME_MAX_SIZE)
+			return 0;
+		conn->frameOff = -1;
+	}
+
+	/*
+	 * A compressed connection lets the buffer grow up to a whole block before
+	 * flushing it, the buffer is resized after this call if needed
+	 */
+	if (conn->compressThreshold > 0) {
+		if (buf->pEnd - buf->pStart > PLC_COMPRESS_BLOCK_SIZE
+		    || (isForse && buf->pEnd > buf->pStart)) {
+			int res = plcBlockSend(conn, buf->data + buf->pStart, buf->pEnd - buf->pStart);
+
+			if (res < 0)
+				return res;
+			buf->pStart = buf->pEnd;
+			plcBufferMaybeReset(conn, PLC_OUTPUT_BUFFER);
+		}
+		return 0;
+	}
+
 	/*
 	 * Flush the buffer if it has less than PLC_BUFFER_MIN_FREE of free space
 	 * available or data size in the buffer is greater than initial buffer size
@@ -235,6 +653,61 @@ static int plcBufferMaybeResize(plcConn *conn, int bufType, size_t bufAppend) {
 	return 0;
 }
 
+/*
+ * Send the buffered data followed by a large value without copying the value
+ * into the buffer. A compressed connection sends the value as blocks of its
+ * own.
+ *
+ * Returns 0 on success, -1 on failure
+ */
+static int plcBufferSendDirect(plcConn *conn, char *srcBuffer, size_t nBytes) {
+	plcBuffer *buf = conn->buffer[PLC_OUTPUT_BUFFER];
+	struct iovec iov[2];
+	int i = 0;
+
+	/* The message goes out before it is complete */
+	conn->frameOff = -1;
+
+	if (conn->compressThreshold > 0) {
+		if (plcBufferMaybeFlush(conn, true) < 0)
+			return -1;
+		while (nBytes > 0) {
+			size_t len = nBytes < PLC_COMPRESS_BLOCK_SIZE ? nBytes : PLC_COMPRESS_BLOCK_SIZE;
+
+			if (plcBlockSend(conn, srcBuffer, len) < 0)
+				return -1;
+			srcBuffer += len;
+			nBytes -= len;
+		}
+		return 0;
+	}
+
+	iov[0].iov_base = buf->data + buf->pStart;
+	iov[0].iov_len = buf->pEnd - buf->pStart;
+	iov[1].iov_base = srcBuffer;
+	iov[1].iov_len = nBytes;
+	while (i < 2) {
+		ssize_t sent = plcSocketSendv(conn, iov + i, 2 - i);
+
+		if (sent < 0) {
+			plc_elog(LOG, "plcBufferSendDirect: Socket write failed, send "
+				"return code is %d, error message is '%s'",
+				(int) sent, strerror(errno));
+			return -1;
+		}
+		for (; i < 2 && (size_t) sent >= iov[i].iov_len; i++)
+			sent -= iov[i].iov_len;
+		if (i < 2) {
+			iov[i].iov_base = (char *) iov[i].iov_base + sent;
+			iov[i].iov_len -= sent;
+		}
+	}
+
+	buf->pStart = buf->pEnd;
+	plcBufferMaybeReset(conn, PLC_OUTPUT_BUFFER);
+	return 0;
+}
+
 /*
  * Append some data to the buffer. This function does not guarantee that the
  * data would be immediately sent, you have to forcefully flush buffer to
@@ -246,6 +719,9 @@ int plcBufferAppend(plcConn *conn, char *srcBuffer, size_t nBytes) {
 	int res = 0;
 	plcBuffer *buf = conn->buffer[PLC_OUTPUT_BUFFER];
 
+	if (nBytes >= PLC_BUFFER_DIRECT_SIZE)
+		return plcBufferSendDirect(conn, srcBuffer, nBytes);
+
 	// If we don't have enough space in the buffer to hold the data
 	if (buf->bufSize - buf->pEnd < (int) nBytes) {
 
@@ -273,6 +749,25 @@ int plcBufferAppend(plcConn *conn, char *srcBuffer, size_t nBytes) {
 	return 0;
 }
 
+/*
+ * Read a large value: take what the buffer already holds and receive the
+ * rest straight into resBuffer
+ *
+ * Returns 0 on success, -1 if failed
+ */
+static int plcBufferReadDirect(plcConn *conn, char *resBuffer, size_t nBytes) {
+	plcBuffer *buf = conn->buffer[PLC_INPUT_BUFFER];
+	size_t buffered = buf->pEnd - buf->pStart;
+
+	if (buffered > nBytes)
+		buffered = nBytes;
+	memcpy(resBuffer, buf->data + buf->pStart, buffered);
+	buf->pStart += buffered;
+	plcBufferMaybeReset(conn, PLC_INPUT_BUFFER);
+
+	return plcSocketRecvAll(conn, resBuffer + buffered, nBytes - buffered);
+}
+
 /*
  * Read some data from the buffer. If buffer does not have enough data in it,
  * it will ask the socket to receive more data and put it into the buffer
@@ -283,6 +778,14 @@ int plcBufferRead(plcConn *conn, char *resBuffer, size_t nBytes) {
 	plcBuffer *buf = conn->buffer[PLC_INPUT_BUFFER];
 	int res = 0;
 
+	/*
+	 * Blocks of a compressed connection have to go through the buffer, and a
+	 * frame is already in memory
+	 */
+	if (nBytes >= PLC_BUFFER_DIRECT_SIZE && conn->compressThreshold == 0
+	    && conn->frame == NULL)
+		return plcBufferReadDirect(conn, resBuffer, nBytes);
+
 	res = plcBufferReceive(conn, nBytes);
 	if (res == 0) {
 		memcpy(resBuffer, buf->data + buf->pStart, nBytes);
@@ -307,10 +810,21 @@ int plcBufferReceive(plcConn *conn, size_t nBytes) {
 		int nBytesToReceive;
 		int recBytes;
 
+		// A frame holds the whole message, nothing more is coming for it
+		if (conn->frame != NULL) {
+			plc_elog(LOG, "plcBufferReceive: The message is longer than its "
+				"length of %d bytes", (int) conn->frameLen);
+			return -1;
+		}
+
 		// First thing to consider - resetting the data in buffer to the beginning
 		// freeing up the space in the end to receive the data
 		plcBufferMaybeReset(conn, PLC_INPUT_BUFFER);
 
+		// A compressed connection is read block by block
+		if (conn->compressThreshold > 0)
+			return plcBlockReceive(conn, nBytes);
+
 		// Second step - check whether we really need to resize the buffer after this
 		res = plcBufferMaybeResize(conn, PLC_INPUT_BUFFER, nBytes);
 		if (res < 0)
@@ -343,6 +857,215 @@ int plcBufferFlush(plcConn *conn) {
 	return plcBufferMaybeFlush(conn, true);
 }
 
+/*
+ * Switch the connection to blocks, compressing the ones of at least
+ * threshold bytes. Both sides switch right after the ping exchange, when
+ * no data is in flight.
+ */
+void plcConnSetCompression(plcConn *conn, int threshold) {
+	conn->compressThreshold = threshold > 0 ? threshold : 0;
+}
+
+void plcConnSetFdPassing(plcConn *conn, int threshold) {
+	conn->fdThreshold = threshold > 0 ? threshold : 0;
+}
+
+/* Versions the other side does not know fall back to the first one */
+void plcConnSetWireVersion(plcConn *conn, int version) {
+	if (version < PLC_WIRE_TAGGED || version > PLC_WIRE_VERSION)
+		version = PLC_WIRE_TAGGED;
+	conn->wireVersion = version;
+}
+
+/* Messages carry their length from now on if both sides asked for it */
+void plcConnSetFraming(plcConn *conn, int framing) {
+	conn->framing = framing != 0;
+}
+
+/*
+ * Send the data of a value passed as a file together with its descriptor.
+ * The descriptor rides on the socket with the data, or alone with a single
+ * byte of its own when the data goes through the rings. Either way it gets
+ * there before the data telling the peer to take it.
+ *
+ * Returns 0 on success, -1 if failed
+ */
+int plcBufferAppendFd(plcConn *conn, int fd, char *srcBuffer, size_t nBytes) {
+	/* The message goes out before it is complete */
+	conn->frameOff = -1;
+
+	conn->sendFd = fd;
+	if (conn->shm != NULL) {
+		struct iovec iov;
+		char c = 0;
+
+		iov.iov_base = &c;
+		iov.iov_len = 1;
+		if (plcSocketSendv(conn, &iov, 1) < 0 || conn->sendFd >= 0) {
+			conn->sendFd = -1;
+			return -1;
+		}
+		return plcBufferAppend(conn, srcBuffer, nBytes);
+	}
+
+	if (plcBufferAppend(conn, srcBuffer, nBytes) < 0 ||
+	    plcBufferMaybeFlush(conn, true) < 0) {
+		conn->sendFd = -1;
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Take the descriptor of the next value passed as a file, in the order they
+ * were sent. The caller closes it.
+ *
+ * Returns the descriptor, -1 if failed
+ */
+int plcBufferTakeFd(plcConn *conn) {
+	int fd;
+
+	/* With the rings, the descriptors come alone on the socket */
+	if (conn->nRecvFds == conn->recvFdsHead && conn->shm != NULL) {
+		ssize_t sz;
+		char c;
+		struct timeval start;
+
+		plc_gettimeofday(&start);
+		while ((sz = plcSocketRecvFds(conn, &c, 1)) < 0) {
+			if (errno == EINTR)
+				continue;
+			if ((errno != EAGAIN && errno != EWOULDBLOCK)
+			    || plcSocketWait(conn, POLLIN, &start) < 0)
+				return -1;
+		}
+		if (sz <= 0)
+			return -1;
+	}
+
+	if (conn->nRecvFds == conn->recvFdsHead) {
+		plc_elog(LOG, "No file descriptor came with a value passed as a file");
+		return -1;
+	}
+
+	fd = conn->recvFds[conn->recvFdsHead++];
+	if (conn->recvFdsHead == conn->nRecvFds) {
+		conn->recvFdsHead = 0;
+		conn->nRecvFds = 0;
+	}
+	return fd;
+}
+
+/*
+ * Start framing the message being sent, right after its type: leave room for
+ * its length if the messages carry one
+ *
+ * Returns 0 on success, -1 if failed
+ */
+int plcBufferFrameStart(plcConn *conn) {
+	plcBuffer *buf = conn->buffer[PLC_OUTPUT_BUFFER];
+	int32 len = PLC_FRAME_STREAMED;
+	int off;
+
+	conn->frameOff = -1;
+	if (conn->framing && plcBufferAppend(conn, (char *) &len, sizeof(len)) < 0)
+		return -1;
+	/* The type is right before, unless the room for the length flushed it */
+	off = buf->pEnd - buf->pStart - 1 - (conn->framing ? (int) sizeof(len) : 0);
+	if (off >= 0)
+		conn->frameOff = off;
+	return 0;
+}
+
+/*
+ * Drop a message that an error left unfinished, if it is still all in the
+ * buffer. Whatever was sent of it already cannot be taken back.
+ */
+void plcBufferFrameAbort(plcConn *conn) {
+	plcBuffer *buf = conn->buffer[PLC_OUTPUT_BUFFER];
+
+	if (conn->frameOff >= 0) {
+		buf->pEnd = buf->pStart + conn->frameOff;
+		conn->frameOff = -1;
+	}
+}
+
+/*
+ * Fill in the length of the message if it is still in the buffer, and send it.
+ * A held message stays in the buffer, unless the buffer is full, and goes out
+ * in the same write as the next message.
+ *
+ * Returns 0 on success, -1 if failed
+ */
+int plcBufferFrameEnd(plcConn *conn) {
+	plcBuffer *buf = conn->buffer[PLC_OUTPUT_BUFFER];
+
+	if (conn->frameOff >= 0 && conn->framing) {
+		int off = conn->frameOff + 1;
+		int32 len = buf->pEnd - buf->pStart - off - (int) sizeof(len);
+
+		memcpy(buf->data + buf->pStart + off, &len, sizeof(len));
+	}
+	conn->frameOff = -1;
+	if (conn->holdOutput)
+		return plcBufferMaybeFlush(conn, false);
+	return plcBufferFlush(conn);
+}
+
+/*
+ * Read the body of a message of a known length into a frame of its own and
+ * decode the message from it. Its values may point into the frame if the
+ * message takes it, see plcBufferFrameTake().
+ *
+ * Returns 0 on success, -1 if failed
+ */
+int plcBufferFrameReceive(plcConn *conn, size_t len) {
+	char *frame = pmalloc(len > 0 ? len : 1);
+
+	if (plcBufferRead(conn, frame, len) < 0) {
+		pfree(frame);
+		return -1;
+	}
+
+	conn->frame = frame;
+	conn->frameLen = len;
+	conn->frameTaken = false;
+	conn->frameBuffer.data = frame;
+	conn->frameBuffer.pStart = 0;
+	conn->frameBuffer.pEnd = (int) len;
+	conn->frameBuffer.bufSize = (int) len;
+	conn->savedInput = conn->buffer[PLC_INPUT_BUFFER];
+	conn->buffer[PLC_INPUT_BUFFER] = &conn->frameBuffer;
+	return 0;
+}
+
+/*
+ * The message being received keeps the frame and frees it with itself
+ */
+char *plcBufferFrameTake(plcConn *conn, size_t *len) {
+	*len = conn->frameLen;
+	if (conn->frame != NULL)
+		conn->frameTaken = true;
+	return conn->frame;
+}
+
+/*
+ * Go back to the input buffer after a message was read from a frame. The frame
+ * is freed unless a message took it, or unless the receiving was interrupted
+ * by an error, which has freed the memory of the message already.
+ */
+void plcBufferFrameDone(plcConn *conn, bool freeFrame) {
+	if (conn->frame == NULL)
+		return;
+
+	conn->buffer[PLC_INPUT_BUFFER] = conn->savedInput;
+	if (freeFrame && !conn->frameTaken)
+		pfree(conn->frame);
+	conn->frame = NULL;
+	conn->frameLen = 0;
+	conn->frameTaken = false;
+}
+
 /*
  *  Initialize plcConn data structure and input/output buffers.
  *  For network connection, uds_fn means nothing.
@@ -367,6 +1090,27 @@ plcConn *plcConnInit(int sock) {
 
 	// Initializing control parameters
 	conn->sock = sock;
+	conn->sent_descs = NULL;
+	conn->received_descs = NULL;
+	conn->compressThreshold = 0;
+	conn->compressBuf = NULL;
+	conn->compressBufSize = 0;
+	memset(&conn->compressStats, 0, sizeof(conn->compressStats));
+	conn->shm = NULL;
+	conn->framing = false;
+	conn->frameOff = -1;
+	conn->frame = NULL;
+	conn->frameLen = 0;
+	conn->frameTaken = false;
+	conn->savedInput = NULL;
+	conn->fdThreshold = 0;
+	conn->sendFd = -1;
+	conn->recvFds = NULL;
+	conn->nRecvFds = 0;
+	conn->recvFdsHead = 0;
+	conn->recvFdsSize = 0;
+	conn->wireVersion = PLC_WIRE_TAGGED;
+	conn->holdOutput = false;
 
 	return conn;
 }
@@ -378,6 +1122,8 @@ extern void init_pplan_slots(plcConn *conn);
 
 extern void deinit_pplan_slots(plcConn *conn);
 
+extern void plcFreeDescriptors(plcConn *conn);
+
 /*
  *  Connect to the specified host of the localhost and initialize the plcConn
  *  data structure
@@ -386,7 +1132,6 @@ plcConn *plcConnect_inet(int port) {
 	struct hostent *server;
 	struct sockaddr_in raddr; /** Remote address */
 	plcConn *result = NULL;
-	struct timeval tv;
 
 	int sock = socket(AF_INET, SOCK_STREAM, 0);
 	if (sock < 0) {
@@ -416,14 +1161,11 @@ plcConn *plcConnect_inet(int port) {
 		goto err_out2;
 	}
 
-	/* FIXME: Do we need them? */
-	/* Set socket receive timeout to 500ms */
-	tv.tv_sec = 0;
-	tv.tv_usec = 500000;
-	setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, (char *) &tv, sizeof(struct timeval));
-
 	result = plcConnInit(sock);
 	init_pplan_slots(result);
+	result->nstreams = 0;
+	memset(result->known_funcs, 0, sizeof(result->known_funcs));
+	result->next_known_func = 0;
 	result->uds_fn = NULL;
 
 	return result;
@@ -440,7 +1182,6 @@ err_out1:
  */
 plcConn *plcConnect_ipc(char *uds_fn) {
 	plcConn *result = NULL;
-	struct timeval tv;
 	int sock;
 	struct sockaddr_un raddr;
 
@@ -469,13 +1210,11 @@ plcConn *plcConnect_ipc(char *uds_fn) {
 		goto err_out;
 	}
 
-	/* Set socket receive timeout to 500ms */
-	tv.tv_sec = 0;
-	tv.tv_usec = 500000;
-	setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, (char *) &tv, sizeof(struct timeval));
-
 	result = plcConnInit(sock);
 	init_pplan_slots(result);
+	result->nstreams = 0;
+	memset(result->known_funcs, 0, sizeof(result->known_funcs));
+	result->next_known_func = 0;
 	result->uds_fn = plc_top_strdup(uds_fn);
 
 	return result;
@@ -490,24 +1229,43 @@ err_out:
  */
 void plcDisconnect(plcConn *conn) {
 	char *uds_fn;
+	char *uds_dir;
 
 	if (conn != NULL) {
 		close(conn->sock);
 
+		if (conn->shm != NULL) {
+			plcShmDetach(conn->shm);
+			conn->shm = NULL;
+		}
+
 		uds_fn = conn->uds_fn;
 		if (uds_fn != NULL) {
 			unlink(uds_fn);
-			rmdir(dirname(uds_fn));
+			uds_dir = dirname(uds_fn);
+			plcShmUnlink(uds_dir);
+			rmdir(uds_dir);
 			pfree(uds_fn);
 			conn->uds_fn = NULL;
 		}
 
+		plcBufferFrameDone(conn, false);
+		if (conn->recvFds != NULL) {
+			int i;
+
+			for (i = conn->recvFdsHead; i < conn->nRecvFds; i++)
+				close(conn->recvFds[i]);
+			pfree(conn->recvFds);
+		}
 		pfree(conn->buffer[PLC_INPUT_BUFFER]->data);
 		pfree(conn->buffer[PLC_OUTPUT_BUFFER]->data);
 		pfree(conn->buffer[PLC_INPUT_BUFFER]);
 		pfree(conn->buffer[PLC_OUTPUT_BUFFER]);
 		conn->buffer[PLC_INPUT_BUFFER] = NULL;
 		conn->buffer[PLC_OUTPUT_BUFFER] = NULL;
+		if (conn->compressBuf != NULL)
+			pfree(conn->compressBuf);
+		plcFreeDescriptors(conn);
 		deinit_pplan_slots(conn);
 		pfree(conn);
 	}
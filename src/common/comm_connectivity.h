@@ -24,27 +24,132 @@ typedef struct plcBuffer {
 	int bufSize;
 } plcBuffer;
 
+/*
+ * Values of at least PLC_BUFFER_DIRECT_SIZE bytes bypass the buffers: they
+ * are sent together with the buffered data in one sendmsg() and received
+ * straight into their destination, instead of being copied through a buffer
+ * grown to hold them.
+ */
+#define PLC_BUFFER_DIRECT_SIZE (64 * 1024)
+
+/*
+ * Messages are framed once the ping exchange has found both sides asking for
+ * it: their type, their length and their body. The ping itself, and every
+ * message of a peer that does not ask for it, goes without the length. The
+ * sender keeps the message in the output buffer until it is complete, up to
+ * PLC_FRAME_MAX_SIZE, so that the length can be filled in when the message
+ * ends. A message that has to be sent before it is complete, being longer or
+ * holding a value sent directly, goes with the length -1 and is read piece
+ * by piece as it arrives. The receiver reads a message with a known length
+ * at once, and may keep it as the frame the values of the message point to.
+ */
+#define PLC_FRAME_MAX_SIZE (8 * 1024 * 1024)
+#define PLC_FRAME_STREAMED (-1)
+
+/*
+ * A value passed as a file is sent as its length PLC_VALUE_FD and the int64
+ * size of the file, the descriptor comes with the data on the socket
+ */
+#define PLC_VALUE_FD (-2)
+#define PLC_MAX_SEND_FDS 8
+
+/*
+ * Once compression is negotiated, every flush of the output buffer travels as
+ * a block: uint32 raw length, uint32 wire length and the payload, which is
+ * compressed when the wire length is less than the raw length. Blocks of at
+ * least compressThreshold bytes are compressed, and the output buffer is
+ * flushed in blocks of up to PLC_COMPRESS_BLOCK_SIZE to give the compressor
+ * more to work with.
+ */
+#define PLC_COMPRESS_BLOCK_SIZE (64 * 1024)
+#define PLC_COMPRESS_MAX_BLOCK (1024 * 1024 * 1024)
+
+typedef struct plcCompressStats {
+	int64 rawSent;       /* bytes of the protocol sent */
+	int64 wireSent;      /* bytes written to the socket for them */
+	int64 rawReceived;
+	int64 wireReceived;
+	int64 blocksCompressed;
+	int64 compressUsec;  /* time spent compressing */
+	int64 decompressUsec;
+} plcCompressStats;
+
+/* Type descriptors interned on the connection, see comm_channel.c */
+typedef struct plcDescriptorTable plcDescriptorTable;
+
+/* Shared memory rings replacing the socket, see comm_shm.c */
+typedef struct plcShm plcShm;
+
 #ifndef PLC_CLIENT
 #define MAX_PPLAN 32 /* Max number of pplan saved in one connection. */
 struct pplan_slots {
 	int64 pplan;
 	int next;
 };
+
+#define MAX_KNOWN_FUNCS 64 /* Max number of function versions remembered per connection. */
+struct known_func {
+	uint32 funcOid;
+	uint32 version;
+};
 #endif
 
+/* rx_timeout_sec of a wait without a timeout */
+#define PLC_RX_WAIT_FOREVER 0x7fffFFFF
+
 typedef struct plcConn {
 	int sock;
 	int rx_timeout_sec;
 	plcBuffer *buffer[2];
+	plcDescriptorTable *sent_descs;     /* descriptors the peer knows by id */
+	plcDescriptorTable *received_descs; /* descriptors the peer defined */
+	int compressThreshold; /* 0 if the stream is not made of blocks */
+	char *compressBuf;     /* compressed form of a block */
+	size_t compressBufSize;
+	plcCompressStats compressStats;
+	plcShm *shm;           /* NULL if the data goes through the socket */
+	bool framing;          /* messages carry their length */
+	int frameOff;          /* start of the message being sent, relative to
+	                        * the output buffer start, -1 if partly sent */
+	char *frame;           /* body of the message being received, if it is
+	                        * read whole */
+	size_t frameLen;
+	bool frameTaken;       /* the received message keeps the frame */
+	plcBuffer frameBuffer; /* input buffer reading from the frame */
+	plcBuffer *savedInput; /* the input buffer meanwhile */
+	int fdThreshold;       /* pass values of at least this size as files, 0 - off */
+	int sendFd;            /* descriptor to attach to the next write, -1 if none */
+	int *recvFds;          /* descriptors received and not taken yet */
+	int nRecvFds;
+	int recvFdsHead;       /* the next one to take */
+	int recvFdsSize;
+	int wireVersion;       /* encoding of rows, PLC_WIRE_* */
+	bool holdOutput;       /* leave the messages sent in the output buffer
+	                        * until a message that is not held is sent */
 #ifndef PLC_CLIENT
 	char *uds_fn; /* File for unix domain socket connection only. */
 	int container_slot;
 	int head_free_pplan_slot;  /* free list of spi pplan slot */
 	struct pplan_slots pplans[MAX_PPLAN]; /* for spi plannning */
+	int nstreams; /* result sets the client is still streaming to us */
+	struct known_func known_funcs[MAX_KNOWN_FUNCS]; /* sent with their source */
+	int next_known_func; /* slot to overwrite when remembering the next one */
 #endif
 } plcConn;
 
+/*
+ * Encodings of the rows of results, calls and composite values, agreed on in
+ * the ping exchange. Version 1 tags every value with 'N' or 'D' and sends
+ * integers and lengths with a fixed size. Version 2 starts every row with a
+ * bitmap of its NULL values and one of its booleans, and sends integers and
+ * lengths as varints.
+ */
+#define PLC_WIRE_TAGGED  1
+#define PLC_WIRE_COMPACT 2
+#define PLC_WIRE_VERSION PLC_WIRE_COMPACT
+
 #define UDS_SHARED_FILE "unix.domain.socket.shared.file"
+#define SHM_SHARED_FILE "ring.shared.file"
 #define IPC_CLIENT_DIR "/tmp/plcontainer"
 #define IPC_GPDB_BASE_DIR "/tmp/plcontainer"
 #define MAX_SHARED_FILE_SZ strlen(UDS_SHARED_FILE)
@@ -69,4 +174,28 @@ int plcBufferReceive(plcConn *conn, size_t nBytes);
 
 int plcBufferFlush(plcConn *conn);
 
+void plcConnSetCompression(plcConn *conn, int threshold);
+
+void plcConnSetFdPassing(plcConn *conn, int threshold);
+
+void plcConnSetWireVersion(plcConn *conn, int version);
+
+void plcConnSetFraming(plcConn *conn, int framing);
+
+int plcBufferAppendFd(plcConn *conn, int fd, char *srcBuffer, size_t nBytes);
+
+int plcBufferTakeFd(plcConn *conn);
+
+int plcBufferFrameStart(plcConn *conn);
+
+int plcBufferFrameEnd(plcConn *conn);
+
+void plcBufferFrameAbort(plcConn *conn);
+
+int plcBufferFrameReceive(plcConn *conn, size_t len);
+
+char *plcBufferFrameTake(plcConn *conn, size_t *len);
+
+void plcBufferFrameDone(plcConn *conn, bool freeFrame);
+
 #endif /* PLC_COMM_CONNECTIVITY_H */
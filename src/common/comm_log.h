@@ -13,6 +13,7 @@ char *dbName;
 int dbQePid;
 char *clientLanguage;
 
-int client_log_level;
+int client_log_level;     /* log_min_messages of the backend */
+int client_message_level; /* client_min_messages of the backend */
 
 #endif /* PLC_COMM_LOG_H */
@@ -0,0 +1,162 @@
+/*------------------------------------------------------------------------------
+ *
+ *
+ * Copyright (c) 2016-Present Pivotal Software, Inc
+ *
+ *------------------------------------------------------------------------------
+ */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#include "comm_utils.h"
+#include "comm_memfd.h"
+
+/* Not known to older C libraries, the kernel tells if it supports them */
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
+#ifndef MFD_ALLOW_SEALING
+#define MFD_ALLOW_SEALING 0x0002U
+#endif
+#ifndef F_ADD_SEALS
+#define F_ADD_SEALS (1024 + 9)
+#define F_GET_SEALS (1024 + 10)
+#define F_SEAL_SEAL 0x0001
+#define F_SEAL_SHRINK 0x0002
+#define F_SEAL_GROW 0x0004
+#define F_SEAL_WRITE 0x0008
+#endif
+
+#define PLC_MEMFD_SEALS (F_SEAL_SEAL | F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE)
+
+static int memfd_new(void) {
+#ifdef SYS_memfd_create
+	return (int) syscall(SYS_memfd_create, "plcontainer", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+#else
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
+bool plcMemfdSupported(void) {
+	static int supported = -1;
+
+	if (supported < 0) {
+		int fd = memfd_new();
+
+		supported = fd >= 0;
+		if (fd >= 0)
+			close(fd);
+	}
+	return supported == 1;
+}
+
+/*
+ * Returns the descriptor of a sealed file holding the data, -1 if failed
+ */
+int plcMemfdCreate(const char *data, size_t len) {
+	size_t done = 0;
+	int fd;
+
+	fd = memfd_new();
+	if (fd < 0) {
+		plc_elog(LOG, "Cannot create a memory file: %s", strerror(errno));
+		return -1;
+	}
+
+	while (done < len) {
+		ssize_t sz = write(fd, data + done, len - done);
+
+		if (sz < 0 && errno == EINTR)
+			continue;
+		if (sz <= 0) {
+			plc_elog(LOG, "Cannot write a memory file: %s", strerror(errno));
+			close(fd);
+			return -1;
+		}
+		done += sz;
+	}
+
+	if (fcntl(fd, F_ADD_SEALS, PLC_MEMFD_SEALS) < 0) {
+		plc_elog(LOG, "Cannot seal a memory file: %s", strerror(errno));
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+/*
+ * The sender cannot change a sealed file under our feet, so the data can be
+ * used without copying it first
+ */
+static int memfd_check(int fd, size_t len) {
+	struct stat st;
+	int seals;
+
+	seals = fcntl(fd, F_GET_SEALS);
+	if (seals < 0 || (seals & PLC_MEMFD_SEALS) != PLC_MEMFD_SEALS) {
+		plc_elog(LOG, "The memory file of a value is not sealed");
+		return -1;
+	}
+	if (fstat(fd, &st) < 0 || (size_t) st.st_size != len) {
+		plc_elog(LOG, "The memory file of a value has a wrong size");
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Map the file privately: the value is read in place, and the rare writes to
+ * it stay with us
+ */
+char *plcMemfdMap(int fd, size_t len) {
+	void *addr;
+
+	if (memfd_check(fd, len) < 0)
+		return NULL;
+
+	addr = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	if (addr == MAP_FAILED) {
+		plc_elog(LOG, "Cannot map the memory file of a value: %s", strerror(errno));
+		return NULL;
+	}
+	return addr;
+}
+
+int plcMemfdRead(int fd, char *data, size_t len) {
+	size_t done = 0;
+
+	if (memfd_check(fd, len) < 0)
+		return -1;
+
+	while (done < len) {
+		ssize_t sz = pread(fd, data + done, len - done, done);
+
+		if (sz < 0 && errno == EINTR)
+			continue;
+		if (sz <= 0) {
+			plc_elog(LOG, "Cannot read the memory file of a value: %s", strerror(errno));
+			return -1;
+		}
+		done += sz;
+	}
+	return 0;
+}
+
+void plcMemfdUnmap(plcMapping *mappings) {
+	while (mappings != NULL) {
+		plcMapping *next = mappings->next;
+
+		munmap(mappings->addr, mappings->len);
+		pfree(mappings);
+		mappings = next;
+	}
+}
@@ -0,0 +1,33 @@
+/*------------------------------------------------------------------------------
+ *
+ *
+ * Copyright (c) 2016-Present Pivotal Software, Inc
+ *
+ *------------------------------------------------------------------------------
+ */
+#ifndef PLC_COMM_MEMFD_H
+#define PLC_COMM_MEMFD_H
+
+#include <sys/types.h>
+
+#include "messages/message_base.h"
+
+/*
+ * Large values passed as files: the sender writes the value, laid out as it
+ * is kept in memory (a cstring with its zero for text, the length and the
+ * bytes for bytea), into an anonymous memory file, seals it against any
+ * change and attaches the file descriptor to the unix domain socket. The
+ * receiver maps the file or reads it at once, the data never goes through
+ * the socket.
+ */
+bool plcMemfdSupported(void);
+
+int plcMemfdCreate(const char *data, size_t len);
+
+char *plcMemfdMap(int fd, size_t len);
+
+int plcMemfdRead(int fd, char *data, size_t len);
+
+void plcMemfdUnmap(plcMapping *mappings);
+
+#endif /* PLC_COMM_MEMFD_H */
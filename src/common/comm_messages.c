@@ -33,10 +33,11 @@ interpreted as representing official policies, either expressed or implied, of t
 #include <stdlib.h>
 
 #include "comm_utils.h"
+#include "comm_memfd.h"
 #include "messages/messages.h"
 
 /* Recursive function to free up the type structure */
-static void free_type(plcType *typArr) {
+void free_type(plcType *typArr) {
 	if (typArr->typeName != NULL) {
 		pfree(typArr->typeName);
 	}
@@ -49,6 +50,20 @@ static void free_type(plcType *typArr) {
 	}
 }
 
+/*
+ * Values received into a frame point into it, and values passed as files are
+ * mapped, both go away with the message
+ */
+static bool is_borrowed(char *frame, size_t frameLen, plcMapping *mappings, char *value) {
+	if (frame != NULL && value >= frame && value < frame + frameLen)
+		return true;
+	for (; mappings != NULL; mappings = mappings->next) {
+		if (value == mappings->addr)
+			return true;
+	}
+	return false;
+}
+
 void free_arguments(plcArgument *args, int nargs, bool isShared, bool isSender) {
 	int i;
 
@@ -84,10 +99,59 @@ void free_callreq(plcMsgCallreq *req, bool isShared, bool isSender) {
 		pfree(req->proc.src);
 	}
 
+	/* free the argument rows of a batched call */
+	if (req->rows != NULL) {
+		uint32 i;
+		int j;
+
+		for (i = 0; i < req->nrows; i++) {
+			if (req->rows[i] == NULL)
+				continue;
+			for (j = 0; j < req->nargs; j++) {
+				if (req->rows[i][j].value == NULL
+				    || is_borrowed(req->frame, req->frameLen, req->mappings, req->rows[i][j].value))
+					continue;
+				if (req->args[j].type.type == PLC_DATA_UDT) {
+					plc_free_udt((plcUDT *) req->rows[i][j].value, &req->args[j].type, isSender);
+				}
+				if (!isSender && req->args[j].type.type == PLC_DATA_ARRAY) {
+					plc_free_array((plcArray *) req->rows[i][j].value, &req->args[j].type, isSender);
+				} else {
+					pfree(req->rows[i][j].value);
+				}
+			}
+			pfree(req->rows[i]);
+		}
+		pfree(req->rows);
+	}
+
+	if (req->frame != NULL || req->mappings != NULL) {
+		int j;
+
+		for (j = 0; j < req->nargs; j++) {
+			if (is_borrowed(req->frame, req->frameLen, req->mappings, req->args[j].data.value))
+				req->args[j].data.value = NULL;
+		}
+	}
+
 	free_arguments(req->args, req->nargs, isShared, isSender);
 
 	free_type(&req->retType);
 
+	if (req->sliced != NULL) {
+		int j;
+
+		for (j = 0; j < req->nsliced; j++) {
+			if (req->sliced[j].detoasted)
+				pfree(req->sliced[j].source);
+		}
+		pfree(req->sliced);
+	}
+
+	if (req->frame != NULL)
+		pfree(req->frame);
+	plcMemfdUnmap(req->mappings);
+
 	/* free the top-level request */
 	pfree(req);
 }
@@ -102,7 +166,8 @@ void free_result(plcMsgResult *res, bool isSender) {
 			if (res->data[i] != NULL) {
 				for (j = 0; j < res->cols; j++) {
 					/* free the data if it is not null */
-					if (res->data[i][j].value != NULL) {
+					if (res->data[i][j].value != NULL
+					    && !is_borrowed(res->frame, res->frameLen, res->mappings, res->data[i][j].value)) {
 						// For UDT we need to free up internal structures
 						if (res->types[j].type == PLC_DATA_UDT) {
 							plc_free_udt((plcUDT *) res->data[i][j].value, &res->types[j], isSender);
@@ -140,6 +205,57 @@ void free_result(plcMsgResult *res, bool isSender) {
 		pfree(res->names);
 		res->names = NULL;
 	}
+
+	if (res->frame != NULL)
+		pfree(res->frame);
+	plcMemfdUnmap(res->mappings);
+	pfree(res);
+}
+
+void free_columns(plcMsgColumns *res, bool isSender) {
+	uint32 i, j;
+
+	if (res->columns != NULL) {
+		for (j = 0; j < res->cols; j++) {
+			plcColumn *col = &res->columns[j];
+
+			if (col->objects != NULL) {
+				for (i = 0; i < res->rows; i++) {
+					if (col->objects[i].value == NULL)
+						continue;
+					if (res->types[j].type == PLC_DATA_UDT) {
+						plc_free_udt((plcUDT *) col->objects[i].value, &res->types[j], isSender);
+					}
+					if (!isSender && res->types[j].type == PLC_DATA_ARRAY) {
+						plc_free_array((plcArray *) col->objects[i].value, &res->types[j], isSender);
+					} else {
+						pfree(col->objects[i].value);
+					}
+				}
+				pfree(col->objects);
+			}
+			if (col->nulls != NULL)
+				pfree(col->nulls);
+			if (col->offsets != NULL)
+				pfree(col->offsets);
+			if (col->values != NULL)
+				pfree(col->values);
+			if (col->codes != NULL)
+				pfree(col->codes);
+		}
+		pfree(res->columns);
+	}
+
+	for (i = 0; i < res->cols; i++) {
+		if (res->names[i] != NULL)
+			pfree(res->names[i]);
+		free_type(&res->types[i]);
+	}
+
+	if (res->types != NULL)
+		pfree(res->types);
+	if (res->names != NULL)
+		pfree(res->names);
 	pfree(res);
 }
 
@@ -171,13 +287,18 @@ plcArray *plc_alloc_array(int ndims) {
 	if (ndims > 0)
 		arr->meta->dims = (int *) pmalloc(ndims * sizeof(int));
 	arr->meta->size = 0;
+	arr->data = NULL;
+	arr->nulls = NULL;
+	arr->blob = NULL;
 	return arr;
 }
 
 void plc_free_array(plcArray *arr, plcType *type, bool isSender) {
 	int i;
 	if (arr != NULL) {
-		if (arr->meta->type == PLC_DATA_TEXT || arr->meta->type == PLC_DATA_BYTEA) {
+		if (arr->blob != NULL) {
+			pfree(arr->blob);
+		} else if (arr->meta->type == PLC_DATA_TEXT || plc_type_is_bytea(arr->meta->type)) {
 			for (i = 0; i < arr->meta->size; i++) {
 				if (((char **) arr->data)[i] != NULL) {
 					pfree(((char **) arr->data)[i]);
@@ -253,6 +374,13 @@ int plc_get_type_length(plcDatatype dt) {
 		case PLC_DATA_TEXT:
 		case PLC_DATA_UDT:
 		case PLC_DATA_BYTEA:
+		case PLC_DATA_NUMERIC:
+		case PLC_DATA_DATE:
+		case PLC_DATA_TIMESTAMP:
+		case PLC_DATA_TIMESTAMPTZ:
+		case PLC_DATA_INTERVAL:
+		case PLC_DATA_UUID:
+		case PLC_DATA_JSONB:
 			/* 8 = the size of pointer */
 			res = 8;
 			break;
@@ -278,6 +406,13 @@ static const char *plcDatatypeName[] =
 		"PLC_DATA_ARRAY",
 		"PLC_DATA_UDT",
 		"PLC_DATA_BYTEA",
+		"PLC_DATA_NUMERIC",
+		"PLC_DATA_DATE",
+		"PLC_DATA_TIMESTAMP",
+		"PLC_DATA_TIMESTAMPTZ",
+		"PLC_DATA_INTERVAL",
+		"PLC_DATA_UUID",
+		"PLC_DATA_JSONB",
 		"PLC_DATA_INVALID"
 	};
 
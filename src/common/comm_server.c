@@ -21,9 +21,15 @@
 #include "comm_utils.h"
 #include "comm_connectivity.h"
 #include "comm_server.h"
+#include "comm_shm.h"
+#include "comm_memfd.h"
 #include "comm_log.h"
 #include "messages/messages.h"
 
+/* Rings the backend created in the shared directory, if any */
+static plcShm *client_shm = NULL;
+static bool client_ipc = false;
+
 /*
  * Function binds the socket and starts listening on it: tcp
  */
@@ -142,6 +148,12 @@ static int start_listener_ipc() {
 		plc_elog(ERROR, "Cannot listen the socket: %s", strerror(errno));
 	}
 
+	/*
+	 * The file is owned by the backend user and cannot be opened once we run
+	 * as the client user, so map it now.
+	 */
+	client_shm = plcShmAttach(IPC_CLIENT_DIR);
+
 	/* Get the uid that the client will run with */
 	if ((env_str = getenv("CLIENT_UID")) == NULL)
 		plc_elog (ERROR, "CLIENT_UID is not set, something wrong on QE side");
@@ -244,6 +256,7 @@ int start_listener() {
 			return -1;
 		}
 		sock = start_listener_ipc();
+		client_ipc = true;
 	} else {
 		sock = -1;
 		plc_elog(ERROR, "USE_CONTAINER_NETWORK is set to wrong value '%s'", use_container_network);
@@ -282,7 +295,6 @@ void connection_wait(int sock) {
 plcConn *connection_init(int sock) {
 	socklen_t raddr_len;
 	struct sockaddr_in raddr;
-	struct timeval tv;
 	int connection;
 
 	raddr_len = sizeof(raddr);
@@ -291,20 +303,21 @@ plcConn *connection_init(int sock) {
 		plc_elog(ERROR, "failed to accept connection: %s", strerror(errno));
 	}
 
-	/* Set socket receive timeout to 500ms */
-	tv.tv_sec = 0;
-	tv.tv_usec = 500000;
-	setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, (char *) &tv, sizeof(struct timeval));
-
 	return plcConnInit(connection);
 }
 
 /*
  * The loop of receiving commands from the Greenplum process and processing them
  */
-void receive_loop(void (*handle_call)(plcMsgCallreq *, plcConn *), plcConn *conn) {
+void receive_loop(void (*handle_call)(plcMsgCallreq *, plcConn *),
+                  void (*handle_next)(plcMsgResultNext *, plcConn *), plcConn *conn) {
 	plcMessage *msg;
 	int res = 0;
+	int64 mask = MT_CALLREQ_BIT | MT_CALLREQ_BATCH_BIT;
+
+	/* Requests for the next chunk of a streamed result set */
+	if (handle_next != NULL)
+		mask |= MT_RESULT_NEXT_BIT;
 
 	res = plcontainer_channel_receive(conn, &msg, MT_PING_BIT);
 	if (res < 0) {
@@ -312,20 +325,45 @@ void receive_loop(void (*handle_call)(plcMsgCallreq *, plcConn *), plcConn *conn
 		return;
 	}
 
+	/* Tell the backend whether we could map the rings it asks for */
+	if (client_shm == NULL)
+		((plcMsgPing *) msg)->sharedMemory = 0;
+	/* and whether we can take files on our socket */
+	if (!client_ipc || !plcMemfdSupported())
+		((plcMsgPing *) msg)->fdPassingThreshold = 0;
+	/* and which encoding of rows we both know */
+	if (((plcMsgPing *) msg)->wireVersion > PLC_WIRE_VERSION)
+		((plcMsgPing *) msg)->wireVersion = PLC_WIRE_VERSION;
+
 	res = plcontainer_channel_send(conn, msg);
 	if (res < 0) {
 		plc_elog(ERROR, "Cannot send 'ping' message response");
 		return;
 	}
+	/* The ping carries the compression the backend asks for */
+	plcConnSetCompression(conn, ((plcMsgPing *) msg)->compressThreshold);
+	plcConnSetFdPassing(conn, ((plcMsgPing *) msg)->fdPassingThreshold);
+	plcConnSetWireVersion(conn, ((plcMsgPing *) msg)->wireVersion);
+	plcConnSetFraming(conn, ((plcMsgPing *) msg)->framing);
+	if (((plcMsgPing *) msg)->sharedMemory) {
+		plcShmSetSide(client_shm, PLC_SHM_CLIENT_TO_BACKEND);
+		client_shm->spinUs = ((plcMsgPing *) msg)->sharedMemorySpinUs;
+		conn->shm = client_shm;
+	}
 	pfree(msg);
 
 	while (1) {
-		res = plcontainer_channel_receive(conn, &msg, MT_CALLREQ_BIT);
+		res = plcontainer_channel_receive(conn, &msg, mask);
 
 		if (res < 0) {
 				plc_elog(ERROR, "Error receiving data from the peer: %d", res);
 			break;
 		}
+		if (msg->msgtype == MT_RESULT_NEXT) {
+			handle_next((plcMsgResultNext *) msg, conn);
+			pfree(msg);
+			continue;
+		}
 		plc_elog(DEBUG1, "Client receive a request: called function oid %u", ((plcMsgCallreq *) msg)->objectid);
 		handle_call((plcMsgCallreq *) msg, conn);
 		free_callreq((plcMsgCallreq *) msg, false, false);
@@ -24,6 +24,7 @@ void connection_wait(int sock);
 
 plcConn *connection_init(int sock);
 
-void receive_loop(void (*handle_call)(plcMsgCallreq *, plcConn *), plcConn *conn);
+void receive_loop(void (*handle_call)(plcMsgCallreq *, plcConn *),
+                  void (*handle_next)(plcMsgResultNext *, plcConn *), plcConn *conn);
 
 #endif /* PLC_COMM_SERVER_H */
@@ -0,0 +1,266 @@
+/*------------------------------------------------------------------------------
+ *
+ *
+ * Copyright (c) 2016-Present Pivotal Software, Inc
+ *
+ *------------------------------------------------------------------------------
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#include "comm_utils.h"
+#include "comm_shm.h"
+#ifndef PLC_CLIENT
+  #include "miscadmin.h"
+#endif
+
+/* A sleeping side wakes up this often to check for the peer and interrupts */
+#define PLC_SHM_WAIT_SLICE_MS 50
+
+#define PLC_SHM_FILE_LEN (2 * sizeof(plcShmRingHeader) + 2 * PLC_SHM_RING_SIZE)
+
+/* Does not allocate, as plcShmUnlink() is also called on exit */
+static void shm_file_name(const char *dir, char *fn) {
+	snprintf(fn, PATH_MAX, "%s/%s", dir, SHM_SHARED_FILE);
+}
+
+static plcShm *shm_map(int fd) {
+	plcShm *shm;
+	void *base;
+
+	base = mmap(NULL, PLC_SHM_FILE_LEN, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (base == MAP_FAILED) {
+		plc_elog(LOG, "Cannot map the shared memory file: %s", strerror(errno));
+		return NULL;
+	}
+
+	shm = (plcShm *) PLy_malloc(sizeof(plcShm));
+	shm->base = base;
+	shm->len = PLC_SHM_FILE_LEN;
+	shm->spinUs = 0;
+	plcShmSetSide(shm, PLC_SHM_BACKEND_TO_CLIENT);
+	return shm;
+}
+
+plcShm *plcShmCreate(const char *dir) {
+	char fn[PATH_MAX];
+	plcShm *shm = NULL;
+	int fd;
+
+	shm_file_name(dir, fn);
+	unlink(fn);
+	fd = open(fn, O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
+	if (fd < 0) {
+		plc_elog(LOG, "Cannot create the shared memory file %s: %s", fn, strerror(errno));
+	} else {
+		/* The file is sparse, the rings start zeroed */
+		if (ftruncate(fd, PLC_SHM_FILE_LEN) < 0)
+			plc_elog(LOG, "Cannot size the shared memory file %s: %s", fn, strerror(errno));
+		else
+			shm = shm_map(fd);
+		close(fd);
+		if (shm == NULL)
+			unlink(fn);
+	}
+
+	return shm;
+}
+
+plcShm *plcShmAttach(const char *dir) {
+	char fn[PATH_MAX];
+	plcShm *shm = NULL;
+	struct stat st;
+	int fd;
+
+	shm_file_name(dir, fn);
+	fd = open(fn, O_RDWR);
+	if (fd >= 0) {
+		if (fstat(fd, &st) == 0 && (size_t) st.st_size == PLC_SHM_FILE_LEN)
+			shm = shm_map(fd);
+		else
+			plc_elog(LOG, "Shared memory file %s has a wrong size", fn);
+		close(fd);
+	}
+
+	return shm;
+}
+
+void plcShmSetSide(plcShm *shm, int outRing) {
+	plcShmRingHeader *headers = (plcShmRingHeader *) shm->base;
+	char *data = (char *) shm->base + 2 * sizeof(plcShmRingHeader);
+
+	shm->out = &headers[outRing];
+	shm->outData = data + outRing * PLC_SHM_RING_SIZE;
+	shm->in = &headers[1 - outRing];
+	shm->inData = data + (1 - outRing) * PLC_SHM_RING_SIZE;
+}
+
+void plcShmDetach(plcShm *shm) {
+	munmap(shm->base, shm->len);
+	pfree(shm);
+}
+
+void plcShmUnlink(const char *dir) {
+	char fn[PATH_MAX];
+
+	shm_file_name(dir, fn);
+	unlink(fn);
+}
+
+static int64 shm_now_usec(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void shm_futex_wait(volatile int32_t *addr, int32_t val) {
+	struct timespec ts;
+
+	ts.tv_sec = 0;
+	ts.tv_nsec = PLC_SHM_WAIT_SLICE_MS * 1000000L;
+	/* Not FUTEX_PRIVATE: the word is shared with the other process */
+	syscall(SYS_futex, addr, FUTEX_WAIT, val, &ts, NULL, 0);
+}
+
+static void shm_futex_wake(volatile int32_t *seq, volatile int32_t *waiting) {
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (__atomic_load_n(waiting, __ATOMIC_SEQ_CST)) {
+		__atomic_add_fetch(seq, 1, __ATOMIC_SEQ_CST);
+		syscall(SYS_futex, seq, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+	}
+}
+
+/* Spinning only helps if the peer runs on another CPU meanwhile */
+static bool shm_can_spin(void) {
+	static int ncpus = 0;
+
+	if (ncpus == 0)
+		ncpus = (int) sysconf(_SC_NPROCESSORS_ONLN);
+	return ncpus > 1;
+}
+
+/*
+ * The peer never writes to the socket once the rings are in use, so the
+ * socket becoming readable means the peer has gone
+ */
+static bool shm_peer_alive(plcConn *conn) {
+	struct pollfd pfd;
+	char c;
+
+	pfd.fd = conn->sock;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+	if (poll(&pfd, 1, 0) <= 0)
+		return true;
+	if (pfd.revents & (POLLHUP | POLLERR))
+		return false;
+	return recv(conn->sock, &c, 1, MSG_PEEK | MSG_DONTWAIT) != 0;
+}
+
+/*
+ * Wait until ready() holds: spin for spinUs, then sleep on the futex seq
+ * after announcing it in waiting, so that the peer knows to wake us up.
+ * Returns 0 when ready, -1 if the peer has gone.
+ */
+static int shm_wait(plcConn *conn, plcShmRingHeader *ring, bool reading) {
+	plcShm *shm = conn->shm;
+	volatile int32_t *seq = reading ? &ring->dataSeq : &ring->spaceSeq;
+	volatile int32_t *waiting = reading ? &ring->readerWaiting : &ring->writerWaiting;
+	int64 start = shm_now_usec();
+	int64 spinUntil = shm_can_spin() ? start + shm->spinUs : start;
+
+#define SHM_READY() (reading \
+		? __atomic_load_n(&ring->head, __ATOMIC_SEQ_CST) != ring->tail \
+		: ring->head - __atomic_load_n(&ring->tail, __ATOMIC_SEQ_CST) < PLC_SHM_RING_SIZE)
+
+	while (!SHM_READY()) {
+		int32_t val;
+
+		if (spinUntil > start && shm_now_usec() < spinUntil) {
+#if defined(__x86_64__) || defined(__i386__)
+			__builtin_ia32_pause();
+#endif
+			continue;
+		}
+
+		val = __atomic_load_n(seq, __ATOMIC_SEQ_CST);
+		__atomic_store_n(waiting, 1, __ATOMIC_SEQ_CST);
+		if (!SHM_READY())
+			shm_futex_wait(seq, val);
+		__atomic_store_n(waiting, 0, __ATOMIC_SEQ_CST);
+
+		if (SHM_READY())
+			break;
+#ifndef PLC_CLIENT
+		CHECK_FOR_INTERRUPTS();
+#endif
+		if (!shm_peer_alive(conn)) {
+			plc_elog(LOG, "The peer has shut down the connection.");
+			return -1;
+		}
+		if (reading && (shm_now_usec() - start) / 1000000 > conn->rx_timeout_sec) {
+			plc_elog(ERROR, "rx timeout (%ds > %ds)",
+				(int) ((shm_now_usec() - start) / 1000000), conn->rx_timeout_sec);
+			return -1;
+		}
+	}
+#undef SHM_READY
+
+	return 0;
+}
+
+ssize_t plcShmSend(plcConn *conn, const char *ptr, size_t len) {
+	plcShmRingHeader *ring = conn->shm->out;
+	uint64_t head = ring->head;
+	size_t space, pos, first;
+
+	if (shm_wait(conn, ring, false) < 0)
+		return -1;
+
+	space = PLC_SHM_RING_SIZE - (size_t) (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE));
+	if (len > space)
+		len = space;
+	pos = (size_t) (head & (PLC_SHM_RING_SIZE - 1));
+	first = PLC_SHM_RING_SIZE - pos < len ? PLC_SHM_RING_SIZE - pos : len;
+	memcpy(conn->shm->outData + pos, ptr, first);
+	memcpy(conn->shm->outData, ptr + first, len - first);
+
+	__atomic_store_n(&ring->head, head + len, __ATOMIC_SEQ_CST);
+	shm_futex_wake(&ring->dataSeq, &ring->readerWaiting);
+
+	return (ssize_t) len;
+}
+
+ssize_t plcShmRecv(plcConn *conn, char *ptr, size_t len) {
+	plcShmRingHeader *ring = conn->shm->in;
+	uint64_t tail = ring->tail;
+	size_t avail, pos, first;
+
+	if (shm_wait(conn, ring, true) < 0)
+		return -1;
+
+	avail = (size_t) (__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) - tail);
+	if (len > avail)
+		len = avail;
+	pos = (size_t) (tail & (PLC_SHM_RING_SIZE - 1));
+	first = PLC_SHM_RING_SIZE - pos < len ? PLC_SHM_RING_SIZE - pos : len;
+	memcpy(ptr, conn->shm->inData + pos, first);
+	memcpy(ptr + first, conn->shm->inData, len - first);
+
+	__atomic_store_n(&ring->tail, tail + len, __ATOMIC_SEQ_CST);
+	shm_futex_wake(&ring->spaceSeq, &ring->writerWaiting);
+
+	return (ssize_t) len;
+}
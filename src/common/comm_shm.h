@@ -0,0 +1,69 @@
+/*------------------------------------------------------------------------------
+ *
+ *
+ * Copyright (c) 2016-Present Pivotal Software, Inc
+ *
+ *------------------------------------------------------------------------------
+ */
+#ifndef PLC_COMM_SHM_H
+#define PLC_COMM_SHM_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "comm_connectivity.h"
+
+/*
+ * Shared memory transport: a file in the directory shared with the container
+ * holds two single producer single consumer rings, one per direction. The
+ * backend creates the file before the container starts, the client maps it
+ * while it still runs as root, and both switch their socket reads and writes
+ * to the rings once the ping exchange agreed on it. The socket stays open and
+ * only tells whether the peer is still there.
+ */
+#define PLC_SHM_RING_SIZE (1024 * 1024) /* power of 2 */
+
+#define PLC_SHM_BACKEND_TO_CLIENT 0
+#define PLC_SHM_CLIENT_TO_BACKEND 1
+
+typedef struct plcShmRingHeader {
+	volatile uint64_t head;    /* bytes written, advanced by the writer */
+	char pad1[56];
+	volatile uint64_t tail;    /* bytes read, advanced by the reader */
+	char pad2[56];
+	volatile int32_t dataSeq;  /* futex the reader sleeps on */
+	volatile int32_t readerWaiting;
+	volatile int32_t spaceSeq; /* futex the writer sleeps on */
+	volatile int32_t writerWaiting;
+	char pad3[48];
+} plcShmRingHeader;
+
+struct plcShm {
+	void *base;
+	size_t len;
+	plcShmRingHeader *out;
+	char *outData;
+	plcShmRingHeader *in;
+	char *inData;
+	int spinUs; /* busy wait this long before sleeping */
+};
+
+/* Backend side: create and map the file in dir */
+plcShm *plcShmCreate(const char *dir);
+
+/* Client side: map the file in dir if the backend created one */
+plcShm *plcShmAttach(const char *dir);
+
+/* Which ring to write to */
+void plcShmSetSide(plcShm *shm, int outRing);
+
+void plcShmDetach(plcShm *shm);
+
+void plcShmUnlink(const char *dir);
+
+/* Like send() and recv(): transfer at least one byte, waiting if needed */
+ssize_t plcShmSend(plcConn *conn, const char *ptr, size_t len);
+
+ssize_t plcShmRecv(plcConn *conn, char *ptr, size_t len);
+
+#endif /* PLC_COMM_SHM_H */
@@ -18,9 +18,17 @@ typedef struct plcMessage {
 
 typedef struct {
 	int32 isnull;
+	int32 len;          // length of a received text value, without its zero byte
 	char *value;
 } rawdata;
 
+/* A value received as a memory file, mapped until its message is freed */
+typedef struct plcMapping {
+	char *addr;
+	size_t len;
+	struct plcMapping *next;
+} plcMapping;
+
 /*
  * Note:
  * Must start from 0 since it is used as index to get type name.
@@ -38,10 +46,28 @@ typedef enum {
 	PLC_DATA_ARRAY,        // Array - array type specification should follow
 	PLC_DATA_UDT,          // User-defined type, specification to follow
 	PLC_DATA_BYTEA,        // Arbitrary set of bytes, stored and transferred as length + data
+	PLC_DATA_NUMERIC,      // Numeric in the binary form of numeric_send, stored and transferred like bytea
+	PLC_DATA_DATE,         // Date, days since 2000-01-01 in the binary form of date_send, like bytea
+	PLC_DATA_TIMESTAMP,    // Timestamp, microseconds since 2000-01-01 in the binary form of timestamp_send
+	PLC_DATA_TIMESTAMPTZ,  // Timestamp with time zone, as timestamp in UTC
+	PLC_DATA_INTERVAL,     // Interval in the binary form of interval_send, like bytea
+	PLC_DATA_UUID,         // UUID, 16 bytes, like bytea
+	PLC_DATA_JSONB,        // Jsonb in the binary form of jsonb_send (version and text), like bytea
 	PLC_DATA_INVALID,      // Invalid data type
 	PLC_DATA_MAX
 } plcDatatype;
 
+/* Whether values of the type are stored and transferred like bytea */
+#define plc_type_is_bytea(dt) \
+	((dt) == PLC_DATA_BYTEA || ((dt) >= PLC_DATA_NUMERIC && (dt) <= PLC_DATA_JSONB))
+
+/*
+ * Values of numeric, date and time and uuid types sent by the client start
+ * with a byte telling the form of the rest of the value
+ */
+#define PLC_FORM_BINARY 'b'    // The binary form of the send function
+#define PLC_FORM_TEXT   't'    // The zero-terminated text, for the input function
+
 typedef struct plcType plcType;
 
 struct plcType {
@@ -15,19 +15,63 @@ typedef struct {
 	char *name; // name of procedure
 } plcProcSrc;
 
+/*
+ * A text or bytea argument too large to be sent with the call. It is sent
+ * as NULL, and the client reads it in slices of at most PLC_SLICE_MAX_SIZE
+ * bytes while the function runs.
+ */
+typedef struct plcSlicedArg {
+	int32 argument;   // index of the argument
+	int64 size;       // bytes of the value
+	char *source;     // backend only: the varlena the slices are read from
+	bool detoasted;   // backend only: source is a detoasted copy to free
+} plcSlicedArg;
+
+#define PLC_SLICE_MAX_SIZE (1024 * 1024)
+
 typedef struct plcMsgCallreq {
 	base_message_content;    // message_type ID
 	uint32 objectid;   // OID of the function in GPDB
 	int32 hasChanged; // flag signaling the function has changed in GPDB
-	plcProcSrc proc;       // procedure - its name and source code
+	uint32 version;    // xmin of the function's pg_proc row
+	plcProcSrc proc;       // procedure - its name and source code, NULL source
+	                       // if the client was already sent this version
 	int32 logLevel;      // log level at client side
+	int32 clientMinMessages; // lowest level the backend sends to the user
 	plcType retType;    // function return type
 	int32 retset;     // whether the function is set-returning
 	int32 nargs;      // number of function arguments
 	char *serverenc; //db_encoding
 	plcArgument *args;       // function arguments
+	uint32 nrows;      // number of argument rows in a batched call
+	rawdata **rows;     // argument values of a batched call, rows[row][arg]
+	char *frame;      // message the text and bytea values point into, or NULL
+	size_t frameLen;
+	plcMapping *mappings; // files the text and bytea values are mapped from
+	int32 nsliced;     // number of arguments read in slices
+	plcSlicedArg *sliced;
 } plcMsgCallreq;
 
+/*
+ * Sent by the client instead of a result when it was called without the
+ * source of a function it does not have, the call is then repeated with it
+ */
+typedef struct plcMsgSourceRequest {
+	base_message_content;
+	uint32 objectid;   // OID of the function in GPDB
+} plcMsgSourceRequest;
+
+/*
+ * Sent by the client to read a slice of a sliced argument of the running
+ * call, answered with the bytes as a raw message
+ */
+typedef struct plcMsgSliceRequest {
+	base_message_content;
+	int32 argument;   // index of the argument
+	int64 offset;
+	int32 length;
+} plcMsgSliceRequest;
+
 void free_arguments(plcArgument *args, int nargs, bool isShared, bool isSender);
 
 /*
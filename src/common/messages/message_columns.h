@@ -0,0 +1,51 @@
+/*------------------------------------------------------------------------------
+ *
+ *
+ * Copyright (c) 2016-Present Pivotal Software, Inc
+ *
+ *------------------------------------------------------------------------------
+ */
+#ifndef PLC_MESSAGE_COLUMNS_H
+#define PLC_MESSAGE_COLUMNS_H
+
+#include "message_base.h"
+
+/*
+ * Column-major encoding of a SPI result. Each column is transferred as one
+ * block instead of one object per row, so that the client can materialize
+ * it with a single copy.
+ */
+typedef enum {
+	PLC_COLUMN_FIXED = 0, /* values holds rows * type length bytes */
+	PLC_COLUMN_VARLEN,    /* offsets[nvalues + 1] into values, one per row */
+	PLC_COLUMN_DICT,      /* offsets[nvalues + 1] into values, one per
+	                       * distinct value, and codes[rows] referencing them */
+	PLC_COLUMN_OBJECT     /* objects[rows], for arrays and UDTs */
+} plcColumnEncoding;
+
+typedef struct plcColumn {
+	plcColumnEncoding encoding;
+	char *nulls;       /* bitmap with (rows + 7) / 8 bytes, bit set for NULL.
+	                    * NULL pointer if the column has no NULL values */
+	int32 nvalues;
+	int32 *offsets;
+	char *values;
+	int32 *codes;
+	rawdata *objects;
+} plcColumn;
+
+#define plc_column_isnull(col, i) \
+	((col)->nulls != NULL && ((col)->nulls[(i) >> 3] & (1 << ((i) & 7))) != 0)
+
+typedef struct plcMsgColumns {
+	base_message_content;
+	uint32 rows;
+	uint32 cols;
+	plcType *types;
+	char **names;
+	plcColumn *columns;
+} plcMsgColumns;
+
+void free_columns(plcMsgColumns *res, bool isSender);
+
+#endif /* PLC_MESSAGE_COLUMNS_H */
@@ -23,6 +23,8 @@ typedef struct plcArray {
 	plcArrayMeta *meta;
 	char *data;
 	char *nulls;
+	char *blob;  /* holds all the text and bytea elements data points to,
+	              * NULL if each of them is allocated on its own */
 } plcArray;
 
 struct plcIterator {
@@ -37,6 +39,14 @@ struct plcIterator {
 	 */
 	rawdata *(*next)(plcIterator *self);
 
+	/*
+	 * optional, used instead of next() for arrays of fixed-width types.
+	 * Returns all the elements as one block with zeroes in place of NULLs,
+	 * and sets the bits of the NULL elements in the zeroed bitmap nulls.
+	 * The block is owned by the iterator, NULL is returned on failure
+	 */
+	char *(*block)(plcIterator *self, char *nulls);
+
 	/*
 	 * called after data is sent to free data
 	 */
@@ -55,4 +65,6 @@ plcUDT *plc_alloc_udt(int nargs);
 
 void plc_free_udt(plcUDT *udt, plcType *type, bool isSender);
 
+void free_type(plcType *type);
+
 #endif /* PLC_MESSAGE_DATA_H */
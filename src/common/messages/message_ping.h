@@ -12,6 +12,12 @@
 
 typedef struct plcMsgPing {
 	base_message_content;
+	int32 compressThreshold; /* requested by the backend and echoed by the client */
+	int32 sharedMemory;       /* 1 if the shared memory rings are to be used */
+	int32 sharedMemorySpinUs; /* busy wait before sleeping on a ring */
+	int32 fdPassingThreshold; /* pass values of at least this size as files, 0 - off */
+	int32 wireVersion;        /* encoding of rows, PLC_WIRE_* */
+	int32 framing;            /* 1 if the messages after the ping carry their length */
 } plcMsgPing;
 
 #endif /* PLC_MESSAGE_PING_H */
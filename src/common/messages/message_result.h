@@ -10,13 +10,28 @@
 
 #include "message_base.h"
 
+/*
+ * Rows of a set-returning function are sent in chunks of this size. Every
+ * chunk but the last one is a MT_RESULT_CHUNK message, after which the client
+ * waits for the backend to request the next chunk with MT_RESULT_NEXT. The
+ * last chunk is a regular MT_RESULT message.
+ */
+#define PLC_RESULT_CHUNK_ROWS 1000
+
+#define PLC_RESULT_NEXT   'n'
+#define PLC_RESULT_CANCEL 'c'
+
 typedef struct plcMsgResult {
 	base_message_content;
+	int32 stream;     /* id of the streamed result set, MT_RESULT_CHUNK only */
 	uint32 rows;
 	uint32 cols;
 	plcType *types;
 	char **names;
 	rawdata **data;
+	char *frame;      /* message the text and bytea values point into, or NULL */
+	size_t frameLen;
+	plcMapping *mappings; /* files the text and bytea values are mapped from */
 
 	/*
 	 * Callback called from message sending function to return the error message
@@ -25,6 +40,12 @@ typedef struct plcMsgResult {
 	void *(*exception_callback)(void);
 } plcMsgResult;
 
+typedef struct plcMsgResultNext {
+	base_message_content;
+	int32 stream;     /* id of the streamed result set, 0 to cancel all of them */
+	char action;      /* PLC_RESULT_NEXT or PLC_RESULT_CANCEL */
+} plcMsgResultNext;
+
 void free_result(plcMsgResult *res, bool isSender);
 
 #endif /* PLC_MESSAGE_RESULT_H */
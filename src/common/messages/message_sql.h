@@ -19,6 +19,8 @@ typedef enum {
 	SQL_TYPE_PREPARE,
 	SQL_TYPE_PEXECUTE,
 	SQL_TYPE_UNPREPARE,
+	SQL_TYPE_STATEMENT_COLUMNS, /* as STATEMENT, with a columnar result */
+	SQL_TYPE_PEXECUTE_COLUMNS,  /* as PEXECUTE, with a columnar result */
 	SQL_TYPE_MAX
 } plcSqlType;
 
@@ -31,6 +33,14 @@ typedef struct plcMsgSQL {
 	void *pplan;        /* For prepare and execute_plan. pointer to plan */
 	char *statement;    /* For prepare and execute_query/execute_plan */
 	int32 nargs;        /* For prepare and execute_plan */
+	int32 cursor;       /* For cursor open, fetch and close. Chosen by the client */
 } plcMsgSQL;
 
+/*
+ * Rows fetched per round trip by plpy.cursor() when no batch size is given.
+ * A fetch returning fewer rows than asked for means the cursor is exhausted,
+ * and the QE closes it at once.
+ */
+#define PLC_CURSOR_BATCH_ROWS 1000
+
 #endif /* PLC_MESSAGE_SQL_H */
@@ -9,12 +9,18 @@
 #define PLC_MESSAGE_TYPES_H
 
 #define MT_CALLREQ        'C'
+#define MT_CALLREQ_BATCH  'B'
 #define MT_EXCEPTION      'E'
 #define MT_LOG            'L'
 #define MT_QUOTE          'Q'
 #define MT_QUOTE_RESULT   'O'
 #define MT_PING           'P'
 #define MT_RESULT         'R'
+#define MT_RESULT_COLUMNS 'K'
+#define MT_RESULT_CHUNK   'H'
+#define MT_RESULT_NEXT    'X'
+#define MT_SOURCE_REQUEST 'F'
+#define MT_SLICE_REQUEST  'G'
 #define MT_SQL            'S'
 #define MT_TRIGREQ        'T'
 #define MT_TUPLRES        'U'
@@ -39,6 +45,12 @@
 #define MT_EOF_BIT            0x1000LL
 #define MT_QUOTE_BIT          0x2000LL
 #define MT_QUOTE_RESULT_BIT   0x4000LL
+#define MT_CALLREQ_BATCH_BIT  0x8000LL
+#define MT_RESULT_COLUMNS_BIT 0x10000LL
+#define MT_RESULT_CHUNK_BIT   0x20000LL
+#define MT_RESULT_NEXT_BIT    0x40000LL
+#define MT_SOURCE_REQUEST_BIT 0x80000LL
+#define MT_SLICE_REQUEST_BIT  0x100000LL
 
 #define MT_ALL_BITS        0xFFFFffffFFFFffffLL
 
@@ -28,10 +28,14 @@
 #endif
 #include "storage/ipc.h"
 #include "libpq/pqsignal.h"
+#include "funcapi.h"
+#include "utils/builtins.h"
 #include "utils/ps_status.h"
 #include "common/comm_utils.h"
 #include "common/comm_channel.h"
 #include "common/comm_connectivity.h"
+#include "common/comm_shm.h"
+#include "common/comm_memfd.h"
 #include "common/messages/messages.h"
 #include "plc_configuration.h"
 #include "containers.h"
@@ -141,9 +145,13 @@ static int delete_backend_if_exited(char *dockerid) {
 }
 
 static void cleanup_uds(char *uds_fn) {
+	char *uds_dir;
+
 	if (uds_fn != NULL) {
 		unlink(uds_fn);
-		rmdir(dirname(uds_fn));
+		uds_dir = dirname(uds_fn);
+		plcShmUnlink(uds_dir);
+		rmdir(uds_dir);
 	}
 }
 
@@ -360,6 +368,7 @@ plcConn *start_backend(runtimeConfEntry *conf) {
 	unsigned int sleepms = 0;
 	plcMsgPing *mping = NULL;
 	plcConn *conn = NULL;
+	plcShm *shm = NULL;
 	char *dockerid = NULL;
 	char *uds_fn = NULL;
 	char *uds_dir = NULL;
@@ -418,8 +427,12 @@ plcConn *start_backend(runtimeConfEntry *conf) {
 	pfree(dockerid);
 	dockerid = containers[container_slot].dockerid;
 
-	if (!conf->useContainerNetwork)
+	if (!conf->useContainerNetwork) {
 		uds_fn = get_uds_fn(uds_dir);
+		/* The client maps the rings when it starts, so create them first */
+		if (conf->useSharedMemory)
+			shm = plcShmCreate(uds_dir);
+	}
 
 	_loop_cnt = 0;
 	while ((res = plc_backend_start(dockerid)) < 0) {
@@ -429,6 +442,8 @@ plcConn *start_backend(runtimeConfEntry *conf) {
 		plc_elog(LOG, "plc_backend_start() fails. Retrying [%d]", _loop_cnt);
 	}
 	if (res < 0) {
+		if (shm != NULL)
+			plcShmDetach(shm);
 		if (!conf->useContainerNetwork)
 			cleanup_uds(uds_fn);
 		plc_elog(ERROR, "Backend start error: %s", backend_error_message);
@@ -486,6 +501,13 @@ plcConn *start_backend(runtimeConfEntry *conf) {
 	 */
 	mping = (plcMsgPing*) palloc(sizeof(plcMsgPing));
 	mping->msgtype = MT_PING;
+	mping->compressThreshold = conf->compressThreshold;
+	mping->sharedMemory = shm != NULL;
+	mping->sharedMemorySpinUs = conf->sharedMemorySpinUs;
+	mping->fdPassingThreshold = (!conf->useContainerNetwork && plcMemfdSupported())
+	                            ? conf->fdPassingThreshold : 0;
+	mping->wireVersion = PLC_WIRE_VERSION;
+	mping->framing = 1;
 	while (sleepms < CONTAINER_CONNECT_TIMEOUT_MS) {
 		int res = 0;
 		plcMessage *mresp = NULL;
@@ -503,6 +525,18 @@ plcConn *start_backend(runtimeConfEntry *conf) {
 			res = plcontainer_channel_send(conn, (plcMessage *) mping);
 			if (res == 0) {
 				res = plcontainer_channel_receive(conn, &mresp, MT_PING_BIT);
+				if (res == 0) {
+					plcConnSetCompression(conn, ((plcMsgPing *) mresp)->compressThreshold);
+					plcConnSetFdPassing(conn, ((plcMsgPing *) mresp)->fdPassingThreshold);
+					plcConnSetWireVersion(conn, ((plcMsgPing *) mresp)->wireVersion);
+					plcConnSetFraming(conn, ((plcMsgPing *) mresp)->framing);
+					/* The client says whether it could map the rings */
+					if (shm != NULL && ((plcMsgPing *) mresp)->sharedMemory) {
+						shm->spinUs = conf->sharedMemorySpinUs;
+						conn->shm = shm;
+						shm = NULL;
+					}
+				}
 				if (mresp != NULL)
 					pfree(mresp);
 				if (res == 0) {
@@ -541,6 +575,12 @@ plcConn *start_backend(runtimeConfEntry *conf) {
 		sleepus = sleepus >= 200000 ? 200000 : sleepus * 2;
 	}
 
+	/* Not taken by the connection: stay on the socket */
+	if (shm != NULL) {
+		plcShmDetach(shm);
+		plcShmUnlink(uds_dir);
+	}
+
 	if (sleepms >= CONTAINER_CONNECT_TIMEOUT_MS) {
 		if (!conf->useContainerNetwork)
 			cleanup_uds(uds_fn);
@@ -620,6 +660,95 @@ void delete_containers() {
 	containers_init = 0;
 }
 
+/*
+ * Cancel the result sets that the containers are still streaming at the end
+ * of transaction, e.g. because the query failed before reading all the rows
+ */
+void cancel_container_streams() {
+	int i;
+
+	if (containers_init == 0)
+		return;
+
+	for (i = 0; i < MAX_CONTAINER_NUMBER; i++) {
+		plcConn *conn = containers[i].conn;
+		plcMsgResultNext msg;
+
+		if (conn == NULL || conn->nstreams == 0)
+			continue;
+
+		msg.msgtype = MT_RESULT_NEXT;
+		msg.stream = 0;
+		msg.action = PLC_RESULT_CANCEL;
+		if (plcontainer_channel_send(conn, (plcMessage *) &msg) < 0)
+			plc_elog(LOG, "Error cancelling result sets of runtime %s", containers[i].runtimeid);
+		conn->nstreams = 0;
+	}
+}
+
+#define COMPRESSION_STATS_COLUMNS 9
+
+PG_FUNCTION_INFO_V1(containers_compression_stats);
+
+/*
+ * Compression counters of the connections to the containers of this
+ * process, one row per runtime. Sent and received are seen from the
+ * backend, so the compression time is spent on sending and the
+ * decompression time on receiving.
+ */
+Datum
+containers_compression_stats(PG_FUNCTION_ARGS) {
+	FuncCallContext *funcctx;
+	int *next_slot;
+
+	if (SRF_IS_FIRSTCALL()) {
+		MemoryContext oldcontext;
+		TupleDesc tupdesc;
+
+		funcctx = SRF_FIRSTCALL_INIT();
+		oldcontext = MemoryContextSwitchTo(funcctx->multi_call_memory_ctx);
+
+		if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+			plc_elog(ERROR, "function returning record called in context that cannot accept type record");
+		funcctx->tuple_desc = BlessTupleDesc(tupdesc);
+		funcctx->user_fctx = palloc0(sizeof(int));
+
+		MemoryContextSwitchTo(oldcontext);
+	}
+
+	funcctx = SRF_PERCALL_SETUP();
+	next_slot = (int *) funcctx->user_fctx;
+
+	for (; containers_init != 0 && *next_slot < MAX_CONTAINER_NUMBER; (*next_slot)++) {
+		plcConn *conn = containers[*next_slot].conn;
+		plcCompressStats *stats;
+		Datum values[COMPRESSION_STATS_COLUMNS];
+		bool nulls[COMPRESSION_STATS_COLUMNS];
+		HeapTuple tuple;
+
+		if (containers[*next_slot].runtimeid == NULL || conn == NULL)
+			continue;
+
+		stats = &conn->compressStats;
+		memset(nulls, 0, sizeof(nulls));
+		values[0] = CStringGetTextDatum(containers[*next_slot].runtimeid);
+		values[1] = Int32GetDatum(conn->compressThreshold);
+		values[2] = Int64GetDatum(stats->rawSent);
+		values[3] = Int64GetDatum(stats->wireSent);
+		values[4] = Int64GetDatum(stats->rawReceived);
+		values[5] = Int64GetDatum(stats->wireReceived);
+		values[6] = Int64GetDatum(stats->blocksCompressed);
+		values[7] = Float8GetDatum(stats->compressUsec / 1000.0);
+		values[8] = Float8GetDatum(stats->decompressUsec / 1000.0);
+
+		tuple = heap_form_tuple(funcctx->tuple_desc, values, nulls);
+		(*next_slot)++;
+		SRF_RETURN_NEXT(funcctx, HeapTupleGetDatum(tuple));
+	}
+
+	SRF_RETURN_DONE(funcctx);
+}
+
 char *parse_container_meta(const char *source) {
 	int first, last, len;
 	char *runtime_id = NULL;
@@ -702,6 +831,137 @@ char *parse_container_meta(const char *source) {
 	return runtime_id;
 }
 
+/*
+ * Given source code of the function, extract the batch size declared with
+ * '# batch: N' among the leading comment lines. Returns 0 when the function
+ * does not declare it.
+ */
+int parse_batch_meta(const char *source) {
+	const char *pos = source;
+	long batch_size = 0;
+
+	while (*pos != '\0') {
+		const char *line = pos;
+		char *end;
+
+		/* Find the start of the next line in advance */
+		while (*pos != '\0' && *pos != '\n' && *pos != '\r')
+			pos++;
+		while (*pos == '\n' || *pos == '\r')
+			pos++;
+
+		while (isblank(*line))
+			line++;
+		if (line == pos || *line == '\n' || *line == '\r')
+			continue;
+		/* Directives are only allowed in the comment block heading the code */
+		if (*line != '#')
+			break;
+		line++;
+
+		while (isblank(*line))
+			line++;
+		if (strncmp(line, "batch", strlen("batch")) != 0)
+			continue;
+		line += strlen("batch");
+		while (isblank(*line))
+			line++;
+		if (*line != ':')
+			continue;
+		line++;
+
+		errno = 0;
+		batch_size = strtol(line, &end, 10);
+		while (isblank(*end))
+			end++;
+		if (errno != 0 || end == line || (*end != '\0' && *end != '\n' && *end != '\r')) {
+			plc_elog(ERROR, "Batch declaration format should be '# batch: N'");
+		}
+		if (batch_size <= 0 || batch_size > PLC_MAX_BATCH_SIZE) {
+			plc_elog(ERROR, "Batch size should be between 1 and %d, current value is %ld",
+			         PLC_MAX_BATCH_SIZE, batch_size);
+		}
+	}
+
+	return (int) batch_size;
+}
+
+/*
+ * Given source code of the function, extract the names listed in a
+ * '# keyword: name[, name ...]' declaration among the leading comment lines
+ */
+static List *parse_name_list_meta(const char *source, const char *keyword, const char *format) {
+	const char *pos = source;
+	List *names = NIL;
+
+	while (*pos != '\0') {
+		const char *line = pos;
+
+		/* Find the start of the next line in advance */
+		while (*pos != '\0' && *pos != '\n' && *pos != '\r')
+			pos++;
+		while (*pos == '\n' || *pos == '\r')
+			pos++;
+
+		while (isblank(*line))
+			line++;
+		if (line == pos || *line == '\n' || *line == '\r')
+			continue;
+		/* Directives are only allowed in the comment block heading the code */
+		if (*line != '#')
+			break;
+		line++;
+
+		while (isblank(*line))
+			line++;
+		if (strncmp(line, keyword, strlen(keyword)) != 0)
+			continue;
+		line += strlen(keyword);
+		while (isblank(*line))
+			line++;
+		if (*line != ':')
+			continue;
+		line++;
+
+		for (;;) {
+			const char *name;
+			char *copy;
+			int len;
+
+			while (isblank(*line))
+				line++;
+			name = line;
+			while (*line != '\0' && *line != '\n' && *line != '\r' && *line != ',' && !isblank(*line))
+				line++;
+			len = line - name;
+			while (isblank(*line))
+				line++;
+			if (len == 0 || (*line != ',' && *line != '\0' && *line != '\n' && *line != '\r')) {
+				plc_elog(ERROR, "%s", format);
+			}
+			copy = palloc(len + 1);
+			memcpy(copy, name, len);
+			copy[len] = '\0';
+			names = lappend(names, copy);
+			if (*line != ',')
+				break;
+			line++;
+		}
+	}
+
+	return names;
+}
+
+List *parse_binary_meta(const char *source) {
+	return parse_name_list_meta(source, "binary",
+	                            "Binary declaration format should be '# binary: type[, type ...]'");
+}
+
+List *parse_slice_meta(const char *source) {
+	return parse_name_list_meta(source, "slice",
+	                            "Slice declaration format should be '# slice: argument[, argument ...]'");
+}
+
 /*
  * check whether configuration id specified in function declaration
  * satisfy the regex which follow docker container/image naming conventions.
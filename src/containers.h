@@ -10,14 +10,26 @@
 
 #include <regex.h>
 
+#include "nodes/pg_list.h"
+
 #include "common/comm_connectivity.h"
 #include "plc_configuration.h"
 
 #define CONTAINER_CONNECT_TIMEOUT_MS 10000
 #define CONTAINER_ID_MAX_LENGTH 128
+#define PLC_MAX_BATCH_SIZE 100000
 /* given source code of the function, extract the container name */
 char *parse_container_meta(const char *source);
 
+/* given source code of the function, extract the '# batch: N' size, 0 if absent */
+int parse_batch_meta(const char *source);
+
+/* given source code of the function, extract the type names of '# binary: type[, ...]' */
+List *parse_binary_meta(const char *source);
+
+/* given source code of the function, extract the argument names of '# slice: argument[, ...]' */
+List *parse_slice_meta(const char *source);
+
 /* return the port of a started container, -1 if the container isn't started */
 plcConn *get_container_conn(const char *id);
 
@@ -27,4 +39,10 @@ plcConn *start_backend(runtimeConfEntry *conf);
 /* Function deletes all the containers */
 void delete_containers(void);
 
+/* cancel the result sets the containers are still streaming */
+void cancel_container_streams(void);
+
+/* compression counters of the connections to the containers */
+Datum containers_compression_stats(PG_FUNCTION_ARGS);
+
 #endif /* PLC_CONTAINERS_H */
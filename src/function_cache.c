@@ -15,62 +15,141 @@
 #pragma GCC diagnostic pop
 #endif
 
+#include "utils/hsearch.h"
+#include "utils/inval.h"
+#include "utils/syscache.h"
+
 #include "message_fns.h"
 
-static plcProcInfo *plcFunctionCache[PLC_FUNCTION_CACHE_SIZE];
-static int plcFunctionCacheInitialized = 0;
+typedef struct plcFunctionCacheEntry {
+	Oid funcOid;
+	bool valid;          /* cleared when the catalog rows of the function change */
+	plcProcInfo *proc;
+} plcFunctionCacheEntry;
+
+static HTAB *plcFunctionCache = NULL;
+
+/*
+ * Invalidations identify the changed catalog row by the hash value of its
+ * key since 9.2, which is kept in the info when it is built, and by its
+ * location before
+ */
+#if PG_VERSION_NUM >= 90200
+typedef uint32 plcCacheInval;
+
+#define plc_inval_all(inval) ((inval) == 0)
+#define plc_inval_matches(inval, hashvalue, tid) ((inval) == (hashvalue))
+#else
+typedef ItemPointer plcCacheInval;
 
-/* Move up the cache item */
-void function_cache_up(int index) {
-	plcProcInfo *tmp;
+#define plc_inval_all(inval) ((inval) == NULL)
+#define plc_inval_matches(inval, hashvalue, tid) ItemPointerEquals((inval), (tid))
+#endif
+
+/* Whether the type info depends on the changed pg_type or pg_class row */
+static bool type_info_affected(plcTypeInfo *type, int cacheid, plcCacheInval inval) {
 	int i;
-	if (index > 0) {
-		tmp = plcFunctionCache[index];
-		for (i = index; i > 0; i--) {
-			plcFunctionCache[i] = plcFunctionCache[i - 1];
-		}
-		plcFunctionCache[0] = tmp;
+
+	if (cacheid == TYPEOID) {
+#if PG_VERSION_NUM >= 90200
+		if (plc_inval_matches(inval, type->typ_hashvalue, NULL))
+			return true;
+		if (OidIsValid(type->domainOid) && plc_inval_matches(inval, type->domain_hashvalue, NULL))
+			return true;
+#else
+		/* The locations of the pg_type rows are not kept */
+		return true;
+#endif
+	} else if (cacheid == RELOID) {
+		/* Records are only described by the function itself */
+		if (type->is_rowtype && !type->is_record
+		    && plc_inval_matches(inval, type->typrel_hashvalue, &type->typrel_tid))
+			return true;
 	}
+
+	for (i = 0; i < type->nSubTypes; i++) {
+		if (!type->subTypes[i].attisdropped && type_info_affected(&type->subTypes[i], cacheid, inval))
+			return true;
+	}
+	return false;
 }
 
-plcProcInfo *function_cache_get(Oid funcOid) {
+static bool function_affected(plcProcInfo *proc, int cacheid, plcCacheInval inval) {
 	int i;
-	plcProcInfo *resFunc = NULL;
-	/* Initialize all the elements with nulls initially */
-	if (!plcFunctionCacheInitialized) {
-		for (i = 0; i < PLC_FUNCTION_CACHE_SIZE; i++) {
-			plcFunctionCache[i] = NULL;
-		}
-		plcFunctionCacheInitialized = 1;
+
+	if (plc_inval_all(inval))
+		return true;
+	if (cacheid == PROCOID)
+		return plc_inval_matches(inval, proc->fn_hashvalue, &proc->fn_tid);
+
+	if (type_info_affected(&proc->result, cacheid, inval))
+		return true;
+	for (i = 0; i < proc->nargs; i++) {
+		if (type_info_affected(&proc->args[i], cacheid, inval))
+			return true;
 	}
-	for (i = 0; i < PLC_FUNCTION_CACHE_SIZE; i++) {
-		if (plcFunctionCache[i] != NULL &&
-		    plcFunctionCache[i]->funcOid == funcOid) {
-			resFunc = plcFunctionCache[i];
-			function_cache_up(i);
-			break;
-		}
+	return false;
+}
+
+/*
+ * The functions are only marked here, as one may be running, and are built
+ * again from the catalog the next time they are called
+ */
+static void function_cache_callback(pg_attribute_unused() Datum arg, int cacheid, plcCacheInval inval) {
+	HASH_SEQ_STATUS status;
+	plcFunctionCacheEntry *entry;
+
+	hash_seq_init(&status, plcFunctionCache);
+	while ((entry = (plcFunctionCacheEntry *) hash_seq_search(&status)) != NULL) {
+		if (entry->valid && function_affected(entry->proc, cacheid, inval))
+			entry->valid = false;
+	}
+}
+
+static void function_cache_init(void) {
+	HASHCTL hash_ctl;
+
+	MemSet(&hash_ctl, 0, sizeof(hash_ctl));
+	hash_ctl.keysize = sizeof(Oid);
+	hash_ctl.entrysize = sizeof(plcFunctionCacheEntry);
+	hash_ctl.hash = tag_hash;
+	plcFunctionCache = hash_create("plcontainer function cache",
+	                               PLC_FUNCTION_CACHE_SIZE,
+	                               &hash_ctl,
+	                               HASH_ELEM | HASH_FUNCTION);
+
+	CacheRegisterSyscacheCallback(PROCOID, function_cache_callback, (Datum) 0);
+	CacheRegisterSyscacheCallback(TYPEOID, function_cache_callback, (Datum) 0);
+	CacheRegisterSyscacheCallback(RELOID, function_cache_callback, (Datum) 0);
+}
+
+plcProcInfo *function_cache_get(Oid funcOid) {
+	plcFunctionCacheEntry *entry;
+
+	if (plcFunctionCache == NULL) {
+		function_cache_init();
+	}
+
+	entry = (plcFunctionCacheEntry *) hash_search(plcFunctionCache, &funcOid, HASH_FIND, NULL);
+	if (entry == NULL || !entry->valid) {
+		return NULL;
 	}
-	return resFunc;
+	return entry->proc;
 }
 
 void function_cache_put(plcProcInfo *func) {
-	int i;
-	plcProcInfo *oldFunc;
-	oldFunc = function_cache_get(func->funcOid);
-	/* If the function is not cached already */
-	if (oldFunc == NULL) {
-		/* If the last element exists we need to free its memory */
-		if (plcFunctionCache[PLC_FUNCTION_CACHE_SIZE - 1] != NULL) {
-			free_proc_info(plcFunctionCache[PLC_FUNCTION_CACHE_SIZE - 1]);
-		}
-		/* Move our LRU cache right */
-		for (i = PLC_FUNCTION_CACHE_SIZE - 1; i > 0; i--) {
-			plcFunctionCache[i] = plcFunctionCache[i - 1];
-		}
-		plcFunctionCache[0] = func;
-	} else {
-		free_proc_info(oldFunc);
-		plcFunctionCache[0] = func;
+	plcFunctionCacheEntry *entry;
+	bool found;
+
+	if (plcFunctionCache == NULL) {
+		function_cache_init();
+	}
+
+	entry = (plcFunctionCacheEntry *) hash_search(plcFunctionCache, &func->funcOid, HASH_ENTER, &found);
+	/* The function is cached already, but its information is outdated */
+	if (found && entry->proc != func) {
+		free_proc_info(entry->proc);
 	}
+	entry->proc = func;
+	entry->valid = true;
 }
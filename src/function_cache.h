@@ -11,9 +11,8 @@
 
 #include "message_fns.h"
 
-#define PLC_FUNCTION_CACHE_SIZE 5
-
-void function_cache_up(int index);
+/* Initial size of the function cache, which grows with the functions called */
+#define PLC_FUNCTION_CACHE_SIZE 128
 
 plcProcInfo *function_cache_get(Oid funcOid);
 
@@ -47,6 +47,7 @@ interpreted as representing official policies, either expressed or implied, of t
 #endif
 
 #include "access/transam.h"
+#include "access/tuptoaster.h"
 #include "catalog/pg_proc.h"
 #include "mb/pg_wchar.h"
 #include "utils/syscache.h"
@@ -60,18 +61,17 @@ interpreted as representing official policies, either expressed or implied, of t
 #include "message_fns.h"
 #include "function_cache.h"
 #include "plc_typeio.h"
+#include "containers.h"
 
 #ifdef PLC_PG
   #include "catalog/pg_type.h"
   #include "access/htup_details.h"
 #endif
 
-static bool plc_procedure_valid(plcProcInfo *proc, HeapTuple procTup);
-
-static bool plc_type_valid(plcTypeInfo *type);
-
 static void fill_callreq_arguments(FunctionCallInfo fcinfo, plcProcInfo *proc, plcMsgCallreq *req);
 
+static int64 sliced_argument_size(Datum arg, plcProcInfo *proc, int argument);
+
 plcProcInfo *plcontainer_procedure_get(FunctionCallInfo fcinfo) {
 	int lenOfArgnames;
 	Datum *argnames = NULL;
@@ -83,154 +83,195 @@ plcProcInfo *plcontainer_procedure_get(FunctionCallInfo fcinfo) {
 		textHeapTup = NULL;
 	Form_pg_type typeTup;
 	plcProcInfo * volatile proc = NULL;
+	char procName[NAMEDATALEN + 256];
+	Form_pg_proc procStruct;
+	bool isnull;
+	int rv;
+	List *binaryTypes;
+	List *sliceNames;
 
 
 	procoid = fcinfo->flinfo->fn_oid;
+
+	/*
+	 * The cached function information is dropped when its catalog rows
+	 * change, so the catalog is read only if it is not cached
+	 */
+	proc = function_cache_get(procoid);
+	if (proc != NULL) {
+		proc->hasChanged = 0;
+		return proc;
+	}
+
 	procHeapTup = SearchSysCache(PROCOID, procoid, 0, 0, 0);
 	if (!HeapTupleIsValid(procHeapTup)) {
 		plc_elog(ERROR, "cannot find proc with oid %u", procoid);
 	}
 
-	proc = function_cache_get(procoid);
+	procStruct = (Form_pg_proc) GETSTRUCT(procHeapTup);
+	rv = snprintf(procName, sizeof(procName), "__plpython_procedure_%s_%u",
+			NameStr(procStruct->proname), procoid/*TODOfn_oid*/);
+	if (rv < 0 || (unsigned int)rv >= sizeof(procName))
+		elog(ERROR, "procedure name would overrun buffer");
+
 	/*
-	 * All the catalog operations are done only if the cached function
-	 * information has changed in the catalog
+	 * Here we are using plc_top_alloc as the function structure should be
+	 * available across the function handler call
+	 *
+	 * Note: we free the procedure from within function_put_cache below
 	 */
-	if (!plc_procedure_valid(proc, procHeapTup)) {
-
-		char procName[NAMEDATALEN + 256];
-		Form_pg_proc procStruct;
-		bool isnull;
-		int rv;
-
-		procStruct = (Form_pg_proc) GETSTRUCT(procHeapTup);
-		rv = snprintf(procName, sizeof(procName), "__plpython_procedure_%s_%u",
-				NameStr(procStruct->proname), procoid/*TODOfn_oid*/);
-		if (rv < 0 || (unsigned int)rv >= sizeof(procName))
-			elog(ERROR, "procedure name would overrun buffer");
-
-		/*
-		 * Here we are using plc_top_alloc as the function structure should be
-		 * available across the function handler call
-		 *
-		 * Note: we free the procedure from within function_put_cache below
-		 */
-		proc = PLy_malloc(sizeof(plcProcInfo));
-		if (proc == NULL) {
-			plc_elog(FATAL, "Cannot allocate memory for plcProcInfo structure");
-		}
+	proc = PLy_malloc(sizeof(plcProcInfo));
+	if (proc == NULL) {
+		plc_elog(FATAL, "Cannot allocate memory for plcProcInfo structure");
+	}
 
-		proc->proname = PLy_strdup(NameStr(procStruct->proname));
-		proc->pyname = PLy_strdup(procName);
-		proc->funcOid = procoid;
-		proc->fn_xmin = HeapTupleHeaderGetXmin(procHeapTup->t_data);
-		proc->fn_tid = procHeapTup->t_self;
-		/* Remember if function is STABLE/IMMUTABLE */
-		proc->fn_readonly = (procStruct->provolatile != PROVOLATILE_VOLATILE);
-
-		proc->retset = fcinfo->flinfo->fn_retset;
-
-		proc->hasChanged = 1;
-
-		HeapTuple rvTypeTup;
-		Form_pg_type rvTypeStruct;
-
-		rvTypeTup = SearchSysCache1(TYPEOID,
-				ObjectIdGetDatum(procStruct->prorettype));
-		if (!HeapTupleIsValid(rvTypeTup))
-			elog(ERROR, "cache lookup failed for type %u",
-					procStruct->prorettype);
-		rvTypeStruct = (Form_pg_type) GETSTRUCT(rvTypeTup);
-
-		/* Disallow pseudotype result, except for void or record */
-		if (rvTypeStruct->typtype == TYPTYPE_PSEUDO) {
-			if (procStruct->prorettype == TRIGGEROID)
-				ereport(ERROR,
-						(errcode(ERRCODE_FEATURE_NOT_SUPPORTED), errmsg(
-								"trigger functions can only be called as triggers")));
-			else if (procStruct->prorettype != VOIDOID
-					&& procStruct->prorettype != RECORDOID)
-				ereport(ERROR,
-						(errcode(ERRCODE_FEATURE_NOT_SUPPORTED), errmsg(
-								"PLContainer functions cannot return type %s",
-								format_type_be(procStruct->prorettype))));
-		}
-		ReleaseSysCache(rvTypeTup);
-		procStruct = (Form_pg_proc) GETSTRUCT(procHeapTup);
+	proc->proname = PLy_strdup(NameStr(procStruct->proname));
+	proc->pyname = PLy_strdup(procName);
+	proc->funcOid = procoid;
+	proc->fn_xmin = HeapTupleHeaderGetXmin(procHeapTup->t_data);
+	proc->fn_tid = procHeapTup->t_self;
+#if PG_VERSION_NUM >= 90200
+	proc->fn_hashvalue = GetSysCacheHashValue1(PROCOID, ObjectIdGetDatum(procoid));
+#endif
+	/* Remember if function is STABLE/IMMUTABLE */
+	proc->fn_readonly = (procStruct->provolatile != PROVOLATILE_VOLATILE);
+
+	proc->retset = fcinfo->flinfo->fn_retset;
+
+	proc->hasChanged = 1;
+
+	HeapTuple rvTypeTup;
+	Form_pg_type rvTypeStruct;
+
+	rvTypeTup = SearchSysCache1(TYPEOID,
+			ObjectIdGetDatum(procStruct->prorettype));
+	if (!HeapTupleIsValid(rvTypeTup))
+		elog(ERROR, "cache lookup failed for type %u",
+				procStruct->prorettype);
+	rvTypeStruct = (Form_pg_type) GETSTRUCT(rvTypeTup);
+
+	/* Disallow pseudotype result, except for void or record */
+	if (rvTypeStruct->typtype == TYPTYPE_PSEUDO) {
+		if (procStruct->prorettype == TRIGGEROID)
+			ereport(ERROR,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED), errmsg(
+							"trigger functions can only be called as triggers")));
+		else if (procStruct->prorettype != VOIDOID
+				&& procStruct->prorettype != RECORDOID)
+			ereport(ERROR,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED), errmsg(
+							"PLContainer functions cannot return type %s",
+							format_type_be(procStruct->prorettype))));
+	}
+	ReleaseSysCache(rvTypeTup);
+	procStruct = (Form_pg_proc) GETSTRUCT(procHeapTup);
 
-		fill_type_info(fcinfo, procStruct->prorettype, &proc->result);
+	fill_type_info(fcinfo, procStruct->prorettype, &proc->result);
 
-		proc->nargs = procStruct->pronargs;
-		if (proc->nargs > 0) {
-			// This is required to avoid the cycle from being removed by optimizer
-			int volatile j;
+	proc->nargs = procStruct->pronargs;
+	if (proc->nargs > 0) {
+		// This is required to avoid the cycle from being removed by optimizer
+		int volatile j;
 
-			proc->args = PLy_malloc(proc->nargs * sizeof(plcTypeInfo));
-			for (j = 0; j < proc->nargs; j++) {
-				fill_type_info(fcinfo, procStruct->proargtypes.values[j], &proc->args[j]);
-			}
+		proc->args = PLy_malloc(proc->nargs * sizeof(plcTypeInfo));
+		for (j = 0; j < proc->nargs; j++) {
+			fill_type_info(fcinfo, procStruct->proargtypes.values[j], &proc->args[j]);
+		}
 
-			argnamesArray = SysCacheGetAttr(PROCOID, procHeapTup,
-			                                Anum_pg_proc_proargnames, &isnull);
-			/* If at least some arguments have names */
-			if (!isnull) {
-				textHeapTup = SearchSysCache(TYPEOID, ObjectIdGetDatum(TEXTOID), 0, 0, 0);
-				if (!HeapTupleIsValid(textHeapTup)) {
-					plc_elog(FATAL, "cannot find text type in cache");
-				}
-				typeTup = (Form_pg_type) GETSTRUCT(textHeapTup);
-				deconstruct_array(DatumGetArrayTypeP(argnamesArray), TEXTOID,
-				                  typeTup->typlen, typeTup->typbyval, typeTup->typalign,
-				                  &argnames, &argnulls, &lenOfArgnames);
-				/* UDF may contain OUT parameter, which is not considered as 
-				 * arguement number. So the length of argname list(container both INPUT and OUTPUT) 
-				 * maybe smaller than arguement number. There is no need to pass OUTPUT name to container.
-				 */
-				if (lenOfArgnames < proc->nargs) {
-					plc_elog(ERROR, "Length of argname list(%d) should be equal to or larger than \
-							number of args(%d)", lenOfArgnames, proc->nargs);
-				}
+		argnamesArray = SysCacheGetAttr(PROCOID, procHeapTup,
+		                                Anum_pg_proc_proargnames, &isnull);
+		/* If at least some arguments have names */
+		if (!isnull) {
+			textHeapTup = SearchSysCache(TYPEOID, ObjectIdGetDatum(TEXTOID), 0, 0, 0);
+			if (!HeapTupleIsValid(textHeapTup)) {
+				plc_elog(FATAL, "cannot find text type in cache");
 			}
+			typeTup = (Form_pg_type) GETSTRUCT(textHeapTup);
+			deconstruct_array(DatumGetArrayTypeP(argnamesArray), TEXTOID,
+			                  typeTup->typlen, typeTup->typbyval, typeTup->typalign,
+			                  &argnames, &argnulls, &lenOfArgnames);
+			/* UDF may contain OUT parameter, which is not considered as 
+			 * arguement number. So the length of argname list(container both INPUT and OUTPUT) 
+			 * maybe smaller than arguement number. There is no need to pass OUTPUT name to container.
+			 */
+			if (lenOfArgnames < proc->nargs) {
+				plc_elog(ERROR, "Length of argname list(%d) should be equal to or larger than \
+						number of args(%d)", lenOfArgnames, proc->nargs);
+			}
+		}
 
-			proc->argnames = PLy_malloc(proc->nargs * sizeof(char *));
-			for (j = 0; j < proc->nargs; j++) {
-				if (!isnull && !argnulls[j]) {
-					proc->argnames[j] =
-						plc_top_strdup(DatumGetCString(
-							DirectFunctionCall1(textout, argnames[j])
-						));
-					if (strlen(proc->argnames[j]) == 0) {
-						pfree(proc->argnames[j]);
-						proc->argnames[j] = NULL;
-					}
-				} else {
+		proc->argnames = PLy_malloc(proc->nargs * sizeof(char *));
+		for (j = 0; j < proc->nargs; j++) {
+			if (!isnull && !argnulls[j]) {
+				proc->argnames[j] =
+					plc_top_strdup(DatumGetCString(
+						DirectFunctionCall1(textout, argnames[j])
+					));
+				if (strlen(proc->argnames[j]) == 0) {
+					pfree(proc->argnames[j]);
 					proc->argnames[j] = NULL;
 				}
+			} else {
+				proc->argnames[j] = NULL;
 			}
-
-			if (textHeapTup != NULL) {
-				ReleaseSysCache(textHeapTup);
-			}
-		} else {
-			proc->args = NULL;
-			proc->argnames = NULL;
 		}
 
-		/* Get the text and name of the function */
-		srcdatum = SysCacheGetAttr(PROCOID, procHeapTup, Anum_pg_proc_prosrc, &isnull);
-		if (isnull)
-			plc_elog(ERROR, "null prosrc");
-		proc->src = plc_top_strdup(DatumGetCString(DirectFunctionCall1(textout, srcdatum)));
-		namedatum = SysCacheGetAttr(PROCOID, procHeapTup, Anum_pg_proc_proname, &isnull);
-		if (isnull)
-			plc_elog(ERROR, "null proname");
-		proc->name = plc_top_strdup(DatumGetCString(DirectFunctionCall1(nameout, namedatum)));
-
-		/* Cache the function for later use */
-		function_cache_put(proc);
+		if (textHeapTup != NULL) {
+			ReleaseSysCache(textHeapTup);
+		}
 	} else {
-		proc->hasChanged = 0;
+		proc->args = NULL;
+		proc->argnames = NULL;
+	}
+
+	/* Get the text and name of the function */
+	srcdatum = SysCacheGetAttr(PROCOID, procHeapTup, Anum_pg_proc_prosrc, &isnull);
+	if (isnull)
+		plc_elog(ERROR, "null prosrc");
+	proc->src = plc_top_strdup(DatumGetCString(DirectFunctionCall1(textout, srcdatum)));
+	namedatum = SysCacheGetAttr(PROCOID, procHeapTup, Anum_pg_proc_proname, &isnull);
+	if (isnull)
+		plc_elog(ERROR, "null proname");
+	proc->name = plc_top_strdup(DatumGetCString(DirectFunctionCall1(nameout, namedatum)));
+	proc->batchSize = parse_batch_meta(proc->src);
+	binaryTypes = parse_binary_meta(proc->src);
+	if (binaryTypes != NIL) {
+		int i;
+
+		plc_type_use_binary(&proc->result, binaryTypes);
+		for (i = 0; i < proc->nargs; i++) {
+			plc_type_use_binary(&proc->args[i], binaryTypes);
+		}
+		list_free_deep(binaryTypes);
+	}
+	proc->sliced = NULL;
+	sliceNames = parse_slice_meta(proc->src);
+	if (sliceNames != NIL) {
+		ListCell *lc;
+
+		if (proc->batchSize > 0)
+			plc_elog(ERROR, "Function with '# batch' declaration cannot read its arguments in slices");
+		proc->sliced = PLy_malloc(proc->nargs * sizeof(bool));
+		memset(proc->sliced, 0, proc->nargs * sizeof(bool));
+		foreach(lc, sliceNames) {
+			char *name = (char *) lfirst(lc);
+			int i;
+
+			for (i = 0; i < proc->nargs; i++) {
+				if (proc->argnames[i] != NULL && strcmp(proc->argnames[i], name) == 0)
+					break;
+			}
+			if (i == proc->nargs)
+				plc_elog(ERROR, "Slice declaration names '%s', which is not an argument of the function", name);
+			if (proc->args[i].typeOid != TEXTOID && proc->args[i].typeOid != BYTEAOID)
+				plc_elog(ERROR, "Argument '%s' of the slice declaration is not of type text or bytea", name);
+			proc->sliced[i] = true;
+		}
+		list_free_deep(sliceNames);
 	}
+
+	/* Cache the function for later use */
+	function_cache_put(proc);
 	ReleaseSysCache(procHeapTup);
 	return proc;
 }
@@ -247,6 +288,9 @@ void free_proc_info(plcProcInfo *proc) {
 		pfree(proc->argnames);
 		pfree(proc->args);
 	}
+	if (proc->sliced != NULL)
+		pfree(proc->sliced);
+	free_type_info(&proc->result);
 	pfree(proc);
 }
 
@@ -255,11 +299,17 @@ plcMsgCallreq *plcontainer_generate_call_request(FunctionCallInfo fcinfo, plcPro
 
 	req = pmalloc(sizeof(plcMsgCallreq));
 	req->msgtype = MT_CALLREQ;
+	req->frame = NULL;
+	req->mappings = NULL;
+	req->nsliced = 0;
+	req->sliced = NULL;
 	req->proc.name = proc->name;
 	req->proc.src = proc->src;
 	req->logLevel = log_min_messages;
+	req->clientMinMessages = client_min_messages;
 	req->objectid = proc->funcOid;
 	req->hasChanged = proc->hasChanged;
+	req->version = proc->fn_xmin;
 	/*
 	 * Python understands almost all PostgreSQL encoding names, but it doesn't
 	 * know SQL_ASCII.
@@ -272,71 +322,82 @@ plcMsgCallreq *plcontainer_generate_call_request(FunctionCallInfo fcinfo, plcPro
 	copy_type_info(&req->retType, &proc->result);
 
 	fill_callreq_arguments(fcinfo, proc, req);
+	req->nrows = 0;
+	req->rows = NULL;
 
 	return req;
 }
 
-static bool plc_type_valid(plcTypeInfo *type) {
-	bool valid = true;
-	int i;
+/*
+ * Batched functions take arrays and return an array, the client sees them
+ * as scalar functions over the array elements and is called once per row.
+ * Here we build the request for rows [start, start + nrows) of the
+ * deconstructed array arguments.
+ */
+plcMsgCallreq *plcontainer_generate_batch_request(plcProcInfo *proc, Datum **values,
+                                                  bool **nulls, int start, int nrows) {
+	plcMsgCallreq *req;
+	int i, j;
+
+	req = pmalloc(sizeof(plcMsgCallreq));
+	req->msgtype = MT_CALLREQ_BATCH;
+	req->frame = NULL;
+	req->mappings = NULL;
+	req->nsliced = 0;
+	req->sliced = NULL;
+	req->proc.name = proc->name;
+	req->proc.src = proc->src;
+	req->logLevel = log_min_messages;
+	req->clientMinMessages = client_min_messages;
+	req->objectid = proc->funcOid;
+	req->hasChanged = proc->hasChanged;
+	req->version = proc->fn_xmin;
+	if (GetDatabaseEncoding() == PG_SQL_ASCII)
+		req->serverenc = (char*)"ascii";
+	else
+		req->serverenc = (char*)GetDatabaseEncodingName();
+	copy_type_info(&req->retType, &proc->result.subTypes[0]);
 
-	for (i = 0; i < type->nSubTypes && valid; i++) {
-		valid = plc_type_valid(&type->subTypes[i]);
+	req->nargs = proc->nargs;
+	req->retset = 0;
+	req->args = pmalloc(sizeof(*req->args) * proc->nargs);
+	for (j = 0; j < proc->nargs; j++) {
+		req->args[j].name = proc->argnames[j];
+		copy_type_info(&req->args[j].type, &proc->args[j].subTypes[0]);
+		req->args[j].data.isnull = 1;
+		req->args[j].data.value = NULL;
 	}
 
-	/* We exclude record from testing here, as it would change only if the function
-	 * changes itself, which would be caugth by checking function creation xid */
-	if (valid && type->is_rowtype && !type->is_record) {
-		HeapTuple relTup;
-
-		Assert(OidIsValid(type->typ_relid));
-		Assert(TransactionIdIsValid(type->typrel_xmin));
-		Assert(ItemPointerIsValid(&type->typrel_tid));
-
-		// Get the pg_class tuple for the argument type
-		relTup = SearchSysCache1(RELOID, ObjectIdGetDatum(type->typ_relid));
-		if (!HeapTupleIsValid(relTup))
-			plc_elog(ERROR, "PL/Container cache lookup failed for relation %u", type->typ_relid);
-
-		// If commit transaction ID has changed or relation was moved within table
-		// our type information is no longer valid
-		if (type->typrel_xmin != HeapTupleHeaderGetXmin(relTup->t_data) ||
-		    !ItemPointerEquals(&type->typrel_tid, &relTup->t_self)) {
-			valid = false;
+	req->nrows = nrows;
+	req->rows = pmalloc(nrows * sizeof(rawdata *));
+	for (i = 0; i < nrows; i++) {
+		req->rows[i] = pmalloc((proc->nargs > 0 ? proc->nargs : 1) * sizeof(rawdata));
+		for (j = 0; j < proc->nargs; j++) {
+			plcTypeInfo *elemType = &proc->args[j].subTypes[0];
+
+			if (nulls[j][start + i]) {
+				req->rows[i][j].isnull = 1;
+				req->rows[i][j].value = NULL;
+			} else {
+				req->rows[i][j].isnull = 0;
+				req->rows[i][j].value = elemType->outfunc(values[j][start + i], elemType);
+			}
 		}
-
-		ReleaseSysCache(relTup);
 	}
 
-	return valid;
+	return req;
 }
 
 /*
- * Decide whether a cached PLyProcedure struct is still valid
+ * The size of an argument the client reads in slices instead of getting it
+ * with the call, or -1. These are the text and bytea arguments named in the
+ * '# slice:' declaration of the function, whatever their size, so that the
+ * function always gets them the same way.
  */
-static bool plc_procedure_valid(plcProcInfo *proc, HeapTuple procTup) {
-	bool valid = false;
-
-	if (proc != NULL) {
-		/* If the pg_proc tuple has changed, it's not valid */
-		if (proc->fn_xmin == HeapTupleHeaderGetXmin(procTup->t_data) &&
-		    ItemPointerEquals(&proc->fn_tid, &procTup->t_self)) {
-			int i;
-
-			valid = true;
-
-			// If there are composite input arguments, they might have changed
-			for (i = 0; i < proc->nargs && valid; i++) {
-				valid = plc_type_valid(&proc->args[i]);
-			}
-
-			// Also check for composite output type
-			if (valid) {
-				valid = plc_type_valid(&proc->result);
-			}
-		}
-	}
-	return valid;
+static int64 sliced_argument_size(Datum arg, plcProcInfo *proc, int argument) {
+	if (proc->sliced == NULL || !proc->sliced[argument])
+		return -1;
+	return (int64) toast_raw_datum_size(arg) - VARHDRSZ;
 }
 
 static void fill_callreq_arguments(FunctionCallInfo fcinfo, plcProcInfo *proc, plcMsgCallreq *req) {
@@ -347,12 +408,28 @@ static void fill_callreq_arguments(FunctionCallInfo fcinfo, plcProcInfo *proc, p
 	req->args = pmalloc(sizeof(*req->args) * proc->nargs);
 
 	for (i = 0; i < proc->nargs; i++) {
+		int64 size;
+
 		req->args[i].name = proc->argnames[i];
 		copy_type_info(&req->args[i].type, &proc->args[i]);
 
 		if (fcinfo->argnull[i]) {
 			req->args[i].data.isnull = 1;
 			req->args[i].data.value = NULL;
+		} else if ((size = sliced_argument_size(fcinfo->arg[i], proc, i)) >= 0) {
+			/*
+			 * Sent as NULL, the client reads the slices it needs while the
+			 * function runs, see plcontainer_process_slice_request()
+			 */
+			if (req->sliced == NULL)
+				req->sliced = pmalloc(proc->nargs * sizeof(plcSlicedArg));
+			req->sliced[req->nsliced].argument = i;
+			req->sliced[req->nsliced].size = size;
+			req->sliced[req->nsliced].source = DatumGetPointer(fcinfo->arg[i]);
+			req->sliced[req->nsliced].detoasted = false;
+			req->nsliced += 1;
+			req->args[i].data.isnull = 1;
+			req->args[i].data.value = NULL;
 		} else {
 			req->args[i].data.isnull = 0;
 			req->args[i].data.value = proc->args[i].outfunc(fcinfo->arg[i], &proc->args[i]);
@@ -30,6 +30,7 @@ interpreted as representing official policies, either expressed or implied, of t
 #include "postgres.h"
 #include "fmgr.h"
 
+#include "common/comm_connectivity.h"
 #include "common/messages/messages.h"
 #include "plc_typeio.h"
 
@@ -37,6 +38,8 @@ interpreted as representing official policies, either expressed or implied, of t
 typedef struct {
 	plcMsgResult *resmsg;
 	uint32 resrow;
+	plcConn *conn;           /* connection streaming further chunks, NULL once complete */
+	int32 stream;            /* id of the streamed result set on the client */
 } plcProcResult;
 
 typedef struct {
@@ -45,6 +48,9 @@ typedef struct {
 	char	   *pyname;		 	 /* Python name of procedure */
 	TransactionId fn_xmin;   /* Transaction ID that created this function in catalog */
 	ItemPointerData fn_tid;  /* ItemPointer for the function row in catalog */
+#if PG_VERSION_NUM >= 90200
+	uint32 fn_hashvalue;     /* syscache hash value of the function row, to match invalidations */
+#endif
 	bool fn_readonly;
 	plcTypeInfo result;
 
@@ -58,6 +64,8 @@ typedef struct {
 	int hasChanged;          /* Whether the function has changed since last call */
 	int retset;
 	Oid funcOid;
+	int batchSize;           /* Rows per batched call, 0 if not batched */
+	bool *sliced;            /* Arguments read in slices, NULL if none */
 
 } plcProcInfo;
 
@@ -67,4 +75,7 @@ void free_proc_info(plcProcInfo *proc);
 
 plcMsgCallreq *plcontainer_generate_call_request(FunctionCallInfo fcinfo, plcProcInfo *pinfo);
 
+plcMsgCallreq *plcontainer_generate_batch_request(plcProcInfo *proc, Datum **values,
+                                                  bool **nulls, int start, int nrows);
+
 #endif /* PLC_MESSAGE_FNS_H */
@@ -177,6 +177,10 @@ static void parse_runtime_configuration(xmlNode *node) {
 		conf_entry->resgroupOid = InvalidOid;
 		conf_entry->useUserControl = false;
 		conf_entry->roles = NULL;
+		conf_entry->compressThreshold = 0;
+		conf_entry->useSharedMemory = false;
+		conf_entry->sharedMemorySpinUs = 0;
+		conf_entry->fdPassingThreshold = 0;
 
 
 		for (cur_node = node->children; cur_node; cur_node = cur_node->next) {
@@ -279,6 +283,63 @@ static void parse_runtime_configuration(xmlNode *node) {
 						value = NULL;
 					}
 
+					value = xmlGetProp(cur_node, (const xmlChar *) "compression_threshold");
+					if (value != NULL) {
+						long compressThreshold = pg_atoi((char *) value, sizeof(int), 0);
+						validSetting = true;
+
+						if (compressThreshold < 0) {
+							plc_elog(ERROR, "compression threshold couldn't be less than 0, current string is %s", value);
+						} else {
+							conf_entry->compressThreshold = compressThreshold;
+						}
+						xmlFree((void *) value);
+						value = NULL;
+					}
+
+					value = xmlGetProp(cur_node, (const xmlChar *) "use_shared_memory");
+					if (value != NULL) {
+						validSetting = true;
+						if (strcasecmp((char *) value, "yes") == 0) {
+							conf_entry->useSharedMemory = true;
+						} else if (strcasecmp((char *) value, "no") == 0) {
+							conf_entry->useSharedMemory = false;
+						} else {
+							plc_elog(ERROR, "SETTING element <use_shared_memory> only accepted \"yes\" or"
+								"\"no\" only, current string is %s", value);
+						}
+						xmlFree((void *) value);
+						value = NULL;
+					}
+
+					value = xmlGetProp(cur_node, (const xmlChar *) "shared_memory_spin_us");
+					if (value != NULL) {
+						long spinUs = pg_atoi((char *) value, sizeof(int), 0);
+						validSetting = true;
+
+						if (spinUs < 0) {
+							plc_elog(ERROR, "shared memory spin time couldn't be less than 0, current string is %s", value);
+						} else {
+							conf_entry->sharedMemorySpinUs = spinUs;
+						}
+						xmlFree((void *) value);
+						value = NULL;
+					}
+
+					value = xmlGetProp(cur_node, (const xmlChar *) "fd_passing_threshold");
+					if (value != NULL) {
+						long fdPassingThreshold = pg_atoi((char *) value, sizeof(int), 0);
+						validSetting = true;
+
+						if (fdPassingThreshold < 0) {
+							plc_elog(ERROR, "fd passing threshold couldn't be less than 0, current string is %s", value);
+						} else {
+							conf_entry->fdPassingThreshold = fdPassingThreshold;
+						}
+						xmlFree((void *) value);
+						value = NULL;
+					}
+
 					value = xmlGetProp(cur_node, (const xmlChar *) "roles");
 					if (value != NULL) {
 						validSetting = true;
@@ -459,6 +520,12 @@ static void print_runtime_configurations() {
 			plc_elog(INFO, "    memory_mb = '%d'", conf_entry->memoryMb);
 			plc_elog(INFO, "    cpu_share = '%d'", conf_entry->cpuShare);
 			plc_elog(INFO, "    use container logging  = '%s'", conf_entry->useContainerLogging ? "yes" : "no");
+			if (conf_entry->compressThreshold > 0)
+				plc_elog(INFO, "    compression threshold = '%d'", conf_entry->compressThreshold);
+			if (conf_entry->useSharedMemory)
+				plc_elog(INFO, "    use shared memory = 'yes', spin = '%d' us", conf_entry->sharedMemorySpinUs);
+			if (conf_entry->fdPassingThreshold > 0)
+				plc_elog(INFO, "    fd passing threshold = '%d'", conf_entry->fdPassingThreshold);
 			if (conf_entry->useUserControl){
 				plc_elog(INFO, "    allowed roles list  = '%s'", conf_entry->roles);
 			}
@@ -54,6 +54,10 @@ typedef struct runtimeConfEntry {
 	bool useContainerNetwork;
 	bool useContainerLogging;
 	bool useUserControl;
+	int compressThreshold; /* compress blocks of at least this size, 0 - off */
+	bool useSharedMemory;   /* exchange data through rings in the shared dir */
+	int sharedMemorySpinUs; /* busy wait on a ring before sleeping */
+	int fdPassingThreshold; /* pass values of at least this size as files, 0 - off */
 } runtimeConfEntry;
 
 /* entrypoint for all plcontainer procedures */
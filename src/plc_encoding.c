@@ -0,0 +1,294 @@
+/*------------------------------------------------------------------------------
+ *
+ *
+ * Copyright (c) 2016-Present Pivotal Software, Inc
+ *
+ *------------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+#include "mb/pg_wchar.h"
+
+/*
+ * Compilers that can build a function for AVX2 without the whole file built
+ * for it get a vectorized check of UTF-8, used when the CPU has AVX2
+ */
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(__clang__) \
+    && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define PLC_UTF8_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "plc_encoding.h"
+
+/*
+ * Number of ASCII bytes at the start of s. The bytes are checked a vector at
+ * a time where the build targets SSE2, as any x86-64 one does, and a word at
+ * a time otherwise.
+ */
+static int plc_ascii_run(const unsigned char *s, int len) {
+	int i = 0;
+
+#if defined(__SSE2__)
+	for (; i + 16 <= len; i += 16) {
+		int mask = _mm_movemask_epi8(_mm_loadu_si128((const __m128i *) (s + i)));
+
+		if (mask != 0)
+			return i + __builtin_ctz(mask);
+	}
+#else
+	for (; i + 8 <= len; i += 8) {
+		uint64 word;
+
+		memcpy(&word, s + i, sizeof(word));
+		if ((word & UINT64CONST(0x8080808080808080)) != 0)
+			break;
+	}
+#endif
+	while (i < len && s[i] < 0x80)
+		i++;
+	return i;
+}
+
+/*
+ * Length of the multibyte sequence at s of at most len bytes, 0 if it is not
+ * valid UTF-8. The range of the second byte rules out the overlong forms, the
+ * surrogates and the code points beyond U+10FFFF.
+ */
+static int plc_utf8_sequence(const unsigned char *s, int len) {
+	unsigned char lo = 0x80;
+	unsigned char hi = 0xBF;
+	int n;
+
+	if (s[0] >= 0xC2 && s[0] <= 0xDF) {
+		n = 2;
+	} else if (s[0] >= 0xE0 && s[0] <= 0xEF) {
+		n = 3;
+		if (s[0] == 0xE0)
+			lo = 0xA0;
+		else if (s[0] == 0xED)
+			hi = 0x9F;
+	} else if (s[0] >= 0xF0 && s[0] <= 0xF4) {
+		n = 4;
+		if (s[0] == 0xF0)
+			lo = 0x90;
+		else if (s[0] == 0xF4)
+			hi = 0x8F;
+	} else {
+		return 0;
+	}
+
+	if (len < n || s[1] < lo || s[1] > hi)
+		return 0;
+	if (n >= 3 && (s[2] & 0xC0) != 0x80)
+		return 0;
+	if (n == 4 && (s[3] & 0xC0) != 0x80)
+		return 0;
+	return n;
+}
+
+#ifdef PLC_UTF8_AVX2
+/* Error bits of a pair of bytes, set in all three lookups when it is invalid */
+#define PLC_UTF8_TOO_SHORT   0x01   /* lead byte or ASCII followed by lead byte or ASCII */
+#define PLC_UTF8_TOO_LONG    0x02   /* ASCII followed by continuation */
+#define PLC_UTF8_OVERLONG_3  0x04   /* 11100000 100_____ */
+#define PLC_UTF8_TOO_LARGE   0x08   /* 11110100 1001____ and above */
+#define PLC_UTF8_SURROGATE   0x10   /* 11101101 101_____ */
+#define PLC_UTF8_OVERLONG_2  0x20   /* 1100000_ 10______ */
+#define PLC_UTF8_TOO_LARGE_1000 0x40   /* 11110101 1000____ and above */
+#define PLC_UTF8_OVERLONG_4  0x40   /* 11110000 1000____ */
+#define PLC_UTF8_TWO_CONTS   0x80   /* continuation followed by continuation */
+#define PLC_UTF8_CARRY (PLC_UTF8_TOO_SHORT | PLC_UTF8_TOO_LONG | PLC_UTF8_TWO_CONTS)
+
+/* The bytes of the block shifted by n, with the last bytes of the previous block in front */
+#define plc_utf8_prev(in, prev, n) \
+	_mm256_alignr_epi8((in), _mm256_permute2x128_si256((prev), (in), 0x21), 16 - (n))
+
+/*
+ * Errors of a block of 32 bytes following the block prev, after the lookup
+ * algorithm of Keiser and Lemire: the high and low nibbles of each byte and
+ * the high nibble of the byte after it index three tables of the errors they
+ * may take part in, and a pair is invalid when all three agree on an error.
+ * The third and fourth bytes of the sequences are then matched against the
+ * continuations the lead bytes two and three bytes before them require.
+ */
+__attribute__((target("avx2")))
+static __m256i plc_utf8_block_errors(__m256i in, __m256i prev) {
+	const __m256i byte1High = _mm256_setr_epi8(
+		PLC_UTF8_TOO_LONG, PLC_UTF8_TOO_LONG, PLC_UTF8_TOO_LONG, PLC_UTF8_TOO_LONG,
+		PLC_UTF8_TOO_LONG, PLC_UTF8_TOO_LONG, PLC_UTF8_TOO_LONG, PLC_UTF8_TOO_LONG,
+		(char) PLC_UTF8_TWO_CONTS, (char) PLC_UTF8_TWO_CONTS,
+		(char) PLC_UTF8_TWO_CONTS, (char) PLC_UTF8_TWO_CONTS,
+		PLC_UTF8_TOO_SHORT | PLC_UTF8_OVERLONG_2,
+		PLC_UTF8_TOO_SHORT,
+		PLC_UTF8_TOO_SHORT | PLC_UTF8_OVERLONG_3 | PLC_UTF8_SURROGATE,
+		PLC_UTF8_TOO_SHORT | PLC_UTF8_TOO_LARGE | PLC_UTF8_TOO_LARGE_1000 | PLC_UTF8_OVERLONG_4,
+		PLC_UTF8_TOO_LONG, PLC_UTF8_TOO_LONG, PLC_UTF8_TOO_LONG, PLC_UTF8_TOO_LONG,
+		PLC_UTF8_TOO_LONG, PLC_UTF8_TOO_LONG, PLC_UTF8_TOO_LONG, PLC_UTF8_TOO_LONG,
+		(char) PLC_UTF8_TWO_CONTS, (char) PLC_UTF8_TWO_CONTS,
+		(char) PLC_UTF8_TWO_CONTS, (char) PLC_UTF8_TWO_CONTS,
+		PLC_UTF8_TOO_SHORT | PLC_UTF8_OVERLONG_2,
+		PLC_UTF8_TOO_SHORT,
+		PLC_UTF8_TOO_SHORT | PLC_UTF8_OVERLONG_3 | PLC_UTF8_SURROGATE,
+		PLC_UTF8_TOO_SHORT | PLC_UTF8_TOO_LARGE | PLC_UTF8_TOO_LARGE_1000 | PLC_UTF8_OVERLONG_4);
+	const __m256i byte1Low = _mm256_setr_epi8(
+		(char) (PLC_UTF8_CARRY | PLC_UTF8_OVERLONG_3 | PLC_UTF8_OVERLONG_2 | PLC_UTF8_OVERLONG_4),
+		(char) (PLC_UTF8_CARRY | PLC_UTF8_OVERLONG_2),
+		(char) PLC_UTF8_CARRY, (char) PLC_UTF8_CARRY,
+		(char) (PLC_UTF8_CARRY | PLC_UTF8_TOO_LARGE),
+		(char) (PLC_UTF8_CARRY | PLC_UTF8_TOO_LARGE | PLC_UTF8_TOO_LARGE_1000),
+		(char) (PLC_UTF8_CARRY | PLC_UTF8_TOO_LARGE | PLC_UTF8_TOO_LARGE_1000),
+		(char) (PLC_UTF8_CARRY | PLC_UTF8_TOO_LARGE | PLC_UTF8_TOO_LARGE_1000),
+		(char) (PLC_UTF8_CARRY | PLC_UTF8_TOO_LARGE | PLC_UTF8_TOO_LARGE_1000),
+		(char) (PLC_UTF8_CARRY | PLC_UTF8_TOO_LARGE | PLC_UTF8_TOO_LARGE_1000),
+		(char) (PLC_UTF8_CARRY | PLC_UTF8_TOO_LARGE | PLC_UTF8_TOO_LARGE_1000),
+		(char) (PLC_UTF8_CARRY | PLC_UTF8_TOO_LARGE | PLC_UTF8_TOO_LARGE_1000),
+		(char) (PLC_UTF8_CARRY | PLC_UTF8_TOO_LARGE | PLC_UTF8_TOO_LARGE_1000),
+		(char) (PLC_UTF8_CARRY | PLC_UTF8_TOO_LARGE | PLC_UTF8_TOO_LARGE_1000 | PLC_UTF8_SURROGATE),
+		(char) (PLC_UTF8_CARRY | PLC_UTF8_TOO_LARGE | PLC_UTF8_TOO_LARGE_1000),
+		(char) (PLC_UTF8_CARRY | PLC_UTF8_TOO_LARGE | PLC_UTF8_TOO_LARGE_1000),
+		(char) (PLC_UTF8_CARRY | PLC_UTF8_OVERLONG_3 | PLC_UTF8_OVERLONG_2 | PLC_UTF8_OVERLONG_4),
+		(char) (PLC_UTF8_CARRY | PLC_UTF8_OVERLONG_2),
+		(char) PLC_UTF8_CARRY, (char) PLC_UTF8_CARRY,
+		(char) (PLC_UTF8_CARRY | PLC_UTF8_TOO_LARGE),
+		(char) (PLC_UTF8_CARRY | PLC_UTF8_TOO_LARGE | PLC_UTF8_TOO_LARGE_1000),
+		(char) (PLC_UTF8_CARRY | PLC_UTF8_TOO_LARGE | PLC_UTF8_TOO_LARGE_1000),
+		(char) (PLC_UTF8_CARRY | PLC_UTF8_TOO_LARGE | PLC_UTF8_TOO_LARGE_1000),
+		(char) (PLC_UTF8_CARRY | PLC_UTF8_TOO_LARGE | PLC_UTF8_TOO_LARGE_1000),
+		(char) (PLC_UTF8_CARRY | PLC_UTF8_TOO_LARGE | PLC_UTF8_TOO_LARGE_1000),
+		(char) (PLC_UTF8_CARRY | PLC_UTF8_TOO_LARGE | PLC_UTF8_TOO_LARGE_1000),
+		(char) (PLC_UTF8_CARRY | PLC_UTF8_TOO_LARGE | PLC_UTF8_TOO_LARGE_1000),
+		(char) (PLC_UTF8_CARRY | PLC_UTF8_TOO_LARGE | PLC_UTF8_TOO_LARGE_1000),
+		(char) (PLC_UTF8_CARRY | PLC_UTF8_TOO_LARGE | PLC_UTF8_TOO_LARGE_1000 | PLC_UTF8_SURROGATE),
+		(char) (PLC_UTF8_CARRY | PLC_UTF8_TOO_LARGE | PLC_UTF8_TOO_LARGE_1000),
+		(char) (PLC_UTF8_CARRY | PLC_UTF8_TOO_LARGE | PLC_UTF8_TOO_LARGE_1000));
+	const __m256i byte2High = _mm256_setr_epi8(
+		PLC_UTF8_TOO_SHORT, PLC_UTF8_TOO_SHORT, PLC_UTF8_TOO_SHORT, PLC_UTF8_TOO_SHORT,
+		PLC_UTF8_TOO_SHORT, PLC_UTF8_TOO_SHORT, PLC_UTF8_TOO_SHORT, PLC_UTF8_TOO_SHORT,
+		(char) (PLC_UTF8_TOO_LONG | PLC_UTF8_OVERLONG_2 | PLC_UTF8_TWO_CONTS
+		        | PLC_UTF8_OVERLONG_3 | PLC_UTF8_TOO_LARGE_1000 | PLC_UTF8_OVERLONG_4),
+		(char) (PLC_UTF8_TOO_LONG | PLC_UTF8_OVERLONG_2 | PLC_UTF8_TWO_CONTS
+		        | PLC_UTF8_OVERLONG_3 | PLC_UTF8_TOO_LARGE),
+		(char) (PLC_UTF8_TOO_LONG | PLC_UTF8_OVERLONG_2 | PLC_UTF8_TWO_CONTS
+		        | PLC_UTF8_SURROGATE | PLC_UTF8_TOO_LARGE),
+		(char) (PLC_UTF8_TOO_LONG | PLC_UTF8_OVERLONG_2 | PLC_UTF8_TWO_CONTS
+		        | PLC_UTF8_SURROGATE | PLC_UTF8_TOO_LARGE),
+		PLC_UTF8_TOO_SHORT, PLC_UTF8_TOO_SHORT, PLC_UTF8_TOO_SHORT, PLC_UTF8_TOO_SHORT,
+		PLC_UTF8_TOO_SHORT, PLC_UTF8_TOO_SHORT, PLC_UTF8_TOO_SHORT, PLC_UTF8_TOO_SHORT,
+		PLC_UTF8_TOO_SHORT, PLC_UTF8_TOO_SHORT, PLC_UTF8_TOO_SHORT, PLC_UTF8_TOO_SHORT,
+		(char) (PLC_UTF8_TOO_LONG | PLC_UTF8_OVERLONG_2 | PLC_UTF8_TWO_CONTS
+		        | PLC_UTF8_OVERLONG_3 | PLC_UTF8_TOO_LARGE_1000 | PLC_UTF8_OVERLONG_4),
+		(char) (PLC_UTF8_TOO_LONG | PLC_UTF8_OVERLONG_2 | PLC_UTF8_TWO_CONTS
+		        | PLC_UTF8_OVERLONG_3 | PLC_UTF8_TOO_LARGE),
+		(char) (PLC_UTF8_TOO_LONG | PLC_UTF8_OVERLONG_2 | PLC_UTF8_TWO_CONTS
+		        | PLC_UTF8_SURROGATE | PLC_UTF8_TOO_LARGE),
+		(char) (PLC_UTF8_TOO_LONG | PLC_UTF8_OVERLONG_2 | PLC_UTF8_TWO_CONTS
+		        | PLC_UTF8_SURROGATE | PLC_UTF8_TOO_LARGE),
+		PLC_UTF8_TOO_SHORT, PLC_UTF8_TOO_SHORT, PLC_UTF8_TOO_SHORT, PLC_UTF8_TOO_SHORT);
+	const __m256i nibble = _mm256_set1_epi8(0x0F);
+	__m256i prev1 = plc_utf8_prev(in, prev, 1);
+	__m256i special;
+	__m256i third;
+	__m256i fourth;
+
+	special = _mm256_and_si256(
+		_mm256_and_si256(
+			_mm256_shuffle_epi8(byte1High, _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble)),
+			_mm256_shuffle_epi8(byte1Low, _mm256_and_si256(prev1, nibble))),
+		_mm256_shuffle_epi8(byte2High, _mm256_and_si256(_mm256_srli_epi16(in, 4), nibble)));
+
+	/* Only the bytes after 111_____ and 1111____ get their top bit set */
+	third = _mm256_subs_epu8(plc_utf8_prev(in, prev, 2), _mm256_set1_epi8(0xE0 - 0x80));
+	fourth = _mm256_subs_epu8(plc_utf8_prev(in, prev, 3), _mm256_set1_epi8(0xF0 - 0x80));
+	return _mm256_xor_si256(_mm256_and_si256(_mm256_or_si256(third, fourth), _mm256_set1_epi8((char) 0x80)),
+	                        special);
+}
+
+__attribute__((target("avx2")))
+static bool plc_utf8_valid_avx2(const unsigned char *s, int len) {
+	/* Bytes of the last positions which start a sequence longer than the rest */
+	const __m256i lastMax = _mm256_setr_epi8(
+		-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+		-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+		(char) (0xF0 - 1), (char) (0xE0 - 1), (char) (0xC0 - 1));
+	__m256i prev = _mm256_setzero_si256();
+	__m256i incomplete = _mm256_setzero_si256();
+	__m256i error = _mm256_setzero_si256();
+	unsigned char tail[32];
+	__m256i in;
+	int i;
+
+	for (i = 0; i < len; i += 32) {
+		if (i + 32 <= len) {
+			in = _mm256_loadu_si256((const __m256i *) (s + i));
+		} else {
+			/* The zero bytes after the end catch a truncated last sequence */
+			memset(tail, 0, sizeof(tail));
+			memcpy(tail, s + i, len - i);
+			in = _mm256_loadu_si256((const __m256i *) tail);
+		}
+
+		if (_mm256_movemask_epi8(in) == 0) {
+			/* ASCII only, nothing may be left to continue */
+			error = _mm256_or_si256(error, incomplete);
+		} else {
+			error = _mm256_or_si256(error, plc_utf8_block_errors(in, prev));
+			incomplete = _mm256_subs_epu8(in, lastMax);
+		}
+		prev = in;
+	}
+	error = _mm256_or_si256(error, incomplete);
+
+	return _mm256_testz_si256(error, error) != 0;
+}
+
+static bool plc_cpu_avx2(void) {
+	static int avx2 = -1;
+
+	if (avx2 < 0)
+		avx2 = __builtin_cpu_supports("avx2") ? 1 : 0;
+	return avx2 == 1;
+}
+#endif
+
+bool plc_utf8_valid(const char *s, int len) {
+	const unsigned char *p = (const unsigned char *) s;
+	int i = 0;
+	int n;
+
+#ifdef PLC_UTF8_AVX2
+	if (len >= 32 && plc_cpu_avx2())
+		return plc_utf8_valid_avx2(p, len);
+#endif
+
+	while (i < len) {
+		i += plc_ascii_run(p + i, len - i);
+		/* Multibyte characters mostly come in runs, which are checked one by one */
+		while (i < len && p[i] >= 0x80) {
+			n = plc_utf8_sequence(p + i, len - i);
+			if (n == 0)
+				return false;
+			i += n;
+		}
+	}
+
+	return true;
+}
+
+/*
+ * The client sends text in the server encoding, which the input functions
+ * take for granted as they do for the text checked when it enters the
+ * server. UTF-8 is checked here, and the other encodings, as well as the
+ * error of invalid UTF-8, are left to pg_verify_mbstr().
+ */
+void plc_verify_server_text(const char *s, int len) {
+	int encoding = GetDatabaseEncoding();
+
+	if (encoding == PG_SQL_ASCII)
+		return;
+	if (encoding == PG_UTF8 && plc_utf8_valid(s, len))
+		return;
+	pg_verify_mbstr(encoding, s, len, false);
+}
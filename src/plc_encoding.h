@@ -0,0 +1,20 @@
+/*------------------------------------------------------------------------------
+ *
+ *
+ * Copyright (c) 2016-Present Pivotal Software, Inc
+ *
+ *------------------------------------------------------------------------------
+ */
+
+#ifndef PLC_ENCODING_H
+#define PLC_ENCODING_H
+
+#include "postgres.h"
+
+/* Whether the bytes are valid UTF-8, where a zero byte counts as a character */
+bool plc_utf8_valid(const char *s, int len);
+
+/* Raise an error if the text received from the client is not in the server encoding */
+void plc_verify_server_text(const char *s, int len);
+
+#endif /* PLC_ENCODING_H */
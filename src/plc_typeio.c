@@ -29,8 +29,11 @@
 #include "utils/typcache.h"
 #include "utils/syscache.h"
 #include "utils/builtins.h"
+#include "utils/memutils.h"
+#include "lib/stringinfo.h"
 
 #include "plc_typeio.h"
+#include "plc_encoding.h"
 #include "common/comm_utils.h"
 #include "message_fns.h"
 
@@ -39,9 +42,21 @@
   #include "access/htup_details.h"
 #endif
 
+/* Timestamps and intervals are sent in binary only when stored as microseconds */
+#if defined(HAVE_INT64_TIMESTAMP) || PG_VERSION_NUM >= 100000
+#define PLC_BINARY_DATETIME
+#endif
+
+/* Domains are supported where their constraints can be checked by themselves */
+#if PG_VERSION_NUM >= 90100
+#define PLC_DOMAIN_CHECK
+#endif
+
 static void fill_type_info_inner(FunctionCallInfo fcinfo, Oid typeOid, plcTypeInfo *type,
                                  bool isArrayElement, bool isUDTElement);
 
+static void free_type_info_inner(plcTypeInfo *type);
+
 static char *plc_datum_as_int1(Datum input, plcTypeInfo *type);
 
 static char *plc_datum_as_int2(Datum input, plcTypeInfo *type);
@@ -54,10 +69,14 @@ static char *plc_datum_as_float4(Datum input, plcTypeInfo *type);
 
 static char *plc_datum_as_float8(Datum input, plcTypeInfo *type);
 
-static char *plc_datum_as_float8_numeric(Datum input, plcTypeInfo *type);
+static char *plc_datum_as_binary(Datum input, plcTypeInfo *type);
+
+static char *plc_datum_as_jsonb(Datum input, plcTypeInfo *type);
 
 static char *plc_datum_as_text(Datum input, plcTypeInfo *type);
 
+static char *plc_datum_as_text_data(Datum input, plcTypeInfo *type);
+
 static char *plc_datum_as_bytea(Datum input, plcTypeInfo *type);
 
 static char *plc_datum_as_array(Datum input, plcTypeInfo *type);
@@ -66,6 +85,10 @@ static void plc_backend_array_free(plcIterator *iter);
 
 static rawdata *plc_backend_array_next(plcIterator *self);
 
+static char *plc_backend_array_block(plcIterator *self, char *nulls);
+
+static bool plc_array_elements_flat(plcTypeInfo *subType);
+
 static char *plc_datum_as_udt(Datum input, plcTypeInfo *type);
 
 static Datum plc_datum_from_int1(char *input, plcTypeInfo *type);
@@ -80,12 +103,22 @@ static Datum plc_datum_from_float4(char *input, plcTypeInfo *type);
 
 static Datum plc_datum_from_float8(char *input, plcTypeInfo *type);
 
-static Datum plc_datum_from_float8_numeric(char *input, plcTypeInfo *type);
+static Datum plc_datum_from_binary(char *input, plcTypeInfo *type);
+
+static Datum plc_datum_from_binary_ptr(char *input, plcTypeInfo *type);
+
+static Datum plc_datum_from_jsonb(char *input, plcTypeInfo *type);
+
+static Datum plc_datum_from_jsonb_ptr(char *input, plcTypeInfo *type);
 
 static Datum plc_datum_from_text(char *input, plcTypeInfo *type);
 
 static Datum plc_datum_from_text_ptr(char *input, plcTypeInfo *type);
 
+static Datum plc_datum_from_text_data(char *input, plcTypeInfo *type);
+
+static Datum plc_datum_from_text_data_ptr(char *input, plcTypeInfo *type);
+
 static Datum plc_datum_from_bytea(char *input, plcTypeInfo *type);
 
 static Datum plc_datum_from_bytea_ptr(char *input, plcTypeInfo *type);
@@ -96,18 +129,59 @@ static Datum plc_datum_from_udt(char *input, plcTypeInfo *type);
 
 static Datum plc_datum_from_udt_ptr(char *input, plcTypeInfo *type);
 
+#ifdef PLC_DOMAIN_CHECK
+static Datum plc_datum_from_domain(char *input, plcTypeInfo *type);
+#endif
+
+/* Look up the in- and out- functions of the types converted through text */
+static void plc_type_text_io(plcTypeInfo *type, Oid typoutput, Oid typinput) {
+	fmgr_info_cxt(typoutput, &type->output, type->mcxt);
+	fmgr_info_cxt(typinput, &type->input, type->mcxt);
+}
+
+/* Look up the send and receive functions of the types sent in binary */
+static void plc_type_binary_io(plcTypeInfo *type) {
+	Oid typsend;
+	Oid typreceive;
+	bool typisvarlena;
+
+	getTypeBinaryOutputInfo(type->typeOid, &typsend, &typisvarlena);
+	getTypeBinaryInputInfo(type->typeOid, &typreceive, &type->typioparam);
+	fmgr_info_cxt(typsend, &type->send, type->mcxt);
+	fmgr_info_cxt(typreceive, &type->recv, type->mcxt);
+}
+
 static void
 fill_type_info_inner(FunctionCallInfo fcinfo, Oid typeOid, plcTypeInfo *type, bool isArrayElement, bool isUDTElement) {
 	HeapTuple typeTup;
 	Form_pg_type typeStruct;
 	char dummy_delim;
-	Oid typioparam;
+	Oid typinput;
 
 	/* Since this is recursive, it could theoretically be driven to overflow */
 	check_stack_depth();
 
 	if (get_typtype(typeOid) == TYPTYPE_DOMAIN) {
+#ifdef PLC_DOMAIN_CHECK
+		/*
+		 * A domain is converted as its base type, and the values received
+		 * from the client are checked against its constraints
+		 */
+		int32 typmod = -1;
+		Oid baseOid = getBaseTypeAndTypmod(typeOid, &typmod);
+
+		fill_type_info_inner(fcinfo, baseOid, type, isArrayElement, isUDTElement);
+		type->typmod = typmod;
+		type->domainOid = typeOid;
+#if PG_VERSION_NUM >= 90200
+		type->domain_hashvalue = GetSysCacheHashValue1(TYPEOID, ObjectIdGetDatum(typeOid));
+#endif
+		type->baseinfunc = type->infunc;
+		type->infunc = plc_datum_from_domain;
+		return;
+#else
 		plc_elog(ERROR, "plcontainer does not support domain type");
+#endif
 	}
 	typeTup = SearchSysCache(TYPEOID, ObjectIdGetDatum(typeOid), 0, 0, 0);
 	if (!HeapTupleIsValid(typeTup))
@@ -117,13 +191,22 @@ fill_type_info_inner(FunctionCallInfo fcinfo, Oid typeOid, plcTypeInfo *type, bo
 	ReleaseSysCache(typeTup);
 
 	type->typeOid = typeOid;
-	type->output = typeStruct->typoutput;
-	type->input = typeStruct->typinput;
+#if PG_VERSION_NUM >= 90200
+	type->typ_hashvalue = GetSysCacheHashValue1(TYPEOID, ObjectIdGetDatum(typeOid));
+#endif
 	get_type_io_data(typeOid, IOFunc_input,
 	                 &type->typlen, &type->typbyval, &type->typalign,
 	                 &dummy_delim,
-	                 &typioparam, &type->input);
+	                 &type->typioparam, &typinput);
 	type->typmod = typeStruct->typtypmod;
+	MemSet(&type->output, 0, sizeof(FmgrInfo));
+	MemSet(&type->input, 0, sizeof(FmgrInfo));
+	MemSet(&type->send, 0, sizeof(FmgrInfo));
+	MemSet(&type->recv, 0, sizeof(FmgrInfo));
+	type->domainOid = InvalidOid;
+	type->domainInfo = NULL;
+	type->baseinfunc = NULL;
+	type->tupdesc = NULL;
 	type->nSubTypes = 0;
 	type->subTypes = NULL;
 	type->typelem = typeStruct->typelem;
@@ -168,9 +251,46 @@ fill_type_info_inner(FunctionCallInfo fcinfo, Oid typeOid, plcTypeInfo *type, bo
 			type->infunc = plc_datum_from_float8;
 			break;
 		case NUMERICOID:
-			type->type = PLC_DATA_FLOAT8;
-			type->outfunc = plc_datum_as_float8_numeric;
-			type->infunc = plc_datum_from_float8_numeric;
+		case DATEOID:
+#ifdef PLC_BINARY_DATETIME
+		case TIMESTAMPOID:
+		case TIMESTAMPTZOID:
+		case INTERVALOID:
+#endif
+		case UUIDOID:
+			type->type = plc_get_datatype_from_oid(typeOid);
+			type->outfunc = plc_datum_as_binary;
+			plc_type_text_io(type, typeStruct->typoutput, typinput);
+			plc_type_binary_io(type);
+			if (!isArrayElement) {
+				type->infunc = plc_datum_from_binary;
+			} else {
+				type->infunc = plc_datum_from_binary_ptr;
+			}
+			break;
+#ifdef JSONBOID
+		case JSONBOID:
+			type->type = PLC_DATA_JSONB;
+			type->outfunc = plc_datum_as_jsonb;
+			plc_type_text_io(type, typeStruct->typoutput, typinput);
+			if (!isArrayElement) {
+				type->infunc = plc_datum_from_jsonb;
+			} else {
+				type->infunc = plc_datum_from_jsonb_ptr;
+			}
+			break;
+#endif
+		case TEXTOID:
+		case VARCHAROID:
+		case BPCHAROID:
+			type->type = PLC_DATA_TEXT;
+			type->outfunc = plc_datum_as_text_data;
+			plc_type_text_io(type, typeStruct->typoutput, typinput);
+			if (!isArrayElement) {
+				type->infunc = plc_datum_from_text_data;
+			} else {
+				type->infunc = plc_datum_from_text_data_ptr;
+			}
 			break;
 		case BYTEAOID:
 			type->type = PLC_DATA_BYTEA;
@@ -186,6 +306,7 @@ fill_type_info_inner(FunctionCallInfo fcinfo, Oid typeOid, plcTypeInfo *type, bo
 		default:
 			type->type = PLC_DATA_TEXT;
 			type->outfunc = plc_datum_as_text;
+			plc_type_text_io(type, typeStruct->typoutput, typinput);
 			if (!isArrayElement) {
 				type->infunc = plc_datum_from_text;
 			} else {
@@ -199,8 +320,10 @@ fill_type_info_inner(FunctionCallInfo fcinfo, Oid typeOid, plcTypeInfo *type, bo
 		type->type = PLC_DATA_ARRAY;
 		type->outfunc = plc_datum_as_array;
 		type->infunc = plc_datum_from_array;
-		type->nSubTypes = 1;
 		type->subTypes = (plcTypeInfo *) PLy_malloc(sizeof(plcTypeInfo));
+		memset(type->subTypes, 0, sizeof(plcTypeInfo));
+		type->nSubTypes = 1;
+		type->subTypes[0].mcxt = type->mcxt;
 		fill_type_info_inner(fcinfo, typeStruct->typelem, &type->subTypes[0], true, isUDTElement);
 	}
 
@@ -233,6 +356,7 @@ fill_type_info_inner(FunctionCallInfo fcinfo, Oid typeOid, plcTypeInfo *type, bo
 		}
 
 		if (type->is_rowtype) {
+			MemoryContext oldcontext;
 			int i;
 
 			type->type = PLC_DATA_UDT;
@@ -242,13 +366,15 @@ fill_type_info_inner(FunctionCallInfo fcinfo, Oid typeOid, plcTypeInfo *type, bo
 			} else {
 				type->infunc = plc_datum_from_udt_ptr;
 			}
-			type->nSubTypes = desc->natts;
 
 			if (desc->tdtypeid != RECORDOID && !TransactionIdIsValid(type->typrel_xmin)) {
 				HeapTuple relTup;
 
 				/* Get the pg_class tuple corresponding to the type of the input */
 				type->typ_relid = typeidTypeRelid(desc->tdtypeid);
+#if PG_VERSION_NUM >= 90200
+				type->typrel_hashvalue = GetSysCacheHashValue1(RELOID, ObjectIdGetDatum(type->typ_relid));
+#endif
 				relTup = SearchSysCache1(RELOID, ObjectIdGetDatum(type->typ_relid));
 				if (!HeapTupleIsValid(relTup)) {
 					plc_elog(ERROR, "cache lookup failed for relation %u", type->typ_relid);
@@ -263,12 +389,14 @@ fill_type_info_inner(FunctionCallInfo fcinfo, Oid typeOid, plcTypeInfo *type, bo
 			}
 
 			// Allocate memory for this number of arguments
-			type->subTypes = (plcTypeInfo *) PLy_malloc(type->nSubTypes * sizeof(plcTypeInfo));
-			memset(type->subTypes, 0, type->nSubTypes * sizeof(plcTypeInfo));
+			type->subTypes = (plcTypeInfo *) PLy_malloc(desc->natts * sizeof(plcTypeInfo));
+			memset(type->subTypes, 0, desc->natts * sizeof(plcTypeInfo));
+			type->nSubTypes = desc->natts;
 
 			// Fill all the subtypes
 			for (i = 0; i < desc->natts; i++) {
 				type->subTypes[i].attisdropped = desc->attrs[i]->attisdropped;
+				type->subTypes[i].mcxt = type->mcxt;
 				if (!type->subTypes[i].attisdropped) {
 					/* We support the case with array of UDTs, each of which contains another array */
 					fill_type_info_inner(fcinfo, desc->attrs[i]->atttypid, &type->subTypes[i], false, true);
@@ -276,12 +404,22 @@ fill_type_info_inner(FunctionCallInfo fcinfo, Oid typeOid, plcTypeInfo *type, bo
 				type->subTypes[i].typeName = plc_top_strdup(NameStr(desc->attrs[i]->attname));
 			}
 
+			/* Keep the descriptor to deform and form the rows with */
+			oldcontext = MemoryContextSwitchTo(TopMemoryContext);
+			type->tupdesc = CreateTupleDescCopy(desc);
+			MemoryContextSwitchTo(oldcontext);
+
 			ReleaseTupleDesc(desc);
 		}
 	}
 }
 
 void fill_type_info(FunctionCallInfo fcinfo, Oid typeOid, plcTypeInfo *type) {
+	type->mcxt = AllocSetContextCreate(TopMemoryContext,
+	                                   "PL/Container type info",
+	                                   ALLOCSET_SMALL_MINSIZE,
+	                                   ALLOCSET_SMALL_INITSIZE,
+	                                   ALLOCSET_SMALL_MAXSIZE);
 	fill_type_info_inner(fcinfo, typeOid, type, false, false);
 }
 
@@ -314,15 +452,19 @@ void copy_type_info(plcType *type, plcTypeInfo *ptype) {
 	}
 }
 
-void free_type_info(plcTypeInfo *type) {
+static void free_type_info_inner(plcTypeInfo *type) {
 	int i = 0;
 
 	if (type->typeName != NULL) {
 		pfree(type->typeName);
 	}
 
+	if (type->tupdesc != NULL) {
+		FreeTupleDesc(type->tupdesc);
+	}
+
 	for (i = 0; i < type->nSubTypes; i++) {
-		free_type_info(&type->subTypes[i]);
+		free_type_info_inner(&type->subTypes[i]);
 	}
 
 	if (type->nSubTypes > 0) {
@@ -330,6 +472,81 @@ void free_type_info(plcTypeInfo *type) {
 	}
 }
 
+void free_type_info(plcTypeInfo *type) {
+	free_type_info_inner(type);
+
+	if (type->mcxt != NULL) {
+		MemoryContextDelete(type->mcxt);
+		type->mcxt = NULL;
+	}
+}
+
+/* Whether the name of the type is one of the names given */
+static bool plc_type_named(Oid typeOid, List *typeNames) {
+	HeapTuple typeTup;
+	ListCell *cell;
+	bool found = false;
+
+	typeTup = SearchSysCache1(TYPEOID, ObjectIdGetDatum(typeOid));
+	if (!HeapTupleIsValid(typeTup))
+		plc_elog(ERROR, "cache lookup failed for type %u", typeOid);
+
+	foreach(cell, typeNames) {
+		if (pg_strcasecmp(NameStr(((Form_pg_type) GETSTRUCT(typeTup))->typname), (char *) lfirst(cell)) == 0) {
+			found = true;
+			break;
+		}
+	}
+	ReleaseSysCache(typeTup);
+	return found;
+}
+
+static void plc_type_use_binary_inner(plcTypeInfo *type, List *typeNames, bool isArrayElement) {
+	plcDatumInput infunc;
+	int i;
+
+	switch (type->type) {
+		case PLC_DATA_ARRAY:
+			plc_type_use_binary_inner(&type->subTypes[0], typeNames, true);
+			return;
+		case PLC_DATA_UDT:
+			for (i = 0; i < type->nSubTypes; i++) {
+				if (!type->subTypes[i].attisdropped)
+					plc_type_use_binary_inner(&type->subTypes[i], typeNames, false);
+			}
+			return;
+		case PLC_DATA_TEXT:
+			break;
+		default:
+			/* The types with their own binary form keep it */
+			return;
+	}
+
+	if (!plc_type_named(type->typeOid, typeNames)
+	    && !(OidIsValid(type->domainOid) && plc_type_named(type->domainOid, typeNames)))
+		return;
+
+	plc_type_binary_io(type);
+	type->type = PLC_DATA_BYTEA;
+	type->outfunc = plc_datum_as_binary;
+	infunc = isArrayElement ? plc_datum_from_binary_ptr : plc_datum_from_binary;
+	if (OidIsValid(type->domainOid)) {
+		type->baseinfunc = infunc;
+	} else {
+		type->infunc = infunc;
+	}
+}
+
+/*
+ * Values of the types named in the '# binary:' declaration of a function, in
+ * arrays and composite types too, travel as the output of the send function
+ * of the type instead of its text. The client gets them as bytea it does not
+ * need to understand, and can return them unchanged to the receive function.
+ */
+void plc_type_use_binary(plcTypeInfo *type, List *typeNames) {
+	plc_type_use_binary_inner(type, typeNames, false);
+}
+
 static char *plc_datum_as_int1(Datum input, pg_attribute_unused() plcTypeInfo *type) {
 	char *out = (char *) pmalloc(1);
 	*((char *) out) = DatumGetBool(input);
@@ -366,19 +583,64 @@ static char *plc_datum_as_float8(Datum input, pg_attribute_unused() plcTypeInfo
 	return out;
 }
 
-static char *plc_datum_as_float8_numeric(Datum input, pg_attribute_unused() plcTypeInfo *type) {
-	char *out = (char *) pmalloc(8);
-	/* Numeric is casted to float8 which causes precision lost */
-	Datum fdatum = DirectFunctionCall1(numeric_float8, input);
-	*((float8 *) out) = DatumGetFloat8(fdatum);
+/*
+ * Numeric, date and time and uuid values travel in the binary form of their
+ * send functions, laid out like bytea, with the length in front of the data.
+ * Numeric is the number of base-10000 digits, the weight of the first one,
+ * the sign, the display scale and the digits, each an int16 in network byte
+ * order. Date is the int32 number of days and timestamp the int64 number of
+ * microseconds since 2000-01-01, in UTC for timestamptz. Interval is the
+ * int64 microseconds, int32 days and int32 months, and uuid its 16 bytes.
+ * The types of a '# binary:' declaration go out the same way, as bytea.
+ */
+static char *plc_datum_as_binary(Datum input, plcTypeInfo *type) {
+	bytea *bin;
+	char *out;
+	int len;
+
+	bin = SendFunctionCall(&type->send, input);
+	len = VARSIZE(bin) - VARHDRSZ;
+	out = (char *) pmalloc(len + 4);
+	*((int *) out) = len;
+	memcpy(out + 4, VARDATA(bin), len);
+	pfree(bin);
+	return out;
+}
+
+/*
+ * Jsonb values travel as the version byte of jsonb_send followed by the
+ * zero-terminated text, in the server encoding, laid out like bytea
+ */
+static char *plc_datum_as_jsonb(Datum input, plcTypeInfo *type) {
+	char *text = plc_datum_as_text(input, type);
+	int len = strlen(text);
+	char *out = (char *) pmalloc(len + 6);
+
+	*((int *) out) = len + 2;
+	out[4] = 1;
+	memcpy(out + 5, text, len + 1);
+	pfree(text);
 	return out;
 }
 
 static char *plc_datum_as_text(Datum input, plcTypeInfo *type) {
-	return DatumGetCString(OidFunctionCall3(type->output,
-	                                        input,
-	                                        type->typelem,
-	                                        type->typmod));
+	return OutputFunctionCall(&type->output, input);
+}
+
+/*
+ * The output functions of text, varchar and char only copy the characters
+ * out of the datum, which is done here without calling them
+ */
+static char *plc_datum_as_text_data(Datum input, pg_attribute_unused() plcTypeInfo *type) {
+	text *txt = DatumGetTextPP(input);
+	int len = VARSIZE_ANY_EXHDR(txt);
+	char *out = (char *) pmalloc(len + 1);
+
+	memcpy(out, VARDATA_ANY(txt), len);
+	out[len] = '\0';
+	if ((Pointer) txt != DatumGetPointer(input))
+		pfree(txt);
+	return out;
 }
 
 static char *plc_datum_as_bytea(Datum input, pg_attribute_unused() plcTypeInfo *type) {
@@ -409,6 +671,7 @@ static char *plc_datum_as_array(Datum input, plcTypeInfo *type) {
 	pos->type = type;
 	pos->bitmap = ARR_NULLBITMAP(array);
 	pos->bitmask = 1;
+	pos->block = NULL;
 	meta->size = meta->ndims > 0 ? 1 : 0;
 	for (i = 0; i < meta->ndims; i++) {
 		meta->dims[i] = ARR_DIMS(array)[i];
@@ -416,6 +679,7 @@ static char *plc_datum_as_array(Datum input, plcTypeInfo *type) {
 	}	
 	iter->data = ARR_DATA_PTR(array);
 	iter->next = plc_backend_array_next;
+	iter->block = plc_backend_array_block;
 	iter->cleanup = plc_backend_array_free;
 
 	return (char *) iter;
@@ -423,10 +687,15 @@ static char *plc_datum_as_array(Datum input, plcTypeInfo *type) {
 
 static void plc_backend_array_free(plcIterator *iter) {
 	plcArrayMeta *meta;
+	plcPgArrayPosition *pos;
 	meta = (plcArrayMeta *) iter->meta;
+	pos = (plcPgArrayPosition *) iter->position;
 	if (meta->ndims > 0) {
 		pfree(meta->dims);
 	}
+	if (pos->block != NULL) {
+		pfree(pos->block);
+	}
 	pfree(iter->meta);
 	pfree(iter->position);
 	return;
@@ -468,15 +737,80 @@ static rawdata *plc_backend_array_next(plcIterator *self) {
 }
 
 /*
-HeapTupleData rec_data;
-rec_data.t_len = HeapTupleHeaderGetDatumLength(rec_header);
-ItemPointerSetInvalid(&(rec_data.t_self));
-rec_data.t_tableOid = InvalidOid;
-rec_data.t_data = rec_header;
-vattr = heap_getattr(&rec_data, (i + 1), type->tupleDesc, &isnull);
-*/
+ * Boolean, integer and float elements are stored in an array just as they
+ * are sent, so an array without NULLs goes out straight from its data.
+ */
+static char *plc_backend_array_block(plcIterator *self, char *nulls) {
+	plcTypeInfo *subtyp;
+	plcPgArrayPosition *pos;
+	Datum itemvalue;
+	char *value;
+	int len;
+	int i;
+
+	pos = (plcPgArrayPosition *) self->position;
+	subtyp = &pos->type->subTypes[0];
+	len = plc_get_type_length(self->meta->type);
+
+	if (pos->bitmap == NULL && plc_array_elements_flat(subtyp))
+		return self->data;
+
+	pos->block = palloc0((Size) self->meta->size * len);
+	for (i = 0; i < self->meta->size; i++) {
+		if (pos->bitmap && (*(pos->bitmap) & pos->bitmask) == 0) {
+			nulls[i >> 3] |= (char) (1 << (i & 7));
+		} else {
+			if (plc_array_elements_flat(subtyp)) {
+				memcpy(pos->block + (Size) i * len, self->data, len);
+			} else {
+				/* elements stored in another form are converted one by one */
+				itemvalue = fetch_att(self->data, subtyp->typbyval, subtyp->typlen);
+				value = subtyp->outfunc(itemvalue, subtyp);
+				memcpy(pos->block + (Size) i * len, value, len);
+				pfree(value);
+			}
+
+			self->data = att_addlength_pointer(self->data, subtyp->typlen, self->data);
+			self->data = (char *) att_align_nominal(self->data, subtyp->typalign);
+		}
+
+		/* advance bitmap pointer if any */
+		if (pos->bitmap) {
+			pos->bitmask <<= 1;
+			if (pos->bitmask == 0x100 /* (1<<8) */) {
+				pos->bitmap++;
+				pos->bitmask = 1;
+			}
+		}
+	}
+
+	return pos->block;
+}
+
+/* Whether the array stores the elements in their wire format */
+static bool plc_array_elements_flat(plcTypeInfo *subType) {
+	switch (subType->type) {
+		case PLC_DATA_INT1:
+		case PLC_DATA_INT2:
+		case PLC_DATA_INT4:
+		case PLC_DATA_INT8:
+		case PLC_DATA_FLOAT4:
+		case PLC_DATA_FLOAT8:
+			return subType->typlen == plc_get_type_length(subType->type);
+		default:
+			return false;
+	}
+}
+
+/*
+ * The attributes of the row are deformed in a single pass over the tuple,
+ * with the descriptor kept in the type info
+ */
 static char *plc_datum_as_udt(Datum input, plcTypeInfo *type) {
 	HeapTupleHeader rec_header;
+	HeapTupleData tuple;
+	Datum *values;
+	bool *nulls;
 	plcUDT *res;
 	int i, j;
 	int nNonDropped = 0;
@@ -490,23 +824,31 @@ static char *plc_datum_as_udt(Datum input, plcTypeInfo *type) {
 	res = plc_alloc_udt(nNonDropped);
 
 	rec_header = DatumGetHeapTupleHeader(input);
-	for (i = 0, j = 0; i < type->nSubTypes; i++) {
-		Datum vattr;
-		bool isnull;
+	MemSet(&tuple, 0, sizeof(tuple));
+	tuple.t_len = HeapTupleHeaderGetDatumLength(rec_header);
+	ItemPointerSetInvalid(&(tuple.t_self));
+	tuple.t_data = rec_header;
 
+	values = palloc(sizeof(Datum) * type->nSubTypes);
+	nulls = palloc(sizeof(bool) * type->nSubTypes);
+	heap_deform_tuple(&tuple, type->tupdesc, values, nulls);
+
+	for (i = 0, j = 0; i < type->nSubTypes; i++) {
 		if (!type->subTypes[i].attisdropped) {
-			vattr = GetAttributeByNum(rec_header, (i + 1), &isnull);
-			if (isnull) {
+			if (nulls[i]) {
 				res->data[j].isnull = true;
 				res->data[j].value = NULL;
 			} else {
 				res->data[j].isnull = false;
-				res->data[j].value = type->subTypes[i].outfunc(vattr, &type->subTypes[i]);
+				res->data[j].value = type->subTypes[i].outfunc(values[i], &type->subTypes[i]);
 			}
 			j++;
 		}
 	}
 
+	pfree(values);
+	pfree(nulls);
+
 	return (char *) res;
 }
 
@@ -534,23 +876,102 @@ static Datum plc_datum_from_float8(char *input, pg_attribute_unused() plcTypeInf
 	return Float8GetDatum(*((float8 *) input));
 }
 
-static Datum plc_datum_from_float8_numeric(char *input, pg_attribute_unused() plcTypeInfo *type) {
-	Datum fdatum = Float8GetDatum(*((float8 *) input));
-	return DirectFunctionCall1(float8_numeric, fdatum);
+/*
+ * The receive functions check the values and apply the typmod of the type.
+ * The values of the types with a binary form start with a PLC_FORM_* byte:
+ * the client sends the zero-terminated text of the objects it has no binary
+ * form of, which goes through the input function. The values of a '# binary:'
+ * declaration, sent as bytea, always come in binary without it.
+ */
+static Datum plc_datum_from_binary(char *input, plcTypeInfo *type) {
+	StringInfoData buf;
+	Datum result;
+
+	buf.len = *((int *) input);
+	buf.maxlen = buf.len;
+	buf.data = input + 4;
+	buf.cursor = 0;
+	if (type->type != PLC_DATA_BYTEA) {
+		char form = buf.len > 0 ? buf.data[0] : '\0';
+
+		buf.data++;
+		buf.len--;
+		buf.maxlen--;
+		if (form == PLC_FORM_TEXT) {
+			if (buf.len == 0 || buf.data[buf.len - 1] != '\0') {
+				ereport(ERROR,
+				        (errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+					        errmsg("incorrect text data format in %s value", format_type_be(type->typeOid))));
+			}
+			return plc_datum_from_text(buf.data, type);
+		}
+		if (form != PLC_FORM_BINARY) {
+			ereport(ERROR,
+			        (errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+				        errmsg("incorrect binary data format in %s value", format_type_be(type->typeOid))));
+		}
+	}
+
+	result = ReceiveFunctionCall(&type->recv, &buf, type->typioparam, type->typmod);
+	if (buf.cursor != buf.len) {
+		ereport(ERROR,
+		        (errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+			        errmsg("incorrect binary data format in %s value", format_type_be(type->typeOid))));
+	}
+	return result;
+}
+
+static Datum plc_datum_from_binary_ptr(char *input, plcTypeInfo *type) {
+	return plc_datum_from_binary(*((char **) input), type);
+}
+
+static Datum plc_datum_from_jsonb(char *input, plcTypeInfo *type) {
+	int len = *((int *) input);
+	char *data = input + 4;
+
+	if (len < 2 || data[0] != 1 || data[len - 1] != '\0') {
+		ereport(ERROR,
+		        (errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+			        errmsg("incorrect binary data format in jsonb value")));
+	}
+	return plc_datum_from_text(data + 1, type);
+}
+
+static Datum plc_datum_from_jsonb_ptr(char *input, plcTypeInfo *type) {
+	return plc_datum_from_jsonb(*((char **) input), type);
 }
 
 static Datum plc_datum_from_text(char *input, plcTypeInfo *type) {
-	return OidFunctionCall3(type->input,
-	                        CStringGetDatum(input),
-	                        type->typelem,
-	                        type->typmod);
+	plc_verify_server_text(input, strlen(input));
+	return InputFunctionCall(&type->input, input, type->typioparam, type->typmod);
 }
 
 static Datum plc_datum_from_text_ptr(char *input, plcTypeInfo *type) {
-	return OidFunctionCall3(type->input,
-	                        CStringGetDatum(*((char **) input)),
-	                        type->typelem,
-	                        type->typmod);
+	return plc_datum_from_text(*((char **) input), type);
+}
+
+/*
+ * Without a typmod to apply, the input functions of text, varchar and char
+ * only copy the characters into the datum, which is done here directly once
+ * the characters are checked
+ */
+static Datum plc_datum_from_text_data(char *input, plcTypeInfo *type) {
+	int len;
+	text *result;
+
+	if (type->typmod >= 0)
+		return plc_datum_from_text(input, type);
+
+	len = strlen(input);
+	plc_verify_server_text(input, len);
+	result = (text *) palloc(len + VARHDRSZ);
+	SET_VARSIZE(result, len + VARHDRSZ);
+	memcpy(VARDATA(result), input, len);
+	return PointerGetDatum(result);
+}
+
+static Datum plc_datum_from_text_data_ptr(char *input, plcTypeInfo *type) {
+	return plc_datum_from_text_data(*((char **) input), type);
 }
 
 static Datum plc_datum_from_bytea(char *input, pg_attribute_unused() plcTypeInfo *type) {
@@ -583,9 +1004,30 @@ static Datum plc_datum_from_array(char *input, plcTypeInfo *type) {
 	for (i = 0; i < arr->meta->ndims; i++)
 		lbs[i] = 1;
 
+	/*
+	 * Without NULLs the elements arrive laid out as the array stores them.
+	 * Booleans still go through infunc to get normalized, and the elements
+	 * of domains to get checked.
+	 */
+	len = plc_get_type_length(subType->type);
+	if (arr->meta->size > 0 && subType->type != PLC_DATA_INT1 && plc_array_elements_flat(subType)
+	    && !OidIsValid(subType->domainOid) && memchr(arr->nulls, 1, arr->meta->size) == NULL) {
+		Size nbytes = ARR_OVERHEAD_NONULLS(arr->meta->ndims) + (Size) arr->meta->size * len;
+
+		array = (ArrayType *) palloc0(nbytes);
+		SET_VARSIZE(array, nbytes);
+		array->ndim = arr->meta->ndims;
+		array->dataoffset = 0;
+		array->elemtype = plc_type_oid(subType);
+		memcpy(ARR_DIMS(array), arr->meta->dims, arr->meta->ndims * sizeof(int));
+		memcpy(ARR_LBOUND(array), lbs, arr->meta->ndims * sizeof(int));
+		memcpy(ARR_DATA_PTR(array), arr->data, (Size) arr->meta->size * len);
+		pfree(lbs);
+		return PointerGetDatum(array);
+	}
+
 	elems = palloc(arr->meta->size * sizeof(Datum));
 	ptr = arr->data;
-	len = plc_get_type_length(subType->type);
 	for (i = 0; i < arr->meta->size; i++) {
 		if (arr->nulls[i] == 0) {
 			elems[i] = subType->infunc(ptr, subType);
@@ -600,7 +1042,7 @@ static Datum plc_datum_from_array(char *input, plcTypeInfo *type) {
 	                           arr->meta->ndims,
 	                           arr->meta->dims,
 	                           lbs,
-	                           subType->typeOid,
+	                           plc_type_oid(subType),
 	                           subType->typlen,
 	                           subType->typbyval,
 	                           subType->typalign);
@@ -614,7 +1056,6 @@ static Datum plc_datum_from_array(char *input, plcTypeInfo *type) {
 }
 
 static Datum plc_datum_from_udt(char *input, plcTypeInfo *type) {
-	TupleDesc desc;
 	HeapTuple tuple;
 	Datum *values;
 	bool *nulls;
@@ -631,15 +1072,13 @@ static Datum plc_datum_from_udt(char *input, plcTypeInfo *type) {
 				values[i] = (Datum) 0;
 			} else {
 				nulls[i] = false;
-				values[i] = type->subTypes[j].infunc(udt->data[j].value, &type->subTypes[j]);
+				values[i] = type->subTypes[i].infunc(udt->data[j].value, &type->subTypes[i]);
 			}
 			j += 1;
 		}
 	}
 
-	desc = lookup_rowtype_tupdesc(type->typeOid, type->typmod);
-	tuple = heap_form_tuple(desc, values, nulls);
-	ReleaseTupleDesc(desc);
+	tuple = heap_form_tuple(type->tupdesc, values, nulls);
 
 	pfree(values);
 	pfree(nulls);
@@ -651,6 +1090,15 @@ static Datum plc_datum_from_udt_ptr(char *input, plcTypeInfo *type) {
 	return plc_datum_from_udt(*((char **) input), type);
 }
 
+#ifdef PLC_DOMAIN_CHECK
+static Datum plc_datum_from_domain(char *input, plcTypeInfo *type) {
+	Datum result = type->baseinfunc(input, type);
+
+	domain_check(result, false, type->domainOid, &type->domainInfo, type->mcxt);
+	return result;
+}
+#endif
+
 plcDatatype plc_get_datatype_from_oid(Oid oid) {
 	plcDatatype dt;
 
@@ -674,8 +1122,30 @@ plcDatatype plc_get_datatype_from_oid(Oid oid) {
 			dt = PLC_DATA_FLOAT8;
 			break;
 		case NUMERICOID:
-			dt = PLC_DATA_FLOAT8;
+			dt = PLC_DATA_NUMERIC;
+			break;
+		case DATEOID:
+			dt = PLC_DATA_DATE;
+			break;
+#ifdef PLC_BINARY_DATETIME
+		case TIMESTAMPOID:
+			dt = PLC_DATA_TIMESTAMP;
+			break;
+		case TIMESTAMPTZOID:
+			dt = PLC_DATA_TIMESTAMPTZ;
 			break;
+		case INTERVALOID:
+			dt = PLC_DATA_INTERVAL;
+			break;
+#endif
+		case UUIDOID:
+			dt = PLC_DATA_UUID;
+			break;
+#ifdef JSONBOID
+		case JSONBOID:
+			dt = PLC_DATA_JSONB;
+			break;
+#endif
 		case BYTEAOID:
 			dt = PLC_DATA_BYTEA;
 			break;
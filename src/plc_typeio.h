@@ -12,6 +12,7 @@
 
 #include "postgres.h"
 #include "funcapi.h"
+#include "nodes/pg_list.h"
 
 #include "common/messages/messages.h"
 #include "plcontainer.h"
@@ -33,18 +34,33 @@ struct plcTypeInfo {
 	plcDatumOutput outfunc;
 	plcDatumInput infunc;
 
-	/* GPDB in- and out- functions to transform custom types to text and back */
-	RegProcedure output, input;
+	/* GPDB in- and out- functions to transform custom types to text and back,
+	 * and send and receive functions of the types sent in binary, looked up
+	 * once when the type is filled */
+	FmgrInfo output, input;
+	FmgrInfo send, recv;
+
+	/* Memory of the functions above, their cached data and the domain
+	 * checks, of this type info and its subtypes. Created by
+	 * fill_type_info() and deleted by free_type_info(). */
+	MemoryContext mcxt;
 
 	/* Information used for type input/output operations */
 	Oid typeOid;
 	Oid typelem;
+	Oid typioparam;
 	bool typbyval;
 	int16 typlen;
 	char typalign;
 	int32 typmod;
 
+	/* Domain over the type above whose constraints are checked on input */
+	Oid domainOid;
+	void *domainInfo;
+	plcDatumInput baseinfunc;
+
 	/* UDT-specific information */
+	TupleDesc tupdesc;  /* copy of the row descriptor, in TopMemoryContext */
 	bool is_rowtype;
 	bool is_record;
 	bool attisdropped;
@@ -52,12 +68,23 @@ struct plcTypeInfo {
 	TransactionId typrel_xmin;
 	ItemPointerData typrel_tid;
 	char *typeName;
+
+#if PG_VERSION_NUM >= 90200
+	/* Syscache hash values of the catalog rows above, to match invalidations */
+	uint32 typ_hashvalue;
+	uint32 domain_hashvalue;
+	uint32 typrel_hashvalue;
+#endif
 };
 
+/* The type of the values built for the type info, the domain if any */
+#define plc_type_oid(type) (OidIsValid((type)->domainOid) ? (type)->domainOid : (type)->typeOid)
+
 typedef struct plcPgArrayPosition {
 	plcTypeInfo *type;
 	bits8 *bitmap;
 	int bitmask;
+	char *block;  /* elements copied out for sending, if not sent in place */
 } plcPgArrayPosition;
 
 void fill_type_info(FunctionCallInfo fcinfo, Oid typeOid, plcTypeInfo *type);
@@ -68,6 +95,8 @@ void free_type_info(plcTypeInfo *type);
 
 char *fill_type_value(Datum funcArg, plcTypeInfo *argType);
 
+void plc_type_use_binary(plcTypeInfo *type, List *typeNames);
+
 plcDatatype plc_get_datatype_from_oid(Oid oid);
 
 #endif /* PLC_TYPEIO_H */
@@ -6,6 +6,8 @@
 
 /* Postgres Headers */
 #include "postgres.h"
+#include "access/tuptoaster.h"
+#include "access/xact.h"
 #include "utils/builtins.h"
 #include "utils/syscache.h"
 #include "catalog/pg_proc.h"
@@ -22,11 +24,16 @@
 #include "storage/ipc.h"
 #include "funcapi.h"
 #include "miscadmin.h"
+#include "utils/array.h"
 #ifndef PLC_PG
   #include "utils/faultinjector.h"
 #endif
 #include "utils/memutils.h"
 #include "utils/guc.h"
+#include "utils/tuplestore.h"
+#ifdef PLC_PG
+  #include "access/htup_details.h"
+#endif
 /* PLContainer Headers */
 #include "common/comm_channel.h"
 #include "common/messages/messages.h"
@@ -56,8 +63,35 @@ PG_FUNCTION_INFO_V1(plcontainer_call_handler);
 
 static Datum plcontainer_function_handler(FunctionCallInfo fcinfo, plcProcInfo *proc);
 
-static plcProcResult *plcontainer_get_result(FunctionCallInfo fcinfo,
-                                             plcProcInfo *proc);
+static Datum plcontainer_batch_handler(FunctionCallInfo fcinfo, plcProcInfo *proc);
+
+static bool plcontainer_materialize_allowed(FunctionCallInfo fcinfo);
+
+static Datum plcontainer_materialize_handler(FunctionCallInfo fcinfo, plcProcInfo *proc);
+
+static plcProcResult *plcontainer_get_result(plcProcInfo *proc,
+                                             plcMsgCallreq *req);
+
+static plcMsgResult *plcontainer_receive_result(plcConn *conn, plcProcInfo *proc,
+                                                plcMsgCallreq *req);
+
+static bool plcontainer_function_known(plcConn *conn, plcProcInfo *proc);
+
+static void plcontainer_function_sent(plcConn *conn, plcProcInfo *proc);
+
+static void plcontainer_process_source_request(plcMsgSourceRequest *msg, plcConn *conn,
+                                               plcProcInfo *proc, plcMsgCallreq *req);
+
+static void plcontainer_process_slice_request(plcMsgSliceRequest *msg, plcConn *conn,
+                                              plcMsgCallreq *req);
+
+static void plcontainer_next_chunk(plcProcResult *presult, plcProcInfo *proc);
+
+static void plcontainer_close_stream(plcProcResult *presult);
+
+static void plcontainer_stream_shutdown(Datum arg);
+
+static void plcontainer_xact_callback(XactEvent event, void *arg);
 
 static Datum plcontainer_process_result(FunctionCallInfo fcinfo,
                                         plcProcInfo *proc,
@@ -110,10 +144,21 @@ _PG_init(void) {
 		return;
 
 	on_proc_exit(plcontainer_cleanup, 0);
+	RegisterXactCallback(plcontainer_xact_callback, NULL);
 	explicit_subtransactions = NIL;
 	inited = true;
 }
 
+/*
+ * Result sets still streamed by the containers at the end of transaction were
+ * abandoned by a failed query, the client does not need to keep them
+ */
+static void
+plcontainer_xact_callback(XactEvent event, void __attribute__((__unused__)) *arg) {
+	if (event == XACT_EVENT_COMMIT || event == XACT_EVENT_ABORT)
+		cancel_container_streams();
+}
+
 static bool
 PLy_procedure_is_trigger(Form_pg_proc procStruct)
 {
@@ -229,7 +274,13 @@ Datum plcontainer_call_handler(PG_FUNCTION_ARGS) {
 
 		plc_elog(DEBUG1, "Calling python proc @ address: %p", proc);
 
-		datumreturn = plcontainer_function_handler(fcinfo, proc);
+		if (proc->batchSize > 0) {
+			datumreturn = plcontainer_batch_handler(fcinfo, proc);
+		} else if (plcontainer_materialize_allowed(fcinfo)) {
+			datumreturn = plcontainer_materialize_handler(fcinfo, proc);
+		} else {
+			datumreturn = plcontainer_function_handler(fcinfo, proc);
+		}
 	}
 	PG_CATCH();
 	{
@@ -266,115 +317,181 @@ Datum plcontainer_call_handler(PG_FUNCTION_ARGS) {
 	return datumreturn;
 }
 
-static plcProcResult *plcontainer_get_result(FunctionCallInfo fcinfo,
-                                             plcProcInfo *proc) {
+static plcProcResult *plcontainer_get_result(plcProcInfo *proc,
+                                             plcMsgCallreq *req) {
 	char *runtime_id;
 	plcConn *conn;
-	int message_type;
-	plcMsgCallreq *req = NULL;
-	plcProcResult *result;
-	int volatile save_subxact_level = list_length(explicit_subtransactions);
+	plcProcResult *result = NULL;
+	runtimeConfEntry *runtime_conf_entry = NULL;
 
-	PG_TRY();
-	{
-		runtimeConfEntry *runtime_conf_entry = NULL;
-		result = NULL;
-
-		req = plcontainer_generate_call_request(fcinfo, proc);
-		runtime_id = parse_container_meta(req->proc.src);
-		
-		runtime_conf_entry = plc_get_runtime_configuration(runtime_id);
-
-		if (runtime_conf_entry == NULL) {
-			plc_elog(ERROR, "Runtime '%s' is not defined in configuration "
-						"and cannot be used", runtime_id);
-		} 
-		/*
-		 * We need to check the privilege in each run
-		 */
-		if (runtime_conf_entry->useUserControl) {
-			if (!plc_check_user_privilege(runtime_conf_entry->roles)){
-				plc_elog(ERROR, "Current user does not have privilege to use runtime %s", runtime_id);
-			}
+	runtime_id = parse_container_meta(req->proc.src);
+
+	runtime_conf_entry = plc_get_runtime_configuration(runtime_id);
+
+	if (runtime_conf_entry == NULL) {
+		plc_elog(ERROR, "Runtime '%s' is not defined in configuration "
+					"and cannot be used", runtime_id);
+	}
+	/*
+	 * We need to check the privilege in each run
+	 */
+	if (runtime_conf_entry->useUserControl) {
+		if (!plc_check_user_privilege(runtime_conf_entry->roles)){
+			plc_elog(ERROR, "Current user does not have privilege to use runtime %s", runtime_id);
 		}
+	}
 
-		conn = get_container_conn(runtime_id);
-		if (conn == NULL) {
-			/* TODO: We could only remove this backend when error occurs. */
-			DeleteBackendsWhenError = true;
-			conn = start_backend(runtime_conf_entry);
-			DeleteBackendsWhenError = false;
+	conn = get_container_conn(runtime_id);
+	if (conn == NULL) {
+		/* TODO: We could only remove this backend when error occurs. */
+		DeleteBackendsWhenError = true;
+		conn = start_backend(runtime_conf_entry);
+		DeleteBackendsWhenError = false;
+	}
+
+	pfree(runtime_id);
+
+	DeleteBackendsWhenError = true;
+	if (conn != NULL) {
+		int res;
+
+		/* The client still has the source of the functions it was sent */
+		if (!req->hasChanged && plcontainer_function_known(conn, proc))
+			req->proc.src = NULL;
+		else
+			plcontainer_function_sent(conn, proc);
+
+		res = plcontainer_channel_send(conn, (plcMessage *) req);
+#ifndef PLC_PG
+		SIMPLE_FAULT_NAME_INJECTOR("plcontainer_after_send_request");
+#endif
+
+		if (res < 0) {
+			plc_elog(ERROR, "Error sending data to the client. "
+						"Maybe retry later.");
+			return NULL;
 		}
 
-		pfree(runtime_id);
+		result = (plcProcResult *) pmalloc(sizeof(plcProcResult));
+		result->resmsg = plcontainer_receive_result(conn, proc, req);
+		free_callreq(req, true, true);
+		result->resrow = 0;
+		result->conn = NULL;
+		result->stream = 0;
+
+		/* The client holds the rest of the rows until we ask for them */
+		if (result->resmsg->msgtype == MT_RESULT_CHUNK) {
+			result->conn = conn;
+			result->stream = result->resmsg->stream;
+			conn->nstreams += 1;
+		}
+	} else {
+		/* If conn == NULL, it should have longjump-ed earlier. */
+		plc_elog(ERROR, "Could not create or connect to container.");
+	}
 
-		DeleteBackendsWhenError = true;
-		if (conn != NULL) {
+	DeleteBackendsWhenError = false;
+	return result;
+}
+
+/*
+ * Whether the client was already sent the source of this version of the
+ * function over the connection
+ */
+static bool plcontainer_function_known(plcConn *conn, plcProcInfo *proc) {
+	int i;
+
+	for (i = 0; i < MAX_KNOWN_FUNCS; i++) {
+		if (conn->known_funcs[i].funcOid == proc->funcOid &&
+		    conn->known_funcs[i].version == proc->fn_xmin)
+			return true;
+	}
+	return false;
+}
+
+/*
+ * Remember the function version sent with its source, replacing the oldest
+ * one remembered when the table is full
+ */
+static void plcontainer_function_sent(plcConn *conn, plcProcInfo *proc) {
+	if (plcontainer_function_known(conn, proc))
+		return;
+
+	conn->known_funcs[conn->next_known_func].funcOid = proc->funcOid;
+	conn->known_funcs[conn->next_known_func].version = proc->fn_xmin;
+	conn->next_known_func = (conn->next_known_func + 1) % MAX_KNOWN_FUNCS;
+}
+
+/*
+ * Wait for the result message of the request sent to the client, serving the
+ * SPI, logging and other requests the function issues meanwhile. req is the
+ * call request to repeat with the source if the client no longer has it, or
+ * NULL when waiting for the next chunk of a result set.
+ */
+static plcMsgResult *plcontainer_receive_result(plcConn *conn, plcProcInfo *proc,
+                                                plcMsgCallreq *req) {
+	plcMsgResult * volatile result = NULL;
+	int volatile save_subxact_level = list_length(explicit_subtransactions);
+
+	PG_TRY();
+	{
+		while (1) {
+			plcMessage *answer;
+			int message_type;
 			int res;
 
-			res = plcontainer_channel_send(conn, (plcMessage *) req);
-#ifndef PLC_PG				
-			SIMPLE_FAULT_NAME_INJECTOR("plcontainer_after_send_request");
+			res = plcontainer_channel_receive(conn, &answer, MT_ALL_BITS);
+#ifndef PLC_PG
+			SIMPLE_FAULT_NAME_INJECTOR("plcontainer_after_recv_request");
 #endif
-
 			if (res < 0) {
-				plc_elog(ERROR, "Error sending data to the client. "
+				plc_elog(ERROR, "Error receiving data from the client. "
 							"Maybe retry later.");
-				return NULL;
+				break;
 			}
-			free_callreq(req, true, true);
-
-			while (1) {
-				plcMessage *answer;
-
-				res = plcontainer_channel_receive(conn, &answer, MT_ALL_BITS);
-#ifndef PLC_PG					
-				SIMPLE_FAULT_NAME_INJECTOR("plcontainer_after_recv_request");
-#endif				
-				if (res < 0) {
-					plc_elog(ERROR, "Error receiving data from the client. "
-								"Maybe retry later.");
-					break;
-				}
-
-				message_type = answer->msgtype;
-				switch (message_type) {
-					case MT_RESULT:
-						result = (plcProcResult *) pmalloc(sizeof(plcProcResult));
-						result->resmsg = (plcMsgResult *) answer;
-						result->resrow = 0;
-						break;
-					case MT_EXCEPTION:
-						/* For exception, no need to delete containers. */
-						DeleteBackendsWhenError = false;
-						plcontainer_process_exception((plcMsgError *) answer);
-						break;
-					case MT_SQL:
-						plcontainer_process_sql((plcMsgSQL *) answer, conn, proc);
-						break;
-					case MT_LOG:
-						plcontainer_process_log((plcMsgLog *) answer);
-						break;
-					case MT_QUOTE:
-						plcontainer_process_quote((plcMsgQuote *)answer, conn);
-						break;
-					case MT_SUBTRANSACTION:
-						plcontainer_process_subtransaction(
-								(plcMsgSubtransaction *) answer, conn);
-						break;
-					default:
-						plc_elog(ERROR, "Received unhandled message with type id %d "
-								"from client", message_type);
-						break;
-				}
 
-				if (message_type != MT_SQL && message_type != MT_LOG
-				    && message_type != MT_SUBTRANSACTION && message_type != MT_QUOTE)
+			message_type = answer->msgtype;
+			switch (message_type) {
+				case MT_RESULT:
+				case MT_RESULT_CHUNK:
+					result = (plcMsgResult *) answer;
+					break;
+				case MT_EXCEPTION:
+					/* For exception, no need to delete containers. */
+					DeleteBackendsWhenError = false;
+					plcontainer_process_exception((plcMsgError *) answer);
+					break;
+				case MT_SQL:
+					plcontainer_process_sql((plcMsgSQL *) answer, conn, proc);
+					break;
+				case MT_LOG:
+					plcontainer_process_log((plcMsgLog *) answer);
+					break;
+				case MT_QUOTE:
+					plcontainer_process_quote((plcMsgQuote *)answer, conn);
+					break;
+				case MT_SUBTRANSACTION:
+					plcontainer_process_subtransaction(
+							(plcMsgSubtransaction *) answer, conn);
+					break;
+				case MT_SOURCE_REQUEST:
+					plcontainer_process_source_request(
+							(plcMsgSourceRequest *) answer, conn, proc, req);
+					break;
+				case MT_SLICE_REQUEST:
+					plcontainer_process_slice_request(
+							(plcMsgSliceRequest *) answer, conn, req);
+					break;
+				default:
+					plc_elog(ERROR, "Received unhandled message with type id %d "
+							"from client", message_type);
 					break;
 			}
-		} else {
-			/* If conn == NULL, it should have longjump-ed earlier. */
-			plc_elog(ERROR, "Could not create or connect to container.");
+
+			if (message_type != MT_SQL && message_type != MT_LOG
+			    && message_type != MT_SUBTRANSACTION && message_type != MT_QUOTE
+			    && message_type != MT_SOURCE_REQUEST && message_type != MT_SLICE_REQUEST)
+				break;
 		}
 		/*
 		 * Since plpy will only let you close subtransactions that you
@@ -392,10 +509,68 @@ static plcProcResult *plcontainer_get_result(FunctionCallInfo fcinfo,
 
 	plcontainer_abort_open_subtransactions(save_subxact_level);
 
-	DeleteBackendsWhenError = false;
 	return result;
 }
 
+/*
+ * Replace the consumed chunk of a streamed result set with the next one
+ */
+static void plcontainer_next_chunk(plcProcResult *presult, plcProcInfo *proc) {
+	plcMsgResultNext msg;
+	plcConn *conn = presult->conn;
+	int res;
+
+	free_result(presult->resmsg, false);
+	presult->resmsg = NULL;
+	presult->resrow = 0;
+
+	msg.msgtype = MT_RESULT_NEXT;
+	msg.stream = presult->stream;
+	msg.action = PLC_RESULT_NEXT;
+
+	DeleteBackendsWhenError = true;
+	res = plcontainer_channel_send(conn, (plcMessage *) &msg);
+	if (res < 0) {
+		plc_elog(ERROR, "Error sending data to the client. "
+					"Maybe retry later.");
+		return;
+	}
+
+	presult->resmsg = plcontainer_receive_result(conn, proc, NULL);
+	if (presult->resmsg->msgtype == MT_RESULT) {
+		conn->nstreams -= 1;
+		presult->conn = NULL;
+	}
+	DeleteBackendsWhenError = false;
+}
+
+/*
+ * Let the client drop the rows of a streamed result set we do not need
+ */
+static void plcontainer_close_stream(plcProcResult *presult) {
+	plcMsgResultNext msg;
+
+	msg.msgtype = MT_RESULT_NEXT;
+	msg.stream = presult->stream;
+	msg.action = PLC_RESULT_CANCEL;
+	if (plcontainer_channel_send(presult->conn, (plcMessage *) &msg) < 0)
+		plc_elog(LOG, "Error cancelling result set %d", presult->stream);
+
+	presult->conn->nstreams -= 1;
+	presult->conn = NULL;
+}
+
+/*
+ * Executor shuts down the set-returning function before reading all of its
+ * rows, e.g. because of LIMIT
+ */
+static void plcontainer_stream_shutdown(Datum arg) {
+	plcProcResult *presult = (plcProcResult *) DatumGetPointer(arg);
+
+	if (presult->conn != NULL)
+		plcontainer_close_stream(presult);
+}
+
 /*
  * Processing client results message
  */
@@ -430,6 +605,78 @@ static Datum plcontainer_process_result(FunctionCallInfo fcinfo,
 	return result;
 }
 
+/*
+ * The client has evicted the function from its cache since it was sent the
+ * source, repeat the call with it
+ */
+static void plcontainer_process_source_request(plcMsgSourceRequest *msg, plcConn *conn,
+                                               plcProcInfo *proc, plcMsgCallreq *req) {
+	Oid funcOid = msg->objectid;
+
+	pfree(msg);
+	if (req == NULL || req->objectid != funcOid) {
+		plc_elog(ERROR, "Client requested the source of function %u it was not called for", funcOid);
+		return;
+	}
+
+	req->proc.src = proc->src;
+	plcontainer_function_sent(conn, proc);
+	if (plcontainer_channel_send(conn, (plcMessage *) req) < 0) {
+		plc_elog(ERROR, "Error sending data to the client. "
+					"Maybe retry later.");
+	}
+}
+
+/*
+ * The function reads a slice of an argument that was not sent with the call.
+ * Only the TOAST chunks holding the slice are fetched, unless the value is
+ * compressed: it is then decompressed once for all the slices of the call.
+ */
+static void plcontainer_process_slice_request(plcMsgSliceRequest *msg, plcConn *conn,
+                                              plcMsgCallreq *req) {
+	plcSlicedArg *arg = NULL;
+	struct varlena *slice;
+	plcMsgRaw raw;
+	int32 length = msg->length;
+	int64 offset = msg->offset;
+	int i;
+
+	if (req != NULL) {
+		for (i = 0; i < req->nsliced; i++) {
+			if (req->sliced[i].argument == msg->argument)
+				arg = &req->sliced[i];
+		}
+	}
+	pfree(msg);
+	if (arg == NULL) {
+		plc_elog(ERROR, "Client requested a slice of an argument not sent in slices");
+		return;
+	}
+	if (offset < 0 || length < 0 || length > PLC_SLICE_MAX_SIZE || offset > arg->size) {
+		plc_elog(ERROR, "Client requested an invalid slice of %d bytes at " INT64_FORMAT
+		         " of a " INT64_FORMAT " bytes argument", length, offset, arg->size);
+		return;
+	}
+	if (length > arg->size - offset)
+		length = (int32) (arg->size - offset);
+
+	if (!arg->detoasted && toast_datum_size(PointerGetDatum(arg->source))
+	                       < toast_raw_datum_size(PointerGetDatum(arg->source)) - VARHDRSZ) {
+		arg->source = (char *) heap_tuple_untoast_attr((struct varlena *) arg->source);
+		arg->detoasted = true;
+	}
+
+	slice = heap_tuple_untoast_attr_slice((struct varlena *) arg->source, (int32) offset, length);
+	raw.msgtype = MT_RAW;
+	raw.size = VARSIZE_ANY_EXHDR(slice);
+	raw.data = VARDATA_ANY(slice);
+	if (plcontainer_channel_send(conn, (plcMessage *) &raw) < 0) {
+		plc_elog(ERROR, "Error sending data to the client. "
+					"Maybe retry later.");
+	}
+	pfree(slice);
+}
+
 /*
  * Processing client log message
  */
@@ -514,6 +761,9 @@ static void plcontainer_process_sql(plcMsgSQL *msg, plcConn *conn, plcProcInfo *
 			case MT_RESULT:
 				free_result((plcMsgResult *) res, true);
 				break;
+			case MT_RESULT_COLUMNS:
+				free_columns((plcMsgColumns *) res, true);
+				break;
 			case MT_CALLREQ:
 				free_callreq((plcMsgCallreq *) res, true, true);
 				break;
@@ -595,7 +845,8 @@ plcontainer_function_handler(FunctionCallInfo fcinfo, plcProcInfo *proc)
 
 		/* First time call for SRF or just a call of scalar function */
 		if (!fcinfo->flinfo->fn_retset || bFirstTimeCall) {
-			presult = plcontainer_get_result(fcinfo, proc);
+			presult = plcontainer_get_result(proc,
+			                                 plcontainer_generate_call_request(fcinfo, proc));
 			if (!fcinfo->flinfo->fn_retset) {
 				/*
 				 * SETOF function parameters will be deleted when last row is
@@ -629,10 +880,19 @@ plcontainer_function_handler(FunctionCallInfo fcinfo, plcProcInfo *proc)
 							(errcode(ERRCODE_DATATYPE_MISMATCH), errmsg(
 									"returned object cannot be iterated"), errdetail(
 									"PL/Python set-returning functions must return an iterable object.")));
+
+				/* Rows are streamed, cancel them if the executor stops early */
+				if (presult->conn != NULL)
+					RegisterExprContextCallback(rsi->econtext, plcontainer_stream_shutdown,
+					                            PointerGetDatum(presult));
 			}
 
 			presult = (plcProcResult *) funcctx->user_fctx;
 
+			/* Rows of the current chunk are consumed, wait for the next one */
+			while (presult->resrow >= presult->resmsg->rows && presult->conn != NULL)
+				plcontainer_next_chunk(presult, proc);
+
 			if (presult->resrow < presult->resmsg->rows)
 				rsi->isDone = ExprMultipleResult;
 			else {
@@ -640,6 +900,8 @@ plcontainer_function_handler(FunctionCallInfo fcinfo, plcProcInfo *proc)
 			}
 
 			if (rsi->isDone == ExprEndResult) {
+				UnregisterExprContextCallback(rsi->econtext, plcontainer_stream_shutdown,
+				                              PointerGetDatum(presult));
 				free_result(presult->resmsg, false);
 				pfree(presult);
 				MemoryContextSwitchTo(oldcontext);
@@ -669,10 +931,17 @@ plcontainer_function_handler(FunctionCallInfo fcinfo, plcProcInfo *proc)
 		 * start the iteration again.
 		 */
 		if (fcinfo->flinfo->fn_retset && funcctx->user_fctx != NULL) {
+			UnregisterExprContextCallback(((ReturnSetInfo *) fcinfo->resultinfo)->econtext,
+			                              plcontainer_stream_shutdown,
+			                              PointerGetDatum(funcctx->user_fctx));
 			funcctx->user_fctx = NULL;
 		}
-		if(presult && presult->resmsg) {
-			free_result(presult->resmsg, false);
+		if (presult) {
+			/* The client is not lost, tell it we will not read the rest of rows */
+			if (presult->conn != NULL && !DeleteBackendsWhenError)
+				plcontainer_close_stream(presult);
+			if (presult->resmsg)
+				free_result(presult->resmsg, false);
 			pfree(presult);
 		}
 		MemoryContextSwitchTo(oldcontext);
@@ -697,3 +966,242 @@ plcontainer_function_handler(FunctionCallInfo fcinfo, plcProcInfo *proc)
 
 
 
+
+static bool
+plcontainer_materialize_allowed(FunctionCallInfo fcinfo)
+{
+	ReturnSetInfo *rsi = (ReturnSetInfo *) fcinfo->resultinfo;
+
+	return fcinfo->flinfo->fn_retset && rsi != NULL && IsA(rsi, ReturnSetInfo) &&
+	       (rsi->allowedModes & SFRM_Materialize) != 0 && rsi->expectedDesc != NULL;
+}
+
+/*
+ * Handler for set-returning functions called by an executor node that accepts
+ * a materialized result, like a function scan. Chunks are moved into a
+ * tuplestore as they arrive, so the rows spill to disk beyond work_mem and the
+ * container connection is free again once the function returns.
+ */
+static Datum
+plcontainer_materialize_handler(FunctionCallInfo fcinfo, plcProcInfo *proc)
+{
+	ReturnSetInfo	   *rsi = (ReturnSetInfo *) fcinfo->resultinfo;
+	plcProcResult	   *presult;
+	Tuplestorestate	   *tupstore;
+	TupleDesc			tupdesc;
+	MemoryContext		oldcontext;
+	MemoryContext		tmpcontext;
+	Datum			   *values;
+	bool			   *nulls;
+	uint32				i;
+
+	oldcontext = MemoryContextSwitchTo(rsi->econtext->ecxt_per_query_memory);
+	tupdesc = CreateTupleDescCopy(rsi->expectedDesc);
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	MemoryContextSwitchTo(oldcontext);
+
+	values = palloc0(sizeof(Datum) * tupdesc->natts);
+	nulls = palloc(sizeof(bool) * tupdesc->natts);
+	tmpcontext = AllocSetContextCreate(CurrentMemoryContext,
+	                                   "PL/Container result chunk",
+	                                   ALLOCSET_DEFAULT_MINSIZE,
+	                                   ALLOCSET_DEFAULT_INITSIZE,
+	                                   ALLOCSET_DEFAULT_MAXSIZE);
+
+	presult = plcontainer_get_result(proc, plcontainer_generate_call_request(fcinfo, proc));
+
+	PG_TRY();
+	{
+		while (1) {
+			plcMsgResult *resmsg = presult->resmsg;
+
+			if (resmsg->cols > 1) {
+				plc_elog(ERROR, "Functions returning multiple columns are not supported yet");
+			}
+
+			oldcontext = MemoryContextSwitchTo(tmpcontext);
+			for (i = 0; i < resmsg->rows; i++) {
+				rawdata *raw = &resmsg->data[i][0];
+				HeapTupleData tmptup;
+				HeapTuple tuple;
+				Datum value = (Datum) 0;
+
+				if (!raw->isnull)
+					value = proc->result.infunc(raw->value, &proc->result);
+
+				if (proc->result.type == PLC_DATA_UDT && !raw->isnull) {
+					/* Composite value is the row itself */
+					HeapTupleHeader td = DatumGetHeapTupleHeader(value);
+
+					tmptup.t_len = HeapTupleHeaderGetDatumLength(td);
+					ItemPointerSetInvalid(&(tmptup.t_self));
+					tmptup.t_tableOid = InvalidOid;
+					tmptup.t_data = td;
+					tuple = &tmptup;
+				} else {
+					memset(nulls, true, sizeof(bool) * tupdesc->natts);
+					if (proc->result.type != PLC_DATA_UDT) {
+						values[0] = value;
+						nulls[0] = raw->isnull ? true : false;
+					}
+					tuple = heap_form_tuple(tupdesc, values, nulls);
+				}
+				tuplestore_puttuple(tupstore, tuple);
+			}
+			MemoryContextSwitchTo(oldcontext);
+			MemoryContextReset(tmpcontext);
+
+			if (presult->conn == NULL)
+				break;
+			plcontainer_next_chunk(presult, proc);
+		}
+	}
+	PG_CATCH();
+	{
+		if (presult->conn != NULL && !DeleteBackendsWhenError)
+			plcontainer_close_stream(presult);
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+
+	free_result(presult->resmsg, false);
+	pfree(presult);
+	MemoryContextDelete(tmpcontext);
+
+	rsi->returnMode = SFRM_Materialize;
+	rsi->setResult = tupstore;
+	rsi->setDesc = tupdesc;
+
+	fcinfo->isnull = true;
+	return (Datum) 0;
+}
+
+/*
+ * Handler for functions declared with '# batch: N'. Such a function takes
+ * arrays and returns an array, and the container runs its body once for
+ * every element position. Arguments are shipped N rows per message, so a
+ * whole array costs ceil(size / N) round trips instead of one per element.
+ */
+static Datum
+plcontainer_batch_handler(FunctionCallInfo fcinfo, plcProcInfo *proc)
+{
+	Datum		  **values;
+	bool		  **nulls;
+	Datum		   *resvalues;
+	bool		   *resnulls;
+	plcTypeInfo	   *resType;
+	ArrayType	   *result;
+	MemoryContext	oldcontext;
+	int				nrows = -1;
+	int				start;
+	int				dims[1];
+	int				lbs[1];
+	int				i;
+
+	if (proc->retset || proc->result.type != PLC_DATA_ARRAY) {
+		ereport(ERROR,
+		        (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+			        errmsg("function with '# batch' declaration must return an array")));
+	}
+
+	values = palloc(sizeof(Datum *) * (proc->nargs > 0 ? proc->nargs : 1));
+	nulls = palloc(sizeof(bool *) * (proc->nargs > 0 ? proc->nargs : 1));
+	for (i = 0; i < proc->nargs; i++) {
+		plcTypeInfo *elemType;
+		ArrayType *array;
+		int nelems;
+
+		if (proc->args[i].type != PLC_DATA_ARRAY) {
+			ereport(ERROR,
+			        (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				        errmsg("function with '# batch' declaration must take only array arguments")));
+		}
+
+		/* As for strict functions, a NULL batch gives a NULL result */
+		if (fcinfo->argnull[i])
+			return (Datum) 0;
+
+		array = DatumGetArrayTypeP(fcinfo->arg[i]);
+		if (ARR_NDIM(array) > 1) {
+			ereport(ERROR,
+			        (errcode(ERRCODE_ARRAY_SUBSCRIPT_ERROR),
+				        errmsg("arguments of a batched function must be one-dimensional arrays")));
+		}
+
+		elemType = &proc->args[i].subTypes[0];
+		deconstruct_array(array, plc_type_oid(elemType), elemType->typlen,
+		                  elemType->typbyval, elemType->typalign,
+		                  &values[i], &nulls[i], &nelems);
+		if (nrows >= 0 && nelems != nrows) {
+			ereport(ERROR,
+			        (errcode(ERRCODE_ARRAY_SUBSCRIPT_ERROR),
+				        errmsg("array arguments of a batched function must have the same length")));
+		}
+		nrows = nelems;
+	}
+
+	/* Function without arguments is called once */
+	if (nrows < 0)
+		nrows = 1;
+
+	resType = &proc->result.subTypes[0];
+	resvalues = palloc(sizeof(Datum) * (nrows > 0 ? nrows : 1));
+	resnulls = palloc(sizeof(bool) * (nrows > 0 ? nrows : 1));
+
+	for (start = 0; start < nrows; start += proc->batchSize) {
+		plcProcResult *presult;
+		plcMsgResult *resmsg;
+		int count = Min(proc->batchSize, nrows - start);
+
+		presult = plcontainer_get_result(proc,
+		                                 plcontainer_generate_batch_request(proc, values, nulls,
+		                                                                    start, count));
+		/* The client has compiled the function with the first batch */
+		proc->hasChanged = 0;
+
+		resmsg = presult->resmsg;
+		if (resmsg->cols != 1) {
+			ereport(ERROR,
+			        (errcode(ERRCODE_DATATYPE_MISMATCH),
+				        errmsg("batched call returned %u columns instead of 1", resmsg->cols)));
+		}
+		if (resmsg->rows != (uint32) count) {
+			ereport(ERROR,
+			        (errcode(ERRCODE_CARDINALITY_VIOLATION),
+				        errmsg("batched call of %d rows returned %u rows", count, resmsg->rows)));
+		}
+
+		for (i = 0; i < count; i++) {
+			rawdata *raw = &resmsg->data[i][0];
+
+			resnulls[start + i] = raw->isnull ? true : false;
+			if (raw->isnull) {
+				resvalues[start + i] = (Datum) 0;
+			} else if (resType->type == PLC_DATA_TEXT || plc_type_is_bytea(resType->type) ||
+			           resType->type == PLC_DATA_UDT) {
+				/* Element input functions take a pointer to the value slot */
+				resvalues[start + i] = resType->infunc((char *) &raw->value, resType);
+			} else {
+				resvalues[start + i] = resType->infunc(raw->value, resType);
+			}
+		}
+
+		free_result(resmsg, false);
+		pfree(presult);
+	}
+
+	dims[0] = nrows;
+	lbs[0] = 1;
+	oldcontext = MemoryContextSwitchTo(pl_container_caller_context);
+	if (nrows == 0) {
+		result = construct_empty_array(plc_type_oid(resType));
+	} else {
+		result = construct_md_array(resvalues, resnulls, 1, dims, lbs,
+		                            plc_type_oid(resType), resType->typlen,
+		                            resType->typbyval, resType->typalign);
+	}
+	MemoryContextSwitchTo(oldcontext);
+
+	fcinfo->isnull = false;
+	return PointerGetDatum(result);
+}
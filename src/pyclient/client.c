@@ -40,6 +40,7 @@ int main(int argc UNUSED, char **argv UNUSED) {
 	setenv("CLIENT_LANGUAGE", "pythonclient", 0);
 
 	client_log_level = WARNING;
+	client_message_level = NOTICE;
 
 	sock = start_listener();
 	plc_elog(LOG, "Client has started execution at %s", asctime(timeinfo));
@@ -50,7 +51,7 @@ int main(int argc UNUSED, char **argv UNUSED) {
 	connection_wait(sock);
 	conn = connection_init(sock);
 	if (status == 0) {
-		receive_loop(handle_call, conn);
+		receive_loop(handle_call, handle_result_next, conn);
 	} else {
 		plc_raise_delayed_error();
 	}
@@ -14,6 +14,8 @@
 #include "pyerror.h"
 #include "pyconversions.h"
 
+#include <math.h>
+
 #define dgettext(d, x) (x)
 
 typedef struct PLySubtransactionObject {
@@ -143,6 +145,12 @@ static PyObject *PLy_spi_execute_query(char *query, long limit);
 
 static PyObject *PLy_spi_execute_plan(PyObject *, PyObject *, long);
 
+static int PLy_spi_send_plan(PyObject *, PyObject *, long, plcSqlType, int32);
+
+static plcMsgColumns *PLy_spi_execute_columns_request(PyObject *args, const char *fname);
+
+static PyObject *PLy_spi_columns_to_dict(plcMsgColumns *resp, PyObject **names);
+
 static PyObject *PLy_spi_execute_fetch_result(plcMsgResult *resp);
 
 PyObject *PLy_spi_execute(PyObject *self, PyObject *pyquery);
@@ -485,7 +493,9 @@ static plcMessage *receive_from_frontend() {
 	int res = 0;
 	plcConn *conn = plcconn_global;
 
-	res = plcontainer_channel_receive(conn, &resp, MT_CALLREQ_BIT | MT_RESULT_BIT | MT_SUBTRAN_RESULT_BIT);
+	res = plcontainer_channel_receive(conn, &resp, MT_CALLREQ_BIT | MT_CALLREQ_BATCH_BIT
+	                                   | MT_RESULT_BIT | MT_RESULT_COLUMNS_BIT
+	                                   | MT_SUBTRAN_RESULT_BIT | MT_RESULT_NEXT_BIT);
 	if (res < 0) {
 		raise_execution_error("Error receiving data from the frontend, %d", res);
 		return NULL;
@@ -493,10 +503,16 @@ static plcMessage *receive_from_frontend() {
 
 	switch (resp->msgtype) {
 		case MT_CALLREQ:
+		case MT_CALLREQ_BATCH:
 			handle_call((plcMsgCallreq *) resp, conn);
 			free_callreq((plcMsgCallreq *) resp, false, false);
 			return receive_from_frontend();
+		case MT_RESULT_NEXT:
+			handle_result_next((plcMsgResultNext *) resp, conn);
+			pfree(resp);
+			return receive_from_frontend();
 		case MT_RESULT:
+		case MT_RESULT_COLUMNS:
 			break;
 		case MT_SUBTRAN_RESULT:
 			break;
@@ -591,8 +607,7 @@ PLy_spi_execute_fetch_result(plcMsgResult *resp)
 				/* FIXME: handle the error case. */
 				PyDict_SetItemString(pydict, obj->res->names[j], Py_None);
 			} else {
-				pyval = obj->args[j].conv.inputfunc(obj->res->data[i][j].value,
-						&obj->args[j]);
+				pyval = plc_pyobject_from_rawdata(&obj->res->data[i][j], &obj->args[j]);
 
 				if (PyDict_SetItemString(pydict, obj->res->names[j], pyval)
 						!= 0) {
@@ -611,18 +626,17 @@ PLy_spi_execute_fetch_result(plcMsgResult *resp)
 		PyList_SetItem(result->rows, i, pydict);
 	}
 	ret:
-	free_result(resp, false);
 	plc_free_result_conversions(obj);
+	free_result(resp, false);
 
 	return (PyObject *) result;
 }
 
-static PyObject *
-PLy_spi_execute_plan(PyObject *ob, PyObject *list, long limit) {
+static int
+PLy_spi_send_plan(PyObject *ob, PyObject *list, long limit, plcSqlType sqltype, int32 cursor) {
 	uint32 j;
 	int32 nargs;
 	plcMsgSQL msg;
-	plcMsgResult *resp;
 	plcConn *conn = plcconn_global;
 	plcArgument *args;
 	PLyPlanObject *py_plan;
@@ -630,7 +644,7 @@ PLy_spi_execute_plan(PyObject *ob, PyObject *list, long limit) {
 	if (list != NULL) {
 		if (!PySequence_Check(list) || PyString_Check(list) || PyUnicode_Check(list)) {
 			PLy_exception_set(PyExc_TypeError, "plpy.execute takes a sequence as its second argument");
-			return NULL;
+			return -1;
 		}
 		nargs = PySequence_Length(list);
 	} else
@@ -641,7 +655,7 @@ PLy_spi_execute_plan(PyObject *ob, PyObject *list, long limit) {
 	if (py_plan->nargs != nargs) {
 		PLy_exception_set(PyExc_TypeError, "plpy.execute takes bad argument number: %d vs expected %d",
 			nargs, py_plan->nargs);
-		return NULL;
+		return -1;
 	}
 
 	if (nargs > 0)
@@ -664,7 +678,7 @@ PLy_spi_execute_plan(PyObject *ob, PyObject *list, long limit) {
 				free_arguments(args, j + 1, false, false);
 				Py_DECREF(elem);
 				PLy_exception_set(PyExc_TypeError, "Failed to convert data in pexecute");
-				return NULL;
+				return -1;
 			}
 		} else {
 			/* FIXME: Wrong ? */
@@ -673,15 +687,28 @@ PLy_spi_execute_plan(PyObject *ob, PyObject *list, long limit) {
 	}
 
 	msg.msgtype = MT_SQL;
-	msg.sqltype = SQL_TYPE_PEXECUTE;
+	msg.sqltype = sqltype;
 	msg.pplan = py_plan->pplan;
 	msg.limit = limit;
 	msg.nargs = nargs;
 	msg.args = args;
+	msg.statement = NULL;
+	msg.cursor = cursor;
 
+	PLy_cursor_close_pending();
 	plcontainer_channel_send(conn, (plcMessage *) &msg);
 	free_arguments(args, nargs, false, false);
 
+	return 0;
+}
+
+static PyObject *
+PLy_spi_execute_plan(PyObject *ob, PyObject *list, long limit) {
+	plcMsgResult *resp;
+
+	if (PLy_spi_send_plan(ob, list, limit, SQL_TYPE_PEXECUTE, 0) < 0)
+		return NULL;
+
 	resp = (plcMsgResult *) receive_from_frontend();
 	if (resp == NULL) {
 		PLy_exception_set(PLy_exc_spi_error, "Error receiving data from frontend");
@@ -691,6 +718,768 @@ PLy_spi_execute_plan(PyObject *ob, PyObject *list, long limit) {
 	return PLy_spi_execute_fetch_result(resp);
 }
 
+/*
+ * Send a query or a plan for execution asking for a columnar result. The
+ * arguments are the same as for plpy.execute().
+ */
+static plcMsgColumns *
+PLy_spi_execute_columns_request(PyObject *args, const char *fname) {
+	char *query;
+	PyObject *plan;
+	PyObject *list = NULL;
+	long limit = 0;
+	plcMsgSQL msg;
+	plcMessage *resp;
+
+	if (PyArg_ParseTuple(args, "s|l", &query, &limit)) {
+		msg.msgtype = MT_SQL;
+		msg.sqltype = SQL_TYPE_STATEMENT_COLUMNS;
+		msg.limit = limit;
+		msg.statement = query;
+		PLy_cursor_close_pending();
+		plcontainer_channel_send(plcconn_global, (plcMessage *) &msg);
+	} else {
+		PyErr_Clear();
+		if (!PyArg_ParseTuple(args, "O|Ol", &plan, &list, &limit) || !is_PLyPlanObject(plan)) {
+			PLy_exception_set(PLy_exc_spi_error, "%s expected a query or a plan", fname);
+			return NULL;
+		}
+		if (PLy_spi_send_plan(plan, list, limit, SQL_TYPE_PEXECUTE_COLUMNS, 0) < 0)
+			return NULL;
+	}
+
+	resp = receive_from_frontend();
+	if (resp == NULL) {
+		raise_execution_error("Error receiving data from frontend");
+		return NULL;
+	}
+
+	return (plcMsgColumns *) resp;
+}
+
+static PyObject *
+PLy_column_varlen_value(char *value, int32 len, plcPyType *type) {
+	if (type->type == PLC_DATA_TEXT)
+		return PyString_FromStringAndSize(value, len);
+	return plc_pyobject_from_binary_data(type->type, value, len);
+}
+
+/* Convert a numeric column into a float64 NumPy array in one pass, NULLs become NaN */
+static PyObject *
+PLy_numeric_column_to_ndarray(plcColumn *col, uint32 rows, PyObject *np) {
+	PyObject *arr;
+	Py_buffer view;
+	double *values;
+	uint32 i;
+
+	arr = PyObject_CallMethod(np, "empty", "(Is)", rows, "float64");
+	if (arr == NULL)
+		return NULL;
+	if (PyObject_GetBuffer(arr, &view, PyBUF_CONTIG) < 0) {
+		Py_DECREF(arr);
+		return NULL;
+	}
+
+	values = (double *) view.buf;
+	for (i = 0; i < rows; i++) {
+		if (plc_column_isnull(col, i)) {
+			values[i] = NAN;
+		} else if (plc_numeric_data_to_float8(col->values + col->offsets[i],
+		                                      col->offsets[i + 1] - col->offsets[i], &values[i]) < 0) {
+			PyBuffer_Release(&view);
+			Py_DECREF(arr);
+			return NULL;
+		}
+	}
+
+	PyBuffer_Release(&view);
+	return arr;
+}
+
+/* Copy a fixed-width column into a NumPy array, NULLs become NaN */
+static PyObject *
+PLy_column_to_ndarray(plcColumn *col, plcPyType *type, uint32 rows, PyObject *np) {
+	PyObject *arr;
+	Py_buffer view;
+	const char *dtype;
+	uint32 i;
+
+	switch (type->type) {
+		case PLC_DATA_INT1:
+			dtype = "bool";
+			break;
+		case PLC_DATA_INT2:
+			dtype = "int16";
+			break;
+		case PLC_DATA_INT4:
+			dtype = "int32";
+			break;
+		case PLC_DATA_INT8:
+			dtype = "int64";
+			break;
+		case PLC_DATA_FLOAT4:
+			dtype = "float32";
+			break;
+		default:
+			dtype = "float64";
+			break;
+	}
+
+	arr = PyObject_CallMethod(np, "empty", "(Is)", rows, dtype);
+	if (arr == NULL)
+		return NULL;
+	if (PyObject_GetBuffer(arr, &view, PyBUF_CONTIG) < 0) {
+		Py_DECREF(arr);
+		return NULL;
+	}
+
+	memcpy(view.buf, col->values, rows * plc_get_type_length(type->type));
+	for (i = 0; i < rows; i++) {
+		if (!plc_column_isnull(col, i))
+			continue;
+		if (type->type == PLC_DATA_FLOAT4)
+			((float *) view.buf)[i] = NAN;
+		else
+			((double *) view.buf)[i] = NAN;
+	}
+
+	PyBuffer_Release(&view);
+	return arr;
+}
+
+/*
+ * Convert one column block into a NumPy array if np is given, or into a
+ * list otherwise. Values of dictionary encoded columns are converted once
+ * and shared between the rows.
+ */
+static PyObject *
+PLy_column_to_python(plcColumn *col, plcPyType *type, uint32 rows, PyObject *np) {
+	PyObject *column;
+	PyObject **dict = NULL;
+	PyObject *obj;
+	uint32 i;
+	int32 k;
+
+	if (np != NULL && col->encoding == PLC_COLUMN_FIXED &&
+	    (col->nulls == NULL || type->type == PLC_DATA_FLOAT4 || type->type == PLC_DATA_FLOAT8))
+		return PLy_column_to_ndarray(col, type, rows, np);
+	if (np != NULL && col->encoding == PLC_COLUMN_VARLEN && type->type == PLC_DATA_NUMERIC)
+		return PLy_numeric_column_to_ndarray(col, rows, np);
+
+	if (type->conv.inputfunc == NULL) {
+		PLy_exception_set(PyExc_TypeError, "Type %d is not yet supported by Python container",
+		                  (int) type->type);
+		return NULL;
+	}
+
+	if (np != NULL)
+		column = PyObject_CallMethod(np, "empty", "(Is)", rows, "object");
+	else
+		column = PyList_New(rows);
+	if (column == NULL)
+		return NULL;
+
+	if (col->encoding == PLC_COLUMN_DICT) {
+		dict = malloc(col->nvalues * sizeof(PyObject *));
+		for (k = 0; k < col->nvalues; k++)
+			dict[k] = NULL;
+		for (k = 0; k < col->nvalues; k++) {
+			dict[k] = PLy_column_varlen_value(col->values + col->offsets[k],
+			                                  col->offsets[k + 1] - col->offsets[k], type);
+			if (dict[k] == NULL)
+				goto error;
+		}
+	}
+
+	for (i = 0; i < rows; i++) {
+		if (plc_column_isnull(col, i)) {
+			Py_INCREF(Py_None);
+			obj = Py_None;
+		} else {
+			switch (col->encoding) {
+				case PLC_COLUMN_FIXED:
+					obj = type->conv.inputfunc(col->values + i * plc_get_type_length(type->type), type);
+					break;
+				case PLC_COLUMN_VARLEN:
+					obj = PLy_column_varlen_value(col->values + col->offsets[i],
+					                              col->offsets[i + 1] - col->offsets[i], type);
+					break;
+				case PLC_COLUMN_DICT:
+					if (col->codes[i] < 0 || col->codes[i] >= col->nvalues) {
+						raise_execution_error("Bad dictionary code %d in column result", col->codes[i]);
+						goto error;
+					}
+					obj = dict[col->codes[i]];
+					Py_INCREF(obj);
+					break;
+				default:
+					obj = plc_pyobject_from_rawdata(&col->objects[i], type);
+					break;
+			}
+			if (obj == NULL)
+				goto error;
+		}
+
+		if (np == NULL) {
+			PyList_SET_ITEM(column, i, obj);
+		} else {
+			int res = PySequence_SetItem(column, i, obj);
+			Py_DECREF(obj);
+			if (res < 0)
+				goto error;
+		}
+	}
+
+	if (dict != NULL) {
+		for (k = 0; k < col->nvalues; k++)
+			Py_DECREF(dict[k]);
+		free(dict);
+	}
+	return column;
+
+error:
+	if (dict != NULL) {
+		for (k = 0; k < col->nvalues; k++)
+			Py_XDECREF(dict[k]);
+		free(dict);
+	}
+	Py_DECREF(column);
+	return NULL;
+}
+
+/*
+ * Build a dict of column name to column values. The column names are also
+ * returned in their query order through names.
+ */
+static PyObject *
+PLy_spi_columns_to_dict(plcMsgColumns *resp, PyObject **names) {
+	plcPyType *types;
+	PyObject *np;
+	PyObject *result;
+	PyObject *column;
+	uint32 j;
+
+	*names = PyList_New(resp->cols);
+	result = PyDict_New();
+	if (*names == NULL || result == NULL) {
+		Py_XDECREF(*names);
+		Py_XDECREF(result);
+		return NULL;
+	}
+
+	/* NumPy is optional, without it the columns are returned as lists */
+	np = PyImport_ImportModule("numpy");
+	if (np == NULL)
+		PyErr_Clear();
+
+	types = plc_init_column_conversions(resp->types, resp->cols);
+	for (j = 0; j < resp->cols; j++) {
+		column = PLy_column_to_python(&resp->columns[j], &types[j], resp->rows, np);
+		if (column == NULL || PyDict_SetItemString(result, resp->names[j], column) != 0) {
+			Py_XDECREF(column);
+			Py_DECREF(result);
+			Py_CLEAR(*names);
+			result = NULL;
+			break;
+		}
+		Py_DECREF(column);
+		PyList_SET_ITEM(*names, j, PyString_FromString(resp->names[j]));
+	}
+	plc_free_column_conversions(types, resp->cols);
+	Py_XDECREF(np);
+
+	return result;
+}
+
+/* execute_columns(query="select * from foo", limit=5)
+ * execute_columns(plan=plan, values=(foo, bar), limit=5)
+ */
+PyObject *
+PLy_spi_execute_columns(PyObject *self UNUSED, PyObject *args) {
+	plcMsgColumns *resp;
+	PyObject *names;
+	PyObject *result;
+
+	/* If the execution was terminated we don't need to proceed with SPI */
+	if (plc_is_execution_terminated != 0) {
+		return NULL;
+	}
+
+	resp = PLy_spi_execute_columns_request(args, "plpy.execute_columns");
+	if (resp == NULL)
+		return NULL;
+
+	result = PLy_spi_columns_to_dict(resp, &names);
+	Py_XDECREF(names);
+	free_columns(resp, false);
+
+	return result;
+}
+
+/* execute_df(query="select * from foo", limit=5)
+ * execute_df(plan=plan, values=(foo, bar), limit=5)
+ */
+PyObject *
+PLy_spi_execute_df(PyObject *self UNUSED, PyObject *args) {
+	plcMsgColumns *resp;
+	PyObject *pandas;
+	PyObject *names;
+	PyObject *columns;
+	PyObject *result = NULL;
+
+	/* If the execution was terminated we don't need to proceed with SPI */
+	if (plc_is_execution_terminated != 0) {
+		return NULL;
+	}
+
+	/* Fail before running the query if pandas is not installed */
+	pandas = PyImport_ImportModule("pandas");
+	if (pandas == NULL)
+		return NULL;
+
+	resp = PLy_spi_execute_columns_request(args, "plpy.execute_df");
+	if (resp == NULL) {
+		Py_DECREF(pandas);
+		return NULL;
+	}
+
+	columns = PLy_spi_columns_to_dict(resp, &names);
+	free_columns(resp, false);
+	if (columns != NULL) {
+		result = PyObject_CallMethod(pandas, "DataFrame", "(OOO)", columns, Py_None, names);
+		Py_DECREF(columns);
+		Py_DECREF(names);
+	}
+	Py_DECREF(pandas);
+
+	return result;
+}
+
+/*
+ * Cursor objects read a query result in batches of rows. The first batch
+ * comes back with the open request, and while a batch is converted to
+ * Python the QE already fetches the next one, so that there is at most one
+ * batch in flight and one being iterated.
+ */
+typedef struct PLyCursorObject {
+	PyObject_HEAD
+	int32 id;             /* the QE names the portal after it */
+	long batch;           /* rows asked for by every fetch */
+	bool open;            /* the portal is still open on the QE */
+	bool closed;          /* closed by the user */
+	plcMsgResult *next;   /* fetched batch not converted yet */
+	PyObject *rows;       /* converted rows of the current batch */
+	Py_ssize_t pos;       /* next row to return from rows */
+} PLyCursorObject;
+
+static int32 plc_last_cursor_id = 0;
+
+/*
+ * Cursors freed with their portal still open. A cursor may be freed by the
+ * garbage collector in the middle of an exchange with the QE, such as while
+ * a prefetched batch is on the wire, so it only records its id here and the
+ * portals are closed before the next request starts.
+ */
+static int32 *plc_pending_closes = NULL;
+static int plc_npending_closes = 0;
+static int plc_pending_closes_size = 0;
+
+static PyObject *PLy_cursor_new(long batch);
+
+static void PLy_cursor_dealloc(PyObject *);
+
+static PyObject *PLy_cursor_iternext(PyObject *);
+
+static PyObject *PLy_cursor_fetch(PyObject *, PyObject *);
+
+static PyObject *PLy_cursor_close(PyObject *, PyObject *);
+
+static char PLy_cursor_doc[] = {
+	"Wrapper around a Greenplum cursor"
+};
+
+static PyMethodDef PLy_cursor_methods[] = {
+	{"fetch", PLy_cursor_fetch, METH_VARARGS, NULL},
+	{"close", PLy_cursor_close, METH_NOARGS,  NULL},
+	{NULL, NULL, 0,                           NULL}
+};
+
+PyTypeObject PLy_CursorType = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	"PLyCursor",                  /* tp_name */
+	sizeof(PLyCursorObject),      /* tp_size */
+	0,                            /* tp_itemsize */
+
+	/*
+	 * methods
+	 */
+	PLy_cursor_dealloc,           /* tp_dealloc */
+	0,                            /* tp_print */
+	0,                            /* tp_getattr */
+	0,                            /* tp_setattr */
+	0,                            /* tp_compare */
+	0,                            /* tp_repr */
+	0,                            /* tp_as_number */
+	0,                            /* tp_as_sequence */
+	0,                            /* tp_as_mapping */
+	0,                            /* tp_hash */
+	0,                            /* tp_call */
+	0,                            /* tp_str */
+	0,                            /* tp_getattro */
+	0,                            /* tp_setattro */
+	0,                            /* tp_as_buffer */
+#if PY_MAJOR_VERSION >= 3
+	Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,    /* tp_flags */
+#else
+	Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE | Py_TPFLAGS_HAVE_ITER,    /* tp_flags */
+#endif
+	PLy_cursor_doc,               /* tp_doc */
+	0,                            /* tp_traverse */
+	0,                            /* tp_clear */
+	0,                            /* tp_richcompare */
+	0,                            /* tp_weaklistoffset */
+	PyObject_SelfIter,            /* tp_iter */
+	PLy_cursor_iternext,          /* tp_iternext */
+	PLy_cursor_methods,           /* tp_tpmethods */
+	0,
+	0,
+	0,
+	0,
+	0,
+	0,
+	0,
+	0,
+	0,
+	0,
+	0,
+	0,
+	0,
+	0,
+	0,
+	0,
+	0,
+	0,
+	0,
+};
+
+static PyObject *
+PLy_cursor_new(long batch) {
+	PLyCursorObject *cursor;
+
+	if ((cursor = PyObject_New(PLyCursorObject, &PLy_CursorType)) == NULL)
+		return NULL;
+
+	plc_last_cursor_id = plc_last_cursor_id % 0x7fffffff + 1;
+	cursor->id = plc_last_cursor_id;
+	cursor->batch = batch;
+	cursor->open = false;
+	cursor->closed = false;
+	cursor->next = NULL;
+	cursor->rows = NULL;
+	cursor->pos = 0;
+
+	return (PyObject *) cursor;
+}
+
+static void
+PLy_cursor_send_fetch(PLyCursorObject *cursor) {
+	plcMsgSQL msg;
+
+	msg.msgtype = MT_SQL;
+	msg.sqltype = SQL_TYPE_FETCH;
+	msg.cursor = cursor->id;
+	msg.limit = cursor->batch;
+
+	plcontainer_channel_send(plcconn_global, (plcMessage *) &msg);
+}
+
+/* Receive a batch, a short one means the QE has closed the cursor */
+static plcMsgResult *
+PLy_cursor_receive(PLyCursorObject *cursor) {
+	plcMsgResult *resp;
+
+	resp = (plcMsgResult *) receive_from_frontend();
+	if (resp == NULL) {
+		cursor->open = false;
+		raise_execution_error("Error receiving data from frontend");
+		return NULL;
+	}
+	if (resp->msgtype != MT_RESULT) {
+		cursor->open = false;
+		raise_execution_error("Unexpected message type %c for a cursor fetch", resp->msgtype);
+		return NULL;
+	}
+	if ((long) resp->rows < cursor->batch)
+		cursor->open = false;
+
+	return resp;
+}
+
+/* Make the next batch of rows the current one */
+static int
+PLy_cursor_refill(PLyCursorObject *cursor) {
+	plcMsgResult *resp = cursor->next;
+	PyObject *result;
+
+	cursor->next = NULL;
+	if (resp == NULL) {
+		if (!cursor->open)
+			return 0;
+		PLy_cursor_close_pending();
+		PLy_cursor_send_fetch(cursor);
+		resp = PLy_cursor_receive(cursor);
+		if (resp == NULL)
+			return -1;
+	}
+
+	/* Let the QE fetch the next batch while this one is converted */
+	if (cursor->open)
+		PLy_cursor_send_fetch(cursor);
+	result = PLy_spi_execute_fetch_result(resp);
+	/* The prefetched batch must be taken off the wire before anything else */
+	if (cursor->open) {
+		cursor->next = PLy_cursor_receive(cursor);
+		if (cursor->next == NULL) {
+			Py_XDECREF(result);
+			return -1;
+		}
+	}
+	if (result == NULL)
+		return -1;
+
+	Py_XDECREF(cursor->rows);
+	cursor->rows = ((PLyResultObject *) result)->rows;
+	Py_INCREF(cursor->rows);
+	cursor->pos = 0;
+	Py_DECREF(result);
+
+	return 0;
+}
+
+/* Close the portal of a cursor on the QE */
+static int
+PLy_cursor_send_close(int32 id) {
+	plcMsgSQL msg;
+	plcMessage *resp;
+	plcConn *conn = plcconn_global;
+
+	msg.msgtype = MT_SQL;
+	msg.sqltype = SQL_TYPE_CURSOR_CLOSE;
+	msg.cursor = id;
+	msg.limit = 0;
+
+	plcontainer_channel_send(conn, (plcMessage *) &msg);
+	if (plcontainer_channel_receive(conn, &resp, MT_RAW_BIT) < 0) {
+		raise_execution_error("Error receiving data from the frontend");
+		return -1;
+	}
+	free_rawmsg((plcMsgRaw *) resp);
+	return 0;
+}
+
+/* Close the portals of the cursors freed since the last request */
+void
+PLy_cursor_close_pending(void) {
+	while (plc_npending_closes > 0) {
+		/* If the execution was terminated the portals go with the transaction */
+		if (plc_is_execution_terminated != 0) {
+			plc_npending_closes = 0;
+			return;
+		}
+		plc_npending_closes--;
+		if (PLy_cursor_send_close(plc_pending_closes[plc_npending_closes]) < 0) {
+			plc_npending_closes = 0;
+			return;
+		}
+	}
+}
+
+/* Drop the rows of the cursor kept in the client */
+static void
+PLy_cursor_clear(PLyCursorObject *cursor) {
+	if (cursor->next != NULL) {
+		free_result(cursor->next, false);
+		cursor->next = NULL;
+	}
+	Py_CLEAR(cursor->rows);
+}
+
+static void
+PLy_cursor_dealloc(PyObject *arg) {
+	PLyCursorObject *cursor = (PLyCursorObject *) arg;
+
+	PLy_cursor_clear(cursor);
+
+	/* If the queue cannot grow, the portal is closed with the transaction */
+	if (cursor->open && plc_is_execution_terminated == 0) {
+		if (plc_npending_closes == plc_pending_closes_size) {
+			int size = plc_pending_closes_size > 0 ? 2 * plc_pending_closes_size : 16;
+			int32 *closes = realloc(plc_pending_closes, size * sizeof(int32));
+
+			if (closes != NULL) {
+				plc_pending_closes = closes;
+				plc_pending_closes_size = size;
+			}
+		}
+		if (plc_npending_closes < plc_pending_closes_size)
+			plc_pending_closes[plc_npending_closes++] = cursor->id;
+	}
+
+	arg->ob_type->tp_free(arg);
+}
+
+static PyObject *
+PLy_cursor_iternext(PyObject *self) {
+	PLyCursorObject *cursor = (PLyCursorObject *) self;
+	PyObject *row;
+
+	if (cursor->closed) {
+		PLy_exception_set(PyExc_ValueError, "iterating a closed cursor");
+		return NULL;
+	}
+
+	if (cursor->rows == NULL || cursor->pos >= PyList_Size(cursor->rows)) {
+		/* If the execution was terminated we don't need to proceed with SPI */
+		if (plc_is_execution_terminated != 0)
+			return NULL;
+		if (PLy_cursor_refill(cursor) < 0)
+			return NULL;
+		/* No rows left, stop the iteration */
+		if (cursor->rows == NULL || cursor->pos >= PyList_Size(cursor->rows))
+			return NULL;
+	}
+
+	/* Hand the row over, so that the batch does not keep it alive */
+	row = PyList_GET_ITEM(cursor->rows, cursor->pos);
+	Py_INCREF(Py_None);
+	PyList_SET_ITEM(cursor->rows, cursor->pos, Py_None);
+	cursor->pos++;
+
+	return row;
+}
+
+/* cursor.fetch(count) returns up to count rows as a result object */
+static PyObject *
+PLy_cursor_fetch(PyObject *self, PyObject *args) {
+	PLyCursorObject *cursor = (PLyCursorObject *) self;
+	PLyResultObject *result;
+	PyObject *row;
+	long count;
+
+	if (!PyArg_ParseTuple(args, "l:fetch", &count))
+		return NULL;
+
+	if (cursor->closed) {
+		PLy_exception_set(PyExc_ValueError, "fetch from a closed cursor");
+		return NULL;
+	}
+
+	result = (PLyResultObject *) PLy_result_new();
+	if (result == NULL)
+		return NULL;
+
+	while (PyList_Size(result->rows) < count) {
+		row = PLy_cursor_iternext(self);
+		if (row == NULL) {
+			if (PyErr_Occurred()) {
+				Py_DECREF(result);
+				return NULL;
+			}
+			break;
+		}
+		PyList_Append(result->rows, row);
+		Py_DECREF(row);
+	}
+
+	Py_DECREF(result->status);
+	result->status = PyInt_FromLong(1);
+	Py_DECREF(result->nrows);
+	result->nrows = PyInt_FromLong(PyList_Size(result->rows));
+
+	return (PyObject *) result;
+}
+
+static PyObject *
+PLy_cursor_close(PyObject *self, PyObject *unused UNUSED) {
+	PLyCursorObject *cursor = (PLyCursorObject *) self;
+
+	if (!cursor->closed) {
+		PLy_cursor_clear(cursor);
+		cursor->closed = true;
+		/* If the execution was terminated we don't need to proceed with SPI */
+		if (cursor->open && plc_is_execution_terminated == 0) {
+			cursor->open = false;
+			if (PLy_cursor_send_close(cursor->id) < 0)
+				return NULL;
+		}
+	}
+
+	Py_INCREF(Py_None);
+	return Py_None;
+}
+
+/* cursor(query="select * from foo", batch_size=1000)
+ * cursor(plan=plan, values=(foo, bar), batch_size=1000)
+ */
+PyObject *
+PLy_spi_cursor(PyObject *self UNUSED, PyObject *args) {
+	char *query;
+	PyObject *plan;
+	PyObject *list = NULL;
+	long batch = PLC_CURSOR_BATCH_ROWS;
+	PLyCursorObject *cursor;
+	plcMsgSQL msg;
+
+	/* If the execution was terminated we don't need to proceed with SPI */
+	if (plc_is_execution_terminated != 0) {
+		return NULL;
+	}
+
+	if (PyArg_ParseTuple(args, "s|l", &query, &batch)) {
+		plan = NULL;
+	} else {
+		PyErr_Clear();
+		if (!PyArg_ParseTuple(args, "O|Ol", &plan, &list, &batch) || !is_PLyPlanObject(plan)) {
+			PLy_exception_set(PLy_exc_spi_error, "plpy.cursor expected a query or a plan");
+			return NULL;
+		}
+	}
+
+	if (batch <= 0) {
+		PLy_exception_set(PyExc_ValueError, "plpy.cursor batch size must be positive");
+		return NULL;
+	}
+
+	cursor = (PLyCursorObject *) PLy_cursor_new(batch);
+	if (cursor == NULL)
+		return NULL;
+
+	if (plan == NULL) {
+		msg.msgtype = MT_SQL;
+		msg.sqltype = SQL_TYPE_CURSOR_OPEN;
+		msg.cursor = cursor->id;
+		msg.limit = batch;
+		msg.nargs = 0;
+		msg.args = NULL;
+		msg.pplan = NULL;
+		msg.statement = query;
+		PLy_cursor_close_pending();
+		plcontainer_channel_send(plcconn_global, (plcMessage *) &msg);
+	} else if (PLy_spi_send_plan(plan, list, batch, SQL_TYPE_CURSOR_OPEN, cursor->id) < 0) {
+		Py_DECREF(cursor);
+		return NULL;
+	}
+
+	cursor->open = true;
+	cursor->next = PLy_cursor_receive(cursor);
+	if (cursor->next == NULL) {
+		Py_DECREF(cursor);
+		return NULL;
+	}
+
+	return (PyObject *) cursor;
+}
+
 PyObject *
 PLy_subtransaction(PyObject *self UNUSED, PyObject *unused UNUSED) {
 	return PLy_subtransaction_new();
@@ -756,6 +1545,7 @@ PLy_subtransaction_enter(PyObject *self, PyObject *unused UNUSED) {
 	msg.action = 'n'; /*set operation to enter 'n' */
 	msg.type = 'n';    /* for enter, type is useless */
 
+	PLy_cursor_close_pending();
 	plcontainer_channel_send(conn, (plcMessage *) &msg);
 	resp = (plcMsgSubtransactionResult *) receive_from_frontend();
 	if (resp == NULL) {
@@ -832,6 +1622,7 @@ PLy_subtransaction_exit(PyObject *self, PyObject *args) {
 	} else {
 		msg.type = 'e';
 	}
+	PLy_cursor_close_pending();
 	plcontainer_channel_send(conn, (plcMessage *) &msg);
 	resp = (plcMsgSubtransactionResult *) receive_from_frontend();
 	if (resp == NULL) {
@@ -870,6 +1661,7 @@ PLy_spi_execute_query(char *query, long limit) {
 	msg.limit = limit;
 	msg.statement = query;
 
+	PLy_cursor_close_pending();
 	plcontainer_channel_send(conn, (plcMessage *) &msg);
 
 	resp = (plcMsgResult *) receive_from_frontend();
@@ -939,6 +1731,7 @@ PyObject *PLy_spi_prepare(PyObject *self UNUSED, PyObject *args) {
 		fill_prepare_argument(&msg.args[i], sptr, PLC_DATA_TEXT);
 	}
 
+	PLy_cursor_close_pending();
 	plcontainer_channel_send(conn, (plcMessage *) &msg);
 	free_arguments(msg.args, msg.nargs, false, false);
 
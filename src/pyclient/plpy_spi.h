@@ -13,13 +13,22 @@
 PyTypeObject PLy_PlanType;
 PyTypeObject PLy_SubtransactionType;
 PyTypeObject PLy_ResultType;
+PyTypeObject PLy_CursorType;
 
 PyObject *PLy_spi_execute(PyObject *self, PyObject *pyquery);
 
 PyObject *PLy_spi_prepare(PyObject *self, PyObject *args);
 
+PyObject *PLy_spi_execute_columns(PyObject *self, PyObject *args);
+
+PyObject *PLy_spi_execute_df(PyObject *self, PyObject *args);
+
+PyObject *PLy_spi_cursor(PyObject *self, PyObject *args);
+
 PyObject *PLy_subtransaction(PyObject *, PyObject *);
 
+void PLy_cursor_close_pending(void);
+
 void Ply_spi_exception_init(PyObject *plpy);
 
 #endif /* PLC_PYSPI_H */
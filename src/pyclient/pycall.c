@@ -19,18 +19,54 @@
 #include "pyquote.h"
 #include "plpy_spi.h"
 #include "pycache.h"
+#include "pyslice.h"
 
 #include <Python.h>
 
 plcConn *plcconn_global = NULL;
 
+int32 plc_current_call = 0;
+
+static int32 plc_last_call_id = 0;
+
+/*
+ * Result set of a set-returning function that is sent to the backend in
+ * chunks. It stays open between the chunks, so it keeps everything it needs
+ * to produce the next one even if the function leaves the cache meanwhile.
+ */
+typedef struct plcPyStream {
+	int32 id;
+	int busy;                  /* producing a chunk at the moment */
+	PyObject *iter;
+	PyObject *pySD;
+	char *name;
+	plcPyType *res;
+	struct plcPyStream *next;
+} plcPyStream;
+
+static plcPyStream *plc_streams = NULL;
+
+static int32 plc_last_stream_id = 0;
+
+static void call_function(plcMsgCallreq *req, plcConn *conn);
+
 static char *create_python_func(plcMsgCallreq *req);
 
+static void request_function_source(plcMsgCallreq *req, plcConn *conn);
+
+static plcSlicedArg *find_sliced_argument(plcMsgCallreq *req, int argument);
+
 static PyObject *arguments_to_pytuple(plcPyFunction *pyfunc);
 
 static int process_call_results(plcConn *conn, PyObject *retval, plcPyFunction *pyfunc);
 
-static int fill_rawdata(rawdata *res, PyObject *retval, plcPyFunction *pyfunc);
+static int process_batch_call(plcConn *conn, plcPyFunction *pyfunc);
+
+static int process_stream_chunk(plcConn *conn, plcPyStream *stream);
+
+static void close_stream(plcPyStream *stream);
+
+static int fill_rawdata(rawdata *res, PyObject *retval, plcPyType *type);
 
 static PyObject *PyMainModule = NULL;
 static PyMethodDef moddef[] = {
@@ -55,6 +91,17 @@ static PyMethodDef moddef[] = {
 	 */
 	{"execute",        PLy_spi_execute,    METH_VARARGS, NULL},
 
+	/*
+	 * execute a plan or query, returning the result by columns
+	 */
+	{"execute_columns", PLy_spi_execute_columns, METH_VARARGS, NULL},
+	{"execute_df",      PLy_spi_execute_df,      METH_VARARGS, NULL},
+
+	/*
+	 * open a cursor over a plan or query, fetching its rows in batches
+	 */
+	{"cursor",          PLy_spi_cursor,          METH_VARARGS, NULL},
+
 	/*
 	 * escaping strings
 	 */
@@ -99,8 +146,12 @@ int python_init() {
 			plc_elog (ERROR, "could not initialize PLy_PlanType");
 	if (PyType_Ready(&PLy_ResultType) < 0)
 			plc_elog(ERROR, "could not initialize PLy_ResultType");
+	if (PyType_Ready(&PLy_CursorType) < 0)
+			plc_elog(ERROR, "could not initialize PLy_CursorType");
 	if (PyType_Ready(&PLy_SubtransactionType) < 0)
 			plc_elog (ERROR, "could not initialize PLy_SubtransactionType");
+	if (PyType_Ready(&PLy_SliceReaderType) < 0)
+			plc_elog(ERROR, "could not initialize PLy_SliceReaderType");
 
 	/* create the plpy module */
 #if PY_MAJOR_VERSION >= 3
@@ -140,6 +191,18 @@ int python_init() {
 }
 
 void handle_call(plcMsgCallreq *req, plcConn *conn) {
+	int32 save_call = plc_current_call;
+
+	/* Readers of sliced arguments work only while their call runs */
+	plc_last_call_id = plc_last_call_id % 0x7fffffff + 1;
+	plc_current_call = plc_last_call_id;
+
+	call_function(req, conn);
+
+	plc_current_call = save_call;
+}
+
+static void call_function(plcMsgCallreq *req, plcConn *conn) {
 	PyObject *retval = NULL;
 	PyObject *dict = NULL;
 	PyObject *args = NULL;
@@ -154,6 +217,7 @@ void handle_call(plcMsgCallreq *req, plcConn *conn) {
 
 	serverenc = req->serverenc;
 	client_log_level = req->logLevel;
+	client_message_level = req->clientMinMessages;
 
 	plc_elog(DEBUG1, "python client receives a call");
 
@@ -165,10 +229,16 @@ void handle_call(plcMsgCallreq *req, plcConn *conn) {
 
 	pyfunc = plc_py_function_cache_get(req->objectid);
 
-	if (pyfunc == NULL || req->hasChanged) {
+	if (pyfunc == NULL || req->hasChanged || pyfunc->version != req->version) {
 		char *func;
 		PyObject *val;
 
+		/* The backend sends the source only once, ask for it if we lost it */
+		if (req->proc.src == NULL) {
+			request_function_source(req, conn);
+			return;
+		}
+
 		/* Parse request to get funcion structure */
 		pyfunc = plc_py_init_function(req);
 
@@ -206,6 +276,12 @@ void handle_call(plcMsgCallreq *req, plcConn *conn) {
 		return;
 	}
 
+	if (req->msgtype == MT_CALLREQ_BATCH) {
+		process_batch_call(conn, pyfunc);
+		pyfunc->call = NULL;
+		return;
+	}
+
 	args = arguments_to_pytuple(pyfunc);
 	if (args == NULL) {
 		raise_execution_error("Cannot convert input arguments to Python tuple");
@@ -232,6 +308,19 @@ void handle_call(plcMsgCallreq *req, plcConn *conn) {
 	return;
 }
 
+/*
+ * Called without the source of a function we no longer have cached, the
+ * backend repeats the call with the source on this request
+ */
+static void request_function_source(plcMsgCallreq *req, plcConn *conn) {
+	plcMsgSourceRequest msg;
+
+	msg.msgtype = MT_SOURCE_REQUEST;
+	msg.objectid = req->objectid;
+	if (plcontainer_channel_send(conn, (plcMessage *) &msg) < 0)
+		raise_execution_error("Cannot request the source of function '%s'", req->proc.name);
+}
+
 static char *create_python_func(plcMsgCallreq *req) {
 	int i, plen;
 	const char *sp;
@@ -307,6 +396,16 @@ static char *create_python_func(plcMsgCallreq *req) {
 	return mrc;
 }
 
+static plcSlicedArg *find_sliced_argument(plcMsgCallreq *req, int argument) {
+	int i;
+
+	for (i = 0; i < req->nsliced; i++) {
+		if (req->sliced[i].argument == argument)
+			return &req->sliced[i];
+	}
+	return NULL;
+}
+
 static PyObject *arguments_to_pytuple(plcPyFunction *pyfunc) {
 	PyObject *args;
 	PyObject *arglist;
@@ -330,9 +429,12 @@ static PyObject *arguments_to_pytuple(plcPyFunction *pyfunc) {
 	pos = 1;
 	for (i = 0; i < pyfunc->nargs; i++) {
 		PyObject *arg = NULL;
+		plcSlicedArg *slice;
 
 		/* Get the argument from the callreq structure */
-		if (pyfunc->call->args[i].data.isnull) {
+		if ((slice = find_sliced_argument(pyfunc->call, i)) != NULL) {
+			arg = PLy_slice_reader_new(i, slice->size);
+		} else if (pyfunc->call->args[i].data.isnull) {
 			Py_INCREF(Py_None);
 			arg = Py_None;
 		} else {
@@ -343,8 +445,7 @@ static PyObject *arguments_to_pytuple(plcPyFunction *pyfunc) {
 				                      pyfunc->args[i].type);
 				return NULL;
 			}
-			arg = pyfunc->args[i].conv.inputfunc(pyfunc->call->args[i].data.value,
-			                                     &pyfunc->args[i]);
+			arg = plc_pyobject_from_rawdata(&pyfunc->call->args[i].data, &pyfunc->args[i]);
 		}
 
 		/* Argument cannot be NULL unless some error has happened as Py_None != NULL */
@@ -380,9 +481,36 @@ static int process_call_results(plcConn *conn, PyObject *retval, plcPyFunction *
 	plcMsgResult *res;
 	int retcode = 0;
 
+	if (pyfunc->retset) {
+		plcPyStream *stream;
+		PyObject *iter;
+
+		iter = PyObject_GetIter(retval);
+		if (iter == NULL) {
+			raise_execution_error("Cannot get iterator out of the returned object");
+			return -1;
+		}
+
+		stream = malloc(sizeof(plcPyStream));
+		plc_last_stream_id = plc_last_stream_id % 0x7fffffff + 1;
+		stream->id = plc_last_stream_id;
+		stream->busy = 0;
+		stream->iter = iter;
+		stream->pySD = pyfunc->pySD;
+		Py_INCREF(stream->pySD);
+		stream->name = (pyfunc->res.argName == NULL) ? NULL : strdup(pyfunc->res.argName);
+		stream->res = plc_py_dup_type(&pyfunc->res);
+		stream->next = plc_streams;
+		plc_streams = stream;
+
+		return process_stream_chunk(conn, stream);
+	}
+
 	/* allocate a result */
 	res = malloc(sizeof(plcMsgResult));
 	res->msgtype = MT_RESULT;
+	res->frame = NULL;
+	res->mappings = NULL;
 	res->names = malloc(1 * sizeof(char *));
 	res->names[0] = (pyfunc->res.argName == NULL) ? NULL : strdup(pyfunc->res.argName);
 	res->types = malloc(1 * sizeof(plcType));
@@ -392,62 +520,223 @@ static int process_call_results(plcConn *conn, PyObject *retval, plcPyFunction *
 
 	/* Now we support only functions returning single column */
 	res->cols = 1;
+	res->rows = 1;
+	res->data = malloc(res->rows * sizeof(rawdata *));
+	res->data[0] = malloc(res->cols * sizeof(rawdata));
+	retcode = fill_rawdata(&res->data[0][0], retval, &pyfunc->res);
 
-	if (pyfunc->retset) {
-		int i = 0;
-		int len = 0;
-		PyObject *retobj = retval;
-		PyObject *obj = NULL;
+	/* Cursors freed while computing the result are closed before it */
+	PLy_cursor_close_pending();
 
-		if (PySequence_Check(retval)) {
-			len = PySequence_Length(retval);
-		} else {
-			PyObject *iter = NULL;
+	/* If the output operation succeeded we send the result back */
+	if (retcode == 0 && plc_is_execution_terminated == 0) {
+		/* We manually state that we are sending the data to avoid message interleaving */
+		plc_sending_data = 1;
+		plcontainer_channel_send(conn, (plcMessage *) res);
+		plc_sending_data = 0;
+	}
 
-			iter = PyObject_GetIter(retval);
-			if (iter == NULL) {
-				raise_execution_error("Cannot get iterator out of the returned object");
-				free_result(res, true);
-				return -1;
-			}
+	free_result(res, true);
 
-			retobj = PyList_New(0);
-			obj = PyIter_Next(iter);
-			while (obj != NULL && retcode == 0) {
-				len += 1;
-				retcode = PyList_Append(retobj, obj);
-				Py_DECREF(obj);
-				obj = PyIter_Next(iter);
-			}
-			Py_XDECREF(obj);
-			Py_DECREF(iter);
+	/* After the message is sent we can safely send exceptions */
+	plc_raise_delayed_error();
 
-			if (retcode < 0) {
+	return retcode;
+}
+
+/*
+ * Send the next PLC_RESULT_CHUNK_ROWS rows of a set-returning function. The
+ * stream is closed once its iterator is exhausted or has failed, otherwise
+ * it waits for the backend to ask for the next chunk.
+ */
+static int process_stream_chunk(plcConn *conn, plcPyStream *stream) {
+	plcMsgResult *res;
+	PyObject *obj;
+	int retcode = 0;
+	int done = 0;
+
+	res = malloc(sizeof(plcMsgResult));
+	res->msgtype = MT_RESULT_CHUNK;
+	res->frame = NULL;
+	res->mappings = NULL;
+	res->stream = stream->id;
+	res->names = malloc(1 * sizeof(char *));
+	res->names[0] = (stream->name == NULL) ? NULL : strdup(stream->name);
+	res->types = malloc(1 * sizeof(plcType));
+	res->exception_callback = plc_error_callback;
+	plc_py_copy_type(&res->types[0], &stream->res[0]);
+	res->cols = 1;
+	res->rows = 0;
+	res->data = malloc(PLC_RESULT_CHUNK_ROWS * sizeof(rawdata *));
+
+	stream->busy = 1;
+	while (res->rows < PLC_RESULT_CHUNK_ROWS) {
+		obj = PyIter_Next(stream->iter);
+		if (obj == NULL) {
+			if (PyErr_Occurred()) {
 				raise_execution_error("Error receiving result data from Python iterator");
-				free_result(res, true);
-				return -1;
+				retcode = -1;
 			}
+			done = 1;
+			break;
+		}
+
+		res->data[res->rows] = malloc(res->cols * sizeof(rawdata));
+		retcode = fill_rawdata(&res->data[res->rows][0], obj, &stream->res[0]);
+		res->rows += 1;
+		Py_DECREF(obj);
+		if (retcode != 0)
+			break;
+	}
+	stream->busy = 0;
+
+	if (done)
+		res->msgtype = MT_RESULT;
+
+	PLy_cursor_close_pending();
+	if (retcode == 0 && plc_is_execution_terminated == 0) {
+		plc_sending_data = 1;
+		plcontainer_channel_send(conn, (plcMessage *) res);
+		plc_sending_data = 0;
+	}
+
+	free_result(res, true);
+
+	if (done || retcode != 0 || plc_is_execution_terminated != 0)
+		close_stream(stream);
+
+	plc_raise_delayed_error();
+
+	return retcode;
+}
+
+static void close_stream(plcPyStream *stream) {
+	plcPyStream **prev;
+
+	for (prev = &plc_streams; *prev != NULL; prev = &(*prev)->next) {
+		if (*prev == stream) {
+			*prev = stream->next;
+			break;
 		}
+	}
+
+	Py_DECREF(stream->iter);
+	Py_DECREF(stream->pySD);
+	if (stream->name != NULL)
+		free(stream->name);
+	plc_free_column_conversions(stream->res, 1);
+	free(stream);
+}
+
+/*
+ * Backend asks for the next chunk of a streamed result set, or cancels it
+ * because it does not need the remaining rows
+ */
+void handle_result_next(plcMsgResultNext *msg, plcConn *conn) {
+	plcPyStream *stream;
+	PyObject *dict;
+
+	plcconn_global = conn;
+	plc_sending_data = 0;
+	plc_is_execution_terminated = 0;
+
+	if (msg->action == PLC_RESULT_CANCEL) {
+		plcPyStream *next;
+
+		/* Stream 0 cancels all the result sets that are not being produced */
+		for (stream = plc_streams; stream != NULL; stream = next) {
+			next = stream->next;
+			if ((msg->stream == 0 && !stream->busy) || stream->id == msg->stream)
+				close_stream(stream);
+		}
+		return;
+	}
+
+	for (stream = plc_streams; stream != NULL; stream = stream->next) {
+		if (stream->id == msg->stream)
+			break;
+	}
+	if (stream == NULL || stream->busy) {
+		raise_execution_error("Result set %d is not open", msg->stream);
+		return;
+	}
 
-		res->rows = len;
+	/* The generator refers the SD of its own function */
+	dict = PyModule_GetDict(PyMainModule);
+	if (dict == NULL || PyDict_SetItemString(dict, "SD", stream->pySD) < 0) {
+		raise_execution_error("Cannot set SD dictionary to main module");
+		return;
+	}
+
+	process_stream_chunk(conn, stream);
+}
+
+/*
+ * Call the function once for every argument row of a batched call request
+ * and send all the results back in a single result message, one row per call
+ */
+static int process_batch_call(plcConn *conn, plcPyFunction *pyfunc) {
+	plcMsgCallreq *req = pyfunc->call;
+	plcMsgResult *res;
+	uint32 i;
+	int j;
+	int retcode = 0;
+
+	res = malloc(sizeof(plcMsgResult));
+	res->msgtype = MT_RESULT;
+	res->frame = NULL;
+	res->mappings = NULL;
+	res->names = malloc(1 * sizeof(char *));
+	res->names[0] = (pyfunc->res.argName == NULL) ? NULL : strdup(pyfunc->res.argName);
+	res->types = malloc(1 * sizeof(plcType));
+	res->exception_callback = plc_error_callback;
+	plc_py_copy_type(&res->types[0], &pyfunc->res);
+	res->cols = 1;
+	res->rows = req->nrows;
+	res->data = NULL;
+	if (res->rows > 0) {
 		res->data = malloc(res->rows * sizeof(rawdata *));
 		memset(res->data, 0, res->rows * sizeof(rawdata *));
-		for (i = 0; i < len && retcode == 0; i++) {
-			res->data[i] = malloc(res->cols * sizeof(rawdata));
-			obj = PySequence_GetItem(retobj, i);
-			retcode = fill_rawdata(&res->data[i][0], obj, pyfunc);
-			Py_XDECREF(obj);
+	}
+
+	for (i = 0; i < req->nrows && retcode == 0; i++) {
+		PyObject *args;
+		PyObject *retval;
+
+		/* Arguments of the current row are borrowed from the batch */
+		for (j = 0; j < req->nargs; j++)
+			req->args[j].data = req->rows[i][j];
+
+		args = arguments_to_pytuple(pyfunc);
+		if (args == NULL) {
+			raise_execution_error("Cannot convert input arguments to Python tuple");
+			retcode = -1;
+			break;
 		}
-	} else {
-		res->rows = 1;
-		res->data = malloc(res->rows * sizeof(rawdata *));
-		res->data[0] = malloc(res->cols * sizeof(rawdata));
-		retcode = fill_rawdata(&res->data[0][0], retval, pyfunc);
+
+		plc_is_execution_terminated = 0;
+		retval = PyObject_Call(pyfunc->pyfunc, args, NULL);
+		Py_XDECREF(args);
+		if (retval == NULL || PyErr_Occurred()) {
+			Py_XDECREF(retval);
+			raise_execution_error("Exception occurred in Python during function execution");
+			retcode = -1;
+			break;
+		}
+
+		res->data[i] = malloc(res->cols * sizeof(rawdata));
+		retcode = fill_rawdata(&res->data[i][0], retval, &pyfunc->res);
+		Py_XDECREF(retval);
 	}
 
-	/* If the output operation succeeded we send the result back */
-	if (retcode == 0) {
-		/* We manually state that we are sending the data to avoid message interleaving */
+	/* Give the borrowed values back so that they are freed only once */
+	for (j = 0; j < req->nargs; j++) {
+		req->args[j].data.isnull = 1;
+		req->args[j].data.value = NULL;
+	}
+
+	PLy_cursor_close_pending();
+	if (retcode == 0 && plc_is_execution_terminated == 0) {
 		plc_sending_data = 1;
 		plcontainer_channel_send(conn, (plcMessage *) res);
 		plc_sending_data = 0;
@@ -455,28 +744,27 @@ static int process_call_results(plcConn *conn, PyObject *retval, plcPyFunction *
 
 	free_result(res, true);
 
-	/* After the message is sent we can safely send exceptions */
 	plc_raise_delayed_error();
 
 	return retcode;
 }
 
-static int fill_rawdata(rawdata *res, PyObject *retval, plcPyFunction *pyfunc) {
+static int fill_rawdata(rawdata *res, PyObject *retval, plcPyType *type) {
 	res->value = NULL;
 	if (retval == Py_None) {
 		res->isnull = 1;
 	} else {
 		int ret = 0;
 		res->isnull = 0;
-		if (pyfunc->res.conv.outputfunc == NULL) {
+		if (type->conv.outputfunc == NULL) {
 			raise_execution_error("Type %d is not yet supported by Python container",
-			                      (int) pyfunc->res.type);
+			                      (int) type->type);
 			return -1;
 		}
-		ret = pyfunc->res.conv.outputfunc(retval, &res->value, &pyfunc->res);
+		ret = type->conv.outputfunc(retval, &res->value, type);
 		if (ret != 0) {
 			raise_execution_error("Exception raised converting function output to type %s [%d]",
-			                      plc_get_type_name(pyfunc->res.type), (int) pyfunc->res.type);
+			                      plc_get_type_name(type->type), (int) type->type);
 			return -1;
 		}
 	}
@@ -24,6 +24,7 @@
 
 // Strings are now unicode
 #define PyString_FromString(x) PyUnicode_FromString(x)
+#define PyString_FromStringAndSize(x, n) PyUnicode_FromStringAndSize(x, n)
 #define PyString_AsString(x)   PyUnicode_AsUTF8(x)
 #define PyString_Check(x)      (PyUnicode_Check(x) || PyBytes_Check(x))
 #else
@@ -42,6 +43,9 @@
 // Global connection object
 extern plcConn *plcconn_global;
 
+// Call being executed, nested calls come in with SPI results
+extern int32 plc_current_call;
+
 // Global execution termination flag
 int plc_is_execution_terminated;
 int plc_sending_data;
@@ -52,4 +56,7 @@ int python_init(void);
 // Processing of the Greenplum function call
 void handle_call(plcMsgCallreq *req, plcConn *conn);
 
+// Processing of the request for the next chunk of a set-returning function result
+void handle_result_next(plcMsgResultNext *msg, plcConn *conn);
+
 #endif /* PLC_PYCALL_H */
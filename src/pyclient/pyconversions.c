@@ -13,6 +13,69 @@
 #include "common/comm_utils.h"
 
 #include <Python.h>
+#include <datetime.h>
+#include <ctype.h>
+#include <errno.h>
+#include <math.h>
+
+/*
+ * Numeric values come in the binary form of numeric_send: the number of
+ * base-10000 digits, the weight of the first one, the sign and the display
+ * scale, followed by the digits, each an int16 in network byte order
+ */
+#define PLC_NUMERIC_HDRSZ     8
+#define PLC_NUMERIC_POS       0x0000
+#define PLC_NUMERIC_NEG       0x4000
+#define PLC_NUMERIC_NAN       0xC000
+#define PLC_NUMERIC_PINF      0xD000
+#define PLC_NUMERIC_NINF      0xF000
+#define PLC_NUMERIC_NBASE     10000
+#define PLC_NUMERIC_DEC_DIGITS 4
+#define PLC_NUMERIC_MAX_DSCALE 0x3FFF
+/* Text of the numeric values at most this long is put together on the stack */
+#define PLC_NUMERIC_STACK     128
+
+/*
+ * Date and time values come in the binary form of their send functions, in
+ * network byte order: date as the int32 number of days and timestamp as the
+ * int64 number of microseconds since 2000-01-01, the extremes of the range
+ * being the infinite values, and interval as the int64 microseconds, int32
+ * days and int32 months
+ */
+#define PLC_DATE_NOBEGIN      ((int32) 0x80000000)
+#define PLC_DATE_NOEND        ((int32) 0x7FFFFFFF)
+#define PLC_TIMESTAMP_NOBEGIN ((int64) 0x8000000000000000ULL)
+#define PLC_TIMESTAMP_NOEND   ((int64) 0x7FFFFFFFFFFFFFFFULL)
+#define PLC_USECS_PER_DAY     86400000000LL
+#define PLC_USECS_PER_HOUR    3600000000LL
+#define PLC_USECS_PER_MINUTE  60000000LL
+#define PLC_USECS_PER_SEC     1000000LL
+/* Days from 0000-03-01 to 2000-01-01 in the proleptic Gregorian calendar */
+#define PLC_DATE_EPOCH_DAYS   730425
+#define PLC_PY_MINYEAR        1
+#define PLC_PY_MAXYEAR        9999
+#define PLC_TIMEDELTA_MAX_DAYS 999999999
+#define PLC_UUID_LEN          16
+/* Jsonb is the version byte of jsonb_send followed by the zero-terminated text */
+#define PLC_JSONB_VERSION     1
+
+#ifndef PyDateTime_DELTA_GET_DAYS
+/* Python 2 has no accessors of the fields of timedelta */
+#define PyDateTime_DELTA_GET_DAYS(o)         (((PyDateTime_Delta *) (o))->days)
+#define PyDateTime_DELTA_GET_SECONDS(o)      (((PyDateTime_Delta *) (o))->seconds)
+#define PyDateTime_DELTA_GET_MICROSECONDS(o) (((PyDateTime_Delta *) (o))->microseconds)
+#endif
+
+typedef struct plcNumeric {
+	int ndigits;
+	int weight;
+	int sign;
+	int dscale;
+	const unsigned char *digits;
+} plcNumeric;
+
+/* Converts a Python object into a preallocated fixed-width value */
+typedef int (*plcPyStoreFunc)(PyObject *, char *);
 
 static PyObject *PLyUnicode_Bytes(PyObject *unicode);
 
@@ -45,6 +108,28 @@ static PyObject *plc_pyobject_from_bytea(char *input, plcPyType *type);
 
 static PyObject *plc_pyobject_from_bytea_ptr(char *input, plcPyType *type);
 
+static PyObject *plc_pyobject_from_binary(char *input, plcPyType *type);
+
+static PyObject *plc_pyobject_from_binary_ptr(char *input, plcPyType *type);
+
+static PyObject *plc_pyobject_from_numeric_float(char *input, plcPyType *type);
+
+static PyObject *plc_pyobject_from_numeric_float_ptr(char *input, plcPyType *type);
+
+static PyObject *plc_pyobject_from_numeric_array_float(char *input, plcPyType *type);
+
+static int plc_pyobject_store_int1(PyObject *input, char *out);
+
+static int plc_pyobject_store_int2(PyObject *input, char *out);
+
+static int plc_pyobject_store_int4(PyObject *input, char *out);
+
+static int plc_pyobject_store_int8(PyObject *input, char *out);
+
+static int plc_pyobject_store_float4(PyObject *input, char *out);
+
+static int plc_pyobject_store_float8(PyObject *input, char *out);
+
 static int plc_pyobject_as_int1(PyObject *input, char **output, plcPyType *type);
 
 static int plc_pyobject_as_int2(PyObject *input, char **output, plcPyType *type);
@@ -65,16 +150,44 @@ static int plc_pyobject_as_udt(PyObject *input, char **output, plcPyType *type);
 
 static int plc_pyobject_as_bytea(PyObject *input, char **output, plcPyType *type);
 
+static int plc_pyobject_as_numeric(PyObject *input, char **output, plcPyType *type);
+
+static int plc_pyobject_as_date(PyObject *input, char **output, plcPyType *type);
+
+static int plc_pyobject_as_timestamp(PyObject *input, char **output, plcPyType *type);
+
+static int plc_pyobject_as_timestamptz(PyObject *input, char **output, plcPyType *type);
+
+static int plc_pyobject_as_interval(PyObject *input, char **output, plcPyType *type);
+
+static int plc_pyobject_as_uuid(PyObject *input, char **output, plcPyType *type);
+
+static int plc_pyobject_as_jsonb(PyObject *input, char **output, plcPyType *type);
+
 static void plc_pyobject_iter_free(plcIterator *iter);
 
 static rawdata *plc_pyobject_as_array_next(plcIterator *iter);
 
+static void plc_pyobject_as_array_advance(plcPyArrMeta *meta, plcPyArrPointer *ptrs);
+
+static void plc_pyobject_release_position(plcPyArrMeta *meta, plcPyArrPointer *ptrs);
+
+static char *plc_pyobject_as_array_block(plcIterator *iter, char *nulls);
+
+static bool plc_pyobject_buffer_matches(Py_buffer *view, plcArrayMeta *meta);
+
+static plcPyStoreFunc Ply_get_store_function(plcDatatype dt);
+
 static plcPyInputFunc Ply_get_input_function(plcDatatype dt, bool isArrayElement);
 
 plcPyOutputFunc Ply_get_output_function(plcDatatype dt);
 
 static void plc_parse_type(plcPyType *pytype, plcType *type, char *argName, bool isArrayElement);
 
+static bool plc_parse_numeric_meta(const char *source);
+
+static void plc_use_float_numeric(plcPyType *type);
+
 static PyObject *plc_pyobject_from_int1(char *input, plcPyType *type UNUSED) {
 	return PyInt_FromLong((long) *input);
 }
@@ -107,6 +220,16 @@ static PyObject *plc_pyobject_from_text_ptr(char *input, plcPyType *type UNUSED)
 	return PyString_FromString(*((char **) input));
 }
 
+/*
+ * Convert a received value. Text is decoded with the length it came with
+ * instead of being measured again.
+ */
+PyObject *plc_pyobject_from_rawdata(rawdata *obj, plcPyType *type) {
+	if (type->type == PLC_DATA_TEXT && obj->value != NULL)
+		return PyString_FromStringAndSize(obj->value, obj->len);
+	return type->conv.inputfunc(obj->value, type);
+}
+
 static PyObject *plc_pyobject_from_array_dim(plcArray *arr,
                                              plcPyType *type,
                                              int *idx,
@@ -177,8 +300,7 @@ static PyObject *plc_pyobject_from_udt(char *input, plcPyType *type) {
 			if (udt->data[i].isnull) {
 				PyDict_SetItemString(res, type->subTypes[i].typeName, Py_None);
 			} else {
-				obj = type->subTypes[i].conv.inputfunc(udt->data[i].value,
-				                                       &type->subTypes[i]);
+				obj = plc_pyobject_from_rawdata(&udt->data[i], &type->subTypes[i]);
 				PyDict_SetItemString(res, type->subTypes[i].typeName, obj);
 				Py_XDECREF(obj);
 			}
@@ -204,10 +326,576 @@ static PyObject *plc_pyobject_from_bytea_ptr(char *input, plcPyType *type) {
 	return plc_pyobject_from_bytea(*((char **) input), type);
 }
 
-static int plc_pyobject_as_int1(PyObject *input, char **output, plcPyType *type UNUSED) {
+static int plc_numeric_int16(const unsigned char *p) {
+	return (int16) ((p[0] << 8) | p[1]);
+}
+
+static int plc_numeric_read(const char *data, int32 len, plcNumeric *num) {
+	int i;
+
+	if (len < PLC_NUMERIC_HDRSZ)
+		goto bad;
+	num->ndigits = plc_numeric_int16((const unsigned char *) data);
+	num->weight = plc_numeric_int16((const unsigned char *) data + 2);
+	num->sign = plc_numeric_int16((const unsigned char *) data + 4) & 0xFFFF;
+	num->dscale = plc_numeric_int16((const unsigned char *) data + 6);
+	num->digits = (const unsigned char *) data + PLC_NUMERIC_HDRSZ;
+	if (num->ndigits < 0 || num->dscale < 0 || len != PLC_NUMERIC_HDRSZ + 2 * num->ndigits)
+		goto bad;
+	if (num->sign != PLC_NUMERIC_POS && num->sign != PLC_NUMERIC_NEG) {
+		if (num->sign != PLC_NUMERIC_NAN && num->sign != PLC_NUMERIC_PINF && num->sign != PLC_NUMERIC_NINF)
+			goto bad;
+		return 0;
+	}
+	for (i = 0; i < num->ndigits; i++) {
+		int digit = plc_numeric_int16(num->digits + 2 * i);
+
+		if (digit < 0 || digit >= PLC_NUMERIC_NBASE)
+			goto bad;
+	}
+	return 0;
+
+bad:
+	raise_execution_error("Received a numeric value in a bad format");
+	return -1;
+}
+
+/*
+ * Writes the digits of a finite value as an integer scaled by 10^-dscale,
+ * "-12345E-2" for -123.45, which both Decimal() and strtod() take. Returns
+ * the length of the text, buf has to hold plc_numeric_text_size() bytes.
+ */
+static int plc_numeric_text_size(plcNumeric *num) {
+	int exp10 = (num->weight - num->ndigits + 1) * PLC_NUMERIC_DEC_DIGITS;
+
+	return num->ndigits * PLC_NUMERIC_DEC_DIGITS + (exp10 > 0 ? exp10 : 0) + num->dscale + 16;
+}
+
+static int plc_numeric_text(plcNumeric *num, char *buf) {
+	int exp10 = (num->weight - num->ndigits + 1) * PLC_NUMERIC_DEC_DIGITS;
+	char *pos = buf;
+	int i;
+
+	if (num->sign == PLC_NUMERIC_NEG)
+		*pos++ = '-';
+	if (num->ndigits == 0) {
+		*pos++ = '0';
+		exp10 = 0;
+	}
+	for (i = 0; i < num->ndigits; i++) {
+		int digit = plc_numeric_int16(num->digits + 2 * i);
+
+		pos[0] = (char) ('0' + digit / 1000);
+		pos[1] = (char) ('0' + digit / 100 % 10);
+		pos[2] = (char) ('0' + digit / 10 % 10);
+		pos[3] = (char) ('0' + digit % 10);
+		pos += PLC_NUMERIC_DEC_DIGITS;
+	}
+	/* The digits below the display scale are zeros */
+	while (exp10 < -num->dscale && pos > buf && pos[-1] == '0') {
+		pos--;
+		exp10++;
+	}
+	while (exp10 > -num->dscale) {
+		*pos++ = '0';
+		exp10--;
+	}
+	return (int) (pos - buf) + sprintf(pos, "E%d", exp10);
+}
+
+/*
+ * The nearest double of a numeric value. Values of at most 53 bits of digits
+ * scaled by a power of ten that is exact in a double are converted with one
+ * multiplication or division, which rounds correctly; the others go through
+ * strtod() like numeric_float8 does.
+ */
+static double plc_numeric_float8(plcNumeric *num) {
+	static const double pow10[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+	char stack[PLC_NUMERIC_STACK];
+	char *buf;
+	uint64 mant = 0;
+	int exp10;
+	double res;
+	int i;
+
+	switch (num->sign) {
+		case PLC_NUMERIC_NAN:
+			return NAN;
+		case PLC_NUMERIC_PINF:
+			return INFINITY;
+		case PLC_NUMERIC_NINF:
+			return -INFINITY;
+		default:
+			break;
+	}
+
+	for (i = 0; i < num->ndigits && mant < ((uint64) 1 << 53) / PLC_NUMERIC_NBASE; i++)
+		mant = mant * PLC_NUMERIC_NBASE + plc_numeric_int16(num->digits + 2 * i);
+	if (i == num->ndigits) {
+		exp10 = (num->weight - num->ndigits + 1) * PLC_NUMERIC_DEC_DIGITS;
+		while (exp10 < 0 && mant != 0 && mant % 10 == 0) {
+			mant /= 10;
+			exp10++;
+		}
+		if (mant <= ((uint64) 1 << 53) && exp10 >= -22 && exp10 <= 22) {
+			res = exp10 < 0 ? (double) mant / pow10[-exp10] : (double) mant * pow10[exp10];
+			return num->sign == PLC_NUMERIC_NEG ? -res : res;
+		}
+	}
+
+	i = plc_numeric_text_size(num);
+	buf = i <= PLC_NUMERIC_STACK ? stack : pmalloc(i);
+	plc_numeric_text(num, buf);
+	res = strtod(buf, NULL);
+	if (buf != stack)
+		pfree(buf);
+	return res;
+}
+
+/* Attribute of a module, imported on first use and kept in cache */
+static PyObject *plc_import_attr(PyObject **cache, const char *module, const char *name) {
+	if (*cache == NULL) {
+		PyObject *mod = PyImport_ImportModule(module);
+
+		if (mod == NULL)
+			return NULL;
+		*cache = PyObject_GetAttrString(mod, name);
+		Py_DECREF(mod);
+	}
+	return *cache;
+}
+
+static PyObject *plc_decimal_type(void) {
+	static PyObject *decimal = NULL;
+
+	return plc_import_attr(&decimal, "decimal", "Decimal");
+}
+
+static PyObject *plc_pyobject_from_numeric_data(const char *data, int32 len) {
+	PyObject *decimal;
+	PyObject *res;
+	plcNumeric num;
+	char stack[PLC_NUMERIC_STACK];
+	char *buf;
+	int size;
+
+	if (plc_numeric_read(data, len, &num) < 0)
+		return NULL;
+	decimal = plc_decimal_type();
+	if (decimal == NULL)
+		return NULL;
+
+	switch (num.sign) {
+		case PLC_NUMERIC_NAN:
+			return PyObject_CallFunction(decimal, "s", "NaN");
+		case PLC_NUMERIC_PINF:
+			return PyObject_CallFunction(decimal, "s", "Infinity");
+		case PLC_NUMERIC_NINF:
+			return PyObject_CallFunction(decimal, "s", "-Infinity");
+		default:
+			break;
+	}
+
+	size = plc_numeric_text_size(&num);
+	buf = size <= PLC_NUMERIC_STACK ? stack : pmalloc(size);
+	size = plc_numeric_text(&num, buf);
+	res = PyObject_CallFunction(decimal, "s#", buf, (Py_ssize_t) size);
+	if (buf != stack)
+		pfree(buf);
+	return res;
+}
+
+int plc_numeric_data_to_float8(const char *data, int32 len, double *out) {
+	plcNumeric num;
+
+	if (plc_numeric_read(data, len, &num) < 0)
+		return -1;
+	*out = plc_numeric_float8(&num);
+	return 0;
+}
+
+static PyObject *plc_pyobject_from_numeric_float(char *input, plcPyType *type UNUSED) {
+	double value;
+
+	if (plc_numeric_data_to_float8(input + 4, *((int *) input), &value) < 0)
+		return NULL;
+	return PyFloat_FromDouble(value);
+}
+
+static PyObject *plc_pyobject_from_numeric_float_ptr(char *input, plcPyType *type) {
+	return plc_pyobject_from_numeric_float(*((char **) input), type);
+}
+
+/*
+ * Numeric arrays of functions taking numeric as float are converted into a
+ * block of doubles in one pass, and the lists are built from the block
+ */
+static PyObject *plc_pyobject_from_numeric_array_float(char *input, plcPyType *type) {
+	plcArray *arr = (plcArray *) input;
+	plcPyType elem;
+	PyObject *res;
+	double *block;
+	char *pos;
+	int *idx;
+	int ipos = 0;
+	int i;
+
+	if (arr->meta->ndims == 0)
+		return PyList_New(0);
+
+	block = pmalloc((arr->meta->size > 0 ? arr->meta->size : 1) * sizeof(double));
+	for (i = 0; i < arr->meta->size; i++) {
+		char *value = ((char **) arr->data)[i];
+
+		if (arr->nulls[i] == 0 && plc_numeric_data_to_float8(value + 4, *((int *) value), &block[i]) < 0) {
+			pfree(block);
+			return NULL;
+		}
+	}
+
+	elem = type->subTypes[0];
+	elem.conv.inputfunc = plc_pyobject_from_float8;
+	idx = malloc(sizeof(int) * arr->meta->ndims);
+	memset(idx, 0, sizeof(int) * arr->meta->ndims);
+	pos = (char *) block;
+	res = plc_pyobject_from_array_dim(arr, &elem, idx, &ipos, &pos, sizeof(double), 0);
+	free(idx);
+	pfree(block);
+
+	return res;
+}
+
+static int32 plc_binary_int32(const char *data) {
+	const unsigned char *p = (const unsigned char *) data;
+
+	return (int32) (((uint32) p[0] << 24) | ((uint32) p[1] << 16) | ((uint32) p[2] << 8) | (uint32) p[3]);
+}
+
+static int64 plc_binary_int64(const char *data) {
+	return (int64) (((uint64) (uint32) plc_binary_int32(data) << 32) | (uint32) plc_binary_int32(data + 4));
+}
+
+static void plc_binary_put_int32(char *data, int32 value) {
+	data[0] = (char) ((uint32) value >> 24);
+	data[1] = (char) ((uint32) value >> 16);
+	data[2] = (char) ((uint32) value >> 8);
+	data[3] = (char) value;
+}
+
+static void plc_binary_put_int64(char *data, int64 value) {
+	plc_binary_put_int32(data, (int32) ((uint64) value >> 32));
+	plc_binary_put_int32(data + 4, (int32) value);
+}
+
+/* Proleptic Gregorian date of a day counted from 2000-01-01, year 0 being 1 BC */
+static void plc_date_from_days(int64 days, int *year, int *month, int *day) {
+	int64 z = days + PLC_DATE_EPOCH_DAYS;
+	int64 era = (z >= 0 ? z : z - 146096) / 146097;
+	int64 doe = z - era * 146097;
+	int64 yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+	int64 doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+	int64 mp = (5 * doy + 2) / 153;
+
+	*day = (int) (doy - (153 * mp + 2) / 5 + 1);
+	*month = (int) (mp < 10 ? mp + 3 : mp - 9);
+	*year = (int) (yoe + era * 400 + (*month <= 2));
+}
+
+static int64 plc_days_from_date(int year, int month, int day) {
+	int64 y = year - (month <= 2);
+	int64 era = (y >= 0 ? y : y - 399) / 400;
+	int64 yoe = y - era * 400;
+	int64 doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+	int64 doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+
+	return era * 146097 + doe - PLC_DATE_EPOCH_DAYS;
+}
+
+static int plc_datetime_import(void) {
+	if (PyDateTimeAPI == NULL) {
+		PyDateTime_IMPORT;
+		if (PyDateTimeAPI == NULL) {
+			raise_execution_error("Could not import the datetime module");
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static PyObject *plc_utc_tzinfo(void) {
+	static PyObject *utc = NULL;
+#if PY_MAJOR_VERSION >= 3
+	static PyObject *timezone = NULL;
+
+	if (utc == NULL && plc_import_attr(&timezone, "datetime", "timezone") != NULL)
+		utc = PyObject_GetAttrString(timezone, "utc");
+#else
+	/* Python 2 has no implementation of tzinfo to use */
+	if (utc == NULL) {
+		PyObject *globals = PyDict_New();
+		PyObject *res;
+
+		if (globals == NULL)
+			return NULL;
+		PyDict_SetItemString(globals, "__builtins__", PyEval_GetBuiltins());
+		res = PyRun_String("from datetime import tzinfo, timedelta\n"
+		                   "class UTC(tzinfo):\n"
+		                   "    def utcoffset(self, dt): return timedelta(0)\n"
+		                   "    def dst(self, dt): return timedelta(0)\n"
+		                   "    def tzname(self, dt): return 'UTC'\n"
+		                   "    def __repr__(self): return 'UTC'\n"
+		                   "utc = UTC()\n",
+		                   Py_file_input, globals, globals);
+		if (res != NULL) {
+			Py_DECREF(res);
+			utc = PyDict_GetItemString(globals, "utc");
+			Py_XINCREF(utc);
+		}
+		Py_DECREF(globals);
+	}
+#endif
+	return utc;
+}
+
+/*
+ * Dates and timestamps out of the range of Python come as their text in the
+ * ISO style, like they used to before they were sent in binary
+ */
+static PyObject *plc_datetime_text(int year, int month, int day, int64 usecs, bool withTime, bool withZone) {
+	char buf[64];
+	int len;
+
+	len = snprintf(buf, sizeof(buf), "%04d-%02d-%02d", year > 0 ? year : 1 - year, month, day);
+	if (withTime) {
+		len += snprintf(buf + len, sizeof(buf) - len, " %02d:%02d:%02d",
+		                (int) (usecs / PLC_USECS_PER_HOUR), (int) (usecs / PLC_USECS_PER_MINUTE % 60),
+		                (int) (usecs / PLC_USECS_PER_SEC % 60));
+		if (usecs % PLC_USECS_PER_SEC != 0) {
+			len += snprintf(buf + len, sizeof(buf) - len, ".%06d", (int) (usecs % PLC_USECS_PER_SEC));
+			while (buf[len - 1] == '0')
+				len--;
+		}
+		if (withZone)
+			len += snprintf(buf + len, sizeof(buf) - len, "+00");
+	}
+	if (year <= 0)
+		len += snprintf(buf + len, sizeof(buf) - len, " BC");
+	return PyString_FromStringAndSize(buf, len);
+}
+
+static PyObject *plc_pyobject_from_date_data(const char *data, int32 len) {
+	int32 days;
+	int year, month, day;
+
+	if (len != 4) {
+		raise_execution_error("Received a date value in a bad format");
+		return NULL;
+	}
+	days = plc_binary_int32(data);
+	if (days == PLC_DATE_NOBEGIN)
+		return PyString_FromString("-infinity");
+	if (days == PLC_DATE_NOEND)
+		return PyString_FromString("infinity");
+
+	plc_date_from_days(days, &year, &month, &day);
+	if (year < PLC_PY_MINYEAR || year > PLC_PY_MAXYEAR)
+		return plc_datetime_text(year, month, day, 0, false, false);
+	if (plc_datetime_import() < 0)
+		return NULL;
+	return PyDate_FromDate(year, month, day);
+}
+
+/* Timestamps become naive datetime objects, and timestamptz ones in UTC */
+static PyObject *plc_pyobject_from_timestamp_data(const char *data, int32 len, bool withZone) {
+	PyObject *utc;
+	int64 value;
+	int64 days;
+	int64 usecs;
+	int year, month, day;
+
+	if (len != 8) {
+		raise_execution_error("Received a timestamp value in a bad format");
+		return NULL;
+	}
+	value = plc_binary_int64(data);
+	if (value == PLC_TIMESTAMP_NOBEGIN)
+		return PyString_FromString("-infinity");
+	if (value == PLC_TIMESTAMP_NOEND)
+		return PyString_FromString("infinity");
+
+	days = value / PLC_USECS_PER_DAY;
+	usecs = value % PLC_USECS_PER_DAY;
+	if (usecs < 0) {
+		usecs += PLC_USECS_PER_DAY;
+		days--;
+	}
+	plc_date_from_days(days, &year, &month, &day);
+	if (year < PLC_PY_MINYEAR || year > PLC_PY_MAXYEAR)
+		return plc_datetime_text(year, month, day, usecs, true, withZone);
+	if (plc_datetime_import() < 0)
+		return NULL;
+	if (!withZone)
+		return PyDateTime_FromDateAndTime(year, month, day,
+		                                  (int) (usecs / PLC_USECS_PER_HOUR),
+		                                  (int) (usecs / PLC_USECS_PER_MINUTE % 60),
+		                                  (int) (usecs / PLC_USECS_PER_SEC % 60),
+		                                  (int) (usecs % PLC_USECS_PER_SEC));
+
+	utc = plc_utc_tzinfo();
+	if (utc == NULL)
+		return NULL;
+	return PyDateTimeAPI->DateTime_FromDateAndTime(year, month, day,
+	                                               (int) (usecs / PLC_USECS_PER_HOUR),
+	                                               (int) (usecs / PLC_USECS_PER_MINUTE % 60),
+	                                               (int) (usecs / PLC_USECS_PER_SEC % 60),
+	                                               (int) (usecs % PLC_USECS_PER_SEC),
+	                                               utc, PyDateTimeAPI->DateTimeType);
+}
+
+/*
+ * Intervals with months have no timedelta, as a month has no fixed number of
+ * days. They come as their text in the postgres IntervalStyle, the default.
+ */
+static PyObject *plc_interval_text(int64 usecs, int32 days, int32 months) {
+	static const char *const units[] = {"year", "mon", "day"};
+	int64 fields[3];
+	char buf[128];
+	int len = 0;
+	bool isZero = true;
+	bool isBefore = false;
+	int i;
+
+	fields[0] = months / 12;
+	fields[1] = months % 12;
+	fields[2] = days;
+	for (i = 0; i < 3; i++) {
+		if (fields[i] == 0)
+			continue;
+		len += snprintf(buf + len, sizeof(buf) - len, "%s%s%lld %s%s", isZero ? "" : " ",
+		                isBefore && fields[i] > 0 ? "+" : "", (long long) fields[i], units[i],
+		                fields[i] != 1 ? "s" : "");
+		isBefore = fields[i] < 0;
+		isZero = false;
+	}
+	if (isZero || usecs != 0) {
+		uint64 time = usecs < 0 ? -(uint64) usecs : (uint64) usecs;
+
+		len += snprintf(buf + len, sizeof(buf) - len, "%s%s%02llu:%02d:%02d", isZero ? "" : " ",
+		                usecs < 0 ? "-" : (isBefore ? "+" : ""),
+		                (unsigned long long) (time / PLC_USECS_PER_HOUR),
+		                (int) (time / PLC_USECS_PER_MINUTE % 60), (int) (time / PLC_USECS_PER_SEC % 60));
+		if (time % PLC_USECS_PER_SEC != 0) {
+			len += snprintf(buf + len, sizeof(buf) - len, ".%06d", (int) (time % PLC_USECS_PER_SEC));
+			while (buf[len - 1] == '0')
+				len--;
+		}
+	}
+	return PyString_FromStringAndSize(buf, len);
+}
+
+static PyObject *plc_pyobject_from_interval_data(const char *data, int32 len) {
+	int64 usecs;
+	int64 days;
+	int32 months;
+
+	if (len != 16) {
+		raise_execution_error("Received an interval value in a bad format");
+		return NULL;
+	}
+	usecs = plc_binary_int64(data);
+	days = plc_binary_int32(data + 8);
+	months = plc_binary_int32(data + 12);
+	if (months != 0)
+		return plc_interval_text(usecs, (int32) days, months);
+
+	days += usecs / PLC_USECS_PER_DAY;
+	usecs %= PLC_USECS_PER_DAY;
+	if (days < -PLC_TIMEDELTA_MAX_DAYS || days > PLC_TIMEDELTA_MAX_DAYS) {
+		raise_execution_error("Interval value is out of range for timedelta");
+		return NULL;
+	}
+	if (plc_datetime_import() < 0)
+		return NULL;
+	return PyDelta_FromDSU((int) days, (int) (usecs / PLC_USECS_PER_SEC), (int) (usecs % PLC_USECS_PER_SEC));
+}
+
+static PyObject *plc_pyobject_from_uuid_data(const char *data, int32 len) {
+	static PyObject *uuid = NULL;
+	PyObject *args;
+	PyObject *kwargs;
+	PyObject *res = NULL;
+
+	if (len != PLC_UUID_LEN) {
+		raise_execution_error("Received a uuid value in a bad format");
+		return NULL;
+	}
+	if (plc_import_attr(&uuid, "uuid", "UUID") == NULL)
+		return NULL;
+
+	args = PyTuple_New(0);
+	kwargs = Py_BuildValue("{s:N}", "bytes", PyBytes_FromStringAndSize(data, PLC_UUID_LEN));
+	if (args != NULL && kwargs != NULL)
+		res = PyObject_Call(uuid, args, kwargs);
+	Py_XDECREF(args);
+	Py_XDECREF(kwargs);
+	return res;
+}
+
+/* Jsonb text is parsed by the C decoder of the json module */
+static PyObject *plc_pyobject_from_jsonb_data(const char *data, int32 len) {
+	static PyObject *loads = NULL;
+	PyObject *text;
+	PyObject *res;
+
+	if (len < 2 || data[0] != PLC_JSONB_VERSION || data[len - 1] != '\0') {
+		raise_execution_error("Received a jsonb value in a bad format");
+		return NULL;
+	}
+	if (plc_import_attr(&loads, "json", "loads") == NULL)
+		return NULL;
+
+	text = PyString_FromStringAndSize(data + 1, len - 2);
+	if (text == NULL)
+		return NULL;
+	res = PyObject_CallFunctionObjArgs(loads, text, NULL);
+	Py_DECREF(text);
+	return res;
+}
+
+PyObject *plc_pyobject_from_binary_data(plcDatatype type, const char *data, int32 len) {
+	switch (type) {
+		case PLC_DATA_NUMERIC:
+			return plc_pyobject_from_numeric_data(data, len);
+		case PLC_DATA_DATE:
+			return plc_pyobject_from_date_data(data, len);
+		case PLC_DATA_TIMESTAMP:
+			return plc_pyobject_from_timestamp_data(data, len, false);
+		case PLC_DATA_TIMESTAMPTZ:
+			return plc_pyobject_from_timestamp_data(data, len, true);
+		case PLC_DATA_INTERVAL:
+			return plc_pyobject_from_interval_data(data, len);
+		case PLC_DATA_UUID:
+			return plc_pyobject_from_uuid_data(data, len);
+		case PLC_DATA_JSONB:
+			return plc_pyobject_from_jsonb_data(data, len);
+		default:
+			return PyBytes_FromStringAndSize(data, len);
+	}
+}
+
+static PyObject *plc_pyobject_from_binary(char *input, plcPyType *type) {
+	return plc_pyobject_from_binary_data(type->type, input + 4, *((int *) input));
+}
+
+static PyObject *plc_pyobject_from_binary_ptr(char *input, plcPyType *type) {
+	return plc_pyobject_from_binary(*((char **) input), type);
+}
+
+static int plc_pyobject_store_int1(PyObject *input, char *out) {
 	int res = 0;
-	char *out = (char *) malloc(1);
-	*output = out;
 	if (PyInt_Check(input))
 		*out = (char) PyInt_AsLong(input);
 	else if (PyLong_Check(input))
@@ -221,10 +909,13 @@ static int plc_pyobject_as_int1(PyObject *input, char **output, plcPyType *type
 	return res;
 }
 
-static int plc_pyobject_as_int2(PyObject *input, char **output, plcPyType *type UNUSED) {
+static int plc_pyobject_as_int1(PyObject *input, char **output, plcPyType *type UNUSED) {
+	*output = (char *) malloc(1);
+	return plc_pyobject_store_int1(input, *output);
+}
+
+static int plc_pyobject_store_int2(PyObject *input, char *out) {
 	int res = 0;
-	char *out = (char *) malloc(2);
-	*output = out;
 	if (PyInt_Check(input))
 		*((short *) out) = (short) PyInt_AsLong(input);
 	else if (PyLong_Check(input))
@@ -238,10 +929,13 @@ static int plc_pyobject_as_int2(PyObject *input, char **output, plcPyType *type
 	return res;
 }
 
-static int plc_pyobject_as_int4(PyObject *input, char **output, plcPyType *type UNUSED) {
+static int plc_pyobject_as_int2(PyObject *input, char **output, plcPyType *type UNUSED) {
+	*output = (char *) malloc(2);
+	return plc_pyobject_store_int2(input, *output);
+}
+
+static int plc_pyobject_store_int4(PyObject *input, char *out) {
 	int res = 0;
-	char *out = (char *) malloc(4);
-	*output = out;
 	if (PyInt_Check(input))
 		*((int *) out) = (int) PyInt_AsLong(input);
 	else if (PyLong_Check(input))
@@ -255,10 +949,13 @@ static int plc_pyobject_as_int4(PyObject *input, char **output, plcPyType *type
 	return res;
 }
 
-static int plc_pyobject_as_int8(PyObject *input, char **output, plcPyType *type UNUSED) {
+static int plc_pyobject_as_int4(PyObject *input, char **output, plcPyType *type UNUSED) {
+	*output = (char *) malloc(4);
+	return plc_pyobject_store_int4(input, *output);
+}
+
+static int plc_pyobject_store_int8(PyObject *input, char *out) {
 	int res = 0;
-	char *out = (char *) malloc(8);
-	*output = out;
 	if (PyLong_Check(input))
 		*((long long *) out) = (long long) PyLong_AsLongLong(input);
 	else if (PyInt_Check(input))
@@ -272,10 +969,13 @@ static int plc_pyobject_as_int8(PyObject *input, char **output, plcPyType *type
 	return res;
 }
 
-static int plc_pyobject_as_float4(PyObject *input, char **output, plcPyType *type UNUSED) {
+static int plc_pyobject_as_int8(PyObject *input, char **output, plcPyType *type UNUSED) {
+	*output = (char *) malloc(8);
+	return plc_pyobject_store_int8(input, *output);
+}
+
+static int plc_pyobject_store_float4(PyObject *input, char *out) {
 	int res = 0;
-	char *out = (char *) malloc(4);
-	*output = out;
 	if (PyFloat_Check(input))
 		*((float *) out) = (float) PyFloat_AsDouble(input);
 	else if (PyLong_Check(input))
@@ -289,10 +989,13 @@ static int plc_pyobject_as_float4(PyObject *input, char **output, plcPyType *typ
 	return res;
 }
 
-static int plc_pyobject_as_float8(PyObject *input, char **output, plcPyType *type UNUSED) {
+static int plc_pyobject_as_float4(PyObject *input, char **output, plcPyType *type UNUSED) {
+	*output = (char *) malloc(4);
+	return plc_pyobject_store_float4(input, *output);
+}
+
+static int plc_pyobject_store_float8(PyObject *input, char *out) {
 	int res = 0;
-	char *out = (char *) malloc(8);
-	*output = out;
 	if (PyFloat_Check(input))
 		*((double *) out) = (double) PyFloat_AsDouble(input);
 	else if (PyLong_Check(input))
@@ -306,11 +1009,57 @@ static int plc_pyobject_as_float8(PyObject *input, char **output, plcPyType *typ
 	return res;
 }
 
+static int plc_pyobject_as_float8(PyObject *input, char **output, plcPyType *type UNUSED) {
+	*output = (char *) malloc(8);
+	return plc_pyobject_store_float8(input, *output);
+}
+
+#if PY_MAJOR_VERSION >= 3
+/* Whether the strings of Python 3 can be taken in their UTF-8 form */
+static bool plc_server_utf8(void) {
+	return serverenc != NULL && strcmp(serverenc, "UTF8") == 0;
+}
+#endif
+
+/* Copy the bytes of a string of known length into a new zero-terminated one */
+static char *plc_text_copy(const char *data, Py_ssize_t len) {
+	char *res = pmalloc(len + 1);
+
+	memcpy(res, data, len);
+	res[len] = '\0';
+	return res;
+}
+
+/*
+ * Strings are copied once knowing their length. Python 3 keeps the UTF-8
+ * form of a str, which is the text itself in a UTF-8 database.
+ */
 static int plc_pyobject_as_text(PyObject *input, char **output, plcPyType *type UNUSED) {
 
 	PyObject *plrv_bo;
+	char *data;
+	Py_ssize_t len;
 	int res = 0;
 
+#if PY_MAJOR_VERSION >= 3
+	if (PyUnicode_Check(input) && plc_server_utf8()) {
+		data = (char *) PyUnicode_AsUTF8AndSize(input, &len);
+		if (data == NULL) {
+			*output = NULL;
+			raise_execution_error("Exception occurred transforming result object to text");
+			return -1;
+		}
+		*output = plc_text_copy(data, len);
+		return 0;
+	}
+#else
+	if (PyString_Check(input)) {
+		PyString_AsStringAndSize(input, &data, &len);
+		*output = plc_text_copy(data, len);
+		return 0;
+	}
+#endif
+
 	if (PyUnicode_Check(input))
 		plrv_bo = PLyUnicode_Bytes(input);
 	else if (PyFloat_Check(input)) {
@@ -325,7 +1074,7 @@ static int plc_pyobject_as_text(PyObject *input, char **output, plcPyType *type
 #endif
 	} else {
 #if PY_MAJOR_VERSION >= 3
-		PyObject *s = PyObject_Str(plrv);
+		PyObject *s = PyObject_Str(input);
 
 		plrv_bo = PLyUnicode_Bytes(s);
 		Py_XDECREF(s);
@@ -338,7 +1087,8 @@ static int plc_pyobject_as_text(PyObject *input, char **output, plcPyType *type
 				raise_execution_error("Exception occurred transforming result object to text");
 				res = -1;
 	} else {
-		*output = pstrdup(PyBytes_AsString(plrv_bo));
+		PyBytes_AsStringAndSize(plrv_bo, &data, &len);
+		*output = plc_text_copy(data, len);
 		Py_XDECREF(plrv_bo);
 	}
 
@@ -350,6 +1100,9 @@ static void plc_pyobject_iter_free(plcIterator *iter) {
 	plcPyArrMeta *pymeta;
 	meta = (plcArrayMeta *) iter->meta;
 	pymeta = (plcPyArrMeta *) iter->payload;
+	plc_pyobject_release_position(pymeta, (plcPyArrPointer *) iter->position);
+	if (pymeta->block != NULL)
+		pfree(pymeta->block);
 	pfree(meta->dims);
 	pfree(pymeta->dims);
 	pfree(iter->meta);
@@ -380,6 +1133,15 @@ static rawdata *plc_pyobject_as_array_next(plcIterator *iter) {
 	}
 	Py_XDECREF(obj);
 
+	plc_pyobject_as_array_advance(meta, ptrs);
+
+	return res;
+}
+
+/* Moves the position to the next element of the innermost dimension */
+static void plc_pyobject_as_array_advance(plcPyArrMeta *meta, plcPyArrPointer *ptrs) {
+	int ptr = meta->ndims - 1;
+
 	while (ptr >= 0) {
 		ptrs[ptr].pos += 1;
 		/* If we finished up iterating over this dimension */
@@ -400,8 +1162,114 @@ static rawdata *plc_pyobject_as_array_next(plcIterator *iter) {
 			break;
 		}
 	}
+}
 
-	return res;
+/* Drops the references the position still holds if it was not iterated to the end */
+static void plc_pyobject_release_position(plcPyArrMeta *meta, plcPyArrPointer *ptrs) {
+	int i;
+
+	for (i = 0; i < meta->ndims; i++) {
+		Py_XDECREF(ptrs[i].obj);
+		ptrs[i].obj = NULL;
+	}
+}
+
+/*
+ * Checks whether the exporter's buffer can be sent as the array block as is:
+ * C-contiguous, of the same shape and holding native values of the same kind
+ * and width as the array element type
+ */
+static bool plc_pyobject_buffer_matches(Py_buffer *view, plcArrayMeta *meta) {
+	const char *fmt = view->format != NULL ? view->format : "B";
+	const int one = 1;
+	int i;
+
+	if (view->ndim != meta->ndims || view->itemsize != plc_get_type_length(meta->type))
+		return false;
+	for (i = 0; i < view->ndim; i++) {
+		if (view->shape == NULL || view->shape[i] != meta->dims[i])
+			return false;
+	}
+
+	/* '<' is native only on little-endian hosts, '>' and '!' never are here */
+	if (*fmt == '@' || *fmt == '=' || (*fmt == '<' && *((const char *) &one) == 1))
+		fmt++;
+	if (fmt[0] == '\0' || fmt[1] != '\0')
+		return false;
+
+	switch (meta->type) {
+		case PLC_DATA_INT1:
+			return *fmt == '?' || *fmt == 'b';
+		case PLC_DATA_INT2:
+		case PLC_DATA_INT4:
+		case PLC_DATA_INT8:
+			return strchr("hilq", *fmt) != NULL;
+		case PLC_DATA_FLOAT4:
+		case PLC_DATA_FLOAT8:
+			return *fmt == 'f' || *fmt == 'd';
+		default:
+			return false;
+	}
+}
+
+/*
+ * Returns all the elements of a fixed-width array as one block. Objects that
+ * export a matching buffer (i.e. NumPy arrays) are copied with a single
+ * memcpy, anything else is walked once converting the elements in place
+ */
+static char *plc_pyobject_as_array_block(plcIterator *iter, char *nulls) {
+	plcArrayMeta *arrmeta;
+	plcPyArrMeta *meta;
+	plcPyArrPointer *ptrs;
+	PyObject *input;
+	plcPyStoreFunc store;
+	size_t len;
+	int i;
+
+	arrmeta = iter->meta;
+	meta = (plcPyArrMeta *) iter->payload;
+	ptrs = (plcPyArrPointer *) iter->position;
+	input = (PyObject *) iter->data;
+	len = (size_t) plc_get_type_length(arrmeta->type);
+	store = Ply_get_store_function(arrmeta->type);
+	if (store == NULL)
+		return NULL;
+
+	meta->block = pmalloc((size_t) arrmeta->size * len);
+	memset(meta->block, 0, (size_t) arrmeta->size * len);
+
+	if (PyObject_CheckBuffer(input)) {
+		Py_buffer view;
+
+		if (PyObject_GetBuffer(input, &view, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) == 0) {
+			bool matches = plc_pyobject_buffer_matches(&view, arrmeta);
+
+			if (matches)
+				memcpy(meta->block, view.buf, (size_t) arrmeta->size * len);
+			PyBuffer_Release(&view);
+			if (matches) {
+				plc_pyobject_release_position(meta, ptrs);
+				return meta->block;
+			}
+		} else {
+			PyErr_Clear();
+		}
+	}
+
+	for (i = 0; i < arrmeta->size; i++) {
+		PyObject *obj;
+
+		obj = PySequence_GetItem(ptrs[meta->ndims - 1].obj, ptrs[meta->ndims - 1].pos);
+		if (obj == NULL || obj == Py_None) {
+			nulls[i >> 3] |= (char) (1 << (i & 7));
+		} else {
+			store(obj, meta->block + (size_t) i * len);
+		}
+		Py_XDECREF(obj);
+		plc_pyobject_as_array_advance(meta, ptrs);
+	}
+
+	return meta->block;
 }
 
 static int plc_pyobject_as_array(PyObject *input, char **output, plcPyType *type) {
@@ -452,6 +1320,7 @@ static int plc_pyobject_as_array(PyObject *input, char **output, plcPyType *type
 		meta->dims = (size_t *) pmalloc(ndims * sizeof(size_t));
 		meta->outputfunc = Ply_get_output_function(type->subTypes[0].type);
 		meta->type = &type->subTypes[0];
+		meta->block = NULL;
 
 		for (i = 0; i < ndims; i++) {
 			meta->dims[i] = dims[i];
@@ -475,6 +1344,7 @@ static int plc_pyobject_as_array(PyObject *input, char **output, plcPyType *type
 
 		/* Initializing "next" and "cleanup" functions */
 		iter->next = plc_pyobject_as_array_next;
+		iter->block = plc_pyobject_as_array_block;
 		iter->cleanup = plc_pyobject_iter_free;
 
 		*output = (char *) iter;
@@ -569,6 +1439,337 @@ static int plc_pyobject_as_bytea(PyObject *input, char **output, plcPyType *type
 	return 0;
 }
 
+/*
+ * Values sent like bytea start with a byte telling how the len bytes after it
+ * are read: PLC_FORM_* for the types with a binary form, the version for jsonb
+ */
+static char *plc_binary_alloc(int32 len, char first) {
+	char *res = pmalloc(len + 5);
+
+	*((int *) res) = len + 1;
+	res[4] = first;
+	return res;
+}
+
+/*
+ * Decimal, int, long and str values are converted from their text and float
+ * from its shortest repr, exactly, into the binary form of numeric_send
+ */
+static int plc_pyobject_as_numeric(PyObject *input, char **output, plcPyType *type UNUSED) {
+	static const int pow10[] = {1, 10, 100, 1000};
+	PyObject *text;
+	const char *str;
+	char *digits;
+	bool sawDigit = false;
+	bool sawPoint = false;
+	int ndigits = 0;
+	long fraction = 0;
+	long exp10 = 0;
+	int sign = PLC_NUMERIC_POS;
+	int weight = 0;
+	long dscale = 0;
+	int ngroups = 0;
+	int16 *groups = NULL;
+	char *res;
+	int i;
+
+	*output = NULL;
+	if (PyFloat_Check(input)) {
+		char *repr = PyOS_double_to_string(PyFloat_AsDouble(input), 'r', 0, 0, NULL);
+
+		text = repr != NULL ? PyBytes_FromString(repr) : NULL;
+		PyMem_Free(repr);
+	} else if (PyBool_Check(input))
+		text = PyBytes_FromString(input == Py_True ? "1" : "0");
+	else if (PyUnicode_Check(input))
+		text = PLyUnicode_Bytes(input);
+	else
+		text = PyObject_Str(input);
+	if (text == NULL) {
+		raise_execution_error("Exception occurred transforming result object to numeric");
+		return -1;
+	}
+	str = PyBytes_AsString(text);
+	digits = pmalloc(strlen(str) + 1);
+
+	while (isspace((unsigned char) *str))
+		str++;
+	if (*str == '-' || *str == '+') {
+		if (*str == '-')
+			sign = PLC_NUMERIC_NEG;
+		str++;
+	}
+	if (strncasecmp(str, "nan", 3) == 0) {
+		sign = PLC_NUMERIC_NAN;
+		str += 3;
+	} else if (strncasecmp(str, "inf", 3) == 0) {
+		sign = sign == PLC_NUMERIC_NEG ? PLC_NUMERIC_NINF : PLC_NUMERIC_PINF;
+		str += strncasecmp(str, "infinity", 8) == 0 ? 8 : 3;
+	} else {
+		/* The digits are kept without the point and the leading zeros */
+		for (; isdigit((unsigned char) *str) || (*str == '.' && !sawPoint); str++) {
+			if (*str == '.') {
+				sawPoint = true;
+				continue;
+			}
+			sawDigit = true;
+			if (sawPoint)
+				fraction++;
+			if (ndigits > 0 || *str != '0')
+				digits[ndigits++] = *str;
+		}
+		if (!sawDigit)
+			goto bad;
+		if (*str == 'e' || *str == 'E') {
+			char *end;
+
+			errno = 0;
+			exp10 = strtol(str + 1, &end, 10);
+			if (end == str + 1 || errno != 0 || exp10 > 1000000 || exp10 < -1000000)
+				goto bad;
+			str = end;
+		}
+		dscale = fraction - exp10 > 0 ? fraction - exp10 : 0;
+		if (dscale > PLC_NUMERIC_MAX_DSCALE)
+			goto range;
+	}
+	while (isspace((unsigned char) *str))
+		str++;
+	if (*str != '\0')
+		goto bad;
+
+	/*
+	 * Digit i stands for 10^(exp10 - fraction + ndigits - 1 - i) and goes to
+	 * the base-10000 digit of the power divided by 4, rounded down
+	 */
+	if (ndigits > 0) {
+		long low = exp10 - fraction;
+		long high = low + ndigits - 1;
+		long lowGroup = low >= 0 ? low / 4 : -((-low + 3) / 4);
+		long highGroup = high >= 0 ? high / 4 : -((-high + 3) / 4);
+
+		if (highGroup > 0x7FFF || lowGroup < -0x7FFF)
+			goto range;
+		weight = (int) highGroup;
+		ngroups = (int) (highGroup - lowGroup + 1);
+		groups = pmalloc(ngroups * sizeof(int16));
+		memset(groups, 0, ngroups * sizeof(int16));
+		for (i = 0; i < ndigits; i++) {
+			long power = high - i;
+			long group = power >= 0 ? power / 4 : -((-power + 3) / 4);
+
+			groups[weight - group] += (int16) ((digits[i] - '0') * pow10[power - group * 4]);
+		}
+		/* Trailing zero digits are not sent */
+		while (groups[ngroups - 1] == 0)
+			ngroups--;
+	} else if (sign == PLC_NUMERIC_NEG) {
+		sign = PLC_NUMERIC_POS;
+	}
+
+	res = plc_binary_alloc(PLC_NUMERIC_HDRSZ + 2 * ngroups, PLC_FORM_BINARY);
+	res[5] = (char) (ngroups >> 8);
+	res[6] = (char) ngroups;
+	res[7] = (char) (weight >> 8);
+	res[8] = (char) weight;
+	res[9] = (char) (sign >> 8);
+	res[10] = (char) sign;
+	res[11] = (char) (dscale >> 8);
+	res[12] = (char) dscale;
+	for (i = 0; i < ngroups; i++) {
+		res[13 + 2 * i] = (char) (groups[i] >> 8);
+		res[14 + 2 * i] = (char) groups[i];
+	}
+	if (groups != NULL)
+		pfree(groups);
+	pfree(digits);
+	Py_DECREF(text);
+	*output = res;
+	return 0;
+
+range:
+	raise_execution_error("Value \"%s\" is out of range for type numeric", PyBytes_AsString(text));
+	pfree(digits);
+	Py_DECREF(text);
+	return -1;
+
+bad:
+	raise_execution_error("Invalid input syntax for type numeric: \"%s\"", PyBytes_AsString(text));
+	pfree(digits);
+	Py_DECREF(text);
+	return -1;
+}
+
+/* Objects the client has no binary form of are sent as their zero-terminated text */
+static int plc_pyobject_as_binary_text(PyObject *input, char **output) {
+	char *text;
+	int32 len;
+
+	if (plc_pyobject_as_text(input, &text, NULL) < 0)
+		return -1;
+	len = strlen(text) + 1;
+	*output = plc_binary_alloc(len, PLC_FORM_TEXT);
+	memcpy(*output + 5, text, len);
+	pfree(text);
+	return 0;
+}
+
+/* Microseconds since 2000-01-01 of the wall clock time of a date or datetime */
+static int64 plc_datetime_usecs(PyObject *input) {
+	int64 usecs = plc_days_from_date(PyDateTime_GET_YEAR(input), PyDateTime_GET_MONTH(input),
+	                                 PyDateTime_GET_DAY(input)) * PLC_USECS_PER_DAY;
+
+	if (PyDateTime_Check(input)) {
+		usecs += PyDateTime_DATE_GET_HOUR(input) * PLC_USECS_PER_HOUR
+		         + PyDateTime_DATE_GET_MINUTE(input) * PLC_USECS_PER_MINUTE
+		         + PyDateTime_DATE_GET_SECOND(input) * PLC_USECS_PER_SEC
+		         + PyDateTime_DATE_GET_MICROSECOND(input);
+	}
+	return usecs;
+}
+
+static int plc_pyobject_as_date(PyObject *input, char **output, plcPyType *type UNUSED) {
+	if (plc_datetime_import() < 0)
+		return -1;
+	if (!PyDate_Check(input))
+		return plc_pyobject_as_binary_text(input, output);
+
+	*output = plc_binary_alloc(4, PLC_FORM_BINARY);
+	plc_binary_put_int32(*output + 5, (int32) plc_days_from_date(PyDateTime_GET_YEAR(input),
+	                                                              PyDateTime_GET_MONTH(input),
+	                                                              PyDateTime_GET_DAY(input)));
+	return 0;
+}
+
+/* The time zone of a datetime is ignored for timestamp, like in its text */
+static int plc_pyobject_as_timestamp(PyObject *input, char **output, plcPyType *type UNUSED) {
+	if (plc_datetime_import() < 0)
+		return -1;
+	if (!PyDate_Check(input))
+		return plc_pyobject_as_binary_text(input, output);
+
+	*output = plc_binary_alloc(8, PLC_FORM_BINARY);
+	plc_binary_put_int64(*output + 5, plc_datetime_usecs(input));
+	return 0;
+}
+
+/*
+ * Only aware datetime objects are converted to UTC here, the naive ones go as
+ * text to be taken in the time zone of the session
+ */
+static int plc_pyobject_as_timestamptz(PyObject *input, char **output, plcPyType *type UNUSED) {
+	PyObject *offset;
+	int64 usecs;
+
+	if (plc_datetime_import() < 0)
+		return -1;
+	if (!PyDateTime_Check(input))
+		return plc_pyobject_as_binary_text(input, output);
+
+	offset = PyObject_CallMethod(input, "utcoffset", NULL);
+	if (offset == NULL) {
+		raise_execution_error("Could not get the UTC offset of a datetime object");
+		return -1;
+	}
+	if (!PyDelta_Check(offset)) {
+		Py_DECREF(offset);
+		return plc_pyobject_as_binary_text(input, output);
+	}
+
+	usecs = plc_datetime_usecs(input)
+	        - ((int64) PyDateTime_DELTA_GET_DAYS(offset) * PLC_USECS_PER_DAY
+	           + (int64) PyDateTime_DELTA_GET_SECONDS(offset) * PLC_USECS_PER_SEC
+	           + PyDateTime_DELTA_GET_MICROSECONDS(offset));
+	Py_DECREF(offset);
+	*output = plc_binary_alloc(8, PLC_FORM_BINARY);
+	plc_binary_put_int64(*output + 5, usecs);
+	return 0;
+}
+
+static int plc_pyobject_as_interval(PyObject *input, char **output, plcPyType *type UNUSED) {
+	if (plc_datetime_import() < 0)
+		return -1;
+	if (!PyDelta_Check(input))
+		return plc_pyobject_as_binary_text(input, output);
+
+	*output = plc_binary_alloc(16, PLC_FORM_BINARY);
+	plc_binary_put_int64(*output + 5, (int64) PyDateTime_DELTA_GET_SECONDS(input) * PLC_USECS_PER_SEC
+	                                  + PyDateTime_DELTA_GET_MICROSECONDS(input));
+	plc_binary_put_int32(*output + 13, PyDateTime_DELTA_GET_DAYS(input));
+	plc_binary_put_int32(*output + 17, 0);
+	return 0;
+}
+
+static int plc_pyobject_as_uuid(PyObject *input, char **output, plcPyType *type UNUSED) {
+	static PyObject *uuid = NULL;
+	PyObject *bytes;
+	int isuuid;
+
+	if (plc_import_attr(&uuid, "uuid", "UUID") == NULL) {
+		raise_execution_error("Could not import the uuid module");
+		return -1;
+	}
+	isuuid = PyObject_IsInstance(input, uuid);
+	if (isuuid < 0) {
+		raise_execution_error("Could not check the type of the uuid value");
+		return -1;
+	}
+	if (!isuuid)
+		return plc_pyobject_as_binary_text(input, output);
+
+	bytes = PyObject_GetAttrString(input, "bytes");
+	if (bytes == NULL || !PyBytes_Check(bytes) || PyBytes_Size(bytes) != PLC_UUID_LEN) {
+		Py_XDECREF(bytes);
+		raise_execution_error("Could not get the bytes of a UUID object");
+		return -1;
+	}
+	*output = plc_binary_alloc(PLC_UUID_LEN, PLC_FORM_BINARY);
+	memcpy(*output + 5, PyBytes_AsString(bytes), PLC_UUID_LEN);
+	Py_DECREF(bytes);
+	return 0;
+}
+
+/* Strings are taken as JSON text, the other objects are serialized by json.dumps() */
+static int plc_pyobject_as_jsonb(PyObject *input, char **output, plcPyType *type UNUSED) {
+	static PyObject *dumps = NULL;
+	PyObject *json = NULL;
+	char *text;
+	int32 len;
+	int res;
+
+#if PY_MAJOR_VERSION >= 3
+	if (PyBytes_Check(input)) {
+		len = PyBytes_Size(input);
+		*output = plc_binary_alloc(len + 1, PLC_JSONB_VERSION);
+		memcpy(*output + 5, PyBytes_AsString(input), len);
+		(*output)[len + 5] = '\0';
+		return 0;
+	}
+#endif
+	if (!PyUnicode_Check(input) && !PyBytes_Check(input)) {
+		if (plc_import_attr(&dumps, "json", "dumps") == NULL) {
+			raise_execution_error("Could not import the json module");
+			return -1;
+		}
+		json = PyObject_CallFunctionObjArgs(dumps, input, NULL);
+		if (json == NULL) {
+			raise_execution_error("Could not serialize the jsonb value");
+			return -1;
+		}
+		input = json;
+	}
+
+	res = plc_pyobject_as_text(input, &text, NULL);
+	Py_XDECREF(json);
+	if (res < 0)
+		return -1;
+	len = strlen(text);
+	*output = plc_binary_alloc(len + 1, PLC_JSONB_VERSION);
+	memcpy(*output + 5, text, len + 1);
+	pfree(text);
+	return 0;
+}
+
 static plcPyInputFunc Ply_get_input_function(plcDatatype dt, bool isArrayElement) {
 	plcPyInputFunc res = NULL;
 	switch (dt) {
@@ -604,6 +1805,19 @@ static plcPyInputFunc Ply_get_input_function(plcDatatype dt, bool isArrayElement
 				res = plc_pyobject_from_bytea;
 			}
 			break;
+		case PLC_DATA_NUMERIC:
+		case PLC_DATA_DATE:
+		case PLC_DATA_TIMESTAMP:
+		case PLC_DATA_TIMESTAMPTZ:
+		case PLC_DATA_INTERVAL:
+		case PLC_DATA_UUID:
+		case PLC_DATA_JSONB:
+			if (isArrayElement) {
+				res = plc_pyobject_from_binary_ptr;
+			} else {
+				res = plc_pyobject_from_binary;
+			}
+			break;
 		case PLC_DATA_ARRAY:
 			res = plc_pyobject_from_array;
 			break;
@@ -649,6 +1863,27 @@ plcPyOutputFunc Ply_get_output_function(plcDatatype dt) {
 		case PLC_DATA_BYTEA:
 			res = plc_pyobject_as_bytea;
 			break;
+		case PLC_DATA_NUMERIC:
+			res = plc_pyobject_as_numeric;
+			break;
+		case PLC_DATA_DATE:
+			res = plc_pyobject_as_date;
+			break;
+		case PLC_DATA_TIMESTAMP:
+			res = plc_pyobject_as_timestamp;
+			break;
+		case PLC_DATA_TIMESTAMPTZ:
+			res = plc_pyobject_as_timestamptz;
+			break;
+		case PLC_DATA_INTERVAL:
+			res = plc_pyobject_as_interval;
+			break;
+		case PLC_DATA_UUID:
+			res = plc_pyobject_as_uuid;
+			break;
+		case PLC_DATA_JSONB:
+			res = plc_pyobject_as_jsonb;
+			break;
 		case PLC_DATA_ARRAY:
 			res = plc_pyobject_as_array;
 			break;
@@ -663,6 +1898,35 @@ plcPyOutputFunc Ply_get_output_function(plcDatatype dt) {
 	return res;
 }
 
+static plcPyStoreFunc Ply_get_store_function(plcDatatype dt) {
+	plcPyStoreFunc res = NULL;
+	switch (dt) {
+		case PLC_DATA_INT1:
+			res = plc_pyobject_store_int1;
+			break;
+		case PLC_DATA_INT2:
+			res = plc_pyobject_store_int2;
+			break;
+		case PLC_DATA_INT4:
+			res = plc_pyobject_store_int4;
+			break;
+		case PLC_DATA_INT8:
+			res = plc_pyobject_store_int8;
+			break;
+		case PLC_DATA_FLOAT4:
+			res = plc_pyobject_store_float4;
+			break;
+		case PLC_DATA_FLOAT8:
+			res = plc_pyobject_store_float8;
+			break;
+		default:
+			raise_execution_error("Type %s [%d] is not a fixed-width type",
+			                      plc_get_type_name(dt), (int) dt);
+			break;
+	}
+	return res;
+}
+
 static void plc_parse_type(plcPyType *pytype, plcType *type, char *argName, bool isArrayElement) {
 	int i = 0;
 
@@ -683,6 +1947,80 @@ static void plc_parse_type(plcPyType *pytype, plcType *type, char *argName, bool
 	}
 }
 
+/*
+ * Whether the function asks for its numeric arguments as float with a
+ * '# numeric: float' line among the leading comment lines
+ */
+static bool plc_parse_numeric_meta(const char *source) {
+	const char *pos = source;
+
+	while (*pos != '\0') {
+		const char *line = pos;
+
+		/* Find the start of the next line in advance */
+		while (*pos != '\0' && *pos != '\n' && *pos != '\r')
+			pos++;
+		while (*pos == '\n' || *pos == '\r')
+			pos++;
+
+		while (isblank(*line))
+			line++;
+		if (line == pos || *line == '\n' || *line == '\r')
+			continue;
+		/* Directives are only allowed in the comment block heading the code */
+		if (*line != '#')
+			break;
+		line++;
+
+		while (isblank(*line))
+			line++;
+		if (strncmp(line, "numeric", strlen("numeric")) != 0)
+			continue;
+		line += strlen("numeric");
+		while (isblank(*line))
+			line++;
+		if (*line != ':')
+			continue;
+		line++;
+		while (isblank(*line))
+			line++;
+		if (strncmp(line, "float", strlen("float")) != 0)
+			continue;
+		line += strlen("float");
+		while (isblank(*line))
+			line++;
+		if (*line == '\0' || *line == '\n' || *line == '\r')
+			return true;
+	}
+
+	return false;
+}
+
+/* Switch the numeric values of an argument, in arrays and composites too, to float */
+static void plc_use_float_numeric(plcPyType *type) {
+	int i;
+
+	switch (type->type) {
+		case PLC_DATA_NUMERIC:
+			type->conv.inputfunc = plc_pyobject_from_numeric_float;
+			break;
+		case PLC_DATA_ARRAY:
+			if (type->subTypes[0].type == PLC_DATA_NUMERIC) {
+				type->subTypes[0].conv.inputfunc = plc_pyobject_from_numeric_float_ptr;
+				type->conv.inputfunc = plc_pyobject_from_numeric_array_float;
+			} else {
+				plc_use_float_numeric(&type->subTypes[0]);
+			}
+			break;
+		case PLC_DATA_UDT:
+			for (i = 0; i < type->nSubTypes; i++)
+				plc_use_float_numeric(&type->subTypes[i]);
+			break;
+		default:
+			break;
+	}
+}
+
 plcPyFunction *plc_py_init_function(plcMsgCallreq *call) {
 	plcPyFunction *res;
 	int i;
@@ -695,11 +2033,16 @@ plcPyFunction *plc_py_init_function(plcMsgCallreq *call) {
 	res->retset = call->retset;
 	res->args = (plcPyType *) malloc(res->nargs * sizeof(plcPyType));
 	res->objectid = call->objectid;
+	res->version = call->version;
 	res->pySD = PyDict_New();
 
 	for (i = 0; i < res->nargs; i++) {
 		plc_parse_type(&res->args[i], &call->args[i].type, call->args[i].name, false);
 	}
+	if (plc_parse_numeric_meta(res->proc.src)) {
+		for (i = 0; i < res->nargs; i++)
+			plc_use_float_numeric(&res->args[i]);
+	}
 
 	plc_parse_type(&res->res, &call->retType, "result", false);
 
@@ -721,6 +2064,28 @@ plcPyResult *plc_init_result_conversions(plcMsgResult *res) {
 	return pyres;
 }
 
+plcPyType *plc_init_column_conversions(plcType *types, uint32 cols) {
+	plcPyType *args;
+	uint32 i;
+
+	args = (plcPyType *) malloc(cols * sizeof(plcPyType));
+	for (i = 0; i < cols; i++) {
+		plc_parse_type(&args[i], &types[i], NULL, false);
+	}
+
+	return args;
+}
+
+static void plc_py_free_plc_type(plcType *type) {
+	int i = 0;
+	if (type->typeName != NULL)
+		free(type->typeName);
+	for (i = 0; i < type->nSubTypes; i++)
+		plc_py_free_plc_type(&type->subTypes[i]);
+	if (type->nSubTypes > 0)
+		free(type->subTypes);
+}
+
 static void plc_py_free_type(plcPyType *type) {
 	int i = 0;
 	if (type->typeName != NULL) {
@@ -758,6 +2123,15 @@ void plc_free_result_conversions(plcPyResult *res) {
 	free(res);
 }
 
+void plc_free_column_conversions(plcPyType *args, uint32 cols) {
+	uint32 i;
+
+	for (i = 0; i < cols; i++) {
+		plc_py_free_type(&args[i]);
+	}
+	free(args);
+}
+
 void plc_py_copy_type(plcType *type, plcPyType *pytype) {
 	type->type = pytype->type;
 	type->nSubTypes = pytype->nSubTypes;
@@ -772,6 +2146,18 @@ void plc_py_copy_type(plcType *type, plcPyType *pytype) {
 	}
 }
 
+plcPyType *plc_py_dup_type(plcPyType *pytype) {
+	plcPyType *res;
+	plcType type;
+
+	/* Round trip through plcType to get a fresh set of conversion functions */
+	plc_py_copy_type(&type, pytype);
+	res = plc_init_column_conversions(&type, 1);
+	plc_py_free_plc_type(&type);
+
+	return res;
+}
+
 
 
 /*
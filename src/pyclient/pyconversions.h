@@ -32,6 +32,7 @@ typedef struct plcPyArrMeta {
 	size_t *dims;
 	plcPyType *type;
 	plcPyOutputFunc outputfunc;
+	char *block;  /* fixed-width elements sent in bulk, NULL until built */
 } plcPyArrMeta;
 
 /* Working with types in Python */
@@ -64,12 +65,15 @@ typedef struct plcPyFunction {
 	plcPyType res;
 	int retset;
 	unsigned int objectid;
+	unsigned int version;
 	PyObject *pyfunc;
 	PyObject *pySD;
 } plcPyFunction;
 
 void plc_py_copy_type(plcType *type, plcPyType *pytype);
 
+plcPyType *plc_py_dup_type(plcPyType *pytype);
+
 plcPyFunction *plc_py_init_function(plcMsgCallreq *call);
 
 plcPyResult *plc_init_result_conversions(plcMsgResult *res);
@@ -78,8 +82,18 @@ void plc_py_free_function(plcPyFunction *func);
 
 void plc_free_result_conversions(plcPyResult *res);
 
+plcPyType *plc_init_column_conversions(plcType *types, uint32 cols);
+
+void plc_free_column_conversions(plcPyType *args, uint32 cols);
+
 plcPyOutputFunc Ply_get_output_function(plcDatatype dt);
 
+PyObject *plc_pyobject_from_rawdata(rawdata *obj, plcPyType *type);
+
+PyObject *plc_pyobject_from_binary_data(plcDatatype type, const char *data, int32 len);
+
+int plc_numeric_data_to_float8(const char *data, int32 len, double *out);
+
 const char *serverenc;
 
 #endif /* PLC_PYCONVERSIONS_H */
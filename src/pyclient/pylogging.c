@@ -13,9 +13,37 @@
 #include "common/comm_utils.h"
 
 #include <Python.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+
+/*
+ * Messages of levels the backend would not report are dropped here. The
+ * others wait in the output buffer to go out with the next message sent to
+ * the backend, a result, a query or an error, so that a function logging in
+ * a loop does not wait for the backend at every message. A thread of its own
+ * flushes the waiting messages PLy_LOG_FLUSH_USEC after the first of them at
+ * the latest, so that they also show up while the function sleeps or
+ * computes. Waiting messages are lost if the client dies.
+ */
+#define PLy_LOG_FLUSH_USEC 1000000
+
+static pthread_mutex_t PLy_log_timer_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t PLy_log_timer_cond;
+static bool PLy_log_timer_started = false;
+/* When the first of the waiting messages was held, 0 if none waits */
+static int64 PLy_log_held_at = 0;
 
 static PyObject *PLy_output(volatile int, PyObject *, PyObject *);
 
+static bool PLy_log_is_reported(int level);
+
+static void PLy_log_hold(void);
+
+static void *PLy_log_flusher(void *arg);
+
+static int64 PLy_log_clock(void);
+
 PyObject *PLy_debug(PyObject *self, PyObject *args) {
 	return PLy_output(DEBUG2, self, args);
 }
@@ -51,7 +79,7 @@ static PyObject *PLy_output(volatile int level, PyObject *self UNUSED, PyObject
 	plcConn *conn = plcconn_global;
 	plcMsgLog *msg;
 
-	if (plc_is_execution_terminated == 0) {
+	if (plc_is_execution_terminated == 0 && PLy_log_is_reported(level)) {
 		if (PyTuple_Size(args) == 1) {
 			/*
 			 * Treat single argument specially to avoid undesirable ('tuple',)
@@ -78,7 +106,12 @@ static PyObject *PLy_output(volatile int level, PyObject *self UNUSED, PyObject
 		msg->level = level;
 		msg->message = sv;
 
-		plcontainer_channel_send(conn, (plcMessage *) msg);
+		if (level >= ERROR) {
+			plcontainer_channel_send(conn, (plcMessage *) msg);
+		} else {
+			plcontainer_channel_send_held(conn, (plcMessage *) msg);
+			PLy_log_hold();
+		}
 
 		/*
 		 * Note: If sv came from PyString_AsString(), it points into storage
@@ -96,3 +129,76 @@ static PyObject *PLy_output(volatile int level, PyObject *self UNUSED, PyObject
 	Py_INCREF(Py_None);
 	return Py_None;
 }
+
+/* Whether the backend writes a message of this level to its log or the user */
+static bool PLy_log_is_reported(int level) {
+	return level >= ERROR || level == INFO || level >= client_message_level
+	       || is_write_log(level, client_log_level);
+}
+
+/* Have the flusher send the message just held in PLy_LOG_FLUSH_USEC */
+static void PLy_log_hold(void) {
+	pthread_mutex_lock(&PLy_log_timer_lock);
+	if (!PLy_log_timer_started) {
+		pthread_condattr_t attr;
+		pthread_t thread;
+		sigset_t all, old;
+
+		pthread_condattr_init(&attr);
+		pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+		pthread_cond_init(&PLy_log_timer_cond, &attr);
+		pthread_condattr_destroy(&attr);
+
+		/* Signals are for the main thread, the flusher inherits the mask */
+		sigfillset(&all);
+		pthread_sigmask(SIG_SETMASK, &all, &old);
+		if (pthread_create(&thread, NULL, PLy_log_flusher, NULL) != 0)
+			plc_elog(ERROR, "Could not start the thread flushing log messages");
+		pthread_sigmask(SIG_SETMASK, &old, NULL);
+		pthread_detach(thread);
+		PLy_log_timer_started = true;
+	}
+	if (PLy_log_held_at == 0) {
+		PLy_log_held_at = PLy_log_clock();
+		pthread_cond_signal(&PLy_log_timer_cond);
+	}
+	pthread_mutex_unlock(&PLy_log_timer_lock);
+}
+
+/*
+ * Flush the held messages once they waited PLy_LOG_FLUSH_USEC. The main
+ * thread may have sent them already with another message, the flush is
+ * then a no-op.
+ */
+static void *PLy_log_flusher(void *arg UNUSED) {
+	pthread_mutex_lock(&PLy_log_timer_lock);
+	for (;;) {
+		int64 due;
+
+		if (PLy_log_held_at == 0) {
+			pthread_cond_wait(&PLy_log_timer_cond, &PLy_log_timer_lock);
+			continue;
+		}
+		due = PLy_log_held_at + PLy_LOG_FLUSH_USEC;
+		if (PLy_log_clock() < due) {
+			struct timespec ts;
+
+			ts.tv_sec = due / 1000000;
+			ts.tv_nsec = (due % 1000000) * 1000;
+			pthread_cond_timedwait(&PLy_log_timer_cond, &PLy_log_timer_lock, &ts);
+			continue;
+		}
+		PLy_log_held_at = 0;
+		pthread_mutex_unlock(&PLy_log_timer_lock);
+		plcontainer_channel_flush(plcconn_global);
+		pthread_mutex_lock(&PLy_log_timer_lock);
+	}
+	return NULL;
+}
+
+static int64 PLy_log_clock(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
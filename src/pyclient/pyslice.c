@@ -0,0 +1,304 @@
+/*------------------------------------------------------------------------------
+ *
+ *
+ * Copyright (c) 2016-Present Pivotal Software, Inc
+ *
+ *------------------------------------------------------------------------------
+ */
+#pragma GCC diagnostic ignored "-Wmissing-field-initializers"
+#include "pyslice.h"
+
+#include <string.h>
+#include <structmember.h>
+
+#include "common/comm_channel.h"
+#include "common/comm_utils.h"
+#include "common/messages/messages.h"
+#include "pycall.h"
+#include "pyerror.h"
+
+/*
+ * The backend does not send text and bytea arguments above the slice
+ * threshold of the runtime with the call, the function gets a reader instead.
+ * Every read asks the backend for the bytes it needs, at most
+ * PLC_SLICE_MAX_SIZE at a time, so the function holds no more of the value
+ * than it reads. The backend serves the requests only while it waits for
+ * the result of the call, so the reader stops working when the function
+ * returns.
+ */
+typedef struct PLySliceReaderObject {
+	PyObject_HEAD
+	int32 call;           /* plc_current_call of the call it was passed to */
+	int32 argument;
+	PY_LONG_LONG size;
+	PY_LONG_LONG pos;
+	char closed;
+} PLySliceReaderObject;
+
+static void PLy_slice_reader_dealloc(PyObject *);
+
+static PyObject *PLy_slice_reader_read(PyObject *, PyObject *);
+
+static PyObject *PLy_slice_reader_seek(PyObject *, PyObject *);
+
+static PyObject *PLy_slice_reader_tell(PyObject *, PyObject *);
+
+static PyObject *PLy_slice_reader_close(PyObject *, PyObject *);
+
+static PyObject *PLy_slice_reader_true(PyObject *, PyObject *);
+
+static PyObject *PLy_slice_reader_enter(PyObject *, PyObject *);
+
+static PyObject *PLy_slice_reader_exit(PyObject *, PyObject *);
+
+static int PLy_slice_reader_fetch(PLySliceReaderObject *reader, char *data, int32 length);
+
+static char PLy_slice_reader_doc[] = {
+	"Reader of a large text or bytea argument"
+};
+
+static PyMethodDef PLy_slice_reader_methods[] = {
+	{"read",      PLy_slice_reader_read,  METH_VARARGS, NULL},
+	{"seek",      PLy_slice_reader_seek,  METH_VARARGS, NULL},
+	{"tell",      PLy_slice_reader_tell,  METH_NOARGS,  NULL},
+	{"close",     PLy_slice_reader_close, METH_NOARGS,  NULL},
+	{"readable",  PLy_slice_reader_true,  METH_NOARGS,  NULL},
+	{"seekable",  PLy_slice_reader_true,  METH_NOARGS,  NULL},
+	{"__enter__", PLy_slice_reader_enter, METH_NOARGS,  NULL},
+	{"__exit__",  PLy_slice_reader_exit,  METH_VARARGS, NULL},
+	{NULL, NULL, 0,                                     NULL}
+};
+
+static PyMemberDef PLy_slice_reader_members[] = {
+	{"size",   T_LONGLONG, offsetof(PLySliceReaderObject, size),   READONLY, NULL},
+	{"closed", T_BOOL,     offsetof(PLySliceReaderObject, closed), READONLY, NULL},
+	{NULL, 0, 0, 0, NULL}
+};
+
+PyTypeObject PLy_SliceReaderType = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	"PLySliceReader",             /* tp_name */
+	sizeof(PLySliceReaderObject), /* tp_size */
+	0,                            /* tp_itemsize */
+
+	/*
+	 * methods
+	 */
+	PLy_slice_reader_dealloc,     /* tp_dealloc */
+	0,                            /* tp_print */
+	0,                            /* tp_getattr */
+	0,                            /* tp_setattr */
+	0,                            /* tp_compare */
+	0,                            /* tp_repr */
+	0,                            /* tp_as_number */
+	0,                            /* tp_as_sequence */
+	0,                            /* tp_as_mapping */
+	0,                            /* tp_hash */
+	0,                            /* tp_call */
+	0,                            /* tp_str */
+	0,                            /* tp_getattro */
+	0,                            /* tp_setattro */
+	0,                            /* tp_as_buffer */
+	Py_TPFLAGS_DEFAULT,           /* tp_flags */
+	PLy_slice_reader_doc,         /* tp_doc */
+	0,                            /* tp_traverse */
+	0,                            /* tp_clear */
+	0,                            /* tp_richcompare */
+	0,                            /* tp_weaklistoffset */
+	0,                            /* tp_iter */
+	0,                            /* tp_iternext */
+	PLy_slice_reader_methods,     /* tp_tpmethods */
+	PLy_slice_reader_members,     /* tp_members */
+	0,
+	0,
+	0,
+	0,
+	0,
+	0,
+	0,
+	0,
+	0,
+	0,
+	0,
+	0,
+	0,
+	0,
+	0,
+	0,
+	0,
+	0,
+};
+
+PyObject *PLy_slice_reader_new(int32 argument, int64 size) {
+	PLySliceReaderObject *reader;
+
+	if ((reader = PyObject_New(PLySliceReaderObject, &PLy_SliceReaderType)) == NULL)
+		return NULL;
+
+	reader->call = plc_current_call;
+	reader->argument = argument;
+	reader->size = size;
+	reader->pos = 0;
+	reader->closed = 0;
+
+	return (PyObject *) reader;
+}
+
+static void PLy_slice_reader_dealloc(PyObject *arg) {
+	arg->ob_type->tp_free(arg);
+}
+
+/* Read length bytes at the current position from the backend */
+static int PLy_slice_reader_fetch(PLySliceReaderObject *reader, char *data, int32 length) {
+	plcConn *conn = plcconn_global;
+	plcMsgSliceRequest msg;
+	plcMessage *resp;
+	plcMsgRaw *raw;
+
+	msg.msgtype = MT_SLICE_REQUEST;
+	msg.argument = reader->argument;
+	msg.offset = reader->pos;
+	msg.length = length;
+	if (plcontainer_channel_send(conn, (plcMessage *) &msg) < 0) {
+		raise_execution_error("Error sending data to the frontend");
+		return -1;
+	}
+	if (plcontainer_channel_receive(conn, &resp, MT_RAW_BIT) < 0) {
+		raise_execution_error("Error receiving data from the frontend");
+		return -1;
+	}
+
+	raw = (plcMsgRaw *) resp;
+	if (raw->size != length) {
+		raise_execution_error("Frontend sent %d bytes of argument %d instead of %d",
+		                      raw->size, reader->argument, length);
+		free_rawmsg(raw);
+		return -1;
+	}
+	memcpy(data, raw->data, length);
+	free_rawmsg(raw);
+
+	reader->pos += length;
+	return 0;
+}
+
+/* reader.read([size]) returns up to size bytes, all the rest by default */
+static PyObject *PLy_slice_reader_read(PyObject *self, PyObject *args) {
+	PLySliceReaderObject *reader = (PLySliceReaderObject *) self;
+	PY_LONG_LONG count = -1;
+	PY_LONG_LONG done;
+	PyObject *result;
+	char *data;
+
+	if (!PyArg_ParseTuple(args, "|L:read", &count))
+		return NULL;
+
+	if (reader->closed) {
+		PyErr_SetString(PyExc_ValueError, "read from a closed argument reader");
+		return NULL;
+	}
+	if (reader->call != plc_current_call) {
+		PyErr_Format(PyExc_ValueError, "argument %d can only be read by the call it was passed to",
+		             reader->argument);
+		return NULL;
+	}
+	/* If the execution was terminated we don't need to ask the backend */
+	if (plc_is_execution_terminated != 0) {
+		PyErr_SetString(PyExc_RuntimeError, "the execution was terminated");
+		return NULL;
+	}
+
+	if (reader->pos >= reader->size)
+		count = 0;
+	else if (count < 0 || count > reader->size - reader->pos)
+		count = reader->size - reader->pos;
+	if (count > PY_SSIZE_T_MAX) {
+		PyErr_SetString(PyExc_OverflowError, "read size does not fit in memory");
+		return NULL;
+	}
+
+	result = PyBytes_FromStringAndSize(NULL, (Py_ssize_t) count);
+	if (result == NULL)
+		return NULL;
+	data = PyBytes_AS_STRING(result);
+
+	for (done = 0; done < count; ) {
+		int32 length = count - done > PLC_SLICE_MAX_SIZE ? PLC_SLICE_MAX_SIZE : (int32) (count - done);
+
+		if (PLy_slice_reader_fetch(reader, data + done, length) < 0) {
+			Py_DECREF(result);
+			return NULL;
+		}
+		done += length;
+	}
+
+	return result;
+}
+
+/* reader.seek(offset[, whence]) moves the position like file.seek() */
+static PyObject *PLy_slice_reader_seek(PyObject *self, PyObject *args) {
+	PLySliceReaderObject *reader = (PLySliceReaderObject *) self;
+	PY_LONG_LONG offset;
+	int whence = 0;
+
+	if (!PyArg_ParseTuple(args, "L|i:seek", &offset, &whence))
+		return NULL;
+
+	if (reader->closed) {
+		PyErr_SetString(PyExc_ValueError, "seek on a closed argument reader");
+		return NULL;
+	}
+
+	switch (whence) {
+		case 0:
+			break;
+		case 1:
+			offset += reader->pos;
+			break;
+		case 2:
+			offset += reader->size;
+			break;
+		default:
+			PyErr_Format(PyExc_ValueError, "invalid whence (%d, should be 0, 1 or 2)", whence);
+			return NULL;
+	}
+	if (offset < 0) {
+		PyErr_Format(PyExc_ValueError, "negative seek position %lld", offset);
+		return NULL;
+	}
+
+	reader->pos = offset;
+	return PyLong_FromLongLong(offset);
+}
+
+static PyObject *PLy_slice_reader_tell(PyObject *self, PyObject *unused UNUSED) {
+	PLySliceReaderObject *reader = (PLySliceReaderObject *) self;
+
+	if (reader->closed) {
+		PyErr_SetString(PyExc_ValueError, "tell on a closed argument reader");
+		return NULL;
+	}
+	return PyLong_FromLongLong(reader->pos);
+}
+
+static PyObject *PLy_slice_reader_close(PyObject *self, PyObject *unused UNUSED) {
+	((PLySliceReaderObject *) self)->closed = 1;
+
+	Py_INCREF(Py_None);
+	return Py_None;
+}
+
+static PyObject *PLy_slice_reader_true(PyObject *self UNUSED, PyObject *unused UNUSED) {
+	return PyBool_FromLong(1);
+}
+
+static PyObject *PLy_slice_reader_enter(PyObject *self, PyObject *unused UNUSED) {
+	Py_INCREF(self);
+	return self;
+}
+
+static PyObject *PLy_slice_reader_exit(PyObject *self, PyObject *args UNUSED) {
+	((PLySliceReaderObject *) self)->closed = 1;
+
+	return PyBool_FromLong(0);
+}
@@ -0,0 +1,21 @@
+/*------------------------------------------------------------------------------
+ *
+ *
+ * Copyright (c) 2016-Present Pivotal Software, Inc
+ *
+ *------------------------------------------------------------------------------
+ */
+
+#ifndef PLC_PYSLICE_H
+#define PLC_PYSLICE_H
+
+#include <Python.h>
+
+#include "common/comm_utils.h"
+
+PyTypeObject PLy_SliceReaderType;
+
+// File-like object reading a sliced argument of the running call
+PyObject *PLy_slice_reader_new(int32 argument, int64 size);
+
+#endif /* PLC_PYSLICE_H */
@@ -21,17 +21,24 @@
 #endif
 
 #include "parser/parse_type.h"
+#include "access/hash.h"
 #include "access/xact.h"
+#include "catalog/pg_type.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
 
 #include "common/comm_utils.h"
 #include "common/comm_channel.h"
 #include "common/comm_connectivity.h"
 #include "plc_typeio.h"
+#include "type_cache.h"
 #include "sqlhandler.h"
 #include "subtransaction_handler.h"
 
 static plcMsgResult *create_sql_result(bool isSelect);
 
+static plcMsgColumns *create_sql_columns(bool isSelect);
+
 static plcMsgRaw *create_prepare_result(int64 pplan, plcDatatype *type, int nargs);
 
 void deinit_pplan_slots(plcConn *conn);
@@ -41,10 +48,12 @@ void init_pplan_slots(plcConn *conn);
 static plcMsgResult *create_sql_result(bool isSelect) {
 	plcMsgResult *result;
 	uint32 i, j;
-	plcTypeInfo *resTypes = NULL;
+	plcTypeInfo **resTypes = NULL;
 
 	result = palloc(sizeof(plcMsgResult));
 	result->msgtype = MT_RESULT;
+	result->frame = NULL;
+	result->mappings = NULL;
 	result->rows = SPI_processed;
 
 	if (!isSelect) {
@@ -63,10 +72,10 @@ static plcMsgResult *create_sql_result(bool isSelect) {
 	result->types = palloc(result->cols * sizeof(*result->types));
 	result->names = palloc(result->cols * sizeof(*result->names));
 	result->exception_callback = NULL;
-	resTypes = palloc(result->cols * sizeof(plcTypeInfo));
+	resTypes = palloc(result->cols * sizeof(plcTypeInfo *));
 	for (j = 0; j < result->cols; j++) {
-		fill_type_info(NULL, SPI_tuptable->tupdesc->attrs[j]->atttypid, &resTypes[j]);
-		copy_type_info(&result->types[j], &resTypes[j]);
+		resTypes[j] = type_cache_get(SPI_tuptable->tupdesc->attrs[j]->atttypid);
+		copy_type_info(&result->types[j], resTypes[j]);
 		result->names[j] = SPI_fname(SPI_tuptable->tupdesc, j + 1);
 	}
 
@@ -89,15 +98,264 @@ static plcMsgResult *create_sql_result(bool isSelect) {
 					result->data[i][j].value = NULL;
 				} else {
 					result->data[i][j].isnull = 0;
-					result->data[i][j].value = resTypes[j].outfunc(origval, &resTypes[j]);
+					result->data[i][j].value = resTypes[j]->outfunc(origval, resTypes[j]);
 				}
 			}
 		}
 	}
 
-	for (i = 0; i < result->cols; i++) {
-		free_type_info(&resTypes[i]);
+	pfree(resTypes);
+
+	return result;
+}
+
+/*
+ * Text columns are dictionary encoded when they have at most one distinct
+ * value per PLC_COLUMN_DICT_RATIO non-null rows.
+ */
+#define PLC_COLUMN_DICT_MIN_ROWS 16
+#define PLC_COLUMN_DICT_RATIO    4
+
+static void set_column_null(plcColumn *col, uint32 row, uint32 rows) {
+	if (col->nulls == NULL)
+		col->nulls = palloc0((rows + 7) / 8);
+	col->nulls[row >> 3] |= (char) (1 << (row & 7));
+}
+
+static void fill_fixed_column(plcColumn *col, int attno, plcTypeInfo *type, uint32 rows) {
+	int len = plc_get_type_length(type->type);
+	bool isnull;
+	Datum origval;
+	char *pos;
+	char *val;
+	uint32 i;
+
+	col->encoding = PLC_COLUMN_FIXED;
+	col->values = palloc0(rows * len);
+	for (i = 0, pos = col->values; i < rows; i++, pos += len) {
+		origval = SPI_getbinval(SPI_tuptable->vals[i], SPI_tuptable->tupdesc, attno, &isnull);
+		if (isnull) {
+			set_column_null(col, i, rows);
+			continue;
+		}
+		/* Store pass-by-value types directly, avoiding a palloc per value */
+		switch (type->typeOid) {
+			case BOOLOID:
+				*((char *) pos) = DatumGetBool(origval);
+				break;
+			case INT2OID:
+				*((int16 *) pos) = DatumGetInt16(origval);
+				break;
+			case INT4OID:
+				*((int32 *) pos) = DatumGetInt32(origval);
+				break;
+			case INT8OID:
+				*((int64 *) pos) = DatumGetInt64(origval);
+				break;
+			case FLOAT4OID:
+				*((float4 *) pos) = DatumGetFloat4(origval);
+				break;
+			case FLOAT8OID:
+				*((float8 *) pos) = DatumGetFloat8(origval);
+				break;
+			default:
+				val = type->outfunc(origval, type);
+				memcpy(pos, val, len);
+				pfree(val);
+				break;
+		}
+	}
+}
+
+/* Try to dictionary encode the values, returns false if there are too many distinct ones */
+static bool fill_dict_column(plcColumn *col, char **vals, int32 *lens, uint32 rows, uint32 nonnull) {
+	uint32 maxdict = nonnull / PLC_COLUMN_DICT_RATIO;
+	uint32 nslots = 16;
+	int32 *slots;
+	int32 *first;
+	int32 *codes;
+	int32 ndict = 0;
+	Size total = 0;
+	uint32 i, h;
+
+	if (rows < PLC_COLUMN_DICT_MIN_ROWS || maxdict == 0)
+		return false;
+
+	while (nslots < maxdict * 2)
+		nslots <<= 1;
+	slots = palloc(nslots * sizeof(int32));
+	memset(slots, -1, nslots * sizeof(int32));
+	first = palloc((maxdict + 1) * sizeof(int32));
+	codes = palloc(rows * sizeof(int32));
+
+	for (i = 0; i < rows; i++) {
+		if (vals[i] == NULL) {
+			codes[i] = -1;
+			continue;
+		}
+		h = DatumGetUInt32(hash_any((unsigned char *) vals[i], lens[i])) & (nslots - 1);
+		while (slots[h] >= 0) {
+			int32 cand = first[slots[h]];
+			if (lens[cand] == lens[i] && memcmp(vals[cand], vals[i], lens[i]) == 0)
+				break;
+			h = (h + 1) & (nslots - 1);
+		}
+		if (slots[h] < 0) {
+			if ((uint32) ndict == maxdict) {
+				pfree(slots);
+				pfree(first);
+				pfree(codes);
+				return false;
+			}
+			slots[h] = ndict;
+			first[ndict++] = i;
+			total += lens[i];
+		}
+		codes[i] = slots[h];
 	}
+
+	col->encoding = PLC_COLUMN_DICT;
+	col->nvalues = ndict;
+	col->codes = codes;
+	col->offsets = palloc((ndict + 1) * sizeof(int32));
+	col->values = palloc(total + 1);
+	col->offsets[0] = 0;
+	for (i = 0; i < (uint32) ndict; i++) {
+		memcpy(col->values + col->offsets[i], vals[first[i]], lens[first[i]]);
+		col->offsets[i + 1] = col->offsets[i] + lens[first[i]];
+	}
+
+	pfree(slots);
+	pfree(first);
+	return true;
+}
+
+static void fill_varlen_column(plcColumn *col, int attno, plcTypeInfo *type, uint32 rows) {
+	bool isnull;
+	Datum origval;
+	char **vals;
+	int32 *lens;
+	Size total = 0;
+	uint32 nonnull = 0;
+	uint32 i;
+
+	vals = palloc(rows * sizeof(char *));
+	lens = palloc(rows * sizeof(int32));
+	for (i = 0; i < rows; i++) {
+		origval = SPI_getbinval(SPI_tuptable->vals[i], SPI_tuptable->tupdesc, attno, &isnull);
+		if (isnull) {
+			set_column_null(col, i, rows);
+			vals[i] = NULL;
+			lens[i] = 0;
+			continue;
+		}
+		vals[i] = type->outfunc(origval, type);
+		lens[i] = type->type == PLC_DATA_TEXT ? (int32) strlen(vals[i]) : *((int32 *) vals[i]);
+		total += lens[i];
+		nonnull++;
+	}
+	/* The offsets of the column are int32, and its values take one allocation */
+	if (total >= MaxAllocSize)
+		plc_elog(ERROR, "values of result column %d take more than %d bytes", attno, (int) MaxAllocSize - 1);
+
+	if (type->type != PLC_DATA_TEXT || !fill_dict_column(col, vals, lens, rows, nonnull)) {
+		col->encoding = PLC_COLUMN_VARLEN;
+		col->nvalues = rows;
+		col->offsets = palloc((rows + 1) * sizeof(int32));
+		col->values = palloc(total + 1);
+		col->offsets[0] = 0;
+		for (i = 0; i < rows; i++) {
+			/* values of the types other than text carry their length in front of the data */
+			if (vals[i] != NULL)
+				memcpy(col->values + col->offsets[i],
+				       type->type != PLC_DATA_TEXT ? vals[i] + 4 : vals[i], lens[i]);
+			col->offsets[i + 1] = col->offsets[i] + lens[i];
+		}
+	}
+
+	for (i = 0; i < rows; i++) {
+		if (vals[i] != NULL)
+			pfree(vals[i]);
+	}
+	pfree(vals);
+	pfree(lens);
+}
+
+static void fill_object_column(plcColumn *col, int attno, plcTypeInfo *type, uint32 rows) {
+	bool isnull;
+	Datum origval;
+	uint32 i;
+
+	col->encoding = PLC_COLUMN_OBJECT;
+	col->objects = palloc(rows * sizeof(rawdata));
+	for (i = 0; i < rows; i++) {
+		origval = SPI_getbinval(SPI_tuptable->vals[i], SPI_tuptable->tupdesc, attno, &isnull);
+		if (isnull) {
+			set_column_null(col, i, rows);
+			col->objects[i].isnull = 1;
+			col->objects[i].value = NULL;
+		} else {
+			col->objects[i].isnull = 0;
+			col->objects[i].value = type->outfunc(origval, type);
+		}
+	}
+}
+
+static plcMsgColumns *create_sql_columns(bool isSelect) {
+	plcMsgColumns *result;
+	plcTypeInfo **resTypes;
+	uint32 j;
+
+	result = palloc(sizeof(plcMsgColumns));
+	result->msgtype = MT_RESULT_COLUMNS;
+	result->rows = SPI_processed;
+	result->cols = 0;
+	result->types = NULL;
+	result->names = NULL;
+	result->columns = NULL;
+
+	if (!isSelect) {
+		return result;
+	} else if (SPI_tuptable == NULL) {
+		plc_elog(ERROR, "Unexpected error: SPI returns NULL result");
+	}
+
+	result->cols = SPI_tuptable->tupdesc->natts;
+	result->types = palloc(result->cols * sizeof(*result->types));
+	result->names = palloc(result->cols * sizeof(*result->names));
+	result->columns = palloc0(result->cols * sizeof(*result->columns));
+	resTypes = palloc(result->cols * sizeof(plcTypeInfo *));
+	for (j = 0; j < result->cols; j++) {
+		resTypes[j] = type_cache_get(SPI_tuptable->tupdesc->attrs[j]->atttypid);
+		copy_type_info(&result->types[j], resTypes[j]);
+		result->names[j] = SPI_fname(SPI_tuptable->tupdesc, j + 1);
+
+		switch (resTypes[j]->type) {
+			case PLC_DATA_INT1:
+			case PLC_DATA_INT2:
+			case PLC_DATA_INT4:
+			case PLC_DATA_INT8:
+			case PLC_DATA_FLOAT4:
+			case PLC_DATA_FLOAT8:
+				fill_fixed_column(&result->columns[j], j + 1, resTypes[j], result->rows);
+				break;
+			case PLC_DATA_TEXT:
+			case PLC_DATA_BYTEA:
+			case PLC_DATA_NUMERIC:
+			case PLC_DATA_DATE:
+			case PLC_DATA_TIMESTAMP:
+			case PLC_DATA_TIMESTAMPTZ:
+			case PLC_DATA_INTERVAL:
+			case PLC_DATA_UUID:
+			case PLC_DATA_JSONB:
+				fill_varlen_column(&result->columns[j], j + 1, resTypes[j], result->rows);
+				break;
+			default:
+				fill_object_column(&result->columns[j], j + 1, resTypes[j], result->rows);
+				break;
+		}
+	}
+
 	pfree(resTypes);
 
 	return result;
@@ -212,6 +470,73 @@ static int free_plc_plan(plcConn *conn, int64 pplan) {
 	return retval;
 }
 
+static plcPlan *lookup_plc_plan(plcConn *conn, plcMsgSQL *msg) {
+	plcPlan *plc_plan;
+
+	if (search_pplan(conn, (int64) msg->pplan) < 0)
+		plc_elog(ERROR, "There is no such prepared plan: %p", msg->pplan);
+	plc_plan = (plcPlan *) ((char *) msg->pplan - offsetof(plcPlan, plan));
+	if (plc_plan->nargs != msg->nargs) {
+		plc_elog(ERROR, "argument number wrong for execute with plan: "
+					"Saved number (%d) vs transferred number (%d)",
+				     plc_plan->nargs, msg->nargs);
+	}
+
+	return plc_plan;
+}
+
+/* Convert the transferred arguments of a prepared plan into Datums */
+static void fill_plan_values(plcPlan *plc_plan, plcMsgSQL *msg, Datum **values, char **nulls) {
+	plcTypeInfo *pexecType;
+	int i;
+
+	if (msg->nargs > 0) {
+		*nulls = pmalloc(msg->nargs * sizeof(char));
+		*values = pmalloc(msg->nargs * sizeof(Datum));
+	} else {
+		*nulls = NULL;
+		*values = NULL;
+	}
+	for (i = 0; i < msg->nargs; i++) {
+		if (msg->args[i].data.isnull) {
+			/* all the build-in type is strict, so we set value to Datum 0. */
+			(*values)[i] = (Datum) 0;
+			(*nulls)[i] = 'n';
+		} else {
+			pexecType = type_cache_get(plc_plan->argOids[i]);
+			(*values)[i] = pexecType->infunc(msg->args[i].data.value, pexecType);
+			(*nulls)[i] = ' ';
+		}
+	}
+}
+
+/*
+ * Cursor ids are only unique for one client, so the portal name carries the
+ * container slot as well.
+ */
+static void get_cursor_name(plcConn *conn, int32 cursor, char *name) {
+	snprintf(name, NAMEDATALEN, "<plcontainer %d cursor %d>", conn->container_slot, cursor);
+}
+
+/*
+ * Fetch the next batch of a cursor. A batch shorter than asked for is the
+ * last one, so the cursor is closed right away and the client does not
+ * need to come back for it.
+ */
+static plcMsgResult *fetch_sql_cursor(Portal portal, int64 limit) {
+	plcMsgResult *result;
+	bool done;
+
+	SPI_cursor_fetch(portal, true, (long) limit);
+	result = create_sql_result(true);
+	done = (int64) SPI_processed < limit;
+	SPI_freetuptable(SPI_tuptable);
+	if (done)
+		SPI_cursor_close(portal);
+
+	return result;
+}
+
 void deinit_pplan_slots(plcConn *conn) {
 	int i;
 	struct pplan_slots *pplans = conn->pplans;
@@ -248,6 +573,9 @@ plcMessage *handle_sql_message(plcMsgSQL *msg, plcConn *conn, plcProcInfo *pinfo
 	Oid type_oid;
 	plcDatatype *argTypes;
 	int32 typemod;
+	bool columnar;
+	Portal portal;
+	char name[NAMEDATALEN];
 	volatile MemoryContext oldcontext;
 	volatile ResourceOwner oldowner;
 
@@ -270,41 +598,16 @@ plcMessage *handle_sql_message(plcMsgSQL *msg, plcConn *conn, plcProcInfo *pinfo
 		switch (msg->sqltype) {
 			case SQL_TYPE_STATEMENT:
 			case SQL_TYPE_PEXECUTE:
-				if (msg->sqltype == SQL_TYPE_PEXECUTE) {
+			case SQL_TYPE_STATEMENT_COLUMNS:
+			case SQL_TYPE_PEXECUTE_COLUMNS:
+				columnar = (msg->sqltype == SQL_TYPE_STATEMENT_COLUMNS ||
+				            msg->sqltype == SQL_TYPE_PEXECUTE_COLUMNS);
+				if (msg->sqltype == SQL_TYPE_PEXECUTE || msg->sqltype == SQL_TYPE_PEXECUTE_COLUMNS) {
 					char *nulls;
 					Datum *values;
-					plcTypeInfo *pexecType;
-
-					if (search_pplan(conn, (int64) msg->pplan) < 0)
-						plc_elog(ERROR, "There is no such prepared plan: %p", msg->pplan);
-					plc_plan = (plcPlan *) ((char *) msg->pplan - offsetof(plcPlan, plan));
-					if (plc_plan->nargs != msg->nargs) {
-						plc_elog(ERROR, "argument number wrong for execute with plan: "
-									"Saved number (%d) vs transferred number (%d)",
-								     plc_plan->nargs, msg->nargs);
-					}
 
-					if (msg->nargs > 0) {
-						nulls = pmalloc(msg->nargs * sizeof(char));
-						values = pmalloc(msg->nargs * sizeof(Datum));
-					} else {
-						nulls = NULL;
-						values = NULL;
-					}
-					pexecType = palloc(sizeof(plcTypeInfo));
-
-					for (i = 0; i < msg->nargs; i++) {
-						if (msg->args[i].data.isnull) {
-							/* all the build-in type is strict, so we set value to Datum 0. */
-							values[i] = (Datum) 0;
-							nulls[i] = 'n';
-						} else {
-							/* A bit heavy to populate plcTypeInfo. */
-							fill_type_info(NULL, plc_plan->argOids[i], pexecType);
-							values[i] = pexecType->infunc(msg->args[i].data.value, pexecType);
-							nulls[i] = ' ';
-						}
-					}
+					plc_plan = lookup_plc_plan(conn, msg);
+					fill_plan_values(plc_plan, msg, &values, &nulls);
 
 					retval = SPI_execute_plan(plc_plan->plan, values, nulls,
 					                          pinfo->fn_readonly, (long) msg->limit);
@@ -312,7 +615,6 @@ plcMessage *handle_sql_message(plcMsgSQL *msg, plcConn *conn, plcProcInfo *pinfo
 						pfree(values);
 					if (nulls)
 						pfree(nulls);
-					pfree(pexecType);
 				} else {
 					retval = SPI_execute(msg->statement, pinfo->fn_readonly,
 					                     (long) msg->limit);
@@ -323,13 +625,19 @@ plcMessage *handle_sql_message(plcMsgSQL *msg, plcConn *conn, plcProcInfo *pinfo
 					case SPI_OK_DELETE_RETURNING:
 					case SPI_OK_UPDATE_RETURNING:
 						/* some data was returned back */
-						result = (plcMessage *) create_sql_result(true);
+						if (columnar)
+							result = (plcMessage *) create_sql_columns(true);
+						else
+							result = (plcMessage *) create_sql_result(true);
 						break;
 					case SPI_OK_INSERT:
 					case SPI_OK_DELETE:
 					case SPI_OK_UPDATE:
 						/* only return number of rows that are processed */
-						result = (plcMessage *) create_sql_result(false);
+						if (columnar)
+							result = (plcMessage *) create_sql_columns(false);
+						else
+							result = (plcMessage *) create_sql_result(false);
 						break;
 					default:
 						plc_elog(ERROR, "Cannot handle sql ('%s') with fn_readonly (%d) "
@@ -365,7 +673,7 @@ plcMessage *handle_sql_message(plcMsgSQL *msg, plcConn *conn, plcProcInfo *pinfo
 						plc_elog(ERROR, "prepare type is bad, unexpected prepare sql type %d",
 								        msg->args[i].type.type);
 					}
-					argTypes[i] = plc_get_datatype_from_oid(plc_plan->argOids[i]);
+					argTypes[i] = plc_get_datatype_from_oid(getBaseType(plc_plan->argOids[i]));
 				}
 				plc_plan->nargs = msg->nargs;
 				plc_plan->plan = SPI_prepare(msg->statement, plc_plan->nargs, plc_plan->argOids);
@@ -391,6 +699,52 @@ plcMessage *handle_sql_message(plcMsgSQL *msg, plcConn *conn, plcProcInfo *pinfo
 				retval = free_plc_plan(conn, (int64) msg->pplan);
 				result = (plcMessage *) create_unprepare_result(retval);
 				break;
+			case SQL_TYPE_CURSOR_OPEN:
+				if (msg->limit <= 0)
+					plc_elog(ERROR, "cursor batch size must be positive, got " INT64_FORMAT, msg->limit);
+				get_cursor_name(conn, msg->cursor, name);
+				if (msg->pplan != NULL) {
+					char *nulls;
+					Datum *values;
+
+					plc_plan = lookup_plc_plan(conn, msg);
+					fill_plan_values(plc_plan, msg, &values, &nulls);
+					portal = SPI_cursor_open(name, plc_plan->plan, values, nulls, pinfo->fn_readonly);
+					if (values)
+						pfree(values);
+					if (nulls)
+						pfree(nulls);
+				} else {
+					tmpplan = SPI_prepare(msg->statement, 0, NULL);
+					if (tmpplan == NULL)
+						plc_elog(ERROR, "SPI_prepare() fails for cursor '%s': %s",
+						         msg->statement, SPI_result_code_string(SPI_result));
+					portal = SPI_cursor_open(name, tmpplan, NULL, NULL, pinfo->fn_readonly);
+					SPI_freeplan(tmpplan);
+				}
+				if (portal == NULL)
+					plc_elog(ERROR, "SPI_cursor_open() fails for cursor %d: %s",
+					         msg->cursor, SPI_result_code_string(SPI_result));
+				/* The first batch travels back with the open request */
+				result = (plcMessage *) fetch_sql_cursor(portal, msg->limit);
+				break;
+			case SQL_TYPE_FETCH:
+				if (msg->limit <= 0)
+					plc_elog(ERROR, "cursor batch size must be positive, got " INT64_FORMAT, msg->limit);
+				get_cursor_name(conn, msg->cursor, name);
+				portal = SPI_cursor_find(name);
+				if (portal == NULL)
+					plc_elog(ERROR, "cursor %d is not open", msg->cursor);
+				result = (plcMessage *) fetch_sql_cursor(portal, msg->limit);
+				break;
+			case SQL_TYPE_CURSOR_CLOSE:
+				/* The cursor may already be gone with its transaction, that is fine */
+				get_cursor_name(conn, msg->cursor, name);
+				portal = SPI_cursor_find(name);
+				if (portal != NULL)
+					SPI_cursor_close(portal);
+				result = (plcMessage *) create_unprepare_result(portal != NULL);
+				break;
 			default:
 				plc_elog(ERROR, "Cannot handle sql type %d", msg->sqltype);
 				break;
@@ -0,0 +1,159 @@
+/*------------------------------------------------------------------------------
+ *
+ * Backend-local cache of the type info of query results and plan arguments
+ *
+ * Copyright (c) 2016-Present Pivotal Software, Inc
+ *
+ *------------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+#include "utils/hsearch.h"
+#include "utils/inval.h"
+#include "utils/syscache.h"
+
+#include "type_cache.h"
+
+#define PLC_TYPE_CACHE_SIZE 64
+
+typedef struct plcTypeCacheEntry {
+	Oid typeOid;  /* hash key */
+	bool valid;   /* info is up to date */
+	bool filled;  /* info holds memory to free before filling it again */
+	plcTypeInfo info;
+} plcTypeCacheEntry;
+
+static HTAB *plcTypeCache = NULL;
+
+/* Number of invalidations received, to notice those arriving while filling an entry */
+static uint32 plcTypeCacheInvalidations = 0;
+
+/* Whether the type info reads rows of the relation, any relation if relid is invalid */
+static bool type_info_uses_rel(plcTypeInfo *type, Oid relid) {
+	int i;
+
+	if (type->is_rowtype && (!OidIsValid(relid) || type->typ_relid == relid))
+		return true;
+	for (i = 0; i < type->nSubTypes; i++) {
+		if (!type->subTypes[i].attisdropped && type_info_uses_rel(&type->subTypes[i], relid))
+			return true;
+	}
+	return false;
+}
+
+#if PG_VERSION_NUM >= 90200
+/* Whether the type info reads values of the type or domain of the pg_type row */
+static bool type_info_uses_type(plcTypeInfo *type, uint32 hashvalue) {
+	int i;
+
+	if (type->typ_hashvalue == hashvalue
+	    || (OidIsValid(type->domainOid) && type->domain_hashvalue == hashvalue))
+		return true;
+	for (i = 0; i < type->nSubTypes; i++) {
+		if (!type->subTypes[i].attisdropped && type_info_uses_type(&type->subTypes[i], hashvalue))
+			return true;
+	}
+	return false;
+}
+#endif
+
+/*
+ * The entries are only marked here, since an invalidation may arrive while
+ * their info is in use, and are filled again when they are next looked up.
+ * Only the entries using the changed pg_type row are marked, all of them
+ * after a cache reset, with a hash value of 0, or where the rows are not
+ * told by their hash values.
+ */
+#if PG_VERSION_NUM >= 90200
+static void type_cache_type_callback(pg_attribute_unused() Datum arg, pg_attribute_unused() int cacheid,
+                                     uint32 hashvalue) {
+#else
+static void type_cache_type_callback(pg_attribute_unused() Datum arg, pg_attribute_unused() int cacheid,
+                                     pg_attribute_unused() ItemPointer tuplePtr) {
+#endif
+	HASH_SEQ_STATUS status;
+	plcTypeCacheEntry *entry;
+
+	plcTypeCacheInvalidations++;
+	hash_seq_init(&status, plcTypeCache);
+	while ((entry = (plcTypeCacheEntry *) hash_seq_search(&status)) != NULL) {
+#if PG_VERSION_NUM >= 90200
+		if (hashvalue != 0 && entry->valid && !type_info_uses_type(&entry->info, hashvalue))
+			continue;
+#endif
+		entry->valid = false;
+	}
+}
+
+static void type_cache_rel_callback(pg_attribute_unused() Datum arg, Oid relid) {
+	HASH_SEQ_STATUS status;
+	plcTypeCacheEntry *entry;
+
+	plcTypeCacheInvalidations++;
+	hash_seq_init(&status, plcTypeCache);
+	while ((entry = (plcTypeCacheEntry *) hash_seq_search(&status)) != NULL) {
+		if (entry->valid && type_info_uses_rel(&entry->info, relid))
+			entry->valid = false;
+	}
+}
+
+static void type_cache_init(void) {
+	HASHCTL hash_ctl;
+
+	MemSet(&hash_ctl, 0, sizeof(hash_ctl));
+	hash_ctl.keysize = sizeof(Oid);
+	hash_ctl.entrysize = sizeof(plcTypeCacheEntry);
+	hash_ctl.hash = tag_hash;
+	plcTypeCache = hash_create("plcontainer type info cache",
+	                           PLC_TYPE_CACHE_SIZE,
+	                           &hash_ctl,
+	                           HASH_ELEM | HASH_FUNCTION);
+
+	CacheRegisterSyscacheCallback(TYPEOID, type_cache_type_callback, (Datum) 0);
+	CacheRegisterRelcacheCallback(type_cache_rel_callback, (Datum) 0);
+}
+
+plcTypeInfo *type_cache_get(Oid typeOid) {
+	plcTypeCacheEntry *entry;
+	bool found;
+
+	if (plcTypeCache == NULL) {
+		type_cache_init();
+	}
+
+	entry = (plcTypeCacheEntry *) hash_search(plcTypeCache, &typeOid, HASH_ENTER, &found);
+	if (!found) {
+		entry->valid = false;
+		entry->filled = false;
+	}
+
+	if (!entry->valid) {
+		uint32 invalidations = plcTypeCacheInvalidations;
+		plcTypeInfo info;
+
+		/*
+		 * The info is filled aside and freed if that fails, which leaves the
+		 * entry as it was, to be filled again on the next lookup
+		 */
+		MemSet(&info, 0, sizeof(plcTypeInfo));
+		PG_TRY();
+		{
+			fill_type_info(NULL, typeOid, &info);
+		}
+		PG_CATCH();
+		{
+			free_type_info(&info);
+			PG_RE_THROW();
+		}
+		PG_END_TRY();
+
+		if (entry->filled) {
+			free_type_info(&entry->info);
+		}
+		entry->info = info;
+		entry->filled = true;
+		entry->valid = (invalidations == plcTypeCacheInvalidations);
+	}
+
+	return &entry->info;
+}
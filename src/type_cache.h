@@ -0,0 +1,22 @@
+/*------------------------------------------------------------------------------
+ *
+ *
+ * Copyright (c) 2016-Present Pivotal Software, Inc
+ *
+ *------------------------------------------------------------------------------
+ */
+
+#ifndef PLC_TYPE_CACHE_H
+#define PLC_TYPE_CACHE_H
+
+#include "plc_typeio.h"
+
+/*
+ * Type info of the values of a type, filled on first use and kept until the
+ * type or the relation of a row type changes. It is shared by all the users
+ * of the type and must not be modified or freed. It carries no typmod, which
+ * the conversions of results do not use.
+ */
+plcTypeInfo *type_cache_get(Oid typeOid);
+
+#endif /* PLC_TYPE_CACHE_H */
@@ -4,6 +4,16 @@ import math
 return math.log10(100)                                                          
 $$ LANGUAGE plcontainer;
 
+CREATE OR REPLACE FUNCTION pytext_ascii(n int) RETURNS text AS $$
+# container: plc_python_shared
+return 'abcdefghij' * (n / 10)
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pytext_utf8(n int) RETURNS text AS $$
+# container: plc_python_shared
+return u'\u00e9t\u00e9 \u4e2d\u6587 x' * (n / 10)
+$$ LANGUAGE plcontainer;
+
 CREATE LANGUAGE plpythonu;
 CREATE OR REPLACE FUNCTION pylog100_py() RETURNS double precision AS $$
 import math
@@ -0,0 +1,5 @@
+\timing
+explain analyze select length(pytext_ascii(100)) from a4;
+explain analyze select length(pytext_utf8(100)) from a4;
+explain analyze select length(pytext_ascii(100000)) from a;
+explain analyze select length(pytext_utf8(100000)) from a;
@@ -0,0 +1,224 @@
+/*------------------------------------------------------------------------------
+ *
+ * Throughput of the check of the UTF-8 text returned by the client, against a
+ * scalar check in the style of pg_verify_mbstr(), after a random comparison
+ * of the two. It is built out of the tree against the server headers:
+ *
+ *   cc -O2 -I$(pg_config --includedir-server) -I../../src utf8_bench.c -o utf8_bench
+ *   ./utf8_bench [random inputs]
+ *
+ * Copyright (c) 2016-Present Pivotal Software, Inc
+ *
+ *------------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <time.h>
+
+#include "plc_encoding.c"
+
+/* The server functions plc_verify_server_text() calls */
+int GetDatabaseEncoding(void) {
+	return PG_UTF8;
+}
+
+bool pg_verify_mbstr(int encoding, const char *mbstr, int len, bool noError) {
+	(void) encoding;
+	(void) mbstr;
+	(void) len;
+	(void) noError;
+	return false;
+}
+
+static int bench_mblen(const unsigned char *s) {
+	if ((*s & 0x80) == 0)
+		return 1;
+	else if ((*s & 0xE0) == 0xC0)
+		return 2;
+	else if ((*s & 0xF0) == 0xE0)
+		return 3;
+	else if ((*s & 0xF8) == 0xF0)
+		return 4;
+	return 1;
+}
+
+/* pg_utf8_islegal() of the server */
+static bool bench_islegal(const unsigned char *source, int length) {
+	unsigned char a;
+
+	switch (length) {
+		default:
+			return false;
+		case 4:
+			a = source[3];
+			if (a < 0x80 || a > 0xBF)
+				return false;
+			/* FALLTHROUGH */
+		case 3:
+			a = source[2];
+			if (a < 0x80 || a > 0xBF)
+				return false;
+			/* FALLTHROUGH */
+		case 2:
+			a = source[1];
+			switch (*source) {
+				case 0xE0:
+					if (a < 0xA0 || a > 0xBF)
+						return false;
+					break;
+				case 0xED:
+					if (a < 0x80 || a > 0x9F)
+						return false;
+					break;
+				case 0xF0:
+					if (a < 0x90 || a > 0xBF)
+						return false;
+					break;
+				case 0xF4:
+					if (a < 0x80 || a > 0x8F)
+						return false;
+					break;
+				default:
+					if (a < 0x80 || a > 0xBF)
+						return false;
+					break;
+			}
+			/* FALLTHROUGH */
+		case 1:
+			a = *source;
+			if (a >= 0x80 && a < 0xC2)
+				return false;
+			if (a > 0xF4)
+				return false;
+			break;
+	}
+	return true;
+}
+
+/* The scalar check, which takes zero bytes like plc_utf8_valid() does */
+static bool bench_scalar(const char *s, int len) {
+	const unsigned char *p = (const unsigned char *) s;
+	int l;
+
+	while (len > 0) {
+		if ((*p & 0x80) == 0) {
+			p++;
+			len--;
+			continue;
+		}
+		l = bench_mblen(p);
+		if (len < l || !bench_islegal(p, l))
+			return false;
+		p += l;
+		len -= l;
+	}
+	return true;
+}
+
+static double bench_now(void) {
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+/*
+ * Random input of up to 100 bytes, so that the sequences fall across the
+ * 32-byte blocks of the vectorized check: mostly valid characters, with
+ * random bytes among them
+ */
+static int bench_random(unsigned char *buf) {
+	static const char *chars[] = {"a", "", "\xC3\xA9", "\xE6\xBC\xA2", "\xF0\x9F\x98\x80"};
+	int n = rand() % 101;
+	int i = 0;
+	int k;
+
+	while (i < n) {
+		k = rand() % 8;
+		if (k < 5) {
+			int l = k == 1 ? 1 : (int) strlen(chars[k]);
+
+			if (i + l > n)
+				break;
+			memcpy(buf + i, chars[k], l);
+			i += l;
+		} else if (k == 5) {
+			buf[i++] = 0x80 + rand() % 64;
+		} else if (k == 6) {
+			buf[i++] = 0xC0 + rand() % 64;
+		} else {
+			buf[i++] = rand() % 256;
+		}
+	}
+	return i;
+}
+
+static void bench_fill(char *buf, int n, const char *unit) {
+	int u = strlen(unit);
+	int i;
+
+	for (i = 0; i + u <= n; i += u)
+		memcpy(buf + i, unit, u);
+	for (; i < n; i++)
+		buf[i] = 'a';
+}
+
+int main(int argc, char **argv) {
+	static const char *names[] = {"ASCII", "Latin-1", "CJK"};
+	static const char *units[] = {
+		"The quick brown fox jumps over the lazy dog. ",
+		"Gr\xC3\xB6\xC3\x9F" "e caf\xC3\xA9 na\xC3\xAFve d\xC3\xA9j\xC3\xA0 vu \xC3\xBC" "ber ",
+		"\xE6\xBC\xA2\xE5\xAD\x97\xE3\x83\x86\xE3\x82\xAD\xE3\x82\xB9\xE3\x83\x88"
+		"\xE4\xB8\xAD\xE6\x96\x87\xED\x95\x9C\xEA\xB5\xAD\xEC\x96\xB4"};
+	int sizes[] = {16, 100, 4096};
+	long inputs = argc > 1 ? atol(argv[1]) : 2000000;
+	unsigned char input[100];
+	long i;
+	int k;
+	int z;
+
+	srand(1);
+	for (i = 0; i < inputs; i++) {
+		int n = bench_random(input);
+
+		if (plc_utf8_valid((char *) input, n) != bench_scalar((char *) input, n)) {
+			printf("mismatch at input %ld\n", i);
+			return 1;
+		}
+	}
+	printf("%ld random inputs checked\n", inputs);
+
+	for (k = 0; k < 3; k++) {
+		for (z = 0; z < 3; z++) {
+			int n = sizes[z];
+			long reps = 400000000 / n;
+			char *buf = malloc(n);
+			double t0;
+			double t1;
+			double t2;
+			long valid = 0;
+
+			bench_fill(buf, n, units[k]);
+			/* Cut at a character boundary */
+			while (n > 0 && !bench_scalar(buf, n))
+				n--;
+
+			t0 = bench_now();
+			for (i = 0; i < reps; i++) {
+				valid += bench_scalar(buf, n);
+				__asm__ volatile("" ::: "memory");
+			}
+			t1 = bench_now();
+			for (i = 0; i < reps; i++) {
+				valid += plc_utf8_valid(buf, n);
+				__asm__ volatile("" ::: "memory");
+			}
+			t2 = bench_now();
+
+			printf("%-8s %5d bytes: scalar %7.0f MB/s, plc_utf8_valid %7.0f MB/s (%ld)\n", names[k], n,
+			       (double) n * reps / (t1 - t0) / 1e6, (double) n * reps / (t2 - t1) / 1e6, valid);
+			free(buf);
+		}
+	}
+	return 0;
+}
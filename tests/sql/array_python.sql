@@ -0,0 +1,53 @@
+CREATE FUNCTION array_echo_bool(a bool[]) RETURNS bool[] AS $$
+# container: plc_python_shared
+return a
+$$ LANGUAGE plcontainer;
+
+CREATE FUNCTION array_echo_int4(a int[]) RETURNS int[] AS $$
+# container: plc_python_shared
+return a
+$$ LANGUAGE plcontainer;
+
+CREATE FUNCTION array_echo_float8(a float8[]) RETURNS float8[] AS $$
+# container: plc_python_shared
+return a
+$$ LANGUAGE plcontainer;
+
+CREATE FUNCTION array_echo_text(a text[]) RETURNS text[] AS $$
+# container: plc_python_shared
+return a
+$$ LANGUAGE plcontainer;
+
+CREATE FUNCTION array_echo_bytea(a bytea[]) RETURNS bytea[] AS $$
+# container: plc_python_shared
+return a
+$$ LANGUAGE plcontainer;
+
+CREATE FUNCTION array_int8_as_text(a int8[]) RETURNS text[] AS $$
+# container: plc_python_shared
+return a
+$$ LANGUAGE plcontainer;
+
+CREATE FUNCTION array_sum_int8(n int) RETURNS int8 AS $$
+# container: plc_python_shared
+return sum(plpy.execute('select array_agg(id)::int8[] a from generate_series(1, %d) id' % n)[0]['a'])
+$$ LANGUAGE plcontainer;
+
+SELECT array_echo_bool(ARRAY[true, NULL, false]);
+SELECT array_echo_int4(ARRAY[1, 2, NULL, 4]);
+SELECT array_echo_int4(ARRAY[[1, NULL, 3], [4, 5, 6]]);
+SELECT array_echo_int4(ARRAY[]::int[]);
+SELECT array_echo_float8(ARRAY[[1.5, 2.5], [NULL, -3.25]]);
+SELECT array_echo_text(ARRAY['a', NULL, '', 'hello world']);
+SELECT array_echo_text(ARRAY[['a', 'b'], ['c', NULL]]);
+SELECT array_echo_bytea(ARRAY['foo'::bytea, NULL, ''::bytea, 'bar'::bytea]);
+SELECT array_int8_as_text(ARRAY[1, NULL, 3]::int8[]);
+SELECT array_sum_int8(100000);
+
+DROP FUNCTION array_echo_bool(bool[]);
+DROP FUNCTION array_echo_int4(int[]);
+DROP FUNCTION array_echo_float8(float8[]);
+DROP FUNCTION array_echo_text(text[]);
+DROP FUNCTION array_echo_bytea(bytea[]);
+DROP FUNCTION array_int8_as_text(int8[]);
+DROP FUNCTION array_sum_int8(int);
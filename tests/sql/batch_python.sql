@@ -0,0 +1,36 @@
+CREATE FUNCTION batch_double(x float8[]) RETURNS float8[] AS $$
+# container: plc_python_shared
+# batch: 2
+if x is None:
+    return None
+return x * 2
+$$ LANGUAGE plcontainer;
+
+CREATE FUNCTION batch_concat(a text[], b int[]) RETURNS text[] AS $$
+# container: plc_python_shared
+# batch: 3
+return '%s-%s' % (a, b)
+$$ LANGUAGE plcontainer;
+
+CREATE FUNCTION batch_scalar(x int) RETURNS int AS $$
+# container: plc_python_shared
+# batch: 10
+return x
+$$ LANGUAGE plcontainer;
+
+CREATE FUNCTION batch_bad_size(x int[]) RETURNS int[] AS $$
+# container: plc_python_shared
+# batch: 0
+return x
+$$ LANGUAGE plcontainer;
+
+SELECT batch_double(ARRAY[1, 2, NULL, 4, 5]::float8[]);
+SELECT batch_double(ARRAY[]::float8[]);
+SELECT batch_double(NULL);
+SELECT batch_concat(ARRAY['a', 'b', 'c', 'd'], ARRAY[1, 2, 3, 4]);
+SELECT batch_concat(ARRAY['a', 'b'], ARRAY[1]);
+SELECT batch_scalar(1);
+
+DROP FUNCTION batch_double(float8[]);
+DROP FUNCTION batch_concat(text[], int[]);
+DROP FUNCTION batch_scalar(int);
@@ -0,0 +1,35 @@
+-- A cancel reaches the backend while it waits for the container, the
+-- containers of the session are deleted and the next call starts a new one
+CREATE OR REPLACE FUNCTION pycancel_sleep(s float8) RETURNS int AS $$
+# container: plc_python_shared
+import time
+time.sleep(s)
+return 1
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pycancel_rows(s float8) RETURNS SETOF int AS $$
+# container: plc_python_shared
+import time
+for i in range(2000):
+    if i == 1500:
+        time.sleep(s)
+    yield i
+$$ LANGUAGE plcontainer;
+
+-- Each case starts the container before the timeout is set
+SELECT pycancel_sleep(0);
+SET statement_timeout = '1s';
+-- Waiting for the result of a call
+SELECT pycancel_sleep(60);
+RESET statement_timeout;
+
+SELECT pycancel_sleep(0);
+SET statement_timeout = '1s';
+-- Waiting for the second chunk of rows of a set-returning function
+SELECT count(*) FROM pycancel_rows(60);
+RESET statement_timeout;
+
+SELECT count(*) FROM pycancel_rows(0);
+
+DROP FUNCTION pycancel_sleep(float8);
+DROP FUNCTION pycancel_rows(float8);
@@ -0,0 +1,71 @@
+-- Runs of values longer than the block of fixed-width values (32) and the
+-- block of short text values (1024 bytes) the row programs put together at a
+-- time, and more result descriptors than the table of a connection holds
+-- (1024), whose rows are then run by programs compiled for each message
+CREATE OR REPLACE FUNCTION pycodec_create_type() RETURNS void AS $$
+# container: plc_python_shared
+cols = ['i%d int8' % i for i in range(100)]
+cols += ['f%d float8' % i for i in range(100)]
+cols += ['t%d text' % i for i in range(300)]
+cols += ['b%d bool' % i for i in range(40)]
+plpy.execute('create type codec_row as (%s)' % ', '.join(cols))
+$$ LANGUAGE plcontainer;
+
+SELECT pycodec_create_type();
+
+CREATE OR REPLACE FUNCTION pycodec_query() RETURNS text AS $$
+# container: plc_python_shared
+cols = ['%d::int8 as i%d' % (i * 100000000, i) for i in range(100)]
+cols += ['%d.25::float8 as f%d' % (i, i) for i in range(100)]
+cols += ["repeat('%s', %d) as t%d" % ('l' if i == 150 else 's', 2000 if i == 150 else 5, i) for i in range(300)]
+cols += ['%s as b%d' % ('true' if i % 2 else 'false', i) for i in range(40)]
+r = plpy.execute('select ' + ', '.join(cols))[0]
+return '%d %.2f %d %d' % (sum(r['i%d' % i] for i in range(100)),
+                          sum(r['f%d' % i] for i in range(100)),
+                          sum(len(r['t%d' % i]) for i in range(300)),
+                          sum(1 for i in range(40) if r['b%d' % i]))
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pycodec_make() RETURNS codec_row AS $$
+# container: plc_python_shared
+r = {}
+for i in range(100):
+    r['i%d' % i] = i * 100000000
+    r['f%d' % i] = i + 0.25
+for i in range(300):
+    r['t%d' % i] = 'l' * 2000 if i == 150 else 's' * 5
+for i in range(40):
+    r['b%d' % i] = i % 2 == 1
+return r
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pycodec_sum(r codec_row) RETURNS text AS $$
+# container: plc_python_shared
+return '%d %.2f %d %d' % (sum(r['i%d' % i] for i in range(100)),
+                          sum(r['f%d' % i] for i in range(100)),
+                          sum(len(r['t%d' % i]) for i in range(300)),
+                          sum(1 for i in range(40) if r['b%d' % i]))
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pycodec_descriptors(n int) RETURNS bigint AS $$
+# container: plc_python_shared
+total = 0
+for i in range(n):
+    total += plpy.execute('select %d as d%d' % (i, i))[0]['d%d' % i]
+return total
+$$ LANGUAGE plcontainer;
+
+SELECT pycodec_query();
+SELECT pycodec_sum(pycodec_make());
+SELECT (pycodec_make()).i99, (pycodec_make()).f99, length((pycodec_make()).t150), (pycodec_make()).b39;
+
+-- The table fills up during the first call, the descriptors past it go inline
+SELECT pycodec_descriptors(1100);
+SELECT pycodec_descriptors(1100);
+
+DROP FUNCTION pycodec_descriptors(int);
+DROP FUNCTION pycodec_sum(codec_row);
+DROP FUNCTION pycodec_make();
+DROP FUNCTION pycodec_query();
+DROP FUNCTION pycodec_create_type();
+DROP TYPE codec_row;
@@ -0,0 +1,47 @@
+-- start_ignore
+\! plcontainer runtime-add -r plc_python_compress -i pivotaldata/plcontainer_python_shared:devel -l python -s use_container_logging=yes -s compression_threshold=64;
+SELECT plcontainer_refresh_local_config(false);
+-- end_ignore
+
+CREATE OR REPLACE FUNCTION pycompress_echo(t text) RETURNS text AS $$
+# container: plc_python_compress
+return t
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pycompress_rows(n int) RETURNS int AS $$
+# container: plc_python_compress
+return sum(len(r['t']) for r in plpy.execute("select i, repeat('x', 100) as t from generate_series(1, %d) i" % n))
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pycompress_plain(t text) RETURNS text AS $$
+# container: plc_python_shared
+return t
+$$ LANGUAGE plcontainer;
+
+-- No connection has been made yet
+SELECT count(*) FROM plcontainer_compression_stats();
+
+SELECT pycompress_echo('short');
+SELECT pycompress_echo(repeat('plcontainer', 10000)) = repeat('plcontainer', 10000);
+SELECT pycompress_rows(1000);
+SELECT pycompress_plain(repeat('plcontainer', 10000)) = repeat('plcontainer', 10000);
+
+-- The compressed runtime sends fewer bytes than it exchanges, the other one counts nothing
+SELECT runtime_id, compression_threshold,
+       raw_bytes_sent > wire_bytes_sent AS sent_compressed,
+       raw_bytes_received > wire_bytes_received AS received_compressed,
+       blocks_compressed > 0 AS blocks_compressed,
+       compress_ms >= 0 AND decompress_ms >= 0 AS timed
+FROM plcontainer_compression_stats() ORDER BY runtime_id;
+
+SELECT runtime_id, raw_bytes_sent, wire_bytes_sent, raw_bytes_received, wire_bytes_received, blocks_compressed
+FROM plcontainer_compression_stats() WHERE compression_threshold = 0;
+
+DROP FUNCTION pycompress_echo(text);
+DROP FUNCTION pycompress_rows(int);
+DROP FUNCTION pycompress_plain(text);
+
+-- start_ignore
+\! plcontainer runtime-delete -r plc_python_compress;
+SELECT plcontainer_refresh_local_config(false);
+-- end_ignore
@@ -0,0 +1,15 @@
+-- plpy.execute_df() needs pandas in the image, see dataframe_python_1.out for
+-- images without it
+CREATE FUNCTION pyspi_execute_df() RETURNS text AS $$
+# container: plc_python_shared
+try:
+	df = plpy.execute_df("select i, 'k' || i as k, i * 1.5::float8 as f from generate_series(1, 3) i order by i")
+except ImportError:
+	return 'skipped: pandas is not installed'
+return "%s %d %s %s %s" % (list(df.columns), len(df), [int(x) for x in df['i']],
+	[str(x) for x in df['k']], [float(x) for x in df['f']])
+$$ LANGUAGE plcontainer;
+
+select pyspi_execute_df();
+
+DROP FUNCTION pyspi_execute_df();
@@ -0,0 +1,115 @@
+SET DateStyle = 'ISO, MDY';
+SET TimeZone = 'Asia/Tokyo';
+
+CREATE FUNCTION datetime_kind_date(d date) RETURNS text AS $$
+# container: plc_python_shared
+return '%s %s' % (type(d).__name__, d)
+$$ LANGUAGE plcontainer;
+
+CREATE FUNCTION datetime_kind_timestamp(t timestamp) RETURNS text AS $$
+# container: plc_python_shared
+return '%s %s' % (type(t).__name__, t)
+$$ LANGUAGE plcontainer;
+
+CREATE FUNCTION datetime_kind_timestamptz(t timestamptz) RETURNS text AS $$
+# container: plc_python_shared
+return '%s %s' % (type(t).__name__, t)
+$$ LANGUAGE plcontainer;
+
+CREATE FUNCTION datetime_kind_interval(i interval) RETURNS text AS $$
+# container: plc_python_shared
+return '%s %s' % (type(i).__name__, i)
+$$ LANGUAGE plcontainer;
+
+CREATE FUNCTION datetime_kind_uuid(u uuid) RETURNS text AS $$
+# container: plc_python_shared
+return '%s %s' % (type(u).__name__, u)
+$$ LANGUAGE plcontainer;
+
+CREATE FUNCTION datetime_echo_date(d date) RETURNS date AS $$
+# container: plc_python_shared
+return d
+$$ LANGUAGE plcontainer;
+
+CREATE FUNCTION datetime_echo_timestamp(t timestamp) RETURNS timestamp AS $$
+# container: plc_python_shared
+return t
+$$ LANGUAGE plcontainer;
+
+CREATE FUNCTION datetime_echo_timestamptz(t timestamptz) RETURNS timestamptz AS $$
+# container: plc_python_shared
+return t
+$$ LANGUAGE plcontainer;
+
+CREATE FUNCTION datetime_echo_interval(i interval) RETURNS interval AS $$
+# container: plc_python_shared
+return i
+$$ LANGUAGE plcontainer;
+
+CREATE FUNCTION datetime_echo_uuid(u uuid) RETURNS uuid AS $$
+# container: plc_python_shared
+return u
+$$ LANGUAGE plcontainer;
+
+CREATE FUNCTION datetime_naive_timestamptz() RETURNS timestamptz AS $$
+# container: plc_python_shared
+import datetime
+return datetime.datetime(2012, 1, 2, 12, 34, 56)
+$$ LANGUAGE plcontainer;
+
+CREATE FUNCTION datetime_text_timestamp(t text) RETURNS timestamp AS $$
+# container: plc_python_shared
+return t
+$$ LANGUAGE plcontainer;
+
+CREATE FUNCTION datetime_text_interval(t text) RETURNS interval AS $$
+# container: plc_python_shared
+return t
+$$ LANGUAGE plcontainer;
+
+CREATE FUNCTION datetime_text_uuid(t text) RETURNS uuid AS $$
+# container: plc_python_shared
+return t
+$$ LANGUAGE plcontainer;
+
+-- Infinite values and those out of the range of Python come as text
+SELECT d, datetime_kind_date(d), datetime_echo_date(d)
+FROM (VALUES ('2012-01-02'::date), ('infinity'), ('-infinity'), ('0044-03-15 BC'), ('12000-01-01')) v(d);
+SELECT t, datetime_kind_timestamp(t), datetime_echo_timestamp(t)
+FROM (VALUES ('2012-01-02 12:34:56.789012'::timestamp), ('infinity'), ('0044-03-15 12:00:00 BC'), ('12000-01-01 00:00:00.5')) v(t);
+
+-- timestamptz values come in UTC
+SELECT t, datetime_kind_timestamptz(t), datetime_echo_timestamptz(t)
+FROM (VALUES ('2012-01-02 12:34:56+04'::timestamptz), ('-infinity'), ('12000-01-01 00:00:00+00')) v(t);
+
+-- Intervals with months come as their text, a timedelta has no months
+SELECT i, datetime_kind_interval(i), datetime_echo_interval(i)
+FROM (VALUES ('1 day 02:03:04'::interval), ('1 year 2 mons 3 days 04:05:06.5'), ('2 mons'), ('-1 mons 2 days -00:00:01')) v(i);
+
+SELECT datetime_kind_uuid('a0eebc99-9c0b-4ef8-bb6d-6bb9bd380a11'), datetime_echo_uuid('a0eebc99-9c0b-4ef8-bb6d-6bb9bd380a11');
+
+-- A naive datetime is taken in the time zone of the session
+SELECT datetime_naive_timestamptz();
+
+-- Strings are taken as text, whatever their length
+SELECT datetime_text_timestamp('01/2/12'), datetime_text_timestamp('2012-01-02 12:34:56');
+SELECT datetime_text_interval('10 days 2:03:04'), datetime_text_interval('1 year');
+SELECT datetime_text_uuid('A0EEBC99-9C0B-4EF8-BB6D-6BB9BD380A11');
+
+DROP FUNCTION datetime_kind_date(date);
+DROP FUNCTION datetime_kind_timestamp(timestamp);
+DROP FUNCTION datetime_kind_timestamptz(timestamptz);
+DROP FUNCTION datetime_kind_interval(interval);
+DROP FUNCTION datetime_kind_uuid(uuid);
+DROP FUNCTION datetime_echo_date(date);
+DROP FUNCTION datetime_echo_timestamp(timestamp);
+DROP FUNCTION datetime_echo_timestamptz(timestamptz);
+DROP FUNCTION datetime_echo_interval(interval);
+DROP FUNCTION datetime_echo_uuid(uuid);
+DROP FUNCTION datetime_naive_timestamptz();
+DROP FUNCTION datetime_text_timestamp(text);
+DROP FUNCTION datetime_text_interval(text);
+DROP FUNCTION datetime_text_uuid(text);
+
+RESET DateStyle;
+RESET TimeZone;
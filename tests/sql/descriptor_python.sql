@@ -0,0 +1,21 @@
+CREATE TYPE descriptor_pair AS (a int, b text);
+
+CREATE FUNCTION descriptor_pair(p descriptor_pair, n int) RETURNS descriptor_pair AS $$
+# container: plc_python_shared
+return {'a': p['a'] + n, 'b': p['b'] * n}
+$$ LANGUAGE plcontainer;
+
+SELECT descriptor_pair(row(x, 'y')::descriptor_pair, x) FROM generate_series(1, 3) x ORDER BY 1;
+SELECT descriptor_pair(row(x, 'z')::descriptor_pair, 1) FROM generate_series(1, 3) x ORDER BY 1;
+
+CREATE FUNCTION descriptor_columns(name text) RETURNS text AS $$
+# container: plc_python_shared
+rv = plpy.execute("select 1 as %s, 'v'::text as b" % name)
+return ','.join(sorted(rv[0].keys()))
+$$ LANGUAGE plcontainer;
+
+SELECT descriptor_columns(n) FROM (VALUES ('a'), ('c'), ('a'), ('d')) t(n) ORDER BY 1;
+
+DROP FUNCTION descriptor_pair(descriptor_pair, int);
+DROP FUNCTION descriptor_columns(text);
+DROP TYPE descriptor_pair;
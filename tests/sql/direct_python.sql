@@ -0,0 +1,40 @@
+-- Values of PLC_BUFFER_DIRECT_SIZE (64 kB) and more bypass the buffers, test
+-- the sizes around it in calls, results and query rows
+CREATE OR REPLACE FUNCTION pydirect_echo(t text) RETURNS text AS $$
+# container: plc_python_shared
+return t
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pydirect_echo_bytea(b bytea) RETURNS bytea AS $$
+# container: plc_python_shared
+return b
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pydirect_pair(a text, b text) RETURNS text AS $$
+# container: plc_python_shared
+return '%d %d' % (len(a), len(b))
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pydirect_rows() RETURNS text AS $$
+# container: plc_python_shared
+rv = plpy.execute("select n, repeat('r', n) as t from (values (65535), (65536), (65537)) v(n) order by n")
+return ' '.join('%d' % len(r['t']) for r in rv)
+$$ LANGUAGE plcontainer;
+
+SELECT n, pydirect_echo(repeat('d', n)) = repeat('d', n) AS same
+FROM (VALUES (65535), (65536), (65537)) t(n) ORDER BY n;
+
+SELECT n, md5(pydirect_echo_bytea(substring(decode(repeat('00ff7f', 21846), 'hex') from 1 for n))) =
+          md5(substring(decode(repeat('00ff7f', 21846), 'hex') from 1 for n)) AS same
+FROM (VALUES (65535), (65536), (65537)) t(n) ORDER BY n;
+
+-- A value going directly between small ones of the same message
+SELECT pydirect_pair(repeat('a', 65536), 'b');
+SELECT pydirect_pair('a', repeat('b', 65537));
+
+SELECT pydirect_rows();
+
+DROP FUNCTION pydirect_echo(text);
+DROP FUNCTION pydirect_echo_bytea(bytea);
+DROP FUNCTION pydirect_pair(text, text);
+DROP FUNCTION pydirect_rows();
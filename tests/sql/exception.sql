@@ -25,21 +25,14 @@ select pyzero();
 -- Test function ok immediately after container is kill-9-ed.
 select pykillself();
 select pyzero();
-select rkillself();
-select rint(0);
 
 -- Test function ok immediately after container captures signal sigsegv.
 select pysegvself();
 select pyzero();
-select rsegvself();
-select rint(0);
 
 -- Test function ok immediately after container exits.
 select pyexit();
 select pyzero();
-select rexit();
-select rint(0);
 
 --  Test shared path write permission for unix domain socket connection.
 select py_shared_path_perm();
-select r_shared_path_perm();
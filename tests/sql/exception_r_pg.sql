@@ -0,0 +1,14 @@
+-- Test function ok immediately after container is kill-9-ed.
+select rkillself();
+select rint(0);
+
+-- Test function ok immediately after container captures signal sigsegv.
+select rsegvself();
+select rint(0);
+
+-- Test function ok immediately after container exits.
+select rexit();
+select rint(0);
+
+--  Test shared path write permission for unix domain socket connection.
+select r_shared_path_perm();
@@ -0,0 +1,70 @@
+-- start_ignore
+\! plcontainer runtime-add -r plc_python_fd -i pivotaldata/plcontainer_python_shared:devel -l python -s use_container_logging=yes -s fd_passing_threshold=4096;
+\! plcontainer runtime-add -r plc_python_fd_shm -i pivotaldata/plcontainer_python_shared:devel -l python -s use_container_logging=yes -s fd_passing_threshold=4096 -s use_shared_memory=yes;
+SELECT plcontainer_refresh_local_config(false);
+-- end_ignore
+
+CREATE OR REPLACE FUNCTION pyfd_echo(t text) RETURNS text AS $$
+# container: plc_python_fd
+return t
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pyfd_echo_bytea(b bytea) RETURNS bytea AS $$
+# container: plc_python_fd
+return b
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pyfd_rows(n int, width int) RETURNS text AS $$
+# container: plc_python_fd
+rv = plpy.execute("select i, repeat('r', %d) as t, 's' as s from generate_series(1, %d) i" % (width, n))
+return '%d %d' % (len(rv), sum(len(r['t']) + len(r['s']) for r in rv))
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pyfd_shm_echo(t text) RETURNS text AS $$
+# container: plc_python_fd_shm
+return t
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pyfd_shm_echo_bytea(b bytea) RETURNS bytea AS $$
+# container: plc_python_fd_shm
+return b
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pyfd_shm_rows(n int, width int) RETURNS text AS $$
+# container: plc_python_fd_shm
+rv = plpy.execute("select i, repeat('r', %d) as t, 's' as s from generate_series(1, %d) i" % (width, n))
+return '%d %d' % (len(rv), sum(len(r['t']) + len(r['s']) for r in rv))
+$$ LANGUAGE plcontainer;
+
+-- The threshold counts the terminating zero of a text and the length of a
+-- bytea, the values from 4095 characters and 4092 bytes on go as files
+SELECT n, pyfd_echo(repeat('f', n)) = repeat('f', n) AS same,
+          pyfd_shm_echo(repeat('f', n)) = repeat('f', n) AS same_shm
+FROM (VALUES (4094), (4095), (4096), (100000)) t(n) ORDER BY n;
+
+SELECT n, md5(pyfd_echo_bytea(substring(decode(repeat('00ff7f', 33334), 'hex') from 1 for n))) =
+          md5(substring(decode(repeat('00ff7f', 33334), 'hex') from 1 for n)) AS same,
+          md5(pyfd_shm_echo_bytea(substring(decode(repeat('00ff7f', 33334), 'hex') from 1 for n))) =
+          md5(substring(decode(repeat('00ff7f', 33334), 'hex') from 1 for n)) AS same_shm
+FROM (VALUES (4091), (4092), (4093), (100000)) t(n) ORDER BY n;
+
+-- Many files in the rows of one result, each between small values
+SELECT pyfd_rows(200, 4096);
+SELECT pyfd_shm_rows(200, 4096);
+
+-- Values below the threshold keep going inline on the same connections
+SELECT pyfd_echo('short'), pyfd_shm_echo('short');
+SELECT pyfd_rows(200, 10), pyfd_shm_rows(200, 10);
+
+DROP FUNCTION pyfd_echo(text);
+DROP FUNCTION pyfd_echo_bytea(bytea);
+DROP FUNCTION pyfd_rows(int, int);
+DROP FUNCTION pyfd_shm_echo(text);
+DROP FUNCTION pyfd_shm_echo_bytea(bytea);
+DROP FUNCTION pyfd_shm_rows(int, int);
+
+-- start_ignore
+\! plcontainer runtime-delete -r plc_python_fd;
+\! plcontainer runtime-delete -r plc_python_fd_shm;
+SELECT plcontainer_refresh_local_config(false);
+-- end_ignore
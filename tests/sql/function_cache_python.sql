@@ -0,0 +1,79 @@
+-- A called function is built again once its definition changes
+CREATE FUNCTION pycache_body() RETURNS text AS $$
+# container: plc_python_shared
+return 'first'
+$$ LANGUAGE plcontainer;
+
+SELECT pycache_body();
+CREATE OR REPLACE FUNCTION pycache_body() RETURNS text AS $$
+# container: plc_python_shared
+return 'second'
+$$ LANGUAGE plcontainer;
+
+SELECT pycache_body();
+
+-- or once the row type of an argument changes
+CREATE TABLE pycache_row (k int, a int) DISTRIBUTED BY (k);
+INSERT INTO pycache_row VALUES (1, 2);
+
+CREATE FUNCTION pycache_row_items(r pycache_row) RETURNS text AS $$
+# container: plc_python_shared
+return str(sorted(r.items()))
+$$ LANGUAGE plcontainer;
+
+SELECT pycache_row_items(t) FROM pycache_row t;
+ALTER TABLE pycache_row ADD COLUMN b text DEFAULT 'x';
+SELECT pycache_row_items(t) FROM pycache_row t;
+ALTER TABLE pycache_row DROP COLUMN a;
+SELECT pycache_row_items(t) FROM pycache_row t;
+
+-- A query may call more functions than the cache used to hold
+CREATE FUNCTION pycache_f1(i int) RETURNS int AS $$
+# container: plc_python_shared
+return i + 1
+$$ LANGUAGE plcontainer;
+
+CREATE FUNCTION pycache_f2(i int) RETURNS int AS $$
+# container: plc_python_shared
+return i + 2
+$$ LANGUAGE plcontainer;
+
+CREATE FUNCTION pycache_f3(i int) RETURNS int AS $$
+# container: plc_python_shared
+return i + 3
+$$ LANGUAGE plcontainer;
+
+CREATE FUNCTION pycache_f4(i int) RETURNS int AS $$
+# container: plc_python_shared
+return i + 4
+$$ LANGUAGE plcontainer;
+
+CREATE FUNCTION pycache_f5(i int) RETURNS int AS $$
+# container: plc_python_shared
+return i + 5
+$$ LANGUAGE plcontainer;
+
+CREATE FUNCTION pycache_f6(i int) RETURNS int AS $$
+# container: plc_python_shared
+return i + 6
+$$ LANGUAGE plcontainer;
+
+CREATE FUNCTION pycache_f7(i int) RETURNS int AS $$
+# container: plc_python_shared
+return i + 7
+$$ LANGUAGE plcontainer;
+
+SELECT pycache_f1(0), pycache_f2(0), pycache_f3(0), pycache_f4(0), pycache_f5(0), pycache_f6(0), pycache_f7(0);
+SELECT pycache_f7(pycache_f6(pycache_f5(pycache_f4(pycache_f3(pycache_f2(pycache_f1(0)))))));
+SELECT sum(pycache_f1(i) + pycache_f2(i) + pycache_f3(i) + pycache_f4(i) + pycache_f5(i) + pycache_f6(i) + pycache_f7(i)) FROM generate_series(1, 10) i;
+
+DROP FUNCTION pycache_f1(int);
+DROP FUNCTION pycache_f2(int);
+DROP FUNCTION pycache_f3(int);
+DROP FUNCTION pycache_f4(int);
+DROP FUNCTION pycache_f5(int);
+DROP FUNCTION pycache_f6(int);
+DROP FUNCTION pycache_f7(int);
+DROP FUNCTION pycache_row_items(pycache_row);
+DROP TABLE pycache_row;
+DROP FUNCTION pycache_body();
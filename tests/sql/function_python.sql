@@ -42,6 +42,17 @@ $$ LANGUAGE plcontainer;
 
 CREATE OR REPLACE FUNCTION pynumeric(n numeric) RETURNS numeric AS $$
 # container: plc_python_shared
+return n+3
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pynumericfloat(n numeric) RETURNS numeric AS $$
+# container: plc_python_shared
+# numeric: float
+return n+3.0
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pynumericmix(n numeric) RETURNS numeric AS $$
+# container: plc_python_shared
 return n+3.0
 $$ LANGUAGE plcontainer;
 
@@ -55,11 +66,48 @@ CREATE OR REPLACE FUNCTION pytimestamptz(t timestamptz) RETURNS timestamptz AS $
 return t
 $$ LANGUAGE plcontainer;
 
+CREATE OR REPLACE FUNCTION pydatetypes(d date, t timestamp, tz timestamptz, i interval, u uuid) RETURNS text AS $$
+# container: plc_python_shared
+import datetime
+if tz.utcoffset() != datetime.timedelta(0) or d.year != 2012: return 'bad'
+return ' '.join(type(x).__name__ for x in (d, t, tz, i, u))
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pybinarypoint(p point, ps point[]) RETURNS point AS $$
+# container: plc_python_shared
+# binary: point
+if len(p) != 16 or len(ps[0]) != 16: return None
+return ps[0]
+$$ LANGUAGE plcontainer;
+
+CREATE DOMAIN posint AS int CHECK (VALUE > 0);
+CREATE OR REPLACE FUNCTION pyposint(i posint) RETURNS posint AS $$
+# container: plc_python_shared
+return i - 2
+$$ LANGUAGE plcontainer;
+
 CREATE OR REPLACE FUNCTION pytext(t text) RETURNS text AS $$
 # container: plc_python_shared
 return t+'bar'
 $$ LANGUAGE plcontainer;
 
+CREATE OR REPLACE FUNCTION pyvarchar(v varchar, c char(4)) RETURNS varchar AS $$
+# container: plc_python_shared
+return '%s|%s|' % (v, c)
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pybpchar(c char(4)) RETURNS char(4) AS $$
+# container: plc_python_shared
+return c.strip() + '.'
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pyvarcharspi(v varchar) RETURNS varchar AS $$
+# container: plc_python_shared
+plan = plpy.prepare("select $1::char(4) as c, $1 || '!' as v", ['varchar'])
+r = plpy.execute(plan, [v])
+return '%s|%s|' % (r[0]['c'], r[0]['v'])
+$$ LANGUAGE plcontainer;
+
 CREATE OR REPLACE FUNCTION pybytea(r bytea) RETURNS bytea AS $$
 # container: plc_python_shared
 return r
@@ -141,6 +189,11 @@ CREATE OR REPLACE FUNCTION pytsarr(t timestamp[]) RETURNS int AS $$
 return sum([1 if '2010' in x else 0 for x in t])
 $$ LANGUAGE plcontainer;
 
+CREATE OR REPLACE FUNCTION pytsarryear(t timestamp[]) RETURNS int AS $$
+# container: plc_python_shared
+return sum([1 if x.year == 2010 else 0 for x in t])
+$$ LANGUAGE plcontainer;
+
 CREATE OR REPLACE FUNCTION pybyteaarr(b bytea[]) RETURNS bytea AS $$
 # container: plc_python_shared
 return '|'.join([x.decode('UTF8') if x else 'None' for x in b])
@@ -319,7 +372,7 @@ if (sys.version_info.major == 2):
     if r[0]['d'] != 3 or str(type(r[0]['d'])) != "<type 'long'>": return 5
     if r[0]['e'] != 4.0 or str(type(r[0]['e'])) != "<type 'float'>": return 6
     if r[0]['f'] != 5.0 or str(type(r[0]['f'])) != "<type 'float'>": return 7
-    if r[0]['g'] != 6.0 or str(type(r[0]['g'])) != "<type 'float'>": return 8
+    if r[0]['g'] != 6 or str(type(r[0]['g'])) != "<class 'decimal.Decimal'>": return 8
     if r[0]['h'] != 'foobar' or str(type(r[0]['h'])) != "<type 'str'>": return 9
     if r[0]['i'] != 'test' or str(type(r[0]['i'])) != "<type 'str'>": return 10
 # Python 3
@@ -330,7 +383,7 @@ else:
     if r[0]['d'] != 3 or str(type(r[0]['d'])) != "<class 'int'>": return 5
     if r[0]['e'] != 4.0 or str(type(r[0]['e'])) != "<class 'float'>": return 6
     if r[0]['f'] != 5.0 or str(type(r[0]['f'])) != "<class 'float'>": return 7
-    if r[0]['g'] != 6.0 or str(type(r[0]['g'])) != "<class 'float'>": return 8
+    if r[0]['g'] != 6 or str(type(r[0]['g'])) != "<class 'decimal.Decimal'>": return 8
     if r[0]['h'] != 'foobar' or str(type(r[0]['h'])) != "<class 'str'>": return 9
     if r[0]['i'].decode('UTF8') != 'test' or str(type(r[0]['i'])) != "<class 'bytes'>": return 10
 return 11
@@ -352,6 +405,14 @@ CREATE OR REPLACE FUNCTION pylogging2() RETURNS void AS $$
 plpy.execute('select pylogging()')
 $$ LANGUAGE plcontainer;
 
+CREATE OR REPLACE FUNCTION pylogging_order() RETURNS void AS $$
+# container: plc_python_shared
+for i in range(3):
+    plpy.notice('held notice %d' % i)
+plpy.info('info after the notices')
+plpy.error('error after the notices')
+$$ LANGUAGE plcontainer;
+
 CREATE OR REPLACE FUNCTION pygdset(key varchar, value varchar) RETURNS text AS $$
 # container: plc_python_shared
 GD[key] = value
@@ -456,7 +517,7 @@ if (sys.version_info.major == 2):
     if len(r['d']) != 3 or r['d'] != [3,4,5] or str(type(r['d'][0])) != "<type 'long'>": return 5
     if len(r['e']) != 3 or r['e'] != [4.5,5.5,6.5] or str(type(r['e'][0])) != "<type 'float'>": return 6
     if len(r['f']) != 3 or r['f'] != [5.5,6.5,7.5] or str(type(r['f'][0])) != "<type 'float'>": return 7
-    if len(r['g']) != 3 or r['g'] != [6.5,7.5,8.5] or str(type(r['g'][0])) != "<type 'float'>": return 8
+    if len(r['g']) != 3 or r['g'] != [6.5,7.5,8.5] or str(type(r['g'][0])) != "<class 'decimal.Decimal'>": return 8
     if len(r['h']) != 3 or r['h'] != ['a','b','c'] or str(type(r['h'][0])) != "<type 'str'>": return 9
 # Python 3
 else:
@@ -466,7 +527,7 @@ else:
     if len(r['d']) != 3 or r['d'] != [3,4,5] or str(type(r['d'][0])) != "<class 'int'>": return 5
     if len(r['e']) != 3 or r['e'] != [4.5,5.5,6.5] or str(type(r['e'][0])) != "<class 'float'>": return 6
     if len(r['f']) != 3 or r['f'] != [5.5,6.5,7.5] or str(type(r['f'][0])) != "<class 'float'>": return 7
-    if len(r['g']) != 3 or r['g'] != [6.5,7.5,8.5] or str(type(r['g'][0])) != "<class 'float'>": return 8
+    if len(r['g']) != 3 or r['g'] != [6.5,7.5,8.5] or str(type(r['g'][0])) != "<class 'decimal.Decimal'>": return 8
     if len(r['h']) != 3 or r['h'] != ['a','b','c'] or str(type(r['h'][0])) != "<class 'str'>": return 9
 return 10
 $$ LANGUAGE plcontainer;
@@ -491,6 +552,18 @@ CREATE OR REPLACE FUNCTION pytestudt13(r test_type3) RETURNS test_type3 AS $$
 return r
 $$ LANGUAGE plcontainer;
 
+-- The notice of Greenplum about the distribution key is kept out of the output
+SET client_min_messages = warning;
+CREATE TABLE droppedcol_row (a int, b text, c float8, d int);
+RESET client_min_messages;
+ALTER TABLE droppedcol_row DROP COLUMN b;
+INSERT INTO droppedcol_row VALUES (1, 2.5, 3);
+
+CREATE OR REPLACE FUNCTION pydroppedcol(r droppedcol_row) RETURNS droppedcol_row AS $$
+# container: plc_python_shared
+return {'a': r['a'] + 1, 'c': r['c'] * 2, 'd': r['d'] + r['a']}
+$$ LANGUAGE plcontainer;
+
 CREATE OR REPLACE FUNCTION pytestudt16() RETURNS SETOF test_type3 AS $$
 # container: plc_python_shared
 return {'a': [1,3], 'b': [2,4], 'c': ['foo','bar']}
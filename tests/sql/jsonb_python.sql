@@ -0,0 +1,38 @@
+-- jsonb exists from PostgreSQL 9.4 on, see jsonb_python_1.out for Greenplum 5
+CREATE FUNCTION jsonb_kind(j jsonb) RETURNS text AS $$
+# container: plc_python_shared
+import json
+return '%s %s' % (type(j).__name__, json.dumps(j, sort_keys=True))
+$$ LANGUAGE plcontainer;
+
+CREATE FUNCTION jsonb_echo(j jsonb) RETURNS jsonb AS $$
+# container: plc_python_shared
+return j
+$$ LANGUAGE plcontainer;
+
+CREATE FUNCTION jsonb_from_text() RETURNS jsonb AS $$
+# container: plc_python_shared
+return '{"k": [1, "v"], "n": null}'
+$$ LANGUAGE plcontainer;
+
+CREATE FUNCTION jsonb_from_object() RETURNS jsonb AS $$
+# container: plc_python_shared
+return {'k': [1, 'v'], 'n': None}
+$$ LANGUAGE plcontainer;
+
+-- jsonb values are decoded into dicts, lists and scalars
+SELECT jsonb_kind('{"b": [1, 2.5, null, true], "a": {"c": "x"}}');
+SELECT jsonb_kind('[1, "x", false]');
+SELECT jsonb_kind('3');
+SELECT jsonb_kind('null');
+SELECT jsonb_echo('{"b": [1, 2.5, null, true], "a": {"c": "x"}}');
+SELECT jsonb_echo('[1, "x", false]');
+
+-- A string is taken as JSON text, other objects go through json.dumps()
+SELECT jsonb_from_text();
+SELECT jsonb_from_object();
+
+DROP FUNCTION jsonb_kind(jsonb);
+DROP FUNCTION jsonb_echo(jsonb);
+DROP FUNCTION jsonb_from_text();
+DROP FUNCTION jsonb_from_object();
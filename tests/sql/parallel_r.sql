@@ -0,0 +1,42 @@
+-- R functions of the parallel tests, run one after the other
+-- cpu-bound
+CREATE OR REPLACE FUNCTION r_cpu_intensive() RETURNS integer AS $$
+# container: plc_r_shared
+primes <- function(n){
+    p <- 2:n
+    i <- 1
+    while (p[i] <= sqrt(n)) {
+        p <-  p[p %% p[i] != 0 | p==p[i]]
+        i <- i+1
+    }
+    return(length(p))
+}
+ret <- primes(100000)
+return (ret)
+$$ LANGUAGE plcontainer;
+
+-- spi with large io
+CREATE OR REPLACE FUNCTION r_large_spi() RETURNS int8 AS $$
+# container: plc_r_shared
+res<-pg.spi.exec('select * from generate_series(1, 1123123) id')
+mean(res[, 1])
+$$ LANGUAGE plcontainer;
+
+-- write local disk.
+CREATE OR REPLACE FUNCTION r_io_intensive() RETURNS integer AS $$
+# container: plc_r_shared
+a <- matrix(1, ncol=1024, nrow=1024*1)
+write.csv(a, file = "/tmp/testfile_r", row.names = F, quote = F)
+b <- read.csv("/tmp/testfile_r")
+ret <- sum(b)
+return (ret)
+$$ LANGUAGE plcontainer;
+
+select r_large_spi();
+select r_io_intensive();
+
+select rlargeint8in(array_agg(id)) from generate_series(1, 1123123) id;
+select avg(x) from (select unnest(rlargeint8out(1123123)) as x) as q;
+
+select r_cpu_intensive();
+select r_cpu_intensive() from generate_series(1,2);
@@ -0,0 +1,129 @@
+CREATE OR REPLACE FUNCTION pyslice_kind(t text, u text) RETURNS text AS $$
+# container: plc_python_shared
+# slice: t
+if t is None:
+    return 'None / %s %d' % (type(u).__name__, len(u))
+return '%s %d / %s %d' % (type(t).__name__, t.size, type(u).__name__, len(u))
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pyslice_chunks(t text, n int) RETURNS text AS $$
+# container: plc_python_shared
+# slice: t
+chunks = []
+while True:
+    chunk = t.read(n)
+    if not chunk:
+        break
+    chunks.append(len(chunk))
+return '%d %d %d %d' % (t.size, len(chunks), sum(chunks), t.tell())
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pyslice_md5(b bytea) RETURNS text AS $$
+# container: plc_python_shared
+# slice: b
+import hashlib
+h = hashlib.md5()
+with b:
+    chunk = b.read(300000)
+    while chunk:
+        h.update(chunk)
+        chunk = b.read(300000)
+return '%s %s' % (h.hexdigest(), b.closed)
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pyslice_seek(t text) RETURNS text AS $$
+# container: plc_python_shared
+# slice: t
+t.seek(1000)
+a = t.read(10)
+t.seek(-10, 1)
+b = t.read(10)
+t.seek(-5, 2)
+c = t.read(100)
+t.seek(3000000)
+d = t.read(10)
+try:
+    t.seek(-1)
+except ValueError as e:
+    plpy.notice(str(e))
+return '%s %s %s %d %d' % (a == b, a.decode(), c.decode(), len(d), t.tell())
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pyslice_keep(t text) RETURNS bigint AS $$
+# container: plc_python_shared
+# slice: t
+GD['pyslice_reader'] = t
+return t.size
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pyslice_kept() RETURNS text AS $$
+# container: plc_python_shared
+try:
+    GD['pyslice_reader'].read(10)
+except ValueError as e:
+    return str(e)
+return 'read'
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pyslice_nested(t text) RETURNS text AS $$
+# container: plc_python_shared
+# slice: t
+GD['pyslice_reader'] = t
+first = t.read(5)
+nested = plpy.execute("select pyslice_kept() as r")[0]['r']
+return '%s / %s / %s' % (first.decode(), nested, t.read(5).decode())
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pyslice_closed(t text) RETURNS text AS $$
+# container: plc_python_shared
+# slice: t
+t.close()
+try:
+    t.read(10)
+except ValueError as e:
+    return '%s %s' % (t.closed, e)
+return 'read'
+$$ LANGUAGE plcontainer;
+
+-- An argument of the slice declaration comes as a reader whatever its size,
+-- the other ones as strings
+SELECT pyslice_kind('short', 'short');
+SELECT pyslice_kind(repeat('0123456789', 200000), repeat('0123456789', 200000));
+SELECT pyslice_kind(NULL, 'short');
+SELECT pyslice_chunks('short', 2);
+SELECT pyslice_chunks(repeat('0123456789', 200000), 300000);
+SELECT pyslice_chunks(repeat('0123456789', 200000), 2000000);
+SELECT pyslice_md5(convert_to(repeat('0123456789', 200000), 'UTF8')) = md5(repeat('0123456789', 200000)) || ' True';
+SELECT pyslice_seek(repeat('0123456789', 200000));
+
+-- The reader cannot be used once the function returned, nor by a nested call
+SELECT pyslice_keep(repeat('0123456789', 200000));
+SELECT pyslice_kept();
+SELECT pyslice_nested(repeat('0123456789', 200000));
+SELECT pyslice_closed(repeat('0123456789', 200000));
+
+-- Only text and bytea arguments of the function can be declared
+CREATE OR REPLACE FUNCTION pyslice_bad_name(t text) RETURNS text AS $$
+# container: plc_python_shared
+# slice: x
+return 'x'
+$$ LANGUAGE plcontainer;
+CREATE OR REPLACE FUNCTION pyslice_bad_type(t text, i int) RETURNS text AS $$
+# container: plc_python_shared
+# slice: t, i
+return 'x'
+$$ LANGUAGE plcontainer;
+CREATE OR REPLACE FUNCTION pyslice_bad_format(t text) RETURNS text AS $$
+# container: plc_python_shared
+# slice: t u
+return 'x'
+$$ LANGUAGE plcontainer;
+
+DROP FUNCTION pyslice_kind(text, text);
+DROP FUNCTION pyslice_chunks(text, int);
+DROP FUNCTION pyslice_md5(bytea);
+DROP FUNCTION pyslice_seek(text);
+DROP FUNCTION pyslice_keep(text);
+DROP FUNCTION pyslice_kept();
+DROP FUNCTION pyslice_nested(text);
+DROP FUNCTION pyslice_closed(text);
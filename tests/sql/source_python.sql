@@ -0,0 +1,167 @@
+CREATE FUNCTION source_version(x int) RETURNS int AS $$
+# container: plc_python_shared
+return x + 1
+$$ LANGUAGE plcontainer;
+
+SELECT source_version(1);
+SELECT source_version(x) FROM generate_series(1, 3) x ORDER BY 1;
+
+CREATE OR REPLACE FUNCTION source_version(x int) RETURNS int AS $$
+# container: plc_python_shared
+return x * 10
+$$ LANGUAGE plcontainer;
+
+SELECT source_version(1);
+SELECT source_version(x) FROM generate_series(1, 3) x ORDER BY 1;
+
+CREATE FUNCTION source_other(x int) RETURNS int AS $$
+# container: plc_python_shared
+return plpy.execute('select source_version(%d) as v' % x)[0]['v'] + 1
+$$ LANGUAGE plcontainer;
+
+SELECT source_other(5);
+SELECT source_other(6);
+
+-- The client keeps the last 20 functions and the backend remembers more of
+-- them as sent, so a call of an evicted function asks for its source again
+CREATE FUNCTION source_many_1(x int) RETURNS int AS $$
+# container: plc_python_shared
+return x + 1
+$$ LANGUAGE plcontainer;
+
+CREATE FUNCTION source_many_2(x int) RETURNS int AS $$
+# container: plc_python_shared
+return x + 2
+$$ LANGUAGE plcontainer;
+
+CREATE FUNCTION source_many_3(x int) RETURNS int AS $$
+# container: plc_python_shared
+return x + 3
+$$ LANGUAGE plcontainer;
+
+CREATE FUNCTION source_many_4(x int) RETURNS int AS $$
+# container: plc_python_shared
+return x + 4
+$$ LANGUAGE plcontainer;
+
+CREATE FUNCTION source_many_5(x int) RETURNS int AS $$
+# container: plc_python_shared
+return x + 5
+$$ LANGUAGE plcontainer;
+
+CREATE FUNCTION source_many_6(x int) RETURNS int AS $$
+# container: plc_python_shared
+return x + 6
+$$ LANGUAGE plcontainer;
+
+CREATE FUNCTION source_many_7(x int) RETURNS int AS $$
+# container: plc_python_shared
+return x + 7
+$$ LANGUAGE plcontainer;
+
+CREATE FUNCTION source_many_8(x int) RETURNS int AS $$
+# container: plc_python_shared
+return x + 8
+$$ LANGUAGE plcontainer;
+
+CREATE FUNCTION source_many_9(x int) RETURNS int AS $$
+# container: plc_python_shared
+return x + 9
+$$ LANGUAGE plcontainer;
+
+CREATE FUNCTION source_many_10(x int) RETURNS int AS $$
+# container: plc_python_shared
+return x + 10
+$$ LANGUAGE plcontainer;
+
+CREATE FUNCTION source_many_11(x int) RETURNS int AS $$
+# container: plc_python_shared
+return x + 11
+$$ LANGUAGE plcontainer;
+
+CREATE FUNCTION source_many_12(x int) RETURNS int AS $$
+# container: plc_python_shared
+return x + 12
+$$ LANGUAGE plcontainer;
+
+CREATE FUNCTION source_many_13(x int) RETURNS int AS $$
+# container: plc_python_shared
+return x + 13
+$$ LANGUAGE plcontainer;
+
+CREATE FUNCTION source_many_14(x int) RETURNS int AS $$
+# container: plc_python_shared
+return x + 14
+$$ LANGUAGE plcontainer;
+
+CREATE FUNCTION source_many_15(x int) RETURNS int AS $$
+# container: plc_python_shared
+return x + 15
+$$ LANGUAGE plcontainer;
+
+CREATE FUNCTION source_many_16(x int) RETURNS int AS $$
+# container: plc_python_shared
+return x + 16
+$$ LANGUAGE plcontainer;
+
+CREATE FUNCTION source_many_17(x int) RETURNS int AS $$
+# container: plc_python_shared
+return x + 17
+$$ LANGUAGE plcontainer;
+
+CREATE FUNCTION source_many_18(x int) RETURNS int AS $$
+# container: plc_python_shared
+return x + 18
+$$ LANGUAGE plcontainer;
+
+CREATE FUNCTION source_many_19(x int) RETURNS int AS $$
+# container: plc_python_shared
+return x + 19
+$$ LANGUAGE plcontainer;
+
+CREATE FUNCTION source_many_20(x int) RETURNS int AS $$
+# container: plc_python_shared
+return x + 20
+$$ LANGUAGE plcontainer;
+
+CREATE FUNCTION source_many_21(x int) RETURNS int AS $$
+# container: plc_python_shared
+return x + 21
+$$ LANGUAGE plcontainer;
+
+SELECT source_many_1(0);
+SELECT source_many_2(0) + source_many_3(0) + source_many_4(0) + source_many_5(0) + source_many_6(0) + source_many_7(0) + source_many_8(0) + source_many_9(0) + source_many_10(0) + source_many_11(0) + source_many_12(0) + source_many_13(0) + source_many_14(0) + source_many_15(0) + source_many_16(0) + source_many_17(0) + source_many_18(0) + source_many_19(0) + source_many_20(0) + source_many_21(0) AS others;
+SELECT source_many_1(0);
+CREATE OR REPLACE FUNCTION source_many_1(x int) RETURNS int AS $$
+# container: plc_python_shared
+return x + 100
+$$ LANGUAGE plcontainer;
+
+SELECT source_many_1(0);
+SELECT source_many_2(0) + source_many_3(0) + source_many_4(0) + source_many_5(0) + source_many_6(0) + source_many_7(0) + source_many_8(0) + source_many_9(0) + source_many_10(0) + source_many_11(0) + source_many_12(0) + source_many_13(0) + source_many_14(0) + source_many_15(0) + source_many_16(0) + source_many_17(0) + source_many_18(0) + source_many_19(0) + source_many_20(0) + source_many_21(0) AS others;
+SELECT source_many_1(0);
+
+DROP FUNCTION source_many_1(int);
+DROP FUNCTION source_many_2(int);
+DROP FUNCTION source_many_3(int);
+DROP FUNCTION source_many_4(int);
+DROP FUNCTION source_many_5(int);
+DROP FUNCTION source_many_6(int);
+DROP FUNCTION source_many_7(int);
+DROP FUNCTION source_many_8(int);
+DROP FUNCTION source_many_9(int);
+DROP FUNCTION source_many_10(int);
+DROP FUNCTION source_many_11(int);
+DROP FUNCTION source_many_12(int);
+DROP FUNCTION source_many_13(int);
+DROP FUNCTION source_many_14(int);
+DROP FUNCTION source_many_15(int);
+DROP FUNCTION source_many_16(int);
+DROP FUNCTION source_many_17(int);
+DROP FUNCTION source_many_18(int);
+DROP FUNCTION source_many_19(int);
+DROP FUNCTION source_many_20(int);
+DROP FUNCTION source_many_21(int);
+
+DROP FUNCTION source_version(int);
+DROP FUNCTION source_other(int);
@@ -532,3 +532,78 @@ else:
 $$ LANGUAGE plcontainer;
 
 select result_nrows_test();
+
+-- columnar results, the columns are lists or NumPy arrays depending on the image
+CREATE FUNCTION pyspi_execute_columns() RETURNS text AS $$
+# container: plc_python_shared
+rv = plpy.execute_columns("select i, i % 3 = 0 as b, 'k' || (i % 2) as k, case when i > 30 then i / 2.0 end as f from generate_series(1, 40) i order by i")
+return "%s %s %s %d %d" % (sorted(rv.keys()), [int(x) for x in rv['i'][:3]],
+	[str(x) for x in rv['k'][:3]], len([x for x in rv['b'] if x]),
+	len([x for x in rv['f'] if x is not None and x == x]))
+$$ LANGUAGE plcontainer;
+
+CREATE FUNCTION pyspi_execute_columns_plan() RETURNS text AS $$
+# container: plc_python_shared
+plan = plpy.prepare("select i, 'v' || i as v from generate_series(1, $1) i order by i", ["int4"])
+rv = plpy.execute_columns(plan, [10], 4)
+return "%s %s" % ([int(x) for x in rv['i']], [str(x) for x in rv['v']])
+$$ LANGUAGE plcontainer;
+
+select pyspi_execute_columns();
+select pyspi_execute_columns_plan();
+
+-- cursors fetch the rows in batches instead of all at once
+CREATE FUNCTION pyspi_cursor() RETURNS text AS $$
+# container: plc_python_shared
+n = 0
+s = 0
+for r in plpy.cursor("select i from generate_series(1, 2500) i", 1000):
+	n += 1
+	s += r['i']
+return "%d %d" % (n, s)
+$$ LANGUAGE plcontainer;
+
+CREATE FUNCTION pyspi_cursor_plan() RETURNS text AS $$
+# container: plc_python_shared
+plan = plpy.prepare("select i from generate_series(1, $1) i order by i", ["int4"])
+cur = plpy.cursor(plan, [10], 4)
+first = cur.fetch(3)
+rest = cur.fetch(100)
+return "%d %s %d %d" % (first.nrows(), [r['i'] for r in first], len(rest), len(cur.fetch(1)))
+$$ LANGUAGE plcontainer;
+
+CREATE FUNCTION pyspi_cursor_close() RETURNS text AS $$
+# container: plc_python_shared
+cur = plpy.cursor("select i from generate_series(1, 100) i", 10)
+row = next(iter(cur))
+cur.close()
+try:
+	cur.fetch(1)
+except ValueError as e:
+	return "%d %s" % (row['i'], e)
+$$ LANGUAGE plcontainer;
+
+select pyspi_cursor();
+select pyspi_cursor_plan();
+select pyspi_cursor_close();
+
+-- the type info of a plan result follows the changes of its row type
+CREATE TABLE pyspi_typecache (k int, a int, b int) DISTRIBUTED BY (k);
+INSERT INTO pyspi_typecache VALUES (1, 2, 3);
+
+CREATE FUNCTION pyspi_typecache() RETURNS text AS $$
+# container: plc_python_shared
+if 'plan' not in SD:
+	SD['plan'] = plpy.prepare("select t from pyspi_typecache t")
+return str(sorted(plpy.execute(SD['plan'])[0]['t'].items()))
+$$ LANGUAGE plcontainer;
+
+select pyspi_typecache();
+ALTER TABLE pyspi_typecache ADD COLUMN c text DEFAULT 'x';
+select pyspi_typecache();
+ALTER TABLE pyspi_typecache DROP COLUMN a;
+select pyspi_typecache();
+ALTER TABLE pyspi_typecache ALTER COLUMN b TYPE text;
+select pyspi_typecache();
+DROP FUNCTION pyspi_typecache();
+DROP TABLE pyspi_typecache;
@@ -0,0 +1,34 @@
+CREATE FUNCTION srf_range(n int) RETURNS SETOF int AS $$
+# container: plc_python_shared
+for i in range(n):
+    yield i
+$$ LANGUAGE plcontainer;
+
+CREATE FUNCTION srf_text(n int) RETURNS SETOF text AS $$
+# container: plc_python_shared
+return ('t%d' % i for i in range(n))
+$$ LANGUAGE plcontainer;
+
+CREATE FUNCTION srf_fail_at(n int, bad int) RETURNS SETOF int AS $$
+# container: plc_python_shared
+for i in range(n):
+    if i == bad:
+        plpy.error('failed at row %d' % i)
+    yield i
+$$ LANGUAGE plcontainer;
+
+-- Function scan reads all the chunks into a tuplestore
+SELECT count(*), sum(x), min(x), max(x) FROM srf_range(2500) x;
+SELECT count(*) FROM srf_range(1000);
+-- Target list returns the rows chunk by chunk
+SELECT count(*), sum(x) FROM (SELECT srf_range(2500) AS x) t;
+SELECT count(*), sum(a), sum(length(b)) FROM (SELECT srf_range(2500) AS a, srf_text(2500) AS b) t;
+-- Rows left in the container are dropped
+SELECT srf_range(5000) LIMIT 3;
+SELECT * FROM srf_fail_at(3000, 1500);
+SELECT srf_fail_at(3000, 1500);
+SELECT sum(x) FROM srf_range(1500) x;
+
+DROP FUNCTION srf_range(int);
+DROP FUNCTION srf_text(int);
+DROP FUNCTION srf_fail_at(int, int);
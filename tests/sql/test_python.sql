@@ -10,10 +10,20 @@ select pyint(345::int8);
 select pyfloat(3.1415926535897932384626433832::float4);
 select pyfloat(3.1415926535897932384626433832::float8);
 select pynumeric(3.1415926535897932384626433832::numeric);
+select pynumericfloat(3.1415926535897932384626433832::numeric);
+select pynumericmix(3.1415926535897932384626433832::numeric);
 select pytimestamp('2012-01-02 12:34:56.789012'::timestamp);
 select pytimestamptz('2012-01-02 12:34:56.789012 UTC+4'::timestamptz);
+select pydatetypes('2012-01-02'::date, '2012-01-02 12:34:56'::timestamp, '2012-01-02 12:34:56+04'::timestamptz, '1 day 02:03:04'::interval, 'a0eebc99-9c0b-4ef8-bb6d-6bb9bd380a11'::uuid);
+select pybinarypoint('(1.5,2)'::point, array['(3,4)'::point]);
+select pyposint(5);
+select pyposint(2);
 select pytext('text');
 select pytext('');
+select pyvarchar('xyz', 'ab');
+select pyvarchar('', '');
+select pybpchar('ab');
+select pyvarcharspi('ab');
 select pybytea('123'::bytea);
 select pybytea(''::bytea) is null;
 select pybytea(null::bytea) is null;
@@ -31,6 +41,7 @@ select pyfloatarr(array[array[1.1,3.3,5.5,7.7],array[3.3,4.4,5.5,6.6]]::float8[]
 select pytextarr(array['aaa','bbb','ccc']::varchar[]);
 select pytextarr(array['aaa','','ccc']::varchar[]);
 select pytsarr(array['2010-01-01 00:00:00', '2010-02-02 01:01:01', '2010-03-03 03:03:03', '2012-01-01 00:00:00']::timestamp[]);
+select pytsarryear(array['2010-01-01 00:00:00', '2010-02-02 01:01:01', '2010-03-03 03:03:03', '2012-01-01 00:00:00']::timestamp[]);
 select pybyteaarr(array['123'::bytea,'321'::bytea]::bytea[]);
 select pybyteaarr(array['123'::bytea,'321'::bytea,null::bytea]::bytea[]);
 select pybyteaarr('{}'::bytea[]);
@@ -70,6 +81,11 @@ select pynested_call_one('a');
 select py_plpy_get_record();
 select pylogging();
 select pylogging2();
+SET client_min_messages = warning;
+select pylogging();
+select pylogging_order();
+RESET client_min_messages;
+select pylogging_order();
 select pygdset('1','a');
 select pygdset('2','b');
 select pygdset('3','c');
@@ -104,6 +120,7 @@ select pytestudt6();
 select pytestudt8();
 select * from pytestudt11();
 select * from pytestudt13( (1,2,'a')::test_type3 );
+select (pydroppedcol(t)).* from droppedcol_row t;
 select pytestudt16();
 select * from pytestudtrecord1() as t(a int, b int, c varchar);
 select * from pytestudtrecord2() as t(a int, b int, c varchar);
@@ -123,4 +140,6 @@ SELECT nnint_test(null, 3);
 select nested_error_raise();
 select nested_fatal_raise();
 select pseudotype_result(1);
+DROP FUNCTION pydroppedcol(droppedcol_row);
+DROP TABLE droppedcol_row;
 \! psql -d ${PL_TESTDB} -c "select pythonlogging_fatal();"
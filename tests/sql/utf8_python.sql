@@ -0,0 +1,26 @@
+-- Text returned by a function is checked against the database encoding,
+-- which is UTF8 here. See utf8_python_1.out for the messages of Greenplum 5.
+SELECT getdatabaseencoding();
+
+CREATE FUNCTION pyutf8_bytes(b bytea) RETURNS text AS $$
+# container: plc_python_shared
+return b
+$$ LANGUAGE plcontainer;
+
+-- Sequences of two, three and four bytes, and one across a 32-byte block
+SELECT octet_length(pyutf8_bytes(decode('c3a9e6bca2f09f9880', 'hex')));
+SELECT octet_length(pyutf8_bytes(decode(repeat('61', 31) || 'e6bca2' || repeat('61', 40), 'hex')));
+
+-- Overlong forms
+SELECT pyutf8_bytes(decode('c0af', 'hex'));
+SELECT pyutf8_bytes(decode(repeat('61', 40) || 'e080af', 'hex'));
+
+-- A surrogate and a code point beyond U+10FFFF
+SELECT pyutf8_bytes(decode(repeat('61', 40) || 'eda080', 'hex'));
+SELECT pyutf8_bytes(decode(repeat('61', 40) || 'f4908080', 'hex'));
+
+-- Sequences cut at the end of a 32-byte block and at the end of the value
+SELECT pyutf8_bytes(decode(repeat('61', 31) || 'e6bc' || repeat('61', 40), 'hex'));
+SELECT pyutf8_bytes(decode(repeat('61', 63) || 'e6', 'hex'));
+
+DROP FUNCTION pyutf8_bytes(bytea);
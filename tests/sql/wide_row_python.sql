@@ -0,0 +1,90 @@
+-- Rows of 600 columns, wider than the NULL and boolean bitmaps kept on the
+-- stack (512 columns), in query results, composite results and arguments.
+-- Column i is a bool, int4, text or float8 as i % 4, and NULL if i % 7 = 0.
+CREATE OR REPLACE FUNCTION pywide_create_type(n int) RETURNS void AS $$
+# container: plc_python_shared
+types = ['bool', 'int4', 'text', 'float8']
+plpy.execute('create type wide_row as (%s)' % ', '.join('c%d %s' % (i, types[i % 4]) for i in range(n)))
+$$ LANGUAGE plcontainer;
+
+SELECT pywide_create_type(600);
+
+CREATE OR REPLACE FUNCTION pywide_query(n int) RETURNS text AS $$
+# container: plc_python_shared
+types = ['bool', 'int4', 'text', 'float8']
+cols = []
+for i in range(n):
+    if i % 7 == 0:
+        v = 'NULL::%s' % types[i % 4]
+    elif i % 4 == 0:
+        v = 'true' if i % 3 == 0 else 'false'
+    elif i % 4 == 1:
+        v = '%d' % i
+    elif i % 4 == 2:
+        v = "repeat('t', %d)" % (i % 50)
+    else:
+        v = '%d.5::float8' % i
+    cols.append('%s as c%d' % (v, i))
+r = plpy.execute('select ' + ', '.join(cols))[0]
+nulls = trues = ints = texts = 0
+floats = 0.0
+for i in range(n):
+    v = r['c%d' % i]
+    if v is None:
+        nulls += 1
+    elif i % 4 == 0:
+        trues += v
+    elif i % 4 == 1:
+        ints += v
+    elif i % 4 == 2:
+        texts += len(v)
+    else:
+        floats += v
+return '%d %d %d %d %d %.1f' % (len(r), nulls, trues, ints, texts, floats)
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pywide_make(n int) RETURNS wide_row AS $$
+# container: plc_python_shared
+r = {}
+for i in range(n):
+    if i % 7 == 0:
+        r['c%d' % i] = None
+    elif i % 4 == 0:
+        r['c%d' % i] = i % 3 == 0
+    elif i % 4 == 1:
+        r['c%d' % i] = i
+    elif i % 4 == 2:
+        r['c%d' % i] = 't' * (i % 50)
+    else:
+        r['c%d' % i] = i + 0.5
+return r
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pywide_sum(r wide_row) RETURNS text AS $$
+# container: plc_python_shared
+nulls = trues = ints = texts = 0
+floats = 0.0
+for i in range(len(r)):
+    v = r['c%d' % i]
+    if v is None:
+        nulls += 1
+    elif i % 4 == 0:
+        trues += v
+    elif i % 4 == 1:
+        ints += v
+    elif i % 4 == 2:
+        texts += len(v)
+    else:
+        floats += v
+return '%d %d %d %d %d %.1f' % (len(r), nulls, trues, ints, texts, floats)
+$$ LANGUAGE plcontainer;
+
+SELECT pywide_query(600);
+SELECT pywide_sum(pywide_make(600));
+SELECT (pywide_make(600)).c0 IS NULL AS c0_null, (pywide_make(600)).c512, (pywide_make(600)).c599;
+
+DROP FUNCTION pywide_sum(wide_row);
+DROP FUNCTION pywide_make(int);
+DROP FUNCTION pywide_query(int);
+DROP FUNCTION pywide_create_type(int);
+DROP TYPE wide_row;